@@ -0,0 +1,433 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// CPU microbenchmark for the host-side code of the sample application.
+// Uses the same harness as rtxdi-sdk-benchmark and doesn't need a GPU.
+//
+// Usage: rtxdi-sample-benchmark [--filter <substring>] [--min-time <milliseconds>]
+
+#include "BenchmarkHarness.h"
+#include "LightPacking.h"
+#include "LightSlotTable.h"
+
+#include <donut/core/math/math.h>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Synthetic scene used by the PrepareLightsPass benchmarks. The pass itself needs a device and a donut scene,
+// so the benchmarks below replicate its host-side loops over these flat arrays instead: the data layout is simpler,
+// but the amount of work per instance, geometry and emitter is the same.
+struct SyntheticMaterial
+{
+    float emissiveColor[3];
+    const void* emissiveTexture;
+};
+
+struct SyntheticGeometry
+{
+    uint32_t materialIndex;
+    uint32_t triangleCount;
+};
+
+struct SyntheticInstance
+{
+    uint32_t firstGeometry;
+    uint32_t geometryCount;
+    uint32_t firstGeometryInstanceIndex;
+    uint32_t skinningFrameIndex;
+    float transform[12];
+};
+
+struct SyntheticScene
+{
+    std::vector<SyntheticMaterial> materials;
+    std::vector<SyntheticGeometry> geometries;
+    std::vector<SyntheticInstance> instances;
+    uint32_t geometryInstanceCount = 0;
+};
+
+// Same as PrepareLightsPass::EmitterState
+struct SyntheticEmitterState
+{
+    uint32_t instanceIndex;
+    uint32_t geometryIndex;
+    float transform[12];
+    float emissiveRadiance[3];
+    const void* emissiveTexture;
+    uint32_t skinningFrameIndex;
+};
+
+static uint32_t NextRandom(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// Instances of 1 to 4 geometries, using 'emissivePercentage' percent of emissive materials
+static SyntheticScene CreateSyntheticScene(uint32_t instanceCount, uint32_t emissivePercentage)
+{
+    SyntheticScene scene;
+    uint32_t state = 1;
+
+    const uint32_t materialCount = 100;
+    for (uint32_t i = 0; i < materialCount; i++)
+    {
+        const float emissive = (i < emissivePercentage) ? 1.f : 0.f;
+        scene.materials.push_back({ { emissive, emissive, emissive }, nullptr });
+    }
+
+    // Meshes are shared between instances, like in the real scenes
+    const uint32_t meshCount = 1000;
+    std::vector<std::pair<uint32_t, uint32_t>> meshes; // first geometry, geometry count
+    for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+    {
+        const uint32_t geometryCount = 1 + NextRandom(state) % 4;
+        meshes.push_back({ uint32_t(scene.geometries.size()), geometryCount });
+        for (uint32_t geometry = 0; geometry < geometryCount; geometry++)
+            scene.geometries.push_back({ NextRandom(state) % materialCount, 1 + NextRandom(state) % 64 });
+    }
+
+    for (uint32_t i = 0; i < instanceCount; i++)
+    {
+        const auto& mesh = meshes[NextRandom(state) % meshCount];
+        SyntheticInstance instance{};
+        instance.firstGeometry = mesh.first;
+        instance.geometryCount = mesh.second;
+        instance.firstGeometryInstanceIndex = scene.geometryInstanceCount;
+        instance.transform[0] = instance.transform[4] = instance.transform[8] = 1.f;
+        instance.transform[9] = float(i);
+        scene.geometryInstanceCount += mesh.second;
+        scene.instances.push_back(instance);
+    }
+
+    return scene;
+}
+
+static bool IsEmissiveGeometry(const SyntheticScene& scene, const SyntheticGeometry& geometry)
+{
+    const SyntheticMaterial& material = scene.materials[geometry.materialIndex];
+    return (material.emissiveColor[0] != 0.f || material.emissiveColor[1] != 0.f || material.emissiveColor[2] != 0.f)
+        && geometry.triangleCount > 0;
+}
+
+// Same as PrepareLightsPass::UpdateEmitterState
+static bool UpdateEmitterState(const SyntheticScene& scene, SyntheticEmitterState& state)
+{
+    const SyntheticInstance& instance = scene.instances[state.instanceIndex];
+    const SyntheticMaterial& material = scene.materials[scene.geometries[instance.firstGeometry + state.geometryIndex].materialIndex];
+
+    const bool changed = memcmp(instance.transform, state.transform, sizeof(state.transform)) != 0
+        || memcmp(material.emissiveColor, state.emissiveRadiance, sizeof(state.emissiveRadiance)) != 0
+        || material.emissiveTexture != state.emissiveTexture
+        || instance.skinningFrameIndex != state.skinningFrameIndex;
+
+    memcpy(state.transform, instance.transform, sizeof(state.transform));
+    memcpy(state.emissiveRadiance, material.emissiveColor, sizeof(state.emissiveRadiance));
+    state.emissiveTexture = material.emissiveTexture;
+    state.skinningFrameIndex = instance.skinningFrameIndex;
+
+    return changed;
+}
+
+// Compares the host-side work of a full layout update of PrepareLightsPass with the incremental update,
+// which reuses the layout and only compares the emitter snapshots to find the tasks to dispatch.
+static void BenchmarkPrepareLightsUpdate(const BenchmarkOptions& options)
+{
+    for (uint32_t instanceCount : { 20000u, 200000u })
+    {
+        SyntheticScene scene = CreateSyntheticScene(instanceCount, 10);
+        const std::string suffix = std::to_string(instanceCount);
+
+        // Full update: find the emissive geometries, look up their slots in the flat table by geometry instance
+        // index, check their state, and build the tasks and the geometry instance -> light mapping
+        struct Slot
+        {
+            uint32_t owner = ~0u;
+            uint32_t offset = 0;
+            uint32_t emitterIndex = 0;
+        };
+
+        std::vector<Slot> slots(scene.geometryInstanceCount);
+        std::vector<SyntheticEmitterState> emitterStates;
+        std::vector<PrepareLightsTask> tasks;
+
+        auto fullUpdate = [&]()
+        {
+            std::vector<uint32_t> geometryInstanceToLight(scene.geometryInstanceCount, RTXDI_INVALID_LIGHT_INDEX);
+            tasks.clear();
+            uint32_t lightBufferOffset = 0;
+
+            for (uint32_t instanceIndex = 0; instanceIndex < uint32_t(scene.instances.size()); instanceIndex++)
+            {
+                const SyntheticInstance& instance = scene.instances[instanceIndex];
+                for (uint32_t geometryIndex = 0; geometryIndex < instance.geometryCount; geometryIndex++)
+                {
+                    const SyntheticGeometry& geometry = scene.geometries[instance.firstGeometry + geometryIndex];
+                    if (!IsEmissiveGeometry(scene, geometry))
+                        continue;
+
+                    const uint32_t geometryInstanceIndex = instance.firstGeometryInstanceIndex + geometryIndex;
+                    Slot& slot = slots[geometryInstanceIndex];
+                    if (slot.owner != instanceIndex)
+                    {
+                        slot.owner = instanceIndex;
+                        slot.offset = lightBufferOffset;
+                        slot.emitterIndex = uint32_t(emitterStates.size());
+                        SyntheticEmitterState state{};
+                        state.instanceIndex = instanceIndex;
+                        state.geometryIndex = geometryIndex;
+                        emitterStates.push_back(state);
+                    }
+                    UpdateEmitterState(scene, emitterStates[slot.emitterIndex]);
+
+                    geometryInstanceToLight[geometryInstanceIndex] = slot.offset;
+
+                    PrepareLightsTask task{};
+                    task.instanceAndGeometryIndex = (instanceIndex << 12) | geometryIndex;
+                    task.triangleCount = geometry.triangleCount;
+                    task.lightBufferOffset = slot.offset;
+                    task.previousLightBufferOffset = int(slot.offset);
+                    task.dispatchOffset = slot.offset;
+                    task.emitterIndex = slot.emitterIndex;
+                    tasks.push_back(task);
+
+                    lightBufferOffset += geometry.triangleCount;
+                }
+            }
+
+            std::sort(tasks.begin(), tasks.end(), [](const PrepareLightsTask& a, const PrepareLightsTask& b)
+                { return a.lightBufferOffset < b.lightBufferOffset; });
+
+            g_Sink = g_Sink + uint32_t(tasks.size()) + geometryInstanceToLight[0];
+        };
+
+        Run(options, "PrepareLights/FullUpdate/" + suffix, fullUpdate);
+
+        // The incremental update needs the layout even if the full update has been filtered out
+        fullUpdate();
+
+        // Incremental update over the layout built above, with a fraction of the emissive instances moving every frame
+        std::vector<uint8_t> taskDirty;
+        std::vector<PrepareLightsTask> dirtyTasks;
+
+        for (uint32_t dirtyPercentage : { 0u, 1u, 10u })
+        {
+            std::vector<uint32_t> movingInstances;
+            for (const PrepareLightsTask& task : tasks)
+            {
+                if ((task.emitterIndex % 100) < dirtyPercentage)
+                    movingInstances.push_back(task.instanceAndGeometryIndex >> 12);
+            }
+
+            Run(options, "PrepareLights/IncrementalUpdate/" + suffix + "/" + std::to_string(dirtyPercentage) + "%dirty", [&]()
+            {
+                for (uint32_t instanceIndex : movingInstances)
+                    scene.instances[instanceIndex].transform[9] += 1.f;
+
+                taskDirty.resize(tasks.size());
+                uint32_t numDirtyTasks = 0;
+                for (size_t index = 0; index < tasks.size(); index++)
+                {
+                    const bool dirty = UpdateEmitterState(scene, emitterStates[tasks[index].emitterIndex]);
+                    taskDirty[index] = dirty;
+                    numDirtyTasks += dirty ? 1 : 0;
+                }
+
+                dirtyTasks.resize(numDirtyTasks);
+                uint32_t dirtyTaskIndex = 0;
+                uint32_t dispatchOffset = 0;
+                for (size_t index = 0; index < tasks.size(); index++)
+                {
+                    if (!taskDirty[index])
+                        continue;
+
+                    PrepareLightsTask& dirtyTask = dirtyTasks[dirtyTaskIndex++];
+                    dirtyTask = tasks[index];
+                    dirtyTask.dispatchOffset = dispatchOffset;
+                    dispatchOffset += dirtyTask.triangleCount;
+                }
+
+                g_Sink = g_Sink + numDirtyTasks + dispatchOffset;
+            });
+        }
+    }
+}
+
+// Compares the per-frame slot lookup and update of PrepareLightsPass, done by LightSlotTable over flat tables indexed
+// by geometry instance index, with the unordered_map keyed on hash_combine(instance, geometryIndex) that it replaced. The baseline is
+// reimplemented here, including nvrhi::hash_combine, since it's not in the tree anymore.
+static void BenchmarkLightSlotLookup(const BenchmarkOptions& options)
+{
+    struct Emitter
+    {
+        const SyntheticInstance* instance;
+        uint32_t geometryIndex;
+        uint32_t geometryInstanceIndex;
+        uint32_t triangleCount;
+    };
+
+    for (uint32_t emitterCount : { 20000u, 200000u })
+    {
+        const std::string suffix = std::to_string(emitterCount);
+
+        // Every geometry is emissive, so that the number of emitters is exact
+        SyntheticScene scene = CreateSyntheticScene(emitterCount, 100);
+        std::vector<Emitter> emitters;
+        for (const SyntheticInstance& instance : scene.instances)
+        {
+            for (uint32_t geometryIndex = 0; geometryIndex < instance.geometryCount && emitters.size() < emitterCount; geometryIndex++)
+            {
+                const uint32_t triangleCount = scene.geometries[instance.firstGeometry + geometryIndex].triangleCount;
+                emitters.push_back({ &instance, geometryIndex, instance.firstGeometryInstanceIndex + geometryIndex, triangleCount });
+            }
+        }
+
+        // Baseline: find the previous offset by hash and store the new one, which rehashes and inserts into the node map
+        {
+            auto hashCombine = [](size_t& seed, auto value)
+            {
+                seed ^= std::hash<decltype(value)>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            };
+
+            std::unordered_map<size_t, uint32_t> lightBufferOffsets;
+
+            Run(options, "LightSlotLookup/HashedMap/" + suffix, [&]()
+            {
+                uint32_t lightBufferOffset = 0;
+                uint32_t numFound = 0;
+                for (const Emitter& emitter : emitters)
+                {
+                    size_t instanceHash = 0;
+                    hashCombine(instanceHash, static_cast<const void*>(emitter.instance));
+                    hashCombine(instanceHash, size_t(emitter.geometryIndex));
+
+                    auto pOffset = lightBufferOffsets.find(instanceHash);
+                    const int previousOffset = (pOffset != lightBufferOffsets.end()) ? int(pOffset->second) : -1;
+                    numFound += (previousOffset >= 0) ? 1 : 0;
+
+                    lightBufferOffsets[instanceHash] = lightBufferOffset;
+                    lightBufferOffset += emitter.triangleCount;
+                }
+
+                g_Sink = g_Sink + numFound + lightBufferOffset;
+            });
+        }
+
+        // Slot table: the emitters are matched by the stable ID of their instance and keep their slots,
+        // using the LightSlotTable of PrepareLightsPass::ProcessLayoutUpdate
+        {
+            std::vector<LayoutEmitter> layoutEmitters(emitters.size());
+            for (size_t index = 0; index < emitters.size(); index++)
+            {
+                const Emitter& emitter = emitters[index];
+                LayoutEmitter& layoutEmitter = layoutEmitters[index];
+                layoutEmitter.owner = { uint32_t(emitter.instance - scene.instances.data()), 0 };
+                layoutEmitter.geometryIndex = emitter.geometryIndex;
+                layoutEmitter.geometryInstanceIndex = emitter.geometryInstanceIndex;
+                layoutEmitter.count = emitter.triangleCount;
+            }
+
+            uint32_t capacity = 0;
+            for (const Emitter& emitter : emitters)
+                capacity += emitter.triangleCount;
+
+            LightSlotTable table;
+            std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+
+            Run(options, "LightSlotLookup/SlotTable/" + suffix, [&]()
+            {
+                freedRanges.clear();
+                table.Update(nullptr, layoutEmitters, scene.geometryInstanceCount, capacity, freedRanges);
+
+                uint32_t numFound = 0;
+                for (const LayoutEmitter& emitter : layoutEmitters)
+                    numFound += (emitter.previousLightBufferOffset >= 0) ? 1 : 0;
+
+                g_Sink = g_Sink + numFound + table.GetSlotAllocator().GetUsedRangeEnd();
+            });
+        }
+    }
+}
+
+// Compares packing analytic lights one by one with PackLight, which is what ConvertLight does for a single light,
+// with the structure-of-arrays batch on its scalar and AVX2 paths.
+static void BenchmarkLightPacking(const BenchmarkOptions& options)
+{
+    const uint32_t lightCount = 100000;
+    const std::string suffix = std::to_string(lightCount);
+
+    std::vector<LightPackingInput> inputs(lightCount);
+    LightPackingBatch batch;
+    uint32_t state = 1;
+    auto random = [&state]() { return float(NextRandom(state) & 0xffff) / 65535.f; };
+
+    for (uint32_t index = 0; index < lightCount; index++)
+    {
+        LightPackingInput& input = inputs[index];
+        input.colorTypeAndFlags = (index % 6) << kPolymorphicLightTypeShift;
+        input.radiance = float3(random(), random(), random()) * 100.f;
+        input.center = float3(random(), random(), random()) * 1000.f;
+        input.scalars[0] = random();
+        input.scalars[1] = random() * 10.f;
+        input.direction1 = normalize(float3(random() - 0.5f, random() - 0.5f, random() + 0.1f));
+        input.direction2 = normalize(float3(random() - 0.5f, random() + 0.1f, random() - 0.5f));
+        input.primaryAxis = normalize(float3(random() + 0.1f, random() - 0.5f, random() - 0.5f));
+        input.cosConeAngleAndSoftness[0] = random();
+        input.cosConeAngleAndSoftness[1] = random();
+        batch.Append(input, index);
+    }
+
+    std::vector<PolymorphicLightInfo> lights(lightCount);
+
+    Run(options, "LightPacking/PackLight/" + suffix, [&]()
+    {
+        for (uint32_t index = 0; index < lightCount; index++)
+            PackLight(inputs[index], lights[index]);
+        g_Sink = g_Sink + lights[lightCount - 1].direction1;
+    });
+
+    Run(options, "LightPacking/BatchScalar/" + suffix, [&]()
+    {
+        batch.Pack(lights.data(), false);
+        g_Sink = g_Sink + lights[lightCount - 1].direction1;
+    });
+
+    if (IsLightPackingSimdSupported())
+    {
+        Run(options, "LightPacking/BatchAVX2/" + suffix, [&]()
+        {
+            batch.Pack(lights.data(), true);
+            g_Sink = g_Sink + lights[lightCount - 1].direction1;
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!ParseBenchmarkOptions(argc, argv, options))
+        return 1;
+
+    PrintBenchmarkHeader();
+
+    BenchmarkPrepareLightsUpdate(options);
+    BenchmarkLightSlotLookup(options);
+    BenchmarkLightPacking(options);
+
+    return 0;
+}
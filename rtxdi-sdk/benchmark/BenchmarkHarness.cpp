@@ -0,0 +1,123 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BenchmarkHarness.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Global allocation counter, incremented by the replaced operator new below.
+// Allocations made through the aligned overloads are not counted, the benchmarked code doesn't use them.
+static std::atomic<uint64_t> g_AllocationCount{ 0 };
+
+void* operator new(size_t size)
+{
+    g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+volatile uint32_t g_Sink = 0;
+
+struct BenchmarkResult
+{
+    uint64_t iterations = 0;
+    double nanosecondsPerCall = 0.0;
+    double allocationsPerCall = 0.0;
+};
+
+static BenchmarkResult Measure(const BenchmarkOptions& options, const std::function<void()>& function)
+{
+    using clock = std::chrono::steady_clock;
+
+    // Warm up the caches and any lazily initialized state
+    function();
+
+    BenchmarkResult result;
+    uint64_t iterations = 1;
+
+    while (true)
+    {
+        const uint64_t allocationsBefore = g_AllocationCount.load(std::memory_order_relaxed);
+        const auto start = clock::now();
+
+        for (uint64_t i = 0; i < iterations; i++)
+            function();
+
+        const auto end = clock::now();
+        const uint64_t allocationsAfter = g_AllocationCount.load(std::memory_order_relaxed);
+
+        const double seconds = std::chrono::duration<double>(end - start).count();
+
+        // Keep doubling the iteration count until the measurement takes long enough to be stable
+        if (seconds >= options.minTimeSeconds || iterations >= (1ull << 40))
+        {
+            result.iterations = iterations;
+            result.nanosecondsPerCall = seconds * 1e9 / double(iterations);
+            result.allocationsPerCall = double(allocationsAfter - allocationsBefore) / double(iterations);
+            return result;
+        }
+
+        iterations *= 2;
+    }
+}
+
+bool ParseBenchmarkOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+        {
+            options.filter = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--min-time") && i + 1 < argc)
+        {
+            options.minTimeSeconds = atof(argv[++i]) * 1e-3;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time <milliseconds>]\n", argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PrintBenchmarkHeader()
+{
+    printf("%-72s %14s %12s %12s\n", "Benchmark", "ns/call", "allocs/call", "iterations");
+}
+
+void Run(const BenchmarkOptions& options, const std::string& name, const std::function<void()>& function)
+{
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+        return;
+
+    BenchmarkResult result = Measure(options, function);
+
+    printf("%-72s %14.1f %12.2f %12llu\n", name.c_str(), result.nanosecondsPerCall, result.allocationsPerCall,
+        (unsigned long long)result.iterations);
+}
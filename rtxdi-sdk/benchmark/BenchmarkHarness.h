@@ -0,0 +1,36 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Measurement harness shared by the CPU benchmarks of the SDK and of the sample application.
+// BenchmarkHarness.cpp replaces the global operator new to count the heap allocations per call.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// A sink for benchmark results that prevents the compiler from optimizing the measured code away.
+extern volatile uint32_t g_Sink;
+
+struct BenchmarkOptions
+{
+    std::string filter;
+    double minTimeSeconds = 0.1;
+};
+
+// Parses [--filter <substring>] [--min-time <milliseconds>], prints the usage and returns false on other arguments.
+bool ParseBenchmarkOptions(int argc, char** argv, BenchmarkOptions& options);
+
+// Prints the header of the result table that Run(...) adds lines to.
+void PrintBenchmarkHeader();
+
+// Measures the function if its name matches the filter, and prints the time and heap allocations per call.
+void Run(const BenchmarkOptions& options, const std::string& name, const std::function<void()>& function);
@@ -0,0 +1,355 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// CPU microbenchmark for the host-side RTXDI SDK functions.
+// It doesn't need a GPU or a graphics API, so it can run on headless build agents.
+//
+// Usage: rtxdi-sdk-benchmark [--filter <substring>] [--min-time <milliseconds>]
+
+#include "BenchmarkHarness.h"
+
+#include <rtxdi/AliasTable.h>
+#include <rtxdi/RTXDI.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const char* GetReGIRModeName(rtxdi::ReGIRMode mode)
+{
+    switch (mode)
+    {
+    case rtxdi::ReGIRMode::Disabled: return "Disabled";
+    case rtxdi::ReGIRMode::Grid: return "Grid";
+    case rtxdi::ReGIRMode::Onion: return "Onion";
+    case rtxdi::ReGIRMode::AlignGrid: return "AlignGrid";
+    case rtxdi::ReGIRMode::HashGrid: return "HashGrid";
+    }
+    return "Unknown";
+}
+
+static std::string DescribeParameters(const rtxdi::ContextParameters& params)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%ux%u/%s/L%u",
+        params.RenderWidth, params.RenderHeight, GetReGIRModeName(params.ReGIR.Mode), params.ReGIR.OnionDetailLayers);
+    return buf;
+}
+
+static std::vector<rtxdi::ContextParameters> GetParameterSweep()
+{
+    const rtxdi::uint3 renderSizes[] = {
+        { 1280, 720, 0 },
+        { 1920, 1080, 0 },
+        { 3840, 2160, 0 },
+    };
+
+    const rtxdi::ReGIRMode regirModes[] = {
+        rtxdi::ReGIRMode::Disabled,
+        rtxdi::ReGIRMode::Grid,
+        rtxdi::ReGIRMode::Onion,
+        rtxdi::ReGIRMode::AlignGrid,
+        rtxdi::ReGIRMode::HashGrid,
+    };
+
+    const uint32_t onionLayerCounts[] = { 1, 5, RTXDI_ONION_MAX_LAYER_GROUPS };
+
+    std::vector<rtxdi::ContextParameters> sweep;
+
+    for (const auto& renderSize : renderSizes)
+    {
+        for (rtxdi::ReGIRMode regirMode : regirModes)
+        {
+            for (uint32_t onionLayers : onionLayerCounts)
+            {
+                // The onion layer count only matters in the Onion mode, don't multiply the other modes
+                if (regirMode != rtxdi::ReGIRMode::Onion && onionLayers != 5)
+                    continue;
+
+                rtxdi::ContextParameters params;
+                params.RenderWidth = renderSize.x;
+                params.RenderHeight = renderSize.y;
+                params.ReGIR.Mode = regirMode;
+                params.ReGIR.OnionDetailLayers = onionLayers;
+                sweep.push_back(params);
+            }
+        }
+    }
+
+    return sweep;
+}
+
+static rtxdi::FrameParameters GetTypicalFrameParameters()
+{
+    rtxdi::FrameParameters frame;
+    frame.frameIndex = 1;
+    frame.numLocalLights = 100000;
+    frame.firstInfiniteLight = frame.numLocalLights;
+    frame.numInfiniteLights = 1;
+    frame.environmentLightPresent = true;
+    frame.environmentLightIndex = frame.firstInfiniteLight + frame.numInfiniteLights;
+    frame.enableLocalLightImportanceSampling = true;
+    frame.regirCenter = { 1.f, 2.f, 3.f };
+    frame.numEmissionThing = 0;
+    frame.currentFrameLightOffset = 0;
+    return frame;
+}
+
+static void BenchmarkContext(const BenchmarkOptions& options)
+{
+    for (const rtxdi::ContextParameters& params : GetParameterSweep())
+    {
+        const std::string suffix = DescribeParameters(params);
+
+        Run(options, "Context::Context/" + suffix, [&params]()
+        {
+            rtxdi::Context context(params);
+            g_Sink = g_Sink + context.GetReservoirBufferElementCount();
+        });
+
+        rtxdi::Context context(params);
+        rtxdi::FrameParameters frame = GetTypicalFrameParameters();
+        RTXDI_ResamplingRuntimeParameters runtimeParams{};
+
+        Run(options, "Context::FillRuntimeParameters/" + suffix, [&]()
+        {
+            frame.frameIndex++;
+            context.FillRuntimeParameters(runtimeParams, frame);
+            g_Sink = g_Sink + runtimeParams.uniformRandomNumber;
+        });
+
+        uint32_t staticVersion = 0;
+
+        Run(options, "Context::Resize/" + suffix, [&]()
+        {
+            // Alternate between two sizes, like a dynamic resolution controller would
+            const uint32_t scale = (++frame.frameIndex & 1) ? 2 : 1;
+            context.Resize(params.RenderWidth / scale, params.RenderHeight / scale);
+            g_Sink = g_Sink + context.GetReservoirBufferElementCount();
+        });
+        context.Resize(params.RenderWidth, params.RenderHeight);
+
+        Run(options, "Context::UpdateRuntimeParameters/" + suffix, [&]()
+        {
+            frame.frameIndex++;
+            context.UpdateRuntimeParameters(runtimeParams, frame, staticVersion);
+            g_Sink = g_Sink + runtimeParams.uniformRandomNumber + staticVersion;
+        });
+    }
+}
+
+static void BenchmarkNeighborOffsets(const BenchmarkOptions& options)
+{
+    const uint32_t neighborOffsetCounts[] = { 1024, 8192, 32768 };
+
+    for (uint32_t neighborOffsetCount : neighborOffsetCounts)
+    {
+        rtxdi::ContextParameters params;
+        params.RenderWidth = 1920;
+        params.RenderHeight = 1080;
+        params.NeighborOffsetCount = neighborOffsetCount;
+
+        rtxdi::Context context(params);
+        std::vector<uint8_t> buffer(neighborOffsetCount * 2);
+
+        Run(options, "Context::FillNeighborOffsetBuffer/" + std::to_string(neighborOffsetCount), [&]()
+        {
+            context.FillNeighborOffsetBuffer(buffer.data());
+            g_Sink = g_Sink + buffer[buffer.size() - 1];
+        });
+    }
+}
+
+static void BenchmarkReservoirLayout(const BenchmarkOptions& options)
+{
+    const uint32_t blockSizes[] = { 8, 16, 32 };
+    const rtxdi::ReservoirBlockLayout layouts[] = { rtxdi::ReservoirBlockLayout::RowMajor, rtxdi::ReservoirBlockLayout::ZCurve };
+
+    for (uint32_t blockSize : blockSizes)
+    {
+        for (rtxdi::ReservoirBlockLayout layout : layouts)
+        {
+            rtxdi::ContextParameters params;
+            params.RenderWidth = 1920;
+            params.RenderHeight = 1080;
+            params.ReservoirBlockSize = blockSize;
+            params.ReservoirLayout = layout;
+
+            rtxdi::Context context(params);
+            RTXDI_ResamplingRuntimeParameters runtimeParams{};
+            context.FillRuntimeParameters(runtimeParams, GetTypicalFrameParameters());
+
+            const std::string name = "ReservoirPositionToPointer/" + std::to_string(blockSize)
+                + (layout == rtxdi::ReservoirBlockLayout::ZCurve ? "/ZCurve" : "/RowMajor");
+
+            // One call covers a full 64x64 pixel tile
+            Run(options, name, [&runtimeParams]()
+            {
+                uint32_t sum = 0;
+                for (uint32_t y = 0; y < 64; y++)
+                    for (uint32_t x = 0; x < 64; x++)
+                        sum += rtxdi::ReservoirPositionToPointer(runtimeParams, x + (g_Sink & 1), y, 1);
+                g_Sink = g_Sink + sum;
+            });
+        }
+    }
+}
+
+static void BenchmarkReGIRHashGrid(const BenchmarkOptions& options)
+{
+    // Fill the table to the given fraction of its capacity with the cells of a 2D surface,
+    // which is roughly what the cells around the visible geometry look like
+    const uint32_t loadPercentages[] = { 25, 50, 75 };
+
+    for (uint32_t loadPercentage : loadPercentages)
+    {
+        rtxdi::ContextParameters params;
+        params.RenderWidth = 1920;
+        params.RenderHeight = 1080;
+        params.ReGIR.Mode = rtxdi::ReGIRMode::HashGrid;
+        params.ReGIR.HashGridCapacity = 16384;
+
+        rtxdi::Context context(params);
+        RTXDI_ResamplingRuntimeParameters runtimeParams{};
+        rtxdi::FrameParameters frame = GetTypicalFrameParameters();
+        frame.regirCellSize = 1.f;
+        context.FillRuntimeParameters(runtimeParams, frame);
+
+        const uint32_t tableSize = context.GetReGIRHashTableSize();
+        const uint32_t numCells = tableSize * loadPercentage / 100;
+        const uint32_t surfaceWidth = 128;
+
+        std::vector<rtxdi::float3> positions(numCells);
+        for (uint32_t i = 0; i < numCells; i++)
+            positions[i] = { float(i % surfaceWidth) + 0.5f, 2.5f, float(i / surfaceWidth) + 0.5f };
+
+        std::vector<uint32_t> table(tableSize, RTXDI_REGIR_HASH_EMPTY_KEY);
+
+        const std::string suffix = std::to_string(tableSize) + "/load" + std::to_string(loadPercentage);
+
+        Run(options, "ReGIRHashGridInsert/" + suffix, [&]()
+        {
+            std::fill(table.begin(), table.end(), RTXDI_REGIR_HASH_EMPTY_KEY);
+            uint32_t sum = 0;
+            for (const rtxdi::float3& position : positions)
+                sum += uint32_t(rtxdi::ReGIRHashGridInsert(runtimeParams, table.data(), position));
+            g_Sink = g_Sink + sum;
+        });
+
+        Run(options, "ReGIRHashGridLookup/" + suffix, [&]()
+        {
+            uint32_t sum = 0;
+            for (const rtxdi::float3& position : positions)
+                sum += uint32_t(rtxdi::ReGIRHashGridLookup(runtimeParams, table.data(), position));
+            g_Sink = g_Sink + sum;
+        });
+    }
+}
+
+static void BenchmarkPdfTextureSize(const BenchmarkOptions& options)
+{
+    const uint32_t itemCounts[] = { 1, 1000, 65536, 1000000, 16777216 };
+
+    for (uint32_t itemCount : itemCounts)
+    {
+        Run(options, "ComputePdfTextureSize/" + std::to_string(itemCount), [itemCount]()
+        {
+            uint32_t width, height, mips;
+            rtxdi::ComputePdfTextureSize(itemCount + (g_Sink & 1), width, height, mips);
+            g_Sink = g_Sink + width + height + mips;
+        });
+    }
+}
+
+// Compares building an alias table over the light power with its baseline, "PdfTextureMipChain": the mip chain of
+// the local light PDF texture that the alias table replaces, built on the CPU from the same power values. The application
+// builds that mip chain on the GPU, so the baseline measures the amount of work rather than the cost in a frame.
+// The lights are stored in the texture in row-major order instead of the Z-curve, which makes no difference for the
+// downsampling cost.
+static void BenchmarkAliasTable(const BenchmarkOptions& options)
+{
+    const uint32_t lightCounts[] = { 1000, 65536, 1000000 };
+
+    for (uint32_t lightCount : lightCounts)
+    {
+        // A few bright lights among many dim ones, generated with a fixed seed
+        std::vector<float> powers(lightCount);
+        uint32_t state = 12345;
+        for (uint32_t i = 0; i < lightCount; i++)
+        {
+            state = state * 1664525u + 1013904223u;
+            const float rnd = float(state >> 8) * (1.f / 16777216.f);
+            powers[i] = rnd * rnd * rnd * 100.f;
+        }
+
+        rtxdi::AliasTable aliasTable;
+
+        Run(options, "AliasTable::Build/" + std::to_string(lightCount), [&]()
+        {
+            aliasTable.Build(powers.data(), lightCount);
+            g_Sink = g_Sink + aliasTable.GetEntries()[0].alias;
+        });
+
+        uint32_t width, height, mipLevels;
+        rtxdi::ComputePdfTextureSize(lightCount, width, height, mipLevels);
+
+        std::vector<std::vector<float>> mips(mipLevels);
+        for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++)
+            mips[mipLevel].resize(size_t(std::max(width >> mipLevel, 1u)) * std::max(height >> mipLevel, 1u));
+
+        Run(options, "PdfTextureMipChain/" + std::to_string(lightCount), [&]()
+        {
+            std::copy(powers.begin(), powers.end(), mips[0].begin());
+            std::fill(mips[0].begin() + lightCount, mips[0].end(), 0.f);
+
+            for (uint32_t mipLevel = 1; mipLevel < mipLevels; mipLevel++)
+            {
+                const uint32_t srcWidth = std::max(width >> (mipLevel - 1), 1u);
+                const uint32_t srcHeight = std::max(height >> (mipLevel - 1), 1u);
+                const uint32_t dstWidth = std::max(width >> mipLevel, 1u);
+                const uint32_t dstHeight = std::max(height >> mipLevel, 1u);
+                const float* src = mips[mipLevel - 1].data();
+                float* dst = mips[mipLevel].data();
+
+                for (uint32_t y = 0; y < dstHeight; y++)
+                {
+                    for (uint32_t x = 0; x < dstWidth; x++)
+                    {
+                        const uint32_t x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+                        const uint32_t y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+                        dst[y * dstWidth + x] = (src[y0 * srcWidth + x0] + src[y0 * srcWidth + x1] +
+                            src[y1 * srcWidth + x0] + src[y1 * srcWidth + x1]) * 0.25f;
+                    }
+                }
+            }
+
+            g_Sink = g_Sink + uint32_t(mips[mipLevels - 1][0]);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!ParseBenchmarkOptions(argc, argv, options))
+        return 1;
+
+    PrintBenchmarkHeader();
+
+    BenchmarkContext(options);
+    BenchmarkNeighborOffsets(options);
+    BenchmarkReservoirLayout(options);
+    BenchmarkReGIRHashGrid(options);
+    BenchmarkPdfTextureSize(options);
+    BenchmarkAliasTable(options);
+
+    return 0;
+}
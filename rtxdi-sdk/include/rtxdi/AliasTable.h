@@ -0,0 +1,101 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "RtxdiParameters.h"
+
+namespace rtxdi
+{
+    // Alias table over a discrete distribution, which selects an element with two random numbers and one
+    // table fetch regardless of the number of elements. Built with Vose's method in O(N).
+    //
+    // For local light sampling, the table is built from the per-light power and uploaded into the buffer
+    // referenced by RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER, where it replaces the PDF texture mip chain:
+    // see RTXDI_PresampleLocalLightsFromAliasTable.
+    //
+    // Sample and EvaluatePdf are the reference implementations of RTXDI_SampleAliasTable and
+    // RTXDI_EvaluateAliasTablePdf in the shaders.
+    class AliasTable
+    {
+    private:
+        std::vector<RTXDI_AliasTableEntry> m_Entries;
+        std::vector<double> m_ScaledWeights;
+        std::vector<uint32_t> m_Small;
+        std::vector<uint32_t> m_Large;
+        double m_WeightSum = 0.0;
+
+    public:
+        // Builds the table over weights[0, count). Negative and NaN weights are treated as zero,
+        // and elements with zero weight are never selected. If all weights are zero, every pdf is zero.
+        void Build(const float* weights, uint32_t count);
+
+        void Clear();
+
+        const std::vector<RTXDI_AliasTableEntry>& GetEntries() const { return m_Entries; }
+        uint32_t GetSize() const { return uint32_t(m_Entries.size()); }
+        double GetWeightSum() const { return m_WeightSum; }
+
+        // Selects an element with the random numbers 'rndIndex' and 'rndAlias' in [0, 1).
+        // Returns false if the table is empty or all weights are zero.
+        bool Sample(float rndIndex, float rndAlias, uint32_t& outIndex, float& outPdf) const;
+
+        // Returns the probability of Sample selecting the given element.
+        float EvaluatePdf(uint32_t index) const;
+    };
+
+    // Alias table over a width x height grid of weights, such as the pixels of an environment map.
+    // The rows are selected from a marginal table over the row sums, and the column from the conditional
+    // table of the selected row, so sampling takes two fetches. GetEntries() contains the 'height' marginal
+    // entries followed by 'width' conditional entries for every row, which is the layout that
+    // RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER expects. The pdf fields of the conditional entries are
+    // relative to their row.
+    //
+    // The rows are independent, so they can be built in parallel: call Resize, then BuildRows on disjoint
+    // row ranges from any number of threads, then BuildMarginal. Build does all of that serially.
+    class AliasTable2D
+    {
+    private:
+        std::vector<RTXDI_AliasTableEntry> m_Entries;
+        std::vector<float> m_RowWeights;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        double m_WeightSum = 0.0;
+
+    public:
+        void Resize(uint32_t width, uint32_t height);
+
+        // Builds the conditional tables of rows [beginRow, endRow). 'weights' points at the whole grid, row by row.
+        void BuildRows(const float* weights, uint32_t beginRow, uint32_t endRow);
+
+        // Builds the marginal table from the row sums computed by BuildRows.
+        void BuildMarginal();
+
+        void Build(const float* weights, uint32_t width, uint32_t height);
+
+        void Clear();
+
+        const std::vector<RTXDI_AliasTableEntry>& GetEntries() const { return m_Entries; }
+        uint32_t GetWidth() const { return m_Width; }
+        uint32_t GetHeight() const { return m_Height; }
+        double GetWeightSum() const { return m_WeightSum; }
+
+        // Selects a grid cell with four random numbers in [0, 1), returning its probability in outPdf.
+        // Returns false if the grid is empty or all weights are zero.
+        bool Sample(float rndRow, float rndRowAlias, float rndColumn, float rndColumnAlias,
+            uint32_t& outX, uint32_t& outY, float& outPdf) const;
+
+        // Returns the probability of Sample selecting the given cell.
+        float EvaluatePdf(uint32_t x, uint32_t y) const;
+    };
+}
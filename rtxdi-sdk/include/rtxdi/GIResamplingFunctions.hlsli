@@ -255,7 +255,7 @@ RTXDI_GIReservoir RTXDI_GITemporalResampling(
 
         // Read temporal reservoir.
         uint2 prevReservoirPos = RTXDI_PixelPosToReservoirPos(idx, params);
-        temporalReservoir = RTXDI_LoadGIReservoir(params, prevReservoirPos, tparams.sourceBufferIndex);
+        temporalReservoir = RTXDI_LoadGIReservoir(params, prevReservoirPos, tparams.sourceBufferIndex, RAB_GetSurfaceWorldPos(temporalSurface));
 
         // Check if the reservoir is a valid one.
         if (!RTXDI_IsValidGIReservoir(temporalReservoir))
@@ -441,7 +441,7 @@ RTXDI_GIReservoir RTXDI_GISpatialResampling(
         }
 
         const uint2 neighborReservoirPos = RTXDI_PixelPosToReservoirPos(idx, params);
-        RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, sparams.sourceBufferIndex);
+        RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, sparams.sourceBufferIndex, RAB_GetSurfaceWorldPos(neighborSurface));
 
         if (!RTXDI_IsValidGIReservoir(neighborReservoir))
         {
@@ -501,7 +501,7 @@ RTXDI_GIReservoir RTXDI_GISpatialResampling(
             RAB_Surface neighborSurface = RAB_GetGBufferSurface(idx, false);
 
             const uint2 neighborReservoirPos = RTXDI_PixelPosToReservoirPos(idx, params);
-            RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, sparams.sourceBufferIndex);
+            RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, sparams.sourceBufferIndex, RAB_GetSurfaceWorldPos(neighborSurface));
 
             // Get the PDF of the sample RIS selected in the first loop, above, *at this neighbor*
             float ps = RAB_GetGISampleTargetPdfForSurface(curReservoir.position, curReservoir.radiance, neighborSurface);
@@ -722,7 +722,7 @@ RTXDI_GIReservoir RTXDI_GISpatioTemporalResampling(
         }
 
         const uint2 neighborReservoirPos = RTXDI_PixelPosToReservoirPos(idx, params);
-        RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, stparams.sourceBufferIndex);
+        RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, stparams.sourceBufferIndex, RAB_GetSurfaceWorldPos(neighborSurface));
 
         if (!RTXDI_IsValidGIReservoir(neighborReservoir))
         {
@@ -815,7 +815,7 @@ RTXDI_GIReservoir RTXDI_GISpatioTemporalResampling(
             RAB_Surface neighborSurface = RAB_GetGBufferSurface(idx, true);
 
             const uint2 neighborReservoirPos = RTXDI_PixelPosToReservoirPos(idx, params);
-            RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, stparams.sourceBufferIndex);
+            RTXDI_GIReservoir neighborReservoir = RTXDI_LoadGIReservoir(params, neighborReservoirPos, stparams.sourceBufferIndex, RAB_GetSurfaceWorldPos(neighborSurface));
 
             // Clamp history length
             neighborReservoir.M = min(neighborReservoir.M, stparams.maxHistoryLength);
@@ -55,6 +55,58 @@ static const uint RTXDI_PackedGIReservoir_MaxM = 0x0ff;
 static const uint RTXDI_PackedGIReservoir_AgeShift = 8;
 static const uint RTXDI_PackedGIReservoir_MaxAge = 0x0ff;
 
+#if RTXDI_COMPACT_GI_RESERVOIR
+
+// The compact form stores the distance from the surface to the sample as fp16 in the upper half of packed_distance_age_M.
+static const uint RTXDI_PackedGIReservoir_DistanceShift = 16;
+static const float RTXDI_PackedGIReservoir_MaxDistance = 65504.0; // Largest finite fp16 value
+
+// Converts a GIReservoir into its compact packed form.
+// The sample position is stored relative to 'surfacePosition', the position of the surface that owns the reservoir,
+// and the same position must be passed to RTXDI_UnpackGIReservoir to reconstruct it.
+RTXDI_PackedGIReservoir RTXDI_PackGIReservoir(const RTXDI_GIReservoir reservoir, const float3 surfacePosition)
+{
+    RTXDI_PackedGIReservoir data;
+
+    float3 offset = reservoir.position - surfacePosition;
+    float distance = length(offset);
+    float3 direction = (distance > 0) ? offset / distance : float3(0.0, 0.0, 1.0);
+
+    data.packed_distance_age_M =
+        (f32tof16(min(distance, RTXDI_PackedGIReservoir_MaxDistance)) << RTXDI_PackedGIReservoir_DistanceShift)
+        | (min(reservoir.age, RTXDI_PackedGIReservoir_MaxAge) << RTXDI_PackedGIReservoir_AgeShift)
+        | (min(reservoir.M, RTXDI_PackedGIReservoir_MaxM) << RTXDI_PackedGIReservoir_MShift);
+
+    data.packed_radiance = RTXDI_EncodeRGBToLogLuv(reservoir.radiance);
+    data.packed_direction = RTXDI_EncodeNormalizedVectorToSnorm2x16(direction);
+    data.packed_weight_normal = (RTXDI_FloatToBFloat16(reservoir.weightSum) << 16)
+        | RTXDI_EncodeNormalizedVectorToSnorm2x8(reservoir.normal);
+
+    return data;
+}
+
+// Converts a compact PackedGIReservoir into its unpacked form, see RTXDI_PackGIReservoir(...)
+RTXDI_GIReservoir RTXDI_UnpackGIReservoir(RTXDI_PackedGIReservoir data, const float3 surfacePosition)
+{
+    RTXDI_GIReservoir res;
+
+    float distance = f16tof32(data.packed_distance_age_M >> RTXDI_PackedGIReservoir_DistanceShift);
+    res.position = surfacePosition + RTXDI_DecodeNormalizedVectorFromSnorm2x16(data.packed_direction) * distance;
+    res.normal = RTXDI_DecodeNormalizedVectorFromSnorm2x8(data.packed_weight_normal);
+
+    res.radiance = RTXDI_DecodeLogLuvToRGB(data.packed_radiance);
+
+    res.weightSum = RTXDI_BFloat16ToFloat(data.packed_weight_normal >> 16);
+
+    res.M = (data.packed_distance_age_M >> RTXDI_PackedGIReservoir_MShift) & RTXDI_PackedGIReservoir_MaxM;
+
+    res.age = (data.packed_distance_age_M >> RTXDI_PackedGIReservoir_AgeShift) & RTXDI_PackedGIReservoir_MaxAge;
+
+    return res;
+}
+
+#else // RTXDI_COMPACT_GI_RESERVOIR
+
 // "misc data" only exists in the packed form of GI reservoir and stored into a gap field of the packed form.
 // RTXDI SDK doesn't look into this field at all and when it stores a packed GI reservoir, the field is always filled with zero.
 // Application can use this field to store anything.
@@ -165,6 +217,44 @@ void RTXDI_StoreGIReservoir(
 
 #endif // RTXDI_ENABLE_STORE_RESERVOIR
 
+#endif // RTXDI_COMPACT_GI_RESERVOIR
+
+// Loads a GI reservoir that belongs to the surface at 'surfacePosition', which is required to reconstruct the sample
+// position with the compact reservoir form. Works with both forms.
+RTXDI_GIReservoir RTXDI_LoadGIReservoir(
+    RTXDI_ResamplingRuntimeParameters params,
+    uint2 reservoirPosition,
+    uint reservoirArrayIndex,
+    float3 surfacePosition)
+{
+    uint pointer = RTXDI_ReservoirPositionToPointer(params, reservoirPosition, reservoirArrayIndex);
+#if RTXDI_COMPACT_GI_RESERVOIR
+    return RTXDI_UnpackGIReservoir(RTXDI_GI_RESERVOIR_BUFFER[pointer], surfacePosition);
+#else
+    return RTXDI_UnpackGIReservoir(RTXDI_GI_RESERVOIR_BUFFER[pointer]);
+#endif
+}
+
+#if RTXDI_ENABLE_STORE_RESERVOIR
+
+// Stores a GI reservoir that belongs to the surface at 'surfacePosition', see RTXDI_LoadGIReservoir(...)
+void RTXDI_StoreGIReservoir(
+    const RTXDI_GIReservoir reservoir,
+    const float3 surfacePosition,
+    RTXDI_ResamplingRuntimeParameters params,
+    uint2 reservoirPosition,
+    uint reservoirArrayIndex)
+{
+    uint pointer = RTXDI_ReservoirPositionToPointer(params, reservoirPosition, reservoirArrayIndex);
+#if RTXDI_COMPACT_GI_RESERVOIR
+    RTXDI_GI_RESERVOIR_BUFFER[pointer] = RTXDI_PackGIReservoir(reservoir, surfacePosition);
+#else
+    RTXDI_GI_RESERVOIR_BUFFER[pointer] = RTXDI_PackGIReservoir(reservoir, 0);
+#endif
+}
+
+#endif // RTXDI_ENABLE_STORE_RESERVOIR
+
 RTXDI_GIReservoir RTXDI_EmptyGIReservoir()
 {
     RTXDI_GIReservoir s;
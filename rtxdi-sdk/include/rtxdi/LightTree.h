@@ -0,0 +1,96 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "RTXDI.h"
+
+namespace rtxdi
+{
+    // Spatial and directional bounds of a single local light, the input to LightTree.
+    struct LightTreeLightBounds
+    {
+        float3 boundsMin{};
+        float3 boundsMax{};
+
+        // Axis of the cone that bounds the normals of the emitting surface.
+        float3 axis{ 0.f, 0.f, 1.f };
+
+        // Cosine of the half-angle of the normal cone: 1 for planar lights, -1 for lights without a preferred direction.
+        float cosThetaO = -1.f;
+
+        // Cosine of the largest angle between the normal and the emitted directions, 0 for a hemisphere.
+        float cosThetaE = 0.f;
+
+        // Emitted power. Lights with zero power are not added to the tree and are never sampled.
+        float power = 0.f;
+    };
+
+    // Bounding volume hierarchy over the local lights with orientation cones in the nodes,
+    // used to sample the lights proportionally to an estimate of their contribution to a given point,
+    // as described in "Importance Sampling of Many Lights with Adaptive Tree Splitting" by Conty Estevez and Kulla.
+    //
+    // The tree is built on the CPU and uploaded into the buffer referenced by RTXDI_LIGHT_TREE_BUFFER,
+    // and the light trails go into RTXDI_LIGHT_TREE_TRAIL_BUFFER. When the lights move without changing
+    // the set of lights, Refit updates the bounds in O(N) without changing the topology.
+    //
+    // Sample and EvaluatePdf are the reference implementations of RTXDI_SampleLightTree and
+    // RTXDI_EvaluateLightTreePdf in the shaders.
+    class LightTree
+    {
+    private:
+        std::vector<RTXDI_LightTreeNode> m_Nodes;
+        std::vector<uint32_t> m_LightTrails;
+        std::vector<uint32_t> m_LeafNodes; // per light, index of its leaf or ~0u
+        std::vector<uint32_t> m_BuildLights;
+        std::vector<float3> m_Centroids;
+        std::vector<uint8_t> m_BuildBuckets;
+        uint32_t m_Depth = 0;
+
+        void BuildNode(const LightTreeLightBounds* lights, uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth, uint32_t trail);
+
+    public:
+        // Builds the tree over lights[0, numLights). The leaves refer to the lights by their index in the array,
+        // which is expected to be relative to the first local light.
+        void Build(const LightTreeLightBounds* lights, uint32_t numLights);
+
+        // Updates the bounds of all nodes after the lights have changed, keeping the topology.
+        // 'numLights' must be the same as in the last Build. Lights that had zero power in the last Build
+        // are not in the tree, so the tree should be rebuilt when lights are turned on.
+        void Refit(const LightTreeLightBounds* lights, uint32_t numLights);
+
+        void Clear();
+
+        // The tree nodes, with the root at index 0. There is always at least one node after Build,
+        // the root is a leaf with zero power if there are no lights.
+        const std::vector<RTXDI_LightTreeNode>& GetNodes() const { return m_Nodes; }
+
+        // The path from the root to every light, with one bit per level starting from the least significant bit,
+        // 0 for the first child and 1 for the second, terminated by a 1 bit. Zero for lights that are not in the tree.
+        const std::vector<uint32_t>& GetLightTrails() const { return m_LightTrails; }
+
+        uint32_t GetNumLights() const { return uint32_t(m_LightTrails.size()); }
+        uint32_t GetDepth() const { return m_Depth; }
+
+        // Estimates the contribution of the lights in 'node' to a point with the given normal,
+        // or a point in a volume if the normal is zero. Same as RTXDI_LightTreeNodeImportance.
+        static float EvaluateImportance(const RTXDI_LightTreeNode& node, const float3& position, const float3& normal);
+
+        // Selects a light by traversing the tree with the random number 'rnd' in [0, 1).
+        // Returns false if no light has a nonzero importance for the point.
+        bool Sample(float rnd, const float3& position, const float3& normal, uint32_t& outLightIndex, float& outPdf) const;
+
+        // Returns the probability of Sample selecting the light with the given index for the point.
+        float EvaluatePdf(uint32_t lightIndex, const float3& position, const float3& normal) const;
+    };
+}
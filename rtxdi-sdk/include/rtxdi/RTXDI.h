@@ -43,14 +43,29 @@ namespace rtxdi
         White = 2
     };
     
+    // Order of the reservoirs within a reservoir block.
+    // Z-curve ordering keeps the 2D neighborhoods of a pixel closer in memory.
+    enum class ReservoirBlockLayout : uint32_t
+    {
+        RowMajor = RTXDI_RESERVOIR_LAYOUT_ROW_MAJOR,
+        ZCurve = RTXDI_RESERVOIR_LAYOUT_ZCURVE
+    };
+    
     enum class ReGIRMode : uint32_t
     {
         Disabled = 0,
         Grid = 1,
         Onion = 2,
-        AlignGrid = 3
+        AlignGrid = 3,
+        HashGrid = 4
     };
     
+    enum class VisibilityBufferLayout : uint32_t
+    {
+        Dense = RTXDI_VISIBILITY_LAYOUT_DENSE,
+        Compact = RTXDI_VISIBILITY_LAYOUT_COMPACT
+    };
+
     struct ReGIRContextParameters
     {
         ReGIRMode Mode = ReGIRMode::Disabled;
@@ -80,6 +95,18 @@ namespace rtxdi
         // only by the number of the detail layers. Coverage layers have cell size
         // that is proportional to the distance from the center as a linear function.
         uint32_t OnionCoverageLayers = 10;
+
+        // Hash grid mode
+
+        // Maximum number of cells that can be allocated in the hash grid at the same time.
+        // The hash table size is this number rounded up to a power of 2. Cells are allocated
+        // from surface positions every frame, so this should be comfortably larger than
+        // the number of grid cells covered by the visible surfaces: linear probing
+        // degrades quickly when the table is more than 3/4 full.
+        uint32_t HashGridCapacity = 4096;
+
+        // Maximum number of slots visited when inserting or looking up a cell.
+        uint32_t HashGridMaxProbes = 16;
     };
 
     struct ContextParameters
@@ -92,8 +119,28 @@ namespace rtxdi
         uint32_t EnvironmentTileSize = 1024;
         uint32_t EnvironmentTileCount = 128;
 
+        // Size of the square pixel blocks that reservoirs are stored in: 8, 16 or 32.
+        uint32_t ReservoirBlockSize = RTXDI_RESERVOIR_BLOCK_SIZE;
+
+        // Order of the reservoirs within each block.
+        ReservoirBlockLayout ReservoirLayout = ReservoirBlockLayout::RowMajor;
+
         bool enableVisibilityVairanceSampling = true;
+
+        // Storage of the per-cell visibility statistics, see RTXDI_VISIBILITY_LAYOUT_...
+        // The dense layout grows with (ReGIR cells x all emitters), the compact one
+        // with (ReGIR cells x VisibilityLightsPerCell).
+        VisibilityBufferLayout VisibilityLayout = VisibilityBufferLayout::Dense;
+
+        // Number of emitters tracked in each ReGIR cell with the compact layout.
+        uint32_t VisibilityLightsPerCell = 32;
+
         CheckerboardMode CheckerboardSamplingMode = CheckerboardMode::Off;
+
+        // Number of views rendered with this context, e.g. 2 for stereo or split-screen rendering.
+        // All views share the RIS buffer, environment presampling and ReGIR, and must have the same
+        // render size. Every reservoir array is split into one slice per view, see FrameParameters::viewIndex.
+        uint32_t ViewCount = 1;
         
         ReGIRContextParameters ReGIR;
     };
@@ -103,6 +150,11 @@ namespace rtxdi
         // Linear index of the current frame, used to determine the checkerboard field.
         uint32_t frameIndex = 0;
 
+        // Index of the view that the runtime parameters are filled for, less than ContextParameters::ViewCount.
+        // Selects the view's slice of the reservoir arrays, and together with frameIndex, its checkerboard field
+        // and random number. Everything else is the same for all views of a frame.
+        uint32_t viewIndex = 0;
+
         // Index of the first local light in the light buffer.
         uint32_t firstLocalLight = 0;
 
@@ -125,6 +177,11 @@ namespace rtxdi
         // Use image-based importance sampling for local lights
         bool enableLocalLightImportanceSampling = false;
 
+        // Sample local lights by traversing a light tree built with rtxdi::LightTree, which accounts for
+        // the distance and orientation of the lights relative to the surface. Takes precedence over
+        // enableLocalLightImportanceSampling. Requires the shaders to define RTXDI_LIGHT_TREE_BUFFER.
+        bool enableLightTree = false;
+
         // Size of the smallest ReGIR cell, in world units.
         float regirCellSize = 2.5f;
 
@@ -138,8 +195,15 @@ namespace rtxdi
         float3 regirCenter{};
 
         // for visibility buffer max size
-        uint32_t numEmissionThing;
-        uint32_t currentFrameLightOffset;
+        uint32_t numEmissionThing = 0;
+        uint32_t currentFrameLightOffset = 0;
+    };
+
+    // Contiguous range of ReGIR cells, see Context::GetReGIRCellRefreshRange(...)
+    struct ReGIRCellRange
+    {
+        uint32_t firstCell = 0;
+        uint32_t cellCount = 0;
     };
 
 
@@ -149,32 +213,225 @@ namespace rtxdi
         ContextParameters m_Params;
         
         uint32_t m_ReservoirBlockRowPitch = 0;
+        uint32_t m_ReservoirViewPitch = 0;
         uint32_t m_ReservoirArrayPitch = 0;
 
         uint32_t m_RegirCellOffset = 0;
+        uint32_t m_RegirHashTableSize = 0;
         uint32_t m_OnionCells = 0;
         std::vector<RTXDI_OnionLayerGroup> m_OnionLayers;
         std::vector<RTXDI_OnionRing> m_OnionRings;
         float m_OnionCubicRootFactor = 0.f;
         float m_OnionLinearFactor = 0.f;
 
+        // Cached copy of the runtime parameters that only depend on the context parameters
+        // and on the ReGIR cell size and jitter, see UpdateRuntimeParameters(...)
+        RTXDI_ResamplingRuntimeParameters m_StaticRuntimeParams{};
+        uint32_t m_StaticRuntimeParamsVersion = 0;
+        float m_StaticRegirCellSize = 0.f;
+        float m_StaticRegirSamplingJitter = 0.f;
+
+        void ComputeReservoirPitches();
         void InitializeOnion();
         void ComputeOnionJitterCurve();
+        void UpdateStaticRuntimeParameters(const FrameParameters& frame);
+        void FillFrameRuntimeParameters(
+            RTXDI_ResamplingRuntimeParameters& runtimeParams,
+            const FrameParameters& frame) const;
 
     public:
         Context(const ContextParameters& params);
         const ContextParameters& GetParameters() const;
+
+        // Changes the render size without recreating the context, and recomputes the reservoir buffer layout.
+        // Nothing else in the context depends on the render size. After a resize, the application must check
+        // that its reservoir buffers still hold at least GetReservoirBufferElementCount() elements per array.
+        void Resize(uint32_t renderWidth, uint32_t renderHeight);
         
         uint32_t GetRisBufferElementCount() const;
+        // Returns the number of reservoirs in one reservoir array, including the slices of all views.
         uint32_t GetReservoirBufferElementCount() const;
         uint32_t GetReGIRLightSlotCount() const;
 
+        // Returns the number of ReGIR cells: grid cells, onion cells or hash table slots, or 0 if ReGIR is disabled.
+        uint32_t GetReGIRCellCount() const;
+
+        // Returns the number of 32-bit elements in the visibility variance buffer for the given maximum
+        // number of emitters (emissive meshes plus primitive lights), or 0 if visibility variance sampling
+        // or ReGIR is disabled. The buffer must be cleared to zero before use.
+        uint64_t GetVisibilityBufferElementCount(uint32_t maxEmitters) const;
+
+        // Returns the number of 32-bit slots in the ReGIR hash table, or 0 if the hash grid mode is not used.
+        // The application must provide a buffer of this size and clear it to RTXDI_REGIR_HASH_EMPTY_KEY every frame
+        // before allocating the cells, see RTXDI_ReGIR_HashGridInsert.
+        uint32_t GetReGIRHashTableSize() const;
+
+        // Returns the number of 32-bit elements in the ReGIR cell occupancy mask, one bit per cell, or 0 if the mode
+        // is not Grid, AlignGrid or Onion. See RTXDI_ReGIR_MarkOccupiedCells for the occupancy-driven build.
+        uint32_t GetReGIROccupancyMaskSize() const;
+
+        // Amortized ReGIR build: instead of rebuilding all cells on every frame, the cells are split into groups
+        // of consecutive cells, and one group is rebuilt per frame in a round-robin order, keeping the other cells.
+        // Returns the number of groups for the given refresh interval, which is 'refreshInterval' itself:
+        // the group sizes differ by at most one cell, and some groups are empty if the interval exceeds the cell count.
+        // An interval of 0 or 1 means that all cells are rebuilt on every frame. The hash grid cells are reallocated
+        // on every frame, so that mode can't be amortized, and this function returns 1.
+        uint32_t GetReGIRRefreshGroupCount(uint32_t refreshInterval) const;
+
+        // Returns the range of cells to rebuild on the given frame with the amortized build, see GetReGIRRefreshGroupCount(...)
+        // The group is selected with (frameIndex % groupCount), so any 'refreshInterval' consecutive frames rebuild
+        // every cell exactly once. The range is empty if ReGIR is disabled, or on frames that select an empty group.
+        // Multiply the range by ReGIR.LightsPerCell to get the light slots.
+        ReGIRCellRange GetReGIRCellRefreshRange(uint32_t frameIndex, uint32_t refreshInterval) const;
+
+        // Fills the entire runtime parameter structure for the given frame and view.
+        // With multiple views, fill and upload one structure per view: they only differ in the per-frame fields.
+        // This function and UpdateRuntimeParameters(...) rebuild the cached static block when the ReGIR
+        // cell size or jitter change, so they must not be called on the same context from multiple threads
+        // at once, or concurrently with Resize(...). Contexts don't share any state that needs locking.
         void FillRuntimeParameters(
             RTXDI_ResamplingRuntimeParameters& runtimeParams,
-            const FrameParameters& frame) const;
+            const FrameParameters& frame);
+
+        // Brings a runtime parameter structure that was previously filled by this function up to date
+        // for the given frame. The structure is split into two parts:
+        // - The static block: everything that depends only on the context parameters and on
+        //   FrameParameters::regirCellSize and regirSamplingJitter, including the onion layers and rings;
+        // - The per-frame fields: light ranges, environment light, importance sampling flag,
+        //   uniformRandomNumber, activeCheckerboardField, reservoirViewOffset and the ReGIR center.
+        // 'inoutStaticVersion' identifies the static block currently stored in 'runtimeParams'.
+        // Initialize it to 0 before the first call. The static block is only copied when the version
+        // doesn't match; otherwise, only the per-frame fields are written. The version changes whenever
+        // the static block is rewritten, so applications that upload the static block separately can
+        // compare it with its previous value to find out whether the block needs to be re-uploaded.
+        void UpdateRuntimeParameters(
+            RTXDI_ResamplingRuntimeParameters& runtimeParams,
+            const FrameParameters& frame,
+            uint32_t& inoutStaticVersion);
 
         void FillNeighborOffsetBuffer(uint8_t* buffer) const;
     };
 
     void ComputePdfTextureSize(uint32_t maxItems, uint32_t& outWidth, uint32_t& outHeight, uint32_t& outMipLevels);
+
+    // Host-side mirror of the RTXDI_ReservoirPositionToPointer shader function,
+    // returns the index of a reservoir in the reservoir buffer.
+    uint32_t ReservoirPositionToPointer(
+        const RTXDI_ResamplingRuntimeParameters& params,
+        uint32_t reservoirPositionX,
+        uint32_t reservoirPositionY,
+        uint32_t reservoirArrayIndex);
+
+    // Host-side mirror of the RTXDI_PackReservoir and RTXDI_UnpackReservoir encoding of the targetPdf, weight
+    // and colorWeight fields with the compact reservoir format, see RTXDI_COMPACT_LIGHT_RESERVOIR.
+    // The exponents are stored in the high 8 bits of 'inoutUvData' and 'inoutDistanceAge', the other bits are kept.
+    void PackCompactReservoirWeights(
+        float targetPdf,
+        float weight,
+        const float3& colorWeight,
+        uint32_t& inoutUvData,
+        uint32_t& inoutDistanceAge,
+        uint32_t& outPackedWeights);
+
+    void UnpackCompactReservoirWeights(
+        uint32_t uvData,
+        uint32_t distanceAge,
+        uint32_t packedWeights,
+        float& outTargetPdf,
+        float& outWeight,
+        float3& outColorWeight);
+
+    // Host-side mirror of the sample position encoding of the compact GI reservoir form, see RTXDI_COMPACT_GI_RESERVOIR.
+    // The position is stored relative to the position of the surface that owns the reservoir: 'outPackedDistance'
+    // receives the fp16 distance in its low 16 bits, and 'outPackedDirection' the octahedral direction.
+    void PackCompactGIReservoirPosition(
+        const float3& samplePosition,
+        const float3& surfacePosition,
+        uint32_t& outPackedDistance,
+        uint32_t& outPackedDirection);
+
+    float3 UnpackCompactGIReservoirPosition(
+        uint32_t packedDistance,
+        uint32_t packedDirection,
+        const float3& surfacePosition);
+
+    // Host-side mirrors of the RTXDI_EncodeRGBToLogLuv and RTXDI_DecodeLogLuvToRGB shader functions,
+    // used for the radiance of the GI reservoirs.
+    uint32_t EncodeRGBToLogLuv(const float3& color);
+
+    float3 DecodeLogLuvToRGB(uint32_t packedColor);
+
+    // Host-side mirrors of the RTXDI_EncodeRGBToLogLuv24 and RTXDI_DecodeLogLuv24ToRGB shader functions,
+    // used for the colorWeight of the compact light reservoirs.
+    uint32_t EncodeRGBToLogLuv24(const float3& color);
+
+    float3 DecodeLogLuv24ToRGB(uint32_t packedColor);
+
+    // Host-side mirrors of the RTXDI_EncodeNormalizedVectorToSnorm2x8 and RTXDI_DecodeNormalizedVectorFromSnorm2x8
+    // shader functions, used for the normal of the compact GI reservoirs. The normal is in the low 16 bits.
+    uint32_t EncodeNormalizedVectorToSnorm2x8(const float3& normal);
+
+    float3 DecodeNormalizedVectorFromSnorm2x8(uint32_t packedNormal);
+
+    // Host-side reference implementation of the ReGIR hash grid, matching the RTXDI_ReGIR_HashGrid... shader functions.
+    // 'table' points to an array of params.regirHashGrid.tableSize keys.
+
+    // Returns the key of the cell containing 'worldPos', or RTXDI_REGIR_HASH_EMPTY_KEY if it's too far from the center.
+    uint32_t ReGIRHashGridWorldPosToKey(const RTXDI_ResamplingRuntimeParameters& params, const float3& worldPos);
+
+    // Allocates or finds the cell containing 'worldPos', returns its index or -1 if the cell can't be allocated.
+    int ReGIRHashGridInsert(const RTXDI_ResamplingRuntimeParameters& params, uint32_t* table, const float3& worldPos);
+
+    // Finds the cell containing 'worldPos', returns its index or -1 if the cell hasn't been allocated.
+    int ReGIRHashGridLookup(const RTXDI_ResamplingRuntimeParameters& params, const uint32_t* table, const float3& worldPos);
+
+    // Host-side mirror of the onion layer and ring lookups of RTXDI_ReGIR_WorldPosToCellIndex, which use the lookup
+    // tables in RTXDI_ReGIROnionParameters, and the reference mappings that the tables are built from.
+
+    // Returns the global index of the layer containing the radius 'r', which must be within the onion,
+    // or the total number of layers if it's outside of the onion.
+    uint32_t ReGIROnionRadiusToLayer(const RTXDI_ReGIROnionParameters& onion, float r);
+
+    // Returns the index of the ring containing abs(sin(elevation)) within the given layer group.
+    uint32_t ReGIROnionRing(const RTXDI_ReGIROnionParameters& onion, uint32_t layerGroupIndex, float absSinElevation);
+
+    // Same as ReGIROnionRadiusToLayer, using the layer group search and logarithm.
+    uint32_t ReGIROnionReferenceRadiusToLayer(const RTXDI_ReGIROnionParameters& onion, float r);
+
+    // Same as ReGIROnionRing, using the arcsine.
+    uint32_t ReGIROnionReferenceRing(const RTXDI_OnionLayerGroup& layerGroup, float absSinElevation);
+
+    // Host-side reference implementation of the ReGIR cell occupancy, matching the RTXDI_ReGIR_... shader functions
+    // for the Grid, AlignGrid and Onion modes. 'occupancyMask' points to GetReGIROccupancyMaskSize() elements.
+
+    // Returns the size of the box around 'worldPos' that the ReGIR sampling jitter can reach.
+    float ReGIRGetJitterScale(const RTXDI_ResamplingRuntimeParameters& params, ReGIRMode mode, const float3& worldPos);
+
+    // Returns the index of the cell containing 'worldPos', or -1 if it's outside of the structure.
+    int ReGIRWorldPosToCellIndex(const RTXDI_ResamplingRuntimeParameters& params, ReGIRMode mode, const float3& worldPos);
+
+    // Sets the bits of all cells that a lookup from 'worldPos' can reach through the jitter. The Grid and AlignGrid
+    // modes mark exactly the cells overlapping the jitter box, the Onion mode marks the cells of a point lattice in it.
+    void ReGIRMarkOccupiedCells(const RTXDI_ResamplingRuntimeParameters& params, ReGIRMode mode, const float3& worldPos, uint32_t* occupancyMask);
+
+    // Host-side mirror of the cell compaction of the occupancy-driven build, see CompactReGIRCells.hlsl in the sample
+    // application. Writes the indices of the cells marked in 'occupancyMask' to 'outCellList', which must have room
+    // for 'cellCount' elements, and returns their number. The host list is sorted, the shader appends in any order.
+    uint32_t ReGIRCompactOccupiedCells(uint32_t cellCount, const uint32_t* occupancyMask, uint32_t* outCellList);
+
+    // Returns the Y and Z group counts of the build over 'listedCellCount' listed cells: one row of groups per cell,
+    // with the rows wrapping every 65535 cells to stay within the dispatch size limits.
+    void ReGIRGetCellListDispatchSize(uint32_t listedCellCount, uint32_t& outGroupsY, uint32_t& outGroupsZ);
+
+    // Host-side reference implementation of the visibility buffer, matching the RTXDI_VisibilityBufferFindEntry,
+    // RTXDI_RecordVisibility and RTXDI_LoadVisibility shader functions for both layouts.
+    // 'visibilityBuffer' points to GetVisibilityBufferElementCount() elements.
+
+    // Returns the index of the first buffer element of the entry for the given emitter in the given cell, or -1.
+    int VisibilityBufferFindEntry(const RTXDI_ResamplingRuntimeParameters& params, uint32_t* visibilityBuffer, int cellIndex, uint32_t emitterIndex, bool allocate);
+
+    void RecordVisibility(const RTXDI_ResamplingRuntimeParameters& params, uint32_t* visibilityBuffer, int cellIndex, uint32_t emitterIndex, bool visible);
+
+    // Returns false if there are no statistics for this emitter in the cell.
+    bool LoadVisibility(const RTXDI_ResamplingRuntimeParameters& params, const uint32_t* visibilityBuffer, int cellIndex, uint32_t emitterIndex, uint32_t& outVisibleCount, uint32_t& outTotalCount);
 }
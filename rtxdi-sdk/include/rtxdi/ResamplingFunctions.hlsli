@@ -151,7 +151,8 @@ bool RTXDI_StreamSample(
     if (selectSample) 
     {
         reservoir.lightData = lightIndex | RTXDI_Reservoir_LightValidBit;
-        reservoir.uvData = uint(saturate(uv.x) * 0xffff) | (uint(saturate(uv.y) * 0xffff) << 16);
+        reservoir.uvData = uint(saturate(uv.x) * RTXDI_Reservoir_UVChannelMax)
+            | (uint(saturate(uv.y) * RTXDI_Reservoir_UVChannelMax) << RTXDI_Reservoir_UVChannelBits);
         reservoir.targetPdf = targetPdf;
     }
 
@@ -364,6 +365,82 @@ void RTXDI_SamplePdfMipmap(
     }
 }
 
+// Selects between the alias table entry with the given index and its alias using a random number in [0, 1),
+// and returns the selected index and its probability.
+uint RTXDI_SelectAliasTableEntry(RTXDI_AliasTableEntry entry, uint index, float rnd, out float pdf)
+{
+    if (rnd < entry.threshold)
+    {
+        pdf = entry.pdf;
+        return index;
+    }
+
+    pdf = entry.aliasPdf;
+    return entry.alias;
+}
+
+#ifdef RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER
+
+// Selects a local light from the alias table built with rtxdi::AliasTable, using one table fetch.
+// Returns the light index relative to the first local light and its selection probability, which is zero if nothing was found.
+void RTXDI_SampleAliasTable(
+    inout RAB_RandomSamplerState rng,
+    uint tableSize,
+    out uint localLightIndex,
+    out float pdf)
+{
+    float rndIndex = RAB_GetNextRandom(rng);
+    float rndAlias = RAB_GetNextRandom(rng);
+
+    uint index = min(uint(rndIndex * float(tableSize)), tableSize - 1);
+    localLightIndex = RTXDI_SelectAliasTableEntry(RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER[index], index, rndAlias, pdf);
+}
+
+// Returns the probability of RTXDI_SampleAliasTable selecting the given local light.
+float RTXDI_EvaluateAliasTablePdf(uint localLightIndex)
+{
+    return RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER[localLightIndex].pdf;
+}
+
+#endif // RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER
+
+#ifdef RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER
+
+// Selects an environment map texel from the two-level alias table built with rtxdi::AliasTable2D,
+// first the row from the marginal table, then the column from the conditional table of that row.
+// Returns the probability of selecting the texel among all texels, which is zero if nothing was found.
+void RTXDI_SampleEnvironmentAliasTable(
+    inout RAB_RandomSamplerState rng,
+    uint2 size,
+    out uint2 position,
+    out float pdf)
+{
+    float rndRow = RAB_GetNextRandom(rng);
+    float rndRowAlias = RAB_GetNextRandom(rng);
+    float rndColumn = RAB_GetNextRandom(rng);
+    float rndColumnAlias = RAB_GetNextRandom(rng);
+
+    uint row = min(uint(rndRow * float(size.y)), size.y - 1);
+    float rowPdf;
+    position.y = RTXDI_SelectAliasTableEntry(RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER[row], row, rndRowAlias, rowPdf);
+
+    uint column = min(uint(rndColumn * float(size.x)), size.x - 1);
+    float columnPdf;
+    position.x = RTXDI_SelectAliasTableEntry(RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER[size.y + position.y * size.x + column],
+        column, rndColumnAlias, columnPdf);
+
+    pdf = rowPdf * columnPdf;
+}
+
+// Returns the probability of RTXDI_SampleEnvironmentAliasTable selecting the given texel.
+float RTXDI_EvaluateEnvironmentAliasTablePdf(uint2 position, uint2 size)
+{
+    return RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER[position.y].pdf *
+        RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER[size.y + position.y * size.x + position.x].pdf;
+}
+
+#endif // RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER
+
 #if RTXDI_ENABLE_PRESAMPLING
 
 void RTXDI_PresampleLocalLights(
@@ -404,29 +481,67 @@ void RTXDI_PresampleLocalLights(
     RTXDI_RIS_BUFFER[risBufferPtr] = uint2(lightIndex, asuint(invSourcePdf));
 }
 
-void RTXDI_PresampleEnvironmentMap(
-    inout RAB_RandomSamplerState rng, 
-    RTXDI_TEX2D pdfTexture,
-    uint2 pdfTextureSize,
+#ifdef RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER
+
+// Same as RTXDI_PresampleLocalLights, but selects the lights from the alias table instead of the PDF texture.
+// The table must have numLocalLights entries.
+void RTXDI_PresampleLocalLightsFromAliasTable(
+    inout RAB_RandomSamplerState rng,
     uint tileIndex,
     uint sampleInTile,
-    RTXDI_EnvironmentLightRuntimeParameters params)
+    RTXDI_ResamplingRuntimeParameters params)
 {
-    uint2 texelPosition;
-    float pdf;
-    RTXDI_SamplePdfMipmap(rng, pdfTexture, pdfTextureSize, texelPosition, pdf);
+    uint lightIndex = 0;
+    float pdf = 0;
+    if (params.localLightParams.numLocalLights > 0)
+        RTXDI_SampleAliasTable(rng, params.localLightParams.numLocalLights, lightIndex, pdf);
+
+    uint risBufferPtr = sampleInTile + tileIndex * params.risBufferParams.tileSize;
+
+    bool compact = false;
+    float invSourcePdf = 0;
+
+    if (pdf > 0)
+    {
+        invSourcePdf = 1.0 / pdf;
+
+        RAB_LightInfo lightInfo = RAB_LoadLightInfo(lightIndex + params.localLightParams.firstLocalLight, false);
+        compact = RAB_StoreCompactLightInfo(risBufferPtr, lightInfo);
+    }
+
+    lightIndex += params.localLightParams.firstLocalLight;
+
+    if(compact) {
+        lightIndex |= RTXDI_LIGHT_COMPACT_BIT;
+    }
+
+    RTXDI_RIS_BUFFER[risBufferPtr] = uint2(lightIndex, asuint(invSourcePdf));
+}
+
+#endif // RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER
 
+// Picks a random point inside the selected environment map texel and stores it into the environment part of the RIS buffer.
+// 'pdf' is the probability of selecting the texel among all texels.
+void RTXDI_StorePresampledEnvironmentTexel(
+    inout RAB_RandomSamplerState rng,
+    uint2 texelPosition,
+    float pdf,
+    uint2 textureSize,
+    uint tileIndex,
+    uint sampleInTile,
+    RTXDI_EnvironmentLightRuntimeParameters params)
+{
     // Uniform sampling inside the pixels
     float2 fPos = float2(texelPosition);
     fPos.x += RAB_GetNextRandom(rng);
     fPos.y += RAB_GetNextRandom(rng);
     
     // Convert texel position to UV and pack it
-    float2 uv = fPos / float2(pdfTextureSize);
+    float2 uv = fPos / float2(textureSize);
     uint packedUv = uint(saturate(uv.x) * 0xffff) | (uint(saturate(uv.y) * 0xffff) << 16);
 
     // Compute the inverse PDF if we found something
-    pdf *= pdfTextureSize.x * pdfTextureSize.y;
+    pdf *= textureSize.x * textureSize.y;
     float invSourcePdf = (pdf > 0) ? (1.0 / pdf) : 0;
 
     // Store the result
@@ -434,6 +549,41 @@ void RTXDI_PresampleEnvironmentMap(
     RTXDI_RIS_BUFFER[risBufferPtr] = uint2(packedUv, asuint(invSourcePdf));
 }
 
+void RTXDI_PresampleEnvironmentMap(
+    inout RAB_RandomSamplerState rng, 
+    RTXDI_TEX2D pdfTexture,
+    uint2 pdfTextureSize,
+    uint tileIndex,
+    uint sampleInTile,
+    RTXDI_EnvironmentLightRuntimeParameters params)
+{
+    uint2 texelPosition;
+    float pdf;
+    RTXDI_SamplePdfMipmap(rng, pdfTexture, pdfTextureSize, texelPosition, pdf);
+
+    RTXDI_StorePresampledEnvironmentTexel(rng, texelPosition, pdf, pdfTextureSize, tileIndex, sampleInTile, params);
+}
+
+#ifdef RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER
+
+// Same as RTXDI_PresampleEnvironmentMap, but selects the texels from the alias table instead of the PDF texture.
+// 'size' is the size of the environment map that the table was built for.
+void RTXDI_PresampleEnvironmentMapFromAliasTable(
+    inout RAB_RandomSamplerState rng,
+    uint2 size,
+    uint tileIndex,
+    uint sampleInTile,
+    RTXDI_EnvironmentLightRuntimeParameters params)
+{
+    uint2 texelPosition;
+    float pdf;
+    RTXDI_SampleEnvironmentAliasTable(rng, size, texelPosition, pdf);
+
+    RTXDI_StorePresampledEnvironmentTexel(rng, texelPosition, pdf, size, tileIndex, sampleInTile, params);
+}
+
+#endif // RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER
+
 #endif // RTXDI_ENABLE_PRESAMPLING
 
 #ifndef RTXDI_TILE_SIZE_IN_PIXELS
@@ -523,8 +673,39 @@ bool RTXDI_StreamLocalLightAtUVIntoReservoir(
     return true;
 }
 
+#ifdef RTXDI_LIGHT_TREE_BUFFER
+// Selects a local light for the surface by traversing the light tree.
+// Returns false if no light in the tree can illuminate the surface.
+bool RTXDI_SelectLocalLightFromTree(
+    inout RAB_RandomSamplerState rng,
+    RAB_Surface surface,
+    uint firstLocalLight,
+    out RAB_LightInfo lightInfo,
+    out uint lightIndex,
+    out float invSourcePdf)
+{
+    uint localLightIndex;
+    float pdf;
+    bool selected = RTXDI_SampleLightTree(RAB_GetNextRandom(rng), RAB_GetSurfaceWorldPos(surface), RAB_GetSurfaceNormal(surface),
+        localLightIndex, pdf);
+
+    lightInfo = RAB_EmptyLightInfo();
+    lightIndex = RTXDI_InvalidLightIndex;
+    invSourcePdf = 0;
+
+    if (!selected)
+        return false;
+
+    lightIndex = localLightIndex + firstLocalLight;
+    invSourcePdf = 1.0 / pdf;
+    lightInfo = RAB_LoadLightInfo(lightIndex, false);
+    return true;
+}
+#endif // RTXDI_LIGHT_TREE_BUFFER
+
 // SDK internal function that samples the given set of lights generated by RIS
 // or the local light pool. The RIS set can come from local light importance presampling or from ReGIR.
+// If 'useLightTree' is true, the lights are selected from the light tree instead.
 RTXDI_Reservoir RTXDI_SampleLocalLightsInternal(
     inout RAB_RandomSamplerState rng, 
     RAB_Surface surface, 
@@ -535,6 +716,7 @@ RTXDI_Reservoir RTXDI_SampleLocalLightsInternal(
     uint risBufferBase,
     uint risBufferCount,
 #endif
+    bool useLightTree,
     out RAB_LightSample o_selectedSample)
 {
     RTXDI_Reservoir state = RTXDI_EmptyReservoir();
@@ -552,11 +734,22 @@ RTXDI_Reservoir RTXDI_SampleLocalLightsInternal(
         RAB_LightInfo lightInfo;
         float invSourcePdf;
 
-        RTXDI_RandomlySelectLocalLight(rng, params.firstLocalLight, params.numLocalLights,
+#ifdef RTXDI_LIGHT_TREE_BUFFER
+        if (useLightTree)
+        {
+            // A failed selection is a candidate with zero weight, the candidate count stays the same
+            if (!RTXDI_SelectLocalLightFromTree(rng, surface, params.firstLocalLight, lightInfo, lightIndex, invSourcePdf))
+                continue;
+        }
+        else
+#endif
+        {
+            RTXDI_RandomlySelectLocalLight(rng, params.firstLocalLight, params.numLocalLights,
 #if RTXDI_ENABLE_PRESAMPLING
-            useRisBuffer, risBufferBase, risBufferCount,
+                useRisBuffer, risBufferBase, risBufferCount,
 #endif
-            lightInfo, lightIndex, invSourcePdf);
+                lightInfo, lightIndex, invSourcePdf);
+        }
 
         float2 uv = RTXDI_RandomlySelectLocalLightUV(rng);
         bool zeroPdf = RTXDI_StreamLocalLightAtUVIntoReservoir(rng, sampleParams, surface, lightIndex, uv, invSourcePdf, lightInfo, state, o_selectedSample);
@@ -587,7 +780,7 @@ RTXDI_Reservoir RTXDI_SampleLocalLights(
 #if RTXDI_ENABLE_PRESAMPLING
         params.localLightParams.enableLocalLightImportanceSampling != 0, risBufferBase, params.risBufferParams.tileSize,
 #endif
-        o_selectedSample);
+        params.localLightParams.enableLightTree != 0, o_selectedSample);
 }
 
 void RTXDI_RandomlySelectInfiniteLight(
@@ -819,6 +1012,20 @@ void RTXDI_PresampleLocalLightsForReGIR(
         float rand = RAB_GetNextRandom(rng);
         bool lightLoaded = false;
 
+#ifdef RTXDI_LIGHT_TREE_BUFFER
+        if (params.localLightParams.enableLightTree != 0)
+        {
+            // Sample the tree for the cell center as a point in a volume, without a surface normal
+            uint localLightIndex;
+            float treePdf;
+            if (!RTXDI_SampleLightTree(rand, cellCenter, float3(0, 0, 0), localLightIndex, treePdf))
+                continue;
+
+            rndLight = localLightIndex + params.localLightParams.firstLocalLight;
+            invSourcePdf = invNumSamples / treePdf;
+        }
+        else
+#endif
         if (params.localLightParams.enableLocalLightImportanceSampling != 0)
         {
             uint tileSample = uint(min(rand * params.risBufferParams.tileSize, params.risBufferParams.tileSize - 1));
@@ -906,10 +1113,17 @@ RTXDI_Reservoir RTXDI_SampleLocalLightsFromReGIR(
         samplingPos += cellJitter * jitterScale;
 
         cellIndex = RTXDI_ReGIR_WorldPosToCellIndex(params, samplingPos);
+
+#if (RTXDI_REGIR_MODE != RTXDI_REGIR_HASHGRID) && defined(RTXDI_REGIR_OCCUPANCY_BUFFER)
+        // Cells that were not marked as occupied have not been built on this frame
+        if (cellIndex >= 0 && !RTXDI_ReGIR_IsCellOccupied(cellIndex))
+            cellIndex = -1;
+#endif
     }
 
     uint risBufferBase, risBufferCount, numSamples;
     bool useRisBuffer;
+    bool useLightTree = false;
 
     if (cellIndex < 0)
     {
@@ -920,6 +1134,7 @@ RTXDI_Reservoir RTXDI_SampleLocalLightsFromReGIR(
         risBufferCount = params.risBufferParams.tileSize;
         numSamples = sampleParams.numLocalLightSamples;
         useRisBuffer = params.localLightParams.enableLocalLightImportanceSampling != 0;
+        useLightTree = params.localLightParams.enableLightTree != 0;
     }
     else
     {
@@ -931,7 +1146,7 @@ RTXDI_Reservoir RTXDI_SampleLocalLightsFromReGIR(
     }
 
     reservoir = RTXDI_SampleLocalLightsInternal(rng, surface, sampleParams, params.localLightParams,
-        useRisBuffer, risBufferBase, risBufferCount, o_selectedSample);
+        useRisBuffer, risBufferBase, risBufferCount, useLightTree, o_selectedSample);
 
     return reservoir;
 }
@@ -985,6 +1200,12 @@ RTXDI_Reservoir RTXDI_SampleBrdf(
 
                 if (lightIndex != RTXDI_InvalidLightIndex)
                 {
+#ifdef RTXDI_LIGHT_TREE_BUFFER
+                    if (params.localLightParams.enableLightTree != 0)
+                        lightSourcePdf = RTXDI_EvaluateLightTreePdf(lightIndex - params.localLightParams.firstLocalLight,
+                            RAB_GetSurfaceWorldPos(surface), RAB_GetSurfaceNormal(surface));
+                    else
+#endif
                     lightSourcePdf = RAB_EvaluateLocalLightSourcePdf(params, lightIndex);
                 }
             }
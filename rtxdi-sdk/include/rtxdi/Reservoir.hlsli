@@ -31,7 +31,7 @@ struct RTXDI_Reservoir
     // Light index (bits 0..30) and validity bit (31)
     uint lightData;     
 
-    // Sample UV encoded in 16-bit fixed point format
+    // Sample UV encoded in 16-bit fixed point format, or 12-bit with RTXDI_COMPACT_LIGHT_RESERVOIR
     uint uvData;        
 
     // Overloaded: represents RIS weight sum during streaming,
@@ -78,6 +78,25 @@ static const uint RTXDI_PackedReservoir_MaxAge = 0xff;
 static const uint RTXDI_PackedReservoir_DistanceMask = (1u << RTXDI_PackedReservoir_DistanceChannelBits) - 1;
 static const  int RTXDI_PackedReservoir_MaxDistance = int((1u << (RTXDI_PackedReservoir_DistanceChannelBits - 1)) - 1);
 
+// Encoding helper constants for the compact RTXDI_PackedReservoir, see RTXDI_COMPACT_LIGHT_RESERVOIR.
+// targetPdf and weight are stored as 12-bit floats: their exponents are in the high 8 bits of distanceAge and uvData,
+// their mantissas in the low 8 bits of packedWeights, and the rest of packedWeights holds colorWeight as 24-bit LogLuv.
+static const uint RTXDI_PackedReservoir_ExponentShift = 24;
+static const uint RTXDI_PackedReservoir_ExponentMask = 0xff;
+static const uint RTXDI_PackedReservoir_MantissaBits = 4;
+static const uint RTXDI_PackedReservoir_MantissaMask = (1u << RTXDI_PackedReservoir_MantissaBits) - 1;
+static const uint RTXDI_PackedReservoir_PdfMantissaShift = 0;
+static const uint RTXDI_PackedReservoir_WeightMantissaShift = 4;
+static const uint RTXDI_PackedReservoir_ColorWeightShift = 8;
+
+// Encoding helper constants for RTXDI_Reservoir.uvData
+#if RTXDI_COMPACT_LIGHT_RESERVOIR
+static const uint RTXDI_Reservoir_UVChannelBits = 12;
+#else
+static const uint RTXDI_Reservoir_UVChannelBits = 16;
+#endif
+static const uint RTXDI_Reservoir_UVChannelMax = (1u << RTXDI_Reservoir_UVChannelBits) - 1;
+
 // Light index helpers
 static const uint RTXDI_Reservoir_LightValidBit = 0x80000000;
 static const uint RTXDI_Reservoir_LightIndexMask = 0x7FFFFFFF;
@@ -99,9 +118,24 @@ RTXDI_PackedReservoir RTXDI_PackReservoir(const RTXDI_Reservoir reservoir)
         | ((clampedSpatialDistance.y & RTXDI_PackedReservoir_DistanceMask) << RTXDI_PackedReservoir_DistanceYShift) 
         | (clampedAge << RTXDI_PackedReservoir_AgeShift);
 
+#if RTXDI_COMPACT_LIGHT_RESERVOIR
+    uint packedPdf = RTXDI_FloatToUnsignedFloat12(reservoir.targetPdf);
+    uint packedWeight = RTXDI_FloatToUnsignedFloat12(reservoir.weightSum);
+    data.distanceAge |= (packedPdf >> RTXDI_PackedReservoir_MantissaBits) << RTXDI_PackedReservoir_ExponentShift;
+    data.uvData |= (packedWeight >> RTXDI_PackedReservoir_MantissaBits) << RTXDI_PackedReservoir_ExponentShift;
+
+    // colorWeight grows with the reservoir weight, which can exceed the LogLuv range with many lights:
+    // store it relative to the stored weight, the unpacking multiplies it back
+    float storedWeight = RTXDI_UnsignedFloat12ToFloat(packedWeight);
+    float colorScale = (storedWeight > 0) ? 1.0 / storedWeight : 1.0;
+    data.packedWeights = ((packedPdf & RTXDI_PackedReservoir_MantissaMask) << RTXDI_PackedReservoir_PdfMantissaShift)
+        | ((packedWeight & RTXDI_PackedReservoir_MantissaMask) << RTXDI_PackedReservoir_WeightMantissaShift)
+        | (RTXDI_EncodeRGBToLogLuv24(reservoir.colorWeight * colorScale) << RTXDI_PackedReservoir_ColorWeightShift);
+#else
     data.targetPdf = reservoir.targetPdf;
     data.weight = reservoir.weightSum;
     data.colorWeight = reservoir.colorWeight;
+#endif
 
     return data;
 }
@@ -138,9 +172,19 @@ RTXDI_Reservoir RTXDI_UnpackReservoir(RTXDI_PackedReservoir data)
 {
     RTXDI_Reservoir res;
     res.lightData = data.lightData;
+#if RTXDI_COMPACT_LIGHT_RESERVOIR
+    uint pdfExponent = (data.distanceAge >> RTXDI_PackedReservoir_ExponentShift) & RTXDI_PackedReservoir_ExponentMask;
+    uint weightExponent = (data.uvData >> RTXDI_PackedReservoir_ExponentShift) & RTXDI_PackedReservoir_ExponentMask;
+    res.uvData = data.uvData & ((1u << RTXDI_PackedReservoir_ExponentShift) - 1);
+    res.targetPdf = RTXDI_UnsignedFloat12ToFloat((pdfExponent << RTXDI_PackedReservoir_MantissaBits)
+        | ((data.packedWeights >> RTXDI_PackedReservoir_PdfMantissaShift) & RTXDI_PackedReservoir_MantissaMask));
+    res.weightSum = RTXDI_UnsignedFloat12ToFloat((weightExponent << RTXDI_PackedReservoir_MantissaBits)
+        | ((data.packedWeights >> RTXDI_PackedReservoir_WeightMantissaShift) & RTXDI_PackedReservoir_MantissaMask));
+#else
     res.uvData = data.uvData;
     res.targetPdf = data.targetPdf;
     res.weightSum = data.weight;
+#endif
     res.M = (data.mVisibility >> RTXDI_PackedReservoir_MShift) & RTXDI_PackedReservoir_MaxM;
     res.packedVisibility = data.mVisibility & RTXDI_PackedReservoir_VisibilityMask;
     // Sign extend the shift values
@@ -148,7 +192,11 @@ RTXDI_Reservoir RTXDI_UnpackReservoir(RTXDI_PackedReservoir data)
     res.spatialDistance.y = int(data.distanceAge << (32 - RTXDI_PackedReservoir_DistanceYShift - RTXDI_PackedReservoir_DistanceChannelBits)) >> (32 - RTXDI_PackedReservoir_DistanceChannelBits);
     res.age = (data.distanceAge >> RTXDI_PackedReservoir_AgeShift) & RTXDI_PackedReservoir_MaxAge;
     res.canonicalWeight = 0.0f;
+#if RTXDI_COMPACT_LIGHT_RESERVOIR
+    res.colorWeight = RTXDI_DecodeLogLuv24ToRGB(data.packedWeights >> RTXDI_PackedReservoir_ColorWeightShift) * ((res.weightSum > 0) ? res.weightSum : 1.0);
+#else
     res.colorWeight = data.colorWeight;
+#endif
 
     // Discard reservoirs that have Inf/NaN
     if (isinf(res.weightSum) || isnan(res.weightSum)) {
@@ -235,7 +283,8 @@ uint RTXDI_GetReservoirLightIndex(const RTXDI_Reservoir reservoir)
 
 float2 RTXDI_GetReservoirSampleUV(const RTXDI_Reservoir reservoir)
 {
-    return float2(reservoir.uvData & 0xffff, reservoir.uvData >> 16) / float(0xffff);
+    return float2(reservoir.uvData & RTXDI_Reservoir_UVChannelMax, (reservoir.uvData >> RTXDI_Reservoir_UVChannelBits) & RTXDI_Reservoir_UVChannelMax)
+        / float(RTXDI_Reservoir_UVChannelMax);
 }
 
 float RTXDI_GetReservoirInvPdf(const RTXDI_Reservoir reservoir)
@@ -70,14 +70,20 @@ uint RTXDI_ReservoirPositionToPointer(
     uint2 reservoirPosition,
     uint reservoirArrayIndex)
 {
-    uint2 blockIdx = reservoirPosition / RTXDI_RESERVOIR_BLOCK_SIZE;
-    uint2 positionInBlock = reservoirPosition % RTXDI_RESERVOIR_BLOCK_SIZE;
+    uint blockSizeLog2 = params.reservoirBlockSizeLog2;
+    uint2 blockIdx = reservoirPosition >> blockSizeLog2;
+    uint2 positionInBlock = reservoirPosition & ((1u << blockSizeLog2) - 1);
+
+    // The layout is uniform across the dispatch, so this branch is coherent
+    uint offsetInBlock = (params.reservoirBlockLayout == RTXDI_RESERVOIR_LAYOUT_ZCURVE)
+        ? RTXDI_ZCurveToLinearIndex(positionInBlock)
+        : (positionInBlock.y << blockSizeLog2) + positionInBlock.x;
 
     return reservoirArrayIndex * params.reservoirArrayPitch
+        + params.reservoirViewOffset
         + blockIdx.y * params.reservoirBlockRowPitch
-        + blockIdx.x * (RTXDI_RESERVOIR_BLOCK_SIZE * RTXDI_RESERVOIR_BLOCK_SIZE)
-        + positionInBlock.y * RTXDI_RESERVOIR_BLOCK_SIZE
-        + positionInBlock.x;
+        + (blockIdx.x << (blockSizeLog2 * 2))
+        + offsetInBlock;
 }
 
 #if RTXDI_REGIR_MODE == RTXDI_REGIR_GRID
@@ -139,7 +145,7 @@ int RTXDI_ReGIR_WorldPosToCellIndex(RTXDI_ResamplingRuntimeParameters params, fl
 
     const int3 gridCenterIndex = floor(camearaCenter / params.regirCommon.cellSize);
     int3 cellIndex = floor(worldPos / params.regirCommon.cellSize);
-    int3 gridCell = cellIndex >= 0 ? cellIndex % gridCellCount : gridCellCount - ((-cellIndex) % gridCellCount);
+    int3 gridCell = ((cellIndex % gridCellCount) + gridCellCount) % gridCellCount;
     
     int3 offset = cellIndex - gridCenterIndex;
     if( offset.x < - 0.5 * gridCellCount.x || offset.x >= 0.5 * gridCellCount.x 
@@ -166,7 +172,7 @@ bool RTXDI_ReGIR_CellIndexToWorldPos(RTXDI_ResamplingRuntimeParameters params, i
     
     int3 gridCenterIndex = floor(camearaCenter / params.regirCommon.cellSize);
     float3 gridCenter = gridCenterIndex * params.regirCommon.cellSize + 0.5 * params.regirCommon.cellSize;
-    gridCenterIndex = gridCenterIndex >= 0 ? gridCenterIndex % gridCellCount : gridCellCount - ((-gridCenterIndex) % gridCellCount);
+    gridCenterIndex = ((gridCenterIndex % gridCellCount) + gridCellCount) % gridCellCount;
     int3 cellOffset = (cellPosition - gridCenterIndex + gridCellCount) % gridCellCount;
     cellOffset = cellOffset >= (gridCellCount / 2) ? cellOffset - gridCellCount : cellOffset;
     cellCenter= cellOffset * params.regirCommon.cellSize + gridCenter;
@@ -175,6 +181,112 @@ bool RTXDI_ReGIR_CellIndexToWorldPos(RTXDI_ResamplingRuntimeParameters params, i
     return true;
 }
 
+#elif RTXDI_REGIR_MODE == RTXDI_REGIR_HASHGRID
+
+// The hash grid stores the keys of the allocated cells in an application-provided buffer,
+// and the index of the hash table slot is the cell index. Cells are allocated by calling
+// RTXDI_ReGIR_HashGridInsert for surface positions before the ReGIR build pass,
+// and the table must be cleared to RTXDI_REGIR_HASH_EMPTY_KEY before that.
+#ifndef RTXDI_REGIR_HASH_BUFFER
+#error "RTXDI_REGIR_HASH_BUFFER must be defined to point to a RWBuffer<uint> type resource"
+#endif
+
+int3 RTXDI_ReGIR_HashGridCenterCell(RTXDI_ResamplingRuntimeParameters params)
+{
+    const float3 gridCenter = float3(params.regirCommon.centerX, params.regirCommon.centerY, params.regirCommon.centerZ);
+    return int3(floor(gridCenter / params.regirCommon.cellSize));
+}
+
+// Returns the hash table key for the cell containing the given position,
+// or RTXDI_REGIR_HASH_EMPTY_KEY if the position is too far from the center.
+uint RTXDI_ReGIR_HashGridWorldPosToKey(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
+{
+    int3 cellOffset = int3(floor(worldPos / params.regirCommon.cellSize)) - RTXDI_ReGIR_HashGridCenterCell(params);
+
+    if (any(cellOffset < -RTXDI_REGIR_HASH_CELL_RANGE) || any(cellOffset >= RTXDI_REGIR_HASH_CELL_RANGE))
+        return RTXDI_REGIR_HASH_EMPTY_KEY;
+
+    uint3 biasedOffset = uint3(cellOffset + RTXDI_REGIR_HASH_CELL_RANGE);
+    return biasedOffset.x | (biasedOffset.y << 10) | (biasedOffset.z << 20) | RTXDI_REGIR_HASH_KEY_VALID_BIT;
+}
+
+// Allocates a hash table slot for the cell containing the given position, or finds the existing one.
+// Returns the cell index, or -1 if the position is out of range or the probing sequence is full.
+int RTXDI_ReGIR_HashGridInsert(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
+{
+    uint key = RTXDI_ReGIR_HashGridWorldPosToKey(params, worldPos);
+    if (key == RTXDI_REGIR_HASH_EMPTY_KEY)
+        return -1;
+
+    uint tableMask = params.regirHashGrid.tableSize - 1;
+    uint slot = RTXDI_JenkinsHash(key) & tableMask;
+
+    for (uint probe = 0; probe < params.regirHashGrid.maxProbes; probe++)
+    {
+        uint previousKey;
+        InterlockedCompareExchange(RTXDI_REGIR_HASH_BUFFER[slot], RTXDI_REGIR_HASH_EMPTY_KEY, key, previousKey);
+
+        if (previousKey == RTXDI_REGIR_HASH_EMPTY_KEY || previousKey == key)
+            return int(slot);
+
+        slot = (slot + 1) & tableMask;
+    }
+
+    return -1;
+}
+
+float RTXDI_ReGIR_GetJitterScale(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
+{
+    return params.regirCommon.samplingJitter * params.regirCommon.cellSize;
+}
+
+int RTXDI_ReGIR_WorldPosToCellIndex(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
+{
+    uint key = RTXDI_ReGIR_HashGridWorldPosToKey(params, worldPos);
+    if (key == RTXDI_REGIR_HASH_EMPTY_KEY)
+        return -1;
+
+    uint tableMask = params.regirHashGrid.tableSize - 1;
+    uint slot = RTXDI_JenkinsHash(key) & tableMask;
+
+    for (uint probe = 0; probe < params.regirHashGrid.maxProbes; probe++)
+    {
+        uint storedKey = RTXDI_REGIR_HASH_BUFFER[slot];
+
+        if (storedKey == key)
+            return int(slot);
+
+        // An empty slot terminates the probing sequence: the cell has not been allocated
+        if (storedKey == RTXDI_REGIR_HASH_EMPTY_KEY)
+            return -1;
+
+        slot = (slot + 1) & tableMask;
+    }
+
+    return -1;
+}
+
+bool RTXDI_ReGIR_CellIndexToWorldPos(RTXDI_ResamplingRuntimeParameters params, int cellIndex, out float3 cellCenter, out float cellRadius)
+{
+    cellCenter = float3(0, 0, 0);
+    cellRadius = 0;
+
+    if (cellIndex < 0 || uint(cellIndex) >= params.regirHashGrid.tableSize)
+        return false;
+
+    uint key = RTXDI_REGIR_HASH_BUFFER[cellIndex];
+    if (key == RTXDI_REGIR_HASH_EMPTY_KEY)
+        return false;
+
+    int3 cellOffset = int3(key & 0x3ff, (key >> 10) & 0x3ff, (key >> 20) & 0x3ff) - RTXDI_REGIR_HASH_CELL_RANGE;
+    int3 cellPosition = RTXDI_ReGIR_HashGridCenterCell(params) + cellOffset;
+
+    cellCenter = (float3(cellPosition) + 0.5) * params.regirCommon.cellSize;
+    cellRadius = params.regirCommon.cellSize * sqrt(3.0);
+
+    return true;
+}
+
 #elif RTXDI_REGIR_MODE == RTXDI_REGIR_ONION
 
 float RTXDI_ReGIR_GetJitterScale(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
@@ -191,37 +303,75 @@ float RTXDI_ReGIR_GetJitterScale(RTXDI_ResamplingRuntimeParameters params, float
     return jitterScale * params.regirCommon.samplingJitter * params.regirCommon.cellSize;
 }
 
-int RTXDI_ReGIR_WorldPosToCellIndex(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
+// Returns the global index of the onion layer containing the given radius, which must be within the onion.
+// All layer groups except the last one contain a single layer, so the global index also identifies the group.
+uint RTXDI_ReGIR_OnionRadiusToLayer(RTXDI_ResamplingRuntimeParameters params, float r)
 {
-    const float3 onionCenter = float3(params.regirCommon.centerX, params.regirCommon.centerY, params.regirCommon.centerZ);
-    const float3 translatedPos = worldPos - onionCenter;
+    uint radiusBucket = (asuint(r) >> RTXDI_ONION_RADIUS_BUCKET_SHIFT) - params.regirOnion.radiusBucketBase;
 
-    float r, azimuth, elevation;
-    RTXDI_CartesianToSpherical(translatedPos, r, azimuth, elevation);
-    azimuth += RTXDI_PI; // Add PI to make sure azimuth doesn't cross zero
+    if (radiusBucket < params.regirOnion.radiusBucketCount)
+    {
+        uint layer = (params.regirOnion.radiusBuckets[radiusBucket >> 4][(radiusBucket >> 2) & 3] >> ((radiusBucket & 3) * 8)) & 0xff;
 
-    if (r <= params.regirOnion.layers[0].innerRadius)
-        return 0;
+        if (layer < params.regirOnion.tableLayerCount && r > params.regirOnion.layerOuterRadius[layer >> 2][layer & 3])
+            layer++;
 
-    RTXDI_OnionLayerGroup layerGroup;
+        return layer;
+    }
 
-    int layerGroupIndex;
-    for (layerGroupIndex = 0; layerGroupIndex < params.regirOnion.numLayerGroups; layerGroupIndex++)
+    // The radius is beyond the lookup table, search the layer groups
+    uint layerOffset = 0;
+    for (uint layerGroupIndex = 0; layerGroupIndex < params.regirOnion.numLayerGroups; layerGroupIndex++)
     {
-        if (r <= params.regirOnion.layers[layerGroupIndex].outerRadius)
+        RTXDI_OnionLayerGroup layerGroup = params.regirOnion.layers[layerGroupIndex];
+
+        if (r <= layerGroup.outerRadius)
         {
-            layerGroup = params.regirOnion.layers[layerGroupIndex];
-            break;
+            uint layerIndex = uint(floor(max(0, log(r / layerGroup.innerRadius) * layerGroup.invLogLayerScale)));
+            layerIndex = min(layerIndex, uint(layerGroup.layerCount - 1)); // Guard against numeric errors at the outer shell
+            return layerOffset + layerIndex;
         }
+
+        layerOffset += uint(layerGroup.layerCount);
     }
 
-    if (layerGroupIndex >= params.regirOnion.numLayerGroups)
+    return layerOffset;
+}
+
+int RTXDI_ReGIR_WorldPosToCellIndex(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
+{
+    const float3 onionCenter = float3(params.regirCommon.centerX, params.regirCommon.centerY, params.regirCommon.centerZ);
+    const float3 translatedPos = worldPos - onionCenter;
+
+    float r = length(translatedPos);
+
+    if (r <= params.regirOnion.layers[0].innerRadius)
+        return 0;
+
+    uint lastLayerGroupIndex = params.regirOnion.numLayerGroups - 1;
+
+    if (r > params.regirOnion.layers[lastLayerGroupIndex].outerRadius)
         return -1;
 
-    uint layerIndex = uint(floor(max(0, log(r / layerGroup.innerRadius) * layerGroup.invLogLayerScale)));
-    layerIndex = min(layerIndex, layerGroup.layerCount - 1); // Guard against numeric errors at the outer shell
+    float3 direction = translatedPos / r;
+    float azimuth = atan2(direction.z, direction.x) + RTXDI_PI; // Add PI to make sure azimuth doesn't cross zero
+    float absSinElevation = abs(direction.y);
+
+    uint layer = RTXDI_ReGIR_OnionRadiusToLayer(params, r);
+    uint layerGroupIndex = min(layer, lastLayerGroupIndex);
+    uint layerIndex = layer - layerGroupIndex;
+
+    RTXDI_OnionLayerGroup layerGroup = params.regirOnion.layers[layerGroupIndex];
+
+    // Same as floor(asin(absSinElevation) * layerGroup.invEquatorialCellAngle + 0.5), see RTXDI_ReGIROnionParameters
+    uint ringBucket = min(uint(absSinElevation * float(RTXDI_ONION_RING_BUCKETS)), uint(RTXDI_ONION_RING_BUCKETS - 1));
+    uint ringEntry = layerGroupIndex * RTXDI_ONION_RING_BUCKETS + ringBucket;
+    uint ringIndex = (params.regirOnion.ringBuckets[ringEntry >> 5][(ringEntry >> 3) & 3] >> ((ringEntry & 7) * 4)) & 0xf;
+
+    int nextRing = layerGroup.ringOffset + int(ringIndex) + 1;
+    if (int(ringIndex) + 1 < layerGroup.ringCount && absSinElevation >= params.regirOnion.ringThresholds[nextRing >> 2][nextRing & 3])
+        ringIndex++;
 
-    uint ringIndex = uint(floor(abs(elevation) * layerGroup.invEquatorialCellAngle + 0.5));
     RTXDI_OnionRing ring = params.regirOnion.rings[layerGroup.ringOffset + ringIndex];
 
     if ((layerIndex & 1) != 0)
@@ -234,7 +384,7 @@ int RTXDI_ReGIR_WorldPosToCellIndex(RTXDI_ResamplingRuntimeParameters params, fl
     int cellIndex = int(floor(azimuth * ring.invCellAngle));
 
     int ringCellOffset = ring.cellOffset;
-    if (elevation < 0 && ringIndex > 0)
+    if (direction.y < 0 && ringIndex > 0)
         ringCellOffset += ring.cellCount;
 
     return int(cellIndex + ringCellOffset + layerIndex * layerGroup.cellsPerLayer + layerGroup.layerCellOffset);
@@ -330,6 +480,76 @@ bool RTXDI_ReGIR_CellIndexToWorldPos(RTXDI_ResamplingRuntimeParameters params, i
 
 #endif
 
+#if (RTXDI_REGIR_MODE != RTXDI_REGIR_DISABLED) && (RTXDI_REGIR_MODE != RTXDI_REGIR_HASHGRID) && defined(RTXDI_REGIR_OCCUPANCY_BUFFER)
+
+// Occupancy-driven ReGIR build: RTXDI_REGIR_OCCUPANCY_BUFFER is a RWBuffer<uint> with one bit per cell,
+// see rtxdi::Context::GetReGIROccupancyMaskSize(). The application clears it, marks the cells reachable from
+// the visible surfaces with RTXDI_ReGIR_MarkOccupiedCells, and then only builds the marked cells.
+// Lookups that land in unmarked cells fall back to local light sampling, see RTXDI_SampleLocalLightsFromReGIR.
+
+bool RTXDI_ReGIR_IsCellOccupied(int cellIndex)
+{
+    if (cellIndex < 0)
+        return false;
+
+    return (RTXDI_REGIR_OCCUPANCY_BUFFER[uint(cellIndex) >> 5] & (1u << (uint(cellIndex) & 31))) != 0;
+}
+
+void RTXDI_ReGIR_MarkCellOccupied(int cellIndex)
+{
+    if (cellIndex < 0)
+        return;
+
+    const uint bit = 1u << (uint(cellIndex) & 31);
+
+    // Most neighboring pixels mark the same cells, skip the atomic when the bit is already set
+    if ((RTXDI_REGIR_OCCUPANCY_BUFFER[uint(cellIndex) >> 5] & bit) == 0)
+        InterlockedOr(RTXDI_REGIR_OCCUPANCY_BUFFER[uint(cellIndex) >> 5], bit);
+}
+
+// Marks all cells that a ReGIR lookup from the given surface position can reach through the sampling jitter.
+// The Grid and AlignGrid modes mark exactly the cells overlapping the jitter box, the Onion mode marks
+// the cells of a point lattice in that box, see rtxdi::ReGIRMarkOccupiedCells for the host-side reference.
+void RTXDI_ReGIR_MarkOccupiedCells(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
+{
+    const float halfJitter = 0.5 * RTXDI_ReGIR_GetJitterScale(params, worldPos);
+    const float3 boxMin = worldPos - halfJitter;
+    const float3 boxMax = worldPos + halfJitter;
+
+#if RTXDI_REGIR_MODE == RTXDI_REGIR_ONION
+    // About 3 lattice points per local cell along each axis
+    const int steps = int(ceil(params.regirCommon.samplingJitter * 3.0));
+    for (int z = 0; z <= steps; z++)
+    for (int y = 0; y <= steps; y++)
+    for (int x = 0; x <= steps; x++)
+    {
+        const float3 latticePos = boxMin + (boxMax - boxMin) * float3(x, y, z) / float(max(steps, 1));
+        RTXDI_ReGIR_MarkCellOccupied(RTXDI_ReGIR_WorldPosToCellIndex(params, latticePos));
+    }
+#else
+    const float cellSize = params.regirCommon.cellSize;
+#if RTXDI_REGIR_MODE == RTXDI_REGIR_GRID
+    const float3 gridCenter = float3(params.regirCommon.centerX, params.regirCommon.centerY, params.regirCommon.centerZ);
+    const int3 gridCellCount = int3(params.regirGrid.cellsX, params.regirGrid.cellsY, params.regirGrid.cellsZ);
+    const float3 gridOrigin = gridCenter - float3(gridCellCount) * (cellSize * 0.5);
+#else
+    const float3 gridOrigin = 0; // AlignGrid cells are aligned to the world origin
+#endif
+    const int3 cellMin = int3(floor((boxMin - gridOrigin) / cellSize));
+    const int3 cellMax = int3(floor((boxMax - gridOrigin) / cellSize));
+
+    for (int z = cellMin.z; z <= cellMax.z; z++)
+    for (int y = cellMin.y; y <= cellMax.y; y++)
+    for (int x = cellMin.x; x <= cellMax.x; x++)
+    {
+        const float3 cellCenter = (float3(x, y, z) + 0.5) * cellSize + gridOrigin;
+        RTXDI_ReGIR_MarkCellOccupied(RTXDI_ReGIR_WorldPosToCellIndex(params, cellCenter));
+    }
+#endif
+}
+
+#endif // RTXDI_REGIR_OCCUPANCY_BUFFER
+
 #if RTXDI_REGIR_MODE != RTXDI_REGIR_DISABLED
 
 float3 RTXDI_VisualizeReGIRCells(RTXDI_ResamplingRuntimeParameters params, float3 worldPos)
@@ -353,6 +573,297 @@ float3 RTXDI_VisualizeReGIRCells(RTXDI_ResamplingRuntimeParameters params, float
 }
 #endif
 
+#ifdef RTXDI_VISIBILITY_BUFFER
+
+// The visibility buffer accumulates visibility test results per (ReGIR cell, emitter) pair,
+// see RTXDI_VISIBILITY_LAYOUT_... for the storage formats. Emitter indices are defined by the application.
+
+// Returns the index of the first buffer element of the entry for the given emitter in the given cell, or -1.
+// With the compact layout, 'allocate' makes the function claim an empty entry for an emitter that is not
+// tracked yet. Entries are only released by clearing the buffer, so each cell tracks the first
+// params.visibilityBuffer.lightsPerCell emitters seen in it since the last clear.
+int RTXDI_VisibilityBufferFindEntry(
+    RTXDI_ResamplingRuntimeParameters params,
+    int cellIndex,
+    uint emitterIndex,
+    bool allocate)
+{
+    const RTXDI_VisibilityBufferParameters vis = params.visibilityBuffer;
+
+    if (cellIndex < 0 || uint(cellIndex) >= vis.cellCount || vis.lightsPerCell == 0)
+        return -1;
+
+    uint cellBase = uint(cellIndex) * vis.lightsPerCell;
+
+    if (vis.layout == RTXDI_VISIBILITY_LAYOUT_DENSE)
+    {
+        if (emitterIndex >= vis.lightsPerCell)
+            return -1;
+
+        return int((cellBase + emitterIndex) * 2);
+    }
+
+    uint key = emitterIndex + 1;
+    uint slot = RTXDI_JenkinsHash(emitterIndex) % vis.lightsPerCell;
+
+    for (uint probe = 0; probe < vis.lightsPerCell; probe++)
+    {
+        uint element = (cellBase + slot) * 2;
+        uint storedKey;
+
+        if (allocate)
+            InterlockedCompareExchange(RTXDI_VISIBILITY_BUFFER[element], RTXDI_VISIBILITY_EMPTY_KEY, key, storedKey);
+        else
+            storedKey = RTXDI_VISIBILITY_BUFFER[element];
+
+        if (storedKey == key || (allocate && storedKey == RTXDI_VISIBILITY_EMPTY_KEY))
+            return int(element);
+
+        // Entries are never removed, so an empty slot terminates the probing sequence
+        if (storedKey == RTXDI_VISIBILITY_EMPTY_KEY)
+            return -1;
+
+        slot = (slot + 1 == vis.lightsPerCell) ? 0 : slot + 1;
+    }
+
+    return -1;
+}
+
+// Adds the result of one visibility test of the given emitter from a surface in the given cell.
+void RTXDI_RecordVisibility(
+    RTXDI_ResamplingRuntimeParameters params,
+    int cellIndex,
+    uint emitterIndex,
+    bool visible)
+{
+    int element = RTXDI_VisibilityBufferFindEntry(params, cellIndex, emitterIndex, true);
+    if (element < 0)
+        return;
+
+    if (params.visibilityBuffer.layout == RTXDI_VISIBILITY_LAYOUT_DENSE)
+    {
+        if (visible)
+            InterlockedAdd(RTXDI_VISIBILITY_BUFFER[element], 1);
+        InterlockedAdd(RTXDI_VISIBILITY_BUFFER[element + 1], 1);
+        return;
+    }
+
+    // The 16-bit counters stop growing once the total is saturated, until the buffer is cleared.
+    // The check is not atomic with the add, but the visible counter can never exceed the total one,
+    // so a race near saturation can only lose the carry out of the total counter.
+    uint counters = RTXDI_VISIBILITY_BUFFER[element + 1];
+    if ((counters >> 16) >= RTXDI_VISIBILITY_MAX_COUNT)
+        return;
+
+    InterlockedAdd(RTXDI_VISIBILITY_BUFFER[element + 1], (1u << 16) | (visible ? 1u : 0u));
+}
+
+// Loads the visibility statistics of the given emitter in the given cell.
+// Returns false if there are no statistics for this emitter, e.g. it's not tracked with the compact layout.
+bool RTXDI_LoadVisibility(
+    RTXDI_ResamplingRuntimeParameters params,
+    int cellIndex,
+    uint emitterIndex,
+    out uint visibleCount,
+    out uint totalCount)
+{
+    visibleCount = 0;
+    totalCount = 0;
+
+    int element = RTXDI_VisibilityBufferFindEntry(params, cellIndex, emitterIndex, false);
+    if (element < 0)
+        return false;
+
+    if (params.visibilityBuffer.layout == RTXDI_VISIBILITY_LAYOUT_DENSE)
+    {
+        visibleCount = RTXDI_VISIBILITY_BUFFER[element];
+        totalCount = RTXDI_VISIBILITY_BUFFER[element + 1];
+    }
+    else
+    {
+        uint counters = RTXDI_VISIBILITY_BUFFER[element + 1];
+        visibleCount = counters & 0xffff;
+        totalCount = counters >> 16;
+    }
+
+    return totalCount != 0;
+}
+
+#endif // RTXDI_VISIBILITY_BUFFER
+
+#ifdef RTXDI_LIGHT_TREE_BUFFER
+
+#ifndef RTXDI_LIGHT_TREE_TRAIL_BUFFER
+#error "RTXDI_LIGHT_TREE_TRAIL_BUFFER must be defined to point to a Buffer<uint> type resource"
+#endif
+
+// The light tree is built on the CPU by rtxdi::LightTree, and the functions below match
+// LightTree::EvaluateImportance, Sample and EvaluatePdf exactly, so that the PDFs of the lights
+// sampled on the GPU can be verified against the reference implementation.
+
+// cos(max(0, a - b)) from the sines and cosines of angles a and b in [0, pi]
+float RTXDI_CosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    if (cosA > cosB)
+        return 1.0;
+    return cosA * cosB + sinA * sinB;
+}
+
+// sin(max(0, a - b)) from the sines and cosines of angles a and b in [0, pi]
+float RTXDI_SinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    if (cosA > cosB)
+        return 0.0;
+    return sinA * cosB - cosA * sinB;
+}
+
+static const float RTXDI_LightTreeOneMinusEpsilon = 0.99999994; // largest float below 1
+
+float RTXDI_SafeSqrt(float x)
+{
+    return sqrt(max(0.0, x));
+}
+
+// Estimates the contribution of the lights in the node to a point with the given normal,
+// or a point in a volume if the normal is zero.
+float RTXDI_LightTreeNodeImportance(RTXDI_LightTreeNode node, float3 position, float3 normal)
+{
+    if (node.power <= 0.0)
+        return 0.0;
+
+    float3 center = (node.boundsMin + node.boundsMax) * 0.5;
+    float3 diagonal = node.boundsMax - node.boundsMin;
+
+    float3 toPosition = position - center;
+    float distanceSquared = dot(toPosition, toPosition);
+    float clampedDistanceSquared = max(max(distanceSquared, 0.5 * sqrt(dot(diagonal, diagonal))), 1e-8);
+    float3 wi = distanceSquared > 0.0 ? toPosition * (1.0 / sqrt(distanceSquared)) : float3(0.0, 0.0, 0.0);
+
+    // Angle between the cone axis and the direction to the point
+    float cosThetaW = distanceSquared > 0.0 ? dot(node.axis, wi) : 1.0;
+    float sinThetaW = RTXDI_SafeSqrt(1.0 - cosThetaW * cosThetaW);
+
+    // Angle subtended by the bounding sphere of the node
+    float radiusSquared = 0.25 * dot(diagonal, diagonal);
+    float cosThetaB = distanceSquared < radiusSquared ? -1.0 : RTXDI_SafeSqrt(1.0 - radiusSquared / distanceSquared);
+    float sinThetaB = RTXDI_SafeSqrt(1.0 - cosThetaB * cosThetaB);
+
+    // Smallest angle between the emitted directions and the direction to the point
+    float sinThetaO = RTXDI_SafeSqrt(1.0 - node.cosThetaO * node.cosThetaO);
+    float cosThetaX = RTXDI_CosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+    float sinThetaX = RTXDI_SinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+    float cosThetaP = RTXDI_CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+
+    if (cosThetaP <= node.cosThetaE)
+        return 0.0;
+
+    float importance = node.power * cosThetaP / clampedDistanceSquared;
+
+    // Smallest angle of incidence at the surface, zero if the node is entirely below the horizon
+    if (dot(normal, normal) > 0.0)
+    {
+        float cosThetaI = distanceSquared > 0.0 ? -dot(wi, normal) : 1.0;
+        float sinThetaI = RTXDI_SafeSqrt(1.0 - cosThetaI * cosThetaI);
+        float cosThetaPI = RTXDI_CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+        importance *= max(0.0, cosThetaPI);
+    }
+
+    return max(0.0, importance);
+}
+
+// Selects a local light by traversing the light tree with the random number 'rnd' in [0, 1).
+// The returned index is relative to the first local light.
+// Returns false if no light has a nonzero importance for the point.
+bool RTXDI_SampleLightTree(
+    float rnd,
+    float3 position,
+    float3 normal,
+    out uint localLightIndex,
+    out float pdf)
+{
+    localLightIndex = RTXDI_InvalidLightIndex;
+    pdf = 0.0;
+
+    RTXDI_LightTreeNode node = RTXDI_LIGHT_TREE_BUFFER[0];
+    if (RTXDI_LightTreeNodeImportance(node, position, normal) <= 0.0)
+        return false;
+
+    float selectionPdf = 1.0;
+
+    // The depth limit only protects against a corrupted buffer
+    for (uint depth = 0; depth < RTXDI_LIGHT_TREE_MAX_DEPTH && (node.flags & RTXDI_LIGHT_TREE_LEAF_BIT) == 0; depth++)
+    {
+        uint firstChild = node.childOrLightIndex;
+        RTXDI_LightTreeNode child0 = RTXDI_LIGHT_TREE_BUFFER[firstChild];
+        RTXDI_LightTreeNode child1 = RTXDI_LIGHT_TREE_BUFFER[firstChild + 1];
+        float importance0 = RTXDI_LightTreeNodeImportance(child0, position, normal);
+        float importance1 = RTXDI_LightTreeNodeImportance(child1, position, normal);
+        float importanceSum = importance0 + importance1;
+
+        if (importanceSum <= 0.0)
+            return false;
+
+        // Reuse the random number for the next level by remapping the selected interval to [0, 1)
+        float probability0 = importance0 / importanceSum;
+        if (rnd < probability0)
+        {
+            node = child0;
+            selectionPdf *= probability0;
+            rnd = min(rnd / probability0, RTXDI_LightTreeOneMinusEpsilon);
+        }
+        else
+        {
+            float probability1 = importance1 / importanceSum;
+            node = child1;
+            selectionPdf *= probability1;
+            rnd = min((rnd - probability0) / probability1, RTXDI_LightTreeOneMinusEpsilon);
+        }
+    }
+
+    if ((node.flags & RTXDI_LIGHT_TREE_LEAF_BIT) == 0)
+        return false;
+
+    localLightIndex = node.childOrLightIndex;
+    pdf = selectionPdf;
+    return pdf > 0.0;
+}
+
+// Returns the probability of RTXDI_SampleLightTree selecting the given local light for the point.
+float RTXDI_EvaluateLightTreePdf(uint localLightIndex, float3 position, float3 normal)
+{
+    uint trail = RTXDI_LIGHT_TREE_TRAIL_BUFFER[localLightIndex];
+    if (trail == 0)
+        return 0.0;
+
+    RTXDI_LightTreeNode node = RTXDI_LIGHT_TREE_BUFFER[0];
+    if (RTXDI_LightTreeNodeImportance(node, position, normal) <= 0.0)
+        return 0.0;
+
+    float pdf = 1.0;
+
+    while (trail > 1)
+    {
+        uint firstChild = node.childOrLightIndex;
+        RTXDI_LightTreeNode child0 = RTXDI_LIGHT_TREE_BUFFER[firstChild];
+        RTXDI_LightTreeNode child1 = RTXDI_LIGHT_TREE_BUFFER[firstChild + 1];
+        float importance0 = RTXDI_LightTreeNodeImportance(child0, position, normal);
+        float importance1 = RTXDI_LightTreeNodeImportance(child1, position, normal);
+        float importanceSum = importance0 + importance1;
+
+        if (importanceSum <= 0.0)
+            return 0.0;
+
+        bool secondChild = (trail & 1) != 0;
+        pdf *= (secondChild ? importance1 : importance0) / importanceSum;
+        node = secondChild ? child1 : child0;
+        trail >>= 1;
+    }
+
+    return pdf;
+}
+
+#endif // RTXDI_LIGHT_TREE_BUFFER
+
 #ifdef RTXDI_ENABLE_BOILING_FILTER
 // RTXDI_BOILING_FILTER_GROUP_SIZE must be defined - 16 is a reasonable value
 #define RTXDI_BOILING_FILTER_MIN_LANE_COUNT 32
@@ -143,6 +143,27 @@ uint RTXDI_PackSnorm2x16(float2 v)
     return packed;
 }
 
+// Unpack two 8-bit snorm values from the lo bits of a dword.
+//  - packed: Two 8-bit snorm in bits 0..7 and 8..15.
+//  - returns: Two float values in [-1,1].
+float2 RTXDI_UnpackSnorm2x8(uint packed)
+{
+    int2 bits = int2(packed << 24, packed << 16) >> 24;
+    float2 unpacked = max(float2(bits) / 127.0, -1.0);
+    return unpacked;
+}
+
+// Pack two floats into 8-bit snorm values in the lo bits of a dword.
+//  - returns: Two 8-bit snorm in bits 0..7 and 8..15.
+uint RTXDI_PackSnorm2x8(float2 v)
+{
+    v = any(isnan(v)) ? float2(0, 0) : clamp(v, -1.0, 1.0);
+    int2 iv = int2(round(v * 127.0));
+    uint packed = (iv.x & 0x000000ff) | ((iv.y & 0x000000ff) << 8);
+
+    return packed;
+}
+
 // Converts normalized direction to the octahedral map (non-equal area, signed normalized).
 //  - n: Normalized direction.
 //  - returns: Position in octahedral map in [-1,1] for each component.
@@ -194,6 +215,20 @@ float3 RTXDI_DecodeNormalizedVectorFromSnorm2x16(uint packedNormal)
     return RTXDI_OctahedralMappingToNormalizedVector(octNormal);
 }
 
+// Encode a normal packed as 2x 8-bit snorms in the octahedral mapping.
+uint RTXDI_EncodeNormalizedVectorToSnorm2x8(float3 normal)
+{
+    float2 octNormal = RTXDI_NormalizedVectorToOctahedralMapping(normal);
+    return RTXDI_PackSnorm2x8(octNormal);
+}
+
+// Decode a normal packed as 2x 8-bit snorms in the octahedral mapping.
+float3 RTXDI_DecodeNormalizedVectorFromSnorm2x8(uint packedNormal)
+{
+    float2 octNormal = RTXDI_UnpackSnorm2x8(packedNormal);
+    return RTXDI_OctahedralMappingToNormalizedVector(octNormal);
+}
+
 // Transforms an RGB color in Rec.709 to CIE XYZ.
 float3 RTXDI_RGBToXYZInRec709(float3 c)
 {
@@ -297,4 +332,75 @@ float3 RTXDI_DecodeLogLuvToRGB(uint packedColor)
     return max(RTXDI_XYZToRGBInRec709(XYZ), 0.0);
 }
 
+// Encode an RGB color into a 24-bit LogLuv format, in the low 24 bits of the result.
+//
+// The log-luminance is encoded with 8 bits over the range [-16,16), in 4.4% steps, and chroma with 8 bits each.
+// Black (all zeros) is handled exactly. See RTXDI_EncodeRGBToLogLuv() for the 32-bit format.
+uint RTXDI_EncodeRGBToLogLuv24(float3 color)
+{
+    float3 XYZ = RTXDI_RGBToXYZInRec709(color);
+
+    // Encode log2(Y) over the range [-16,16) in 8 bits, Le==0 if Y < 2^-16 and decodes as zero.
+    float logY = 8.0 * (log2(XYZ.y) + 16.0); // -inf if Y==0
+    uint Le = uint(clamp(logY, 0.0, 255.0));
+
+    if (Le == 0) return 0;
+
+    float invDenom = 1.0 / (-2.0 * XYZ.x + 12.0 * XYZ.y + 3.0 * (XYZ.x + XYZ.y + XYZ.z));
+    float2 uv = float2(4.0, 9.0) * XYZ.xy * invDenom;
+
+    // The gamut of perceivable uv values is roughly [0,0.62], so scale by 410 to get 8-bit values.
+    uint2 uve = uint2(clamp(410.0 * uv, 0.0, 255.0));
+
+    return (Le << 16) | (uve.x << 8) | uve.y;
+}
+
+// Decode an RGB color stored in the 24-bit LogLuv format, ignoring the high 8 bits of the input.
+//    See RTXDI_EncodeRGBToLogLuv24() for details.
+float3 RTXDI_DecodeLogLuv24ToRGB(uint packedColor)
+{
+    uint Le = (packedColor >> 16) & 0xff;
+    if (Le == 0) return float3(0, 0, 0);
+
+    float logY = (float(Le) + 0.5) / 8.0 - 16.0;
+    float Y = pow(2.0, logY);
+
+    uint2 uve = uint2(packedColor >> 8, packedColor) & 0xff;
+    float2 uv = (float2(uve)+0.5) / 410.0;
+
+    float invDenom = 1.0 / (6.0 * uv.x - 16.0 * uv.y + 12.0);
+    float2 xy = float2(9.0, 4.0) * uv * invDenom;
+
+    float s = Y / xy.y;
+    float3 XYZ = float3(s * xy.x, Y, s * (1.f - xy.x - xy.y));
+
+    return max(RTXDI_XYZToRGBInRec709(XYZ), 0.0);
+}
+
+// Rounds a float to the nearest bfloat16 value, i.e. the upper 16 bits of the fp32 representation.
+// Keeps the 8-bit exponent, so the range is the same as fp32, and the mantissa is reduced to 7 bits.
+uint RTXDI_FloatToBFloat16(float value)
+{
+    uint bits = asuint(value);
+    return (bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16;
+}
+
+float RTXDI_BFloat16ToFloat(uint packedValue)
+{
+    return asfloat((packedValue & 0xffffu) << 16);
+}
+
+// Rounds a non-negative float to the nearest 12-bit float without a sign bit: the 8-bit exponent of fp32,
+// so the range is the same, and the mantissa reduced to 4 bits.
+uint RTXDI_FloatToUnsignedFloat12(float value)
+{
+    uint bits = asuint(value);
+    return (bits + 0x3ffffu + ((bits >> 19) & 1u)) >> 19;
+}
+
+float RTXDI_UnsignedFloat12ToFloat(uint packedValue)
+{
+    return asfloat((packedValue & 0xfffu) << 19);
+}
+
 #endif // RTXDI_MATH_HLSLI
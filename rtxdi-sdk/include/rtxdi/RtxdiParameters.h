@@ -21,9 +21,34 @@
 #define RTXDI_LIGHT_INDEX_MASK 0x7fffffff
 
 // Reservoirs are stored in a structured buffer in a block-linear layout.
-// This constant defines the size of that block, measured in pixels.
+// This constant defines the default size of that block, measured in pixels.
+// The actual block size is selected with rtxdi::ContextParameters::ReservoirBlockSize.
 #define RTXDI_RESERVOIR_BLOCK_SIZE 16
 
+// Storage format of the light reservoirs, see RTXDI_PackedReservoir.
+// 0: 36 bytes, targetPdf, weight and colorWeight are stored as 32-bit floats.
+// 1: 20 bytes, targetPdf and weight are rounded to 12-bit floats that keep the full 8-bit exponent, so their range
+//    is unchanged and the relative error is below 3.2%. Their exponents use the spare high bits of distanceAge
+//    and uvData, which leaves 12 bits for each sample UV channel. colorWeight is stored in a 24-bit LogLuv format.
+// The macro must have the same value in the host code, which uses sizeof(RTXDI_PackedReservoir), and in the shaders.
+#ifndef RTXDI_COMPACT_LIGHT_RESERVOIR
+#define RTXDI_COMPACT_LIGHT_RESERVOIR 0
+#endif
+
+// Storage format of the GI reservoirs, see RTXDI_PackedGIReservoir.
+// 0: 32 bytes, the sample position is stored as a float3.
+// 1: 16 bytes, the sample position is stored relative to the surface that the reservoir belongs to, as an fp16 distance
+//    and an octahedral direction, and is reconstructed from the G-buffer when the reservoir is loaded. The weight is rounded
+//    to bfloat16, the sample normal to 2x 8-bit octahedral snorms, and there is no space for the application's misc data.
+// The macro must have the same value in the host code and in the shaders, like RTXDI_COMPACT_LIGHT_RESERVOIR.
+#ifndef RTXDI_COMPACT_GI_RESERVOIR
+#define RTXDI_COMPACT_GI_RESERVOIR 0
+#endif
+
+// Orders of the reservoirs within a block, see RTXDI_ResamplingRuntimeParameters::reservoirBlockLayout
+#define RTXDI_RESERVOIR_LAYOUT_ROW_MAJOR 0
+#define RTXDI_RESERVOIR_LAYOUT_ZCURVE 1
+
 // Bias correction modes for temporal and spatial resampling:
 // Use (1/M) normalization, which is very biased but also very fast.
 #define RTXDI_BIAS_CORRECTION_OFF 0
@@ -38,10 +63,35 @@
 #define RTXDI_ONION_MAX_LAYER_GROUPS 8
 #define RTXDI_ONION_MAX_RINGS 52
 
+// Onion cell lookup tables, see RTXDI_ReGIROnionParameters.
+// The radius buckets are indexed with the exponent and the 3 upper mantissa bits of the radius, i.e. 8 buckets per octave,
+// which is finer than the smallest layer scale, so that every bucket contains at most one layer boundary.
+#define RTXDI_ONION_RADIUS_BUCKET_SHIFT 20
+#define RTXDI_ONION_MAX_RADIUS_BUCKETS 128
+#define RTXDI_ONION_MAX_TABLE_LAYERS 64
+// Ring buckets per layer group, indexed with abs(sin(elevation))
+#define RTXDI_ONION_RING_BUCKETS 64
+
 #define RTXDI_REGIR_DISABLED 0
 #define RTXDI_REGIR_GRID 1
 #define RTXDI_REGIR_ONION 2
 #define RTXDI_REGIR_ALIGNGRID 3
+#define RTXDI_REGIR_HASHGRID 4
+
+// Hash grid cells are addressed relative to the cell containing the ReGIR center,
+// with 10 bits per axis, i.e. [-512, 511] cells in each direction.
+#define RTXDI_REGIR_HASH_CELL_RANGE 512
+#define RTXDI_REGIR_HASH_KEY_VALID_BIT (1u << 30)
+#define RTXDI_REGIR_HASH_EMPTY_KEY 0u
+
+// Layouts of the visibility variance buffer, see RTXDI_VisibilityBufferParameters::layout
+// Dense: a pair of 32-bit counters (visible, total) for every emitter in every ReGIR cell.
+#define RTXDI_VISIBILITY_LAYOUT_DENSE 0
+// Compact: a fixed number of (emitter key, packed counters) entries per ReGIR cell,
+// the counters are 16-bit: visible in the low half, total in the high half.
+#define RTXDI_VISIBILITY_LAYOUT_COMPACT 1
+#define RTXDI_VISIBILITY_EMPTY_KEY 0u
+#define RTXDI_VISIBILITY_MAX_COUNT 0xffffu
 
 #ifndef RTXDI_REGIR_MODE
 #define RTXDI_REGIR_MODE RTXDI_REGIR_DISABLED
@@ -49,6 +99,13 @@
 
 #define RTXDI_INVALID_LIGHT_INDEX (0xffffffffu)
 
+// Flag in RTXDI_LightTreeNode::flags that marks a leaf node, which references a single light.
+#define RTXDI_LIGHT_TREE_LEAF_BIT 0x1u
+
+// Maximum depth of the light tree. The path from the root to every leaf is stored in 32 bits,
+// see RTXDI_LIGHT_TREE_TRAIL_BUFFER.
+#define RTXDI_LIGHT_TREE_MAX_DEPTH 31
+
 #ifndef __cplusplus
 static const uint RTXDI_InvalidLightIndex = RTXDI_INVALID_LIGHT_INDEX;
 #endif
@@ -100,8 +157,29 @@ struct RTXDI_ReGIRGridParameters
     uint32_t pad;
 };
 
+struct RTXDI_ReGIRHashGridParameters
+{
+    uint32_t tableSize; // Number of slots in the hash table, a power of 2
+    uint32_t maxProbes; // Maximum length of a linear probing sequence
+    uint32_t pad1;
+    uint32_t pad2;
+};
+
+struct RTXDI_VisibilityBufferParameters
+{
+    uint32_t layout;        // One of the RTXDI_VISIBILITY_LAYOUT_... constants
+    uint32_t lightsPerCell; // Dense: number of emitters on the current frame; compact: number of entries per cell
+    uint32_t cellCount;     // Number of ReGIR cells covered by the buffer
+    uint32_t pad1;
+};
+
 struct RTXDI_ReGIROnionParameters
 {
+#ifdef __cplusplus
+    using uint4 = uint32_t[4];
+    using float4 = float[4];
+#endif
+
     RTXDI_OnionLayerGroup layers[RTXDI_ONION_MAX_LAYER_GROUPS];
     RTXDI_OnionRing rings[RTXDI_ONION_MAX_RINGS];
 
@@ -109,6 +187,23 @@ struct RTXDI_ReGIROnionParameters
     float cubicRootFactor;
     float linearFactor;
     float pad;
+
+    // Lookup tables that replace the logarithm, arcsine and layer group search in RTXDI_ReGIR_WorldPosToCellIndex.
+    // The layers are numbered globally, and all layer groups except the last one contain a single layer.
+    // A radius bucket stores the layer containing the start of the bucket, and the next layer is selected
+    // when the radius is greater than the outer radius of that layer. Radii beyond the last bucket use the full computation.
+    uint32_t radiusBucketBase; // asuint(layers[0].innerRadius) >> RTXDI_ONION_RADIUS_BUCKET_SHIFT
+    uint32_t radiusBucketCount;
+    uint32_t tableLayerCount; // Number of valid layerOuterRadius entries
+    uint32_t pad2;
+
+    uint4 radiusBuckets[RTXDI_ONION_MAX_RADIUS_BUCKETS / 16]; // 8-bit layer indices
+    float4 layerOuterRadius[RTXDI_ONION_MAX_TABLE_LAYERS / 4];
+
+    // Same for the rings: a bucket stores the ring containing the start of the bucket in the layer group,
+    // and the next ring is selected when abs(sin(elevation)) is at least the threshold of that ring.
+    uint4 ringBuckets[RTXDI_ONION_MAX_LAYER_GROUPS * RTXDI_ONION_RING_BUCKETS / 32]; // 4-bit ring indices
+    float4 ringThresholds[RTXDI_ONION_MAX_RINGS / 4]; // Indexed like 'rings'
 };
 
 struct RTXDI_LocalLightRuntimeParameters
@@ -116,7 +211,7 @@ struct RTXDI_LocalLightRuntimeParameters
     uint32_t firstLocalLight;
     uint32_t numLocalLights;
     uint32_t enableLocalLightImportanceSampling;
-    uint32_t pad1;
+    uint32_t enableLightTree; // Takes precedence over enableLocalLightImportanceSampling when nonzero
 };
 
 struct RTXDI_InfiniteLightRuntimeParameters
@@ -161,31 +256,79 @@ struct RTXDI_ResamplingRuntimeParameters
     uint32_t reservoirBlockRowPitch;
     
     uint32_t reservoirArrayPitch;
-    uint32_t pad1;
-    uint32_t pad2;
-    uint32_t pad3;
+    uint32_t reservoirBlockSizeLog2;
+    uint32_t reservoirBlockLayout; // One of the RTXDI_RESERVOIR_LAYOUT_... constants
+    uint32_t reservoirViewOffset; // Offset of the current view's slice within each reservoir array
 
     RTXDI_ReGIRCommonParameters regirCommon;
     RTXDI_ReGIRGridParameters regirGrid;
+    RTXDI_ReGIRHashGridParameters regirHashGrid;
+    RTXDI_VisibilityBufferParameters visibilityBuffer;
     RTXDI_ReGIROnionParameters regirOnion;
 };
 
+// Node of the light tree that is used for spatially aware local light sampling, see rtxdi::LightTree.
+// The bounds are the union of the bounds of all lights under the node. The orientation cone bounds
+// the normals of the emitters (axis, cosThetaO), and cosThetaE bounds the angle between the normal
+// and the emitted directions.
+struct RTXDI_LightTreeNode
+{
+#ifdef __cplusplus
+    using float3 = float[3];
+#endif
+
+    float3 boundsMin;
+    uint32_t childOrLightIndex; // Interior: index of the first child, the second child follows it; leaf: local light index
+
+    float3 boundsMax;
+    uint32_t flags; // RTXDI_LIGHT_TREE_LEAF_BIT
+
+    float3 axis;
+    float cosThetaO;
+
+    float power;
+    float cosThetaE;
+    uint32_t pad1;
+    uint32_t pad2;
+};
+
+// Entry of the alias table that is used for O(1) local light sampling, see rtxdi::AliasTable.
+// Entry i is selected with probability 1/N, then it keeps i with probability 'threshold' or moves to 'alias'.
+// The normalized selection probabilities of both outcomes are stored so that one fetch also returns the pdf.
+struct RTXDI_AliasTableEntry
+{
+    float threshold;
+    uint32_t alias;
+    float pdf;      // probability of selecting light i
+    float aliasPdf; // probability of selecting light 'alias'
+};
+
 struct RTXDI_PackedReservoir
 {
     uint32_t lightData;
-    uint32_t uvData;
+    uint32_t uvData;        // Compact form: exponent of the weight in the high 8 bits
     uint32_t mVisibility;
-    uint32_t distanceAge;
+    uint32_t distanceAge;   // Compact form: exponent of targetPdf in the high 8 bits
+#if RTXDI_COMPACT_LIGHT_RESERVOIR
+    uint32_t packedWeights; // Mantissas of targetPdf and weight in bits 0-3 and 4-7, colorWeight as 24-bit LogLuv in bits 8-31
+#else
     float targetPdf;
     float weight;
 #ifdef __cplusplus
     using float3 = float[3];
 #endif
     float3 colorWeight;
+#endif
 };
 
 struct RTXDI_PackedGIReservoir
 {
+#if RTXDI_COMPACT_GI_RESERVOIR
+    uint32_t    packed_distance_age_M; // See GIReservoir.hlsli about the detail of the bit field.
+    uint32_t    packed_radiance;    // Stored as 32bit LogLUV format.
+    uint32_t    packed_direction;   // Direction from the surface to the sample, stored as 2x 16-bit snorms in the octahedral mapping
+    uint32_t    packed_weight_normal; // Weight as bfloat16 in the high half, normal as 2x 8-bit snorms in the octahedral mapping in the low half
+#else
 #ifdef __cplusplus
     using float3 = float[3];
 #endif
@@ -197,6 +340,7 @@ struct RTXDI_PackedGIReservoir
     float       weight;
     uint32_t    packed_normal;      // Stored as 2x 16-bit snorms in the octahedral mapping
     float       unused;
+#endif
 };
 
 #endif // RTXDI_PARAMETERS_H
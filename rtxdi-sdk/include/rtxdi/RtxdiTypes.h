@@ -21,6 +21,7 @@
 #define int3 ivec3
 #define uint2 uvec2
 #define uint3 uvec3
+#define uint4 uvec4
 #define float2 vec2
 #define float3 vec3
 #define float4 vec4
@@ -223,12 +223,22 @@ RWStructuredBuffer<RTXDI_PackedReservoir> u_LightReservoirs;
 RWStructuredBuffer<RTXDI_PackedGIReservoir> u_GIReservoirs;
 Buffer<float2> t_NeighborOffsets;
 RWBuffer<uint> u_GridVisibility;
+StructuredBuffer<RTXDI_LightTreeNode> t_LightTreeNodes;
+Buffer<uint> t_LightTreeTrails;
+StructuredBuffer<RTXDI_AliasTableEntry> t_LocalLightAliasTable;
+StructuredBuffer<RTXDI_AliasTableEntry> t_EnvironmentAliasTable;
+RWBuffer<uint> u_ReGIROccupancy;
 
 #define RTXDI_RIS_BUFFER u_RisBuffer
 #define RTXDI_LIGHT_RESERVOIR_BUFFER u_LightReservoirs
 #define RTXDI_GI_RESERVOIR_BUFFER u_GIReservoirs
 #define RTXDI_NEIGHBOR_OFFSETS_BUFFER t_NeighborOffsets
 #define RTXDI_VISIBILITY_BUFFER u_GridVisibility
+#define RTXDI_LIGHT_TREE_BUFFER t_LightTreeNodes
+#define RTXDI_LIGHT_TREE_TRAIL_BUFFER t_LightTreeTrails
+#define RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER t_LocalLightAliasTable
+#define RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER t_EnvironmentAliasTable
+#define RTXDI_REGIR_OCCUPANCY_BUFFER u_ReGIROccupancy
 
 #include <rtxdi/ResamplingFunctions.hlsli>
 
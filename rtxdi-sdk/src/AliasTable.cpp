@@ -0,0 +1,219 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include <rtxdi/AliasTable.h>
+#include <algorithm>
+#include <cassert>
+
+using namespace rtxdi;
+
+// Builds an alias table over weights[0, count) into outEntries[0, count) and returns the sum of the weights.
+// The vectors are scratch storage, passed in so that their allocations can be reused.
+static double BuildAliasTable(const float* weights, uint32_t count, RTXDI_AliasTableEntry* outEntries,
+    std::vector<double>& scaledWeights, std::vector<uint32_t>& smallList, std::vector<uint32_t>& largeList)
+{
+    double weightSum = 0.0;
+
+    // Comparisons with NaN are false, so NaN weights go to zero along with the negative ones
+    scaledWeights.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const float weight = weights[i];
+        scaledWeights[i] = (weight > 0.f) ? double(weight) : 0.0;
+        weightSum += scaledWeights[i];
+    }
+
+    if (weightSum <= 0.0)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            outEntries[i] = { 1.f, i, 0.f, 0.f };
+        return 0.0;
+    }
+
+    const double invWeightSum = 1.0 / weightSum;
+    const double scale = double(count) * invWeightSum;
+
+    // Zero weights are pushed last and popped first, so they are always paired with a large element
+    // and don't end up in the leftovers where the rounding errors go.
+    smallList.clear();
+    largeList.clear();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        double& scaled = scaledWeights[i];
+        const float pdf = float(scaled * invWeightSum);
+        outEntries[i] = { 1.f, i, pdf, pdf };
+
+        scaled *= scale;
+        if (scaled >= 1.0)
+            largeList.push_back(i);
+        else if (scaled > 0.0)
+            smallList.push_back(i);
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (scaledWeights[i] == 0.0)
+            smallList.push_back(i);
+    }
+
+    while (!smallList.empty() && !largeList.empty())
+    {
+        const uint32_t smallIndex = smallList.back();
+        smallList.pop_back();
+        const uint32_t largeIndex = largeList.back();
+
+        RTXDI_AliasTableEntry& entry = outEntries[smallIndex];
+        entry.threshold = float(scaledWeights[smallIndex]);
+        entry.alias = largeIndex;
+        entry.aliasPdf = outEntries[largeIndex].pdf;
+
+        // The large element gives away the part of its bucket that the small element doesn't fill
+        double& remainder = scaledWeights[largeIndex];
+        remainder = (remainder + scaledWeights[smallIndex]) - 1.0;
+        if (remainder < 1.0)
+        {
+            largeList.pop_back();
+            smallList.push_back(largeIndex);
+        }
+    }
+
+    // Whatever is left has a scaled weight of 1 up to rounding errors and keeps its whole bucket,
+    // which the initialization above already set up.
+    return weightSum;
+}
+
+// Selects between the entry and its alias, same as RTXDI_SelectAliasTableEntry.
+static uint32_t SelectAliasTableEntry(const RTXDI_AliasTableEntry& entry, uint32_t index, float rnd, float& outPdf)
+{
+    if (rnd < entry.threshold)
+    {
+        outPdf = entry.pdf;
+        return index;
+    }
+
+    outPdf = entry.aliasPdf;
+    return entry.alias;
+}
+
+void AliasTable::Build(const float* weights, uint32_t count)
+{
+    m_Entries.resize(count);
+    m_WeightSum = BuildAliasTable(weights, count, m_Entries.data(), m_ScaledWeights, m_Small, m_Large);
+}
+
+void AliasTable::Clear()
+{
+    m_Entries.clear();
+    m_ScaledWeights.clear();
+    m_Small.clear();
+    m_Large.clear();
+    m_WeightSum = 0.0;
+}
+
+bool AliasTable::Sample(float rndIndex, float rndAlias, uint32_t& outIndex, float& outPdf) const
+{
+    outIndex = 0;
+    outPdf = 0.f;
+
+    const uint32_t size = GetSize();
+    if (size == 0)
+        return false;
+
+    const uint32_t index = std::min(uint32_t(rndIndex * float(size)), size - 1);
+    outIndex = SelectAliasTableEntry(m_Entries[index], index, rndAlias, outPdf);
+
+    return outPdf > 0.f;
+}
+
+float AliasTable::EvaluatePdf(uint32_t index) const
+{
+    if (index >= GetSize())
+        return 0.f;
+
+    return m_Entries[index].pdf;
+}
+
+void AliasTable2D::Resize(uint32_t width, uint32_t height)
+{
+    m_Width = width;
+    m_Height = height;
+    m_Entries.resize(size_t(width) * height + height);
+    m_RowWeights.assign(height, 0.f);
+}
+
+void AliasTable2D::BuildRows(const float* weights, uint32_t beginRow, uint32_t endRow)
+{
+    assert(endRow <= m_Height);
+
+    std::vector<double> scaledWeights;
+    std::vector<uint32_t> smallList;
+    std::vector<uint32_t> largeList;
+
+    for (uint32_t row = beginRow; row < endRow; row++)
+    {
+        const size_t rowOffset = size_t(row) * m_Width;
+        const double rowWeight = BuildAliasTable(weights + rowOffset, m_Width, m_Entries.data() + m_Height + rowOffset,
+            scaledWeights, smallList, largeList);
+        m_RowWeights[row] = float(rowWeight);
+    }
+}
+
+void AliasTable2D::BuildMarginal()
+{
+    std::vector<double> scaledWeights;
+    std::vector<uint32_t> smallList;
+    std::vector<uint32_t> largeList;
+    m_WeightSum = BuildAliasTable(m_RowWeights.data(), m_Height, m_Entries.data(), scaledWeights, smallList, largeList);
+}
+
+void AliasTable2D::Build(const float* weights, uint32_t width, uint32_t height)
+{
+    Resize(width, height);
+    BuildRows(weights, 0, height);
+    BuildMarginal();
+}
+
+void AliasTable2D::Clear()
+{
+    m_Entries.clear();
+    m_RowWeights.clear();
+    m_Width = 0;
+    m_Height = 0;
+    m_WeightSum = 0.0;
+}
+
+bool AliasTable2D::Sample(float rndRow, float rndRowAlias, float rndColumn, float rndColumnAlias,
+    uint32_t& outX, uint32_t& outY, float& outPdf) const
+{
+    outX = 0;
+    outY = 0;
+    outPdf = 0.f;
+
+    if (m_Width == 0 || m_Height == 0)
+        return false;
+
+    const uint32_t row = std::min(uint32_t(rndRow * float(m_Height)), m_Height - 1);
+    float rowPdf;
+    outY = SelectAliasTableEntry(m_Entries[row], row, rndRowAlias, rowPdf);
+
+    const uint32_t column = std::min(uint32_t(rndColumn * float(m_Width)), m_Width - 1);
+    float columnPdf;
+    outX = SelectAliasTableEntry(m_Entries[m_Height + size_t(outY) * m_Width + column], column, rndColumnAlias, columnPdf);
+
+    outPdf = rowPdf * columnPdf;
+    return outPdf > 0.f;
+}
+
+float AliasTable2D::EvaluatePdf(uint32_t x, uint32_t y) const
+{
+    if (x >= m_Width || y >= m_Height)
+        return 0.f;
+
+    return m_Entries[y].pdf * m_Entries[m_Height + size_t(y) * m_Width + x].pdf;
+}
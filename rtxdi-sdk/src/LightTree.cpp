@@ -0,0 +1,540 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include <rtxdi/LightTree.h>
+#include <algorithm>
+#include <cassert>
+#include <math.h>
+
+using namespace rtxdi;
+
+constexpr float c_pi = 3.1415926535f;
+constexpr float c_OneMinusEpsilon = 0x1.fffffep-1f;
+
+// Number of buckets per axis that the split positions are evaluated for
+constexpr uint32_t c_NumSplitBuckets = 12;
+
+static float3 MakeFloat3(float x, float y, float z) { return { x, y, z }; }
+static float3 Add(const float3& a, const float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+static float3 Sub(const float3& a, const float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static float3 Mul(const float3& a, float b) { return { a.x * b, a.y * b, a.z * b }; }
+static float3 Min(const float3& a, const float3& b) { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) }; }
+static float3 Max(const float3& a, const float3& b) { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) }; }
+static float Dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static float Component(const float3& a, uint32_t dim) { return dim == 0 ? a.x : dim == 1 ? a.y : a.z; }
+
+static float3 Load(const float (&v)[3]) { return { v[0], v[1], v[2] }; }
+static void Store(float (&v)[3], const float3& a) { v[0] = a.x; v[1] = a.y; v[2] = a.z; }
+
+static float SafeSqrt(float x) { return sqrtf(std::max(0.f, x)); }
+
+// cos(max(0, a - b)) from the sines and cosines of angles a and b in [0, pi]
+static float CosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    if (cosA > cosB)
+        return 1.f;
+    return cosA * cosB + sinA * sinB;
+}
+
+// sin(max(0, a - b)) from the sines and cosines of angles a and b in [0, pi]
+static float SinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    if (cosA > cosB)
+        return 0.f;
+    return sinA * cosB - cosA * sinB;
+}
+
+// cos(min(pi, a + b)) from the cosines of angles a and b in [0, pi]
+static float CosAddClamped(float cosA, float cosB)
+{
+    if (cosA <= -cosB)
+        return -1.f;
+    return cosA * cosB - SafeSqrt(1.f - cosA * cosA) * SafeSqrt(1.f - cosB * cosB);
+}
+
+// Direction cone, i.e. all directions within acos(cosTheta) of the axis
+struct Cone
+{
+    float3 axis;
+    float cosTheta;
+};
+
+static float3 NormalizeOrZero(const float3& v)
+{
+    const float length = sqrtf(Dot(v, v));
+    return length > 0.f ? Mul(v, 1.f / length) : MakeFloat3(0.f, 0.f, 0.f);
+}
+
+// Returns a cone around 'axis' that contains the cone 'c'
+static float ExpandConeToContain(const float3& axis, const Cone& c)
+{
+    if (c.cosTheta <= -1.f)
+        return -1.f;
+    return CosAddClamped(std::min(1.f, Dot(axis, c.axis)), c.cosTheta);
+}
+
+// Conservative union of two cones around the bisector of their axes. It's not the tightest possible cone,
+// but it doesn't need any inverse trigonometric functions, which matters for refitting large trees.
+static Cone MergeCones(const Cone& a, const Cone& b)
+{
+    if (a.cosTheta <= -1.f || b.cosTheta <= -1.f)
+        return { a.axis, -1.f };
+
+    const float3 axis = NormalizeOrZero(Add(a.axis, b.axis));
+    if (Dot(axis, axis) == 0.f)
+        return { a.axis, -1.f };
+
+    return { axis, std::min(ExpandConeToContain(axis, a), ExpandConeToContain(axis, b)) };
+}
+
+static void InitLeafNode(RTXDI_LightTreeNode& node, const LightTreeLightBounds& light, uint32_t lightIndex)
+{
+    Store(node.boundsMin, light.boundsMin);
+    Store(node.boundsMax, light.boundsMax);
+    Store(node.axis, light.axis);
+    node.cosThetaO = light.cosThetaO;
+    node.cosThetaE = light.cosThetaE;
+    node.power = light.power;
+    node.childOrLightIndex = lightIndex;
+    node.flags = RTXDI_LIGHT_TREE_LEAF_BIT;
+    node.pad1 = 0;
+    node.pad2 = 0;
+}
+
+static void InitInteriorNode(RTXDI_LightTreeNode& node, const RTXDI_LightTreeNode& a, const RTXDI_LightTreeNode& b, uint32_t firstChild)
+{
+    const Cone cone = MergeCones({ Load(a.axis), a.cosThetaO }, { Load(b.axis), b.cosThetaO });
+
+    Store(node.boundsMin, Min(Load(a.boundsMin), Load(b.boundsMin)));
+    Store(node.boundsMax, Max(Load(a.boundsMax), Load(b.boundsMax)));
+    Store(node.axis, cone.axis);
+    node.cosThetaO = cone.cosTheta;
+    node.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+    node.power = a.power + b.power;
+    node.childOrLightIndex = firstChild;
+    node.flags = 0;
+    node.pad1 = 0;
+    node.pad2 = 0;
+}
+
+static uint32_t CeilLog2(uint32_t x)
+{
+    uint32_t log = 0;
+    while ((1ull << log) < x)
+        log++;
+    return log;
+}
+
+// Bounds of a group of lights that is considered when evaluating a split
+struct SplitBounds
+{
+    float3 boundsMin{ INFINITY, INFINITY, INFINITY };
+    float3 boundsMax{ -INFINITY, -INFINITY, -INFINITY };
+    float3 axisSum{};
+    float cosThetaO = 1.f;
+    float cosThetaE = 1.f;
+    float power = 0.f;
+    uint32_t count = 0;
+    bool entireSphere = false;
+
+    void AddBoundsAndAxis(const LightTreeLightBounds& light)
+    {
+        boundsMin = Min(boundsMin, light.boundsMin);
+        boundsMax = Max(boundsMax, light.boundsMax);
+        axisSum = Add(axisSum, light.axis);
+        cosThetaE = std::min(cosThetaE, light.cosThetaE);
+        power += light.power;
+        entireSphere |= light.cosThetaO <= -1.f;
+        count++;
+    }
+
+    float3 GetAxis() const
+    {
+        return NormalizeOrZero(axisSum);
+    }
+
+    // Grows the cone around 'axis', which must be GetAxis(), to contain the light's normals.
+    void AddCone(const float3& axis, const LightTreeLightBounds& light)
+    {
+        if (entireSphere || Dot(axis, axis) == 0.f)
+            cosThetaO = -1.f;
+        else
+            cosThetaO = std::min(cosThetaO, ExpandConeToContain(axis, { light.axis, light.cosThetaO }));
+    }
+
+    void Merge(const SplitBounds& other)
+    {
+        if (other.count == 0)
+            return;
+
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+
+        const Cone cone = MergeCones({ GetAxis(), cosThetaO }, { other.GetAxis(), other.cosThetaO });
+        boundsMin = Min(boundsMin, other.boundsMin);
+        boundsMax = Max(boundsMax, other.boundsMax);
+        axisSum = cone.axis;
+        cosThetaO = cone.cosTheta;
+        cosThetaE = std::min(cosThetaE, other.cosThetaE);
+        power += other.power;
+        count += other.count;
+    }
+
+    // Surface area orientation heuristic from pbrt-v4: power weighted by the bounding box area
+    // and by the solid angle of the emitted directions, with a penalty for thin boxes.
+    float EvaluateCost(float boxAspectFactor) const
+    {
+        const float thetaO = acosf(std::max(-1.f, std::min(1.f, cosThetaO)));
+        const float thetaE = acosf(std::max(-1.f, std::min(1.f, cosThetaE)));
+        const float thetaW = std::min(thetaO + thetaE, c_pi);
+        const float sinThetaO = SafeSqrt(1.f - cosThetaO * cosThetaO);
+        const float solidAngleMeasure = 2.f * c_pi * (1.f - cosThetaO) +
+            0.5f * c_pi * (2.f * thetaW * sinThetaO - cosf(thetaO - 2.f * thetaW) - 2.f * thetaO * sinThetaO + cosThetaO);
+
+        const float3 diagonal = Sub(boundsMax, boundsMin);
+        const float area = 2.f * (diagonal.x * diagonal.y + diagonal.y * diagonal.z + diagonal.z * diagonal.x);
+
+        return power * solidAngleMeasure * area * boxAspectFactor;
+    }
+};
+
+void LightTree::Clear()
+{
+    m_Nodes.clear();
+    m_LightTrails.clear();
+    m_LeafNodes.clear();
+    m_Depth = 0;
+}
+
+void LightTree::Build(const LightTreeLightBounds* lights, uint32_t numLights)
+{
+    Clear();
+    m_LightTrails.resize(numLights, 0);
+    m_LeafNodes.resize(numLights, ~0u);
+
+    m_BuildLights.clear();
+    for (uint32_t lightIndex = 0; lightIndex < numLights; ++lightIndex)
+    {
+        if (lights[lightIndex].power > 0.f)
+            m_BuildLights.push_back(lightIndex);
+    }
+
+    if (m_BuildLights.empty())
+    {
+        // The root exists even without lights, so that the shaders don't need to check the node count.
+        // Its importance is zero everywhere, so nothing is sampled.
+        m_Nodes.resize(1);
+        InitLeafNode(m_Nodes[0], LightTreeLightBounds(), 0);
+        return;
+    }
+
+    m_Centroids.resize(numLights);
+    for (uint32_t lightIndex : m_BuildLights)
+        m_Centroids[lightIndex] = Mul(Add(lights[lightIndex].boundsMin, lights[lightIndex].boundsMax), 0.5f);
+
+    m_BuildBuckets.resize(m_BuildLights.size());
+
+    m_Nodes.reserve(m_BuildLights.size() * 2 - 1);
+    m_Nodes.resize(1);
+    BuildNode(lights, 0, 0, uint32_t(m_BuildLights.size()), 0, 0);
+}
+
+void LightTree::BuildNode(const LightTreeLightBounds* lights, uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth, uint32_t trail)
+{
+    const uint32_t count = end - begin;
+
+    if (count == 1)
+    {
+        const uint32_t lightIndex = m_BuildLights[begin];
+        InitLeafNode(m_Nodes[nodeIndex], lights[lightIndex], lightIndex);
+        m_LightTrails[lightIndex] = trail | (1u << depth);
+        m_LeafNodes[lightIndex] = nodeIndex;
+        m_Depth = std::max(m_Depth, depth);
+        return;
+    }
+
+    SplitBounds nodeBounds;
+    float3 centroidMin = { INFINITY, INFINITY, INFINITY };
+    float3 centroidMax = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const uint32_t lightIndex = m_BuildLights[i];
+        nodeBounds.AddBoundsAndAxis(lights[lightIndex]);
+        centroidMin = Min(centroidMin, m_Centroids[lightIndex]);
+        centroidMax = Max(centroidMax, m_Centroids[lightIndex]);
+    }
+
+    const float3 centroidExtent = Sub(centroidMax, centroidMin);
+    const float3 nodeExtent = Sub(nodeBounds.boundsMax, nodeBounds.boundsMin);
+    const float maxNodeExtent = std::max(nodeExtent.x, std::max(nodeExtent.y, nodeExtent.z));
+
+    // Split at the bucket boundary with the lowest cost, unless the tree could get deeper than the trails allow,
+    // in which case the lights are split in half so that the remaining levels are enough for the subtree.
+    uint32_t mid = begin;
+    const bool allowCostSplit = depth + 1 + CeilLog2(count) <= RTXDI_LIGHT_TREE_MAX_DEPTH;
+
+    if (allowCostSplit)
+    {
+        float bestCost = INFINITY;
+        uint32_t bestDim = 0;
+        uint32_t bestBucket = 0;
+
+        for (uint32_t dim = 0; dim < 3; ++dim)
+        {
+            const float extent = Component(centroidExtent, dim);
+            if (extent <= 0.f)
+                continue;
+
+            const float bucketScale = float(c_NumSplitBuckets) / extent;
+            const float bucketBase = Component(centroidMin, dim);
+
+            SplitBounds buckets[c_NumSplitBuckets];
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const uint32_t lightIndex = m_BuildLights[i];
+                const float relative = (Component(m_Centroids[lightIndex], dim) - bucketBase) * bucketScale;
+                const uint8_t bucket = uint8_t(std::min(c_NumSplitBuckets - 1, uint32_t(std::max(0.f, relative))));
+                m_BuildBuckets[i - begin] = bucket;
+                buckets[bucket].AddBoundsAndAxis(lights[lightIndex]);
+            }
+
+            float3 bucketAxes[c_NumSplitBuckets];
+            for (uint32_t bucket = 0; bucket < c_NumSplitBuckets; ++bucket)
+                bucketAxes[bucket] = buckets[bucket].GetAxis();
+
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const uint8_t bucket = m_BuildBuckets[i - begin];
+                buckets[bucket].AddCone(bucketAxes[bucket], lights[m_BuildLights[i]]);
+            }
+
+            SplitBounds below[c_NumSplitBuckets];
+            below[0] = buckets[0];
+            for (uint32_t bucket = 1; bucket < c_NumSplitBuckets; ++bucket)
+            {
+                below[bucket] = below[bucket - 1];
+                below[bucket].Merge(buckets[bucket]);
+            }
+
+            const float boxAspectFactor = maxNodeExtent / Component(nodeExtent, dim);
+
+            SplitBounds above;
+            for (uint32_t bucket = c_NumSplitBuckets - 1; bucket > 0; --bucket)
+            {
+                above.Merge(buckets[bucket]);
+
+                if (below[bucket - 1].count == 0 || above.count == 0)
+                    continue;
+
+                const float cost = below[bucket - 1].EvaluateCost(boxAspectFactor) + above.EvaluateCost(boxAspectFactor);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestDim = dim;
+                    bestBucket = bucket;
+                }
+            }
+        }
+
+        if (bestCost < INFINITY)
+        {
+            const float bucketScale = float(c_NumSplitBuckets) / Component(centroidExtent, bestDim);
+            const float bucketBase = Component(centroidMin, bestDim);
+
+            auto it = std::partition(m_BuildLights.begin() + begin, m_BuildLights.begin() + end,
+                [&](uint32_t lightIndex)
+                {
+                    const float relative = (Component(m_Centroids[lightIndex], bestDim) - bucketBase) * bucketScale;
+                    return std::min(c_NumSplitBuckets - 1, uint32_t(std::max(0.f, relative))) < bestBucket;
+                });
+            mid = uint32_t(it - m_BuildLights.begin());
+        }
+    }
+
+    if (mid == begin || mid == end)
+    {
+        // Median split along the largest centroid extent, or in the input order if all centroids are the same
+        mid = begin + count / 2;
+
+        uint32_t dim = 0;
+        if (centroidExtent.y > Component(centroidExtent, dim)) dim = 1;
+        if (centroidExtent.z > Component(centroidExtent, dim)) dim = 2;
+
+        if (Component(centroidExtent, dim) > 0.f)
+        {
+            std::nth_element(m_BuildLights.begin() + begin, m_BuildLights.begin() + mid, m_BuildLights.begin() + end,
+                [&](uint32_t a, uint32_t b)
+                {
+                    const float ca = Component(m_Centroids[a], dim);
+                    const float cb = Component(m_Centroids[b], dim);
+                    return ca < cb || (ca == cb && a < b);
+                });
+        }
+    }
+
+    // The children are always stored next to each other, after their parent
+    const uint32_t firstChild = uint32_t(m_Nodes.size());
+    m_Nodes.resize(m_Nodes.size() + 2);
+
+    BuildNode(lights, firstChild, begin, mid, depth + 1, trail);
+    BuildNode(lights, firstChild + 1, mid, end, depth + 1, trail | (1u << depth));
+
+    InitInteriorNode(m_Nodes[nodeIndex], m_Nodes[firstChild], m_Nodes[firstChild + 1], firstChild);
+}
+
+void LightTree::Refit(const LightTreeLightBounds* lights, uint32_t numLights)
+{
+    assert(numLights == m_LeafNodes.size());
+    (void)numLights;
+
+    for (uint32_t lightIndex = 0; lightIndex < uint32_t(m_LeafNodes.size()); ++lightIndex)
+    {
+        const uint32_t leaf = m_LeafNodes[lightIndex];
+        if (leaf != ~0u)
+            InitLeafNode(m_Nodes[leaf], lights[lightIndex], lightIndex);
+    }
+
+    // Children are always stored after their parents
+    for (size_t nodeIndex = m_Nodes.size(); nodeIndex-- > 0; )
+    {
+        RTXDI_LightTreeNode& node = m_Nodes[nodeIndex];
+        if (node.flags & RTXDI_LIGHT_TREE_LEAF_BIT)
+            continue;
+
+        const uint32_t firstChild = node.childOrLightIndex;
+        InitInteriorNode(node, m_Nodes[firstChild], m_Nodes[firstChild + 1], firstChild);
+    }
+}
+
+float LightTree::EvaluateImportance(const RTXDI_LightTreeNode& node, const float3& position, const float3& normal)
+{
+    if (node.power <= 0.f)
+        return 0.f;
+
+    const float3 boundsMin = Load(node.boundsMin);
+    const float3 boundsMax = Load(node.boundsMax);
+    const float3 center = Mul(Add(boundsMin, boundsMax), 0.5f);
+    const float3 diagonal = Sub(boundsMax, boundsMin);
+
+    const float3 toPosition = Sub(position, center);
+    const float distanceSquared = Dot(toPosition, toPosition);
+    const float clampedDistanceSquared = std::max(std::max(distanceSquared, 0.5f * sqrtf(Dot(diagonal, diagonal))), 1e-8f);
+    const float3 wi = distanceSquared > 0.f ? Mul(toPosition, 1.f / sqrtf(distanceSquared)) : MakeFloat3(0.f, 0.f, 0.f);
+
+    // Angle between the cone axis and the direction to the point
+    const float cosThetaW = distanceSquared > 0.f ? Dot(Load(node.axis), wi) : 1.f;
+    const float sinThetaW = SafeSqrt(1.f - cosThetaW * cosThetaW);
+
+    // Angle subtended by the bounding sphere of the node
+    const float radiusSquared = 0.25f * Dot(diagonal, diagonal);
+    const float cosThetaB = distanceSquared < radiusSquared ? -1.f : SafeSqrt(1.f - radiusSquared / distanceSquared);
+    const float sinThetaB = SafeSqrt(1.f - cosThetaB * cosThetaB);
+
+    // Smallest angle between the emitted directions and the direction to the point
+    const float sinThetaO = SafeSqrt(1.f - node.cosThetaO * node.cosThetaO);
+    const float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+    const float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+    const float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+
+    if (cosThetaP <= node.cosThetaE)
+        return 0.f;
+
+    float importance = node.power * cosThetaP / clampedDistanceSquared;
+
+    // Smallest angle of incidence at the surface, zero if the node is entirely below the horizon
+    if (Dot(normal, normal) > 0.f)
+    {
+        const float cosThetaI = distanceSquared > 0.f ? -Dot(wi, normal) : 1.f;
+        const float sinThetaI = SafeSqrt(1.f - cosThetaI * cosThetaI);
+        const float cosThetaPI = CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+        importance *= std::max(0.f, cosThetaPI);
+    }
+
+    return std::max(0.f, importance);
+}
+
+bool LightTree::Sample(float rnd, const float3& position, const float3& normal, uint32_t& outLightIndex, float& outPdf) const
+{
+    outLightIndex = RTXDI_INVALID_LIGHT_INDEX;
+    outPdf = 0.f;
+
+    if (m_Nodes.empty() || EvaluateImportance(m_Nodes[0], position, normal) <= 0.f)
+        return false;
+
+    uint32_t nodeIndex = 0;
+    float pdf = 1.f;
+
+    while ((m_Nodes[nodeIndex].flags & RTXDI_LIGHT_TREE_LEAF_BIT) == 0)
+    {
+        const uint32_t firstChild = m_Nodes[nodeIndex].childOrLightIndex;
+        const float importance0 = EvaluateImportance(m_Nodes[firstChild], position, normal);
+        const float importance1 = EvaluateImportance(m_Nodes[firstChild + 1], position, normal);
+        const float importanceSum = importance0 + importance1;
+
+        if (importanceSum <= 0.f)
+            return false;
+
+        // Reuse the random number for the next level by remapping the selected interval to [0, 1)
+        const float probability0 = importance0 / importanceSum;
+        if (rnd < probability0)
+        {
+            nodeIndex = firstChild;
+            pdf *= probability0;
+            rnd = std::min(rnd / probability0, c_OneMinusEpsilon);
+        }
+        else
+        {
+            const float probability1 = importance1 / importanceSum;
+            nodeIndex = firstChild + 1;
+            pdf *= probability1;
+            rnd = std::min((rnd - probability0) / probability1, c_OneMinusEpsilon);
+        }
+    }
+
+    outLightIndex = m_Nodes[nodeIndex].childOrLightIndex;
+    outPdf = pdf;
+    return pdf > 0.f;
+}
+
+float LightTree::EvaluatePdf(uint32_t lightIndex, const float3& position, const float3& normal) const
+{
+    if (lightIndex >= m_LightTrails.size() || m_LightTrails[lightIndex] == 0)
+        return 0.f;
+
+    if (EvaluateImportance(m_Nodes[0], position, normal) <= 0.f)
+        return 0.f;
+
+    uint32_t trail = m_LightTrails[lightIndex];
+    uint32_t nodeIndex = 0;
+    float pdf = 1.f;
+
+    while (trail > 1)
+    {
+        assert((m_Nodes[nodeIndex].flags & RTXDI_LIGHT_TREE_LEAF_BIT) == 0);
+
+        const uint32_t firstChild = m_Nodes[nodeIndex].childOrLightIndex;
+        const float importance0 = EvaluateImportance(m_Nodes[firstChild], position, normal);
+        const float importance1 = EvaluateImportance(m_Nodes[firstChild + 1], position, normal);
+        const float importanceSum = importance0 + importance1;
+
+        if (importanceSum <= 0.f)
+            return 0.f;
+
+        const uint32_t child = trail & 1;
+        pdf *= (child ? importance1 : importance0) / importanceSum;
+        nodeIndex = firstChild + child;
+        trail >>= 1;
+    }
+
+    return pdf;
+}
@@ -9,11 +9,13 @@
  **************************************************************************/
 
 #include <rtxdi/RTXDI.h>
+#include <atomic>
 #include <cassert>
 #include <algorithm>
 #include <vector>
 #include <numeric>
 #include <math.h>
+#include <string.h>
 
 #define PRINT_JITTER_CURVE 0
 
@@ -31,28 +33,84 @@ static bool IsNonzeroPowerOf2(uint32_t i)
     return ((i & (i - 1)) == 0) && (i > 0);
 }
 
+static uint32_t Log2OfPowerOf2(uint32_t i)
+{
+    uint32_t log = 0;
+    while (i > 1)
+    {
+        i >>= 1;
+        log++;
+    }
+    return log;
+}
+
+// Inserts a 0 between each bit of a 16-bit integer, same as RTXDI_IntegerExplode in the shaders.
+static uint32_t IntegerExplode(uint32_t x)
+{
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
 rtxdi::Context::Context(const ContextParameters& params)
     : m_Params(params)
 {
     assert(IsNonzeroPowerOf2(params.TileSize));
     assert(IsNonzeroPowerOf2(params.TileCount));
-    assert(params.RenderWidth > 0);
-    assert(params.RenderHeight > 0);
+    assert(params.ViewCount > 0);
+    assert(params.ReservoirBlockSize == 8 || params.ReservoirBlockSize == 16 || params.ReservoirBlockSize == 32);
+    assert(params.VisibilityLayout != VisibilityBufferLayout::Compact || params.VisibilityLightsPerCell > 0);
 
-    uint32_t renderWidth = (params.CheckerboardSamplingMode == CheckerboardMode::Off)
-        ? params.RenderWidth
-        : (params.RenderWidth + 1) / 2;
-    uint32_t renderWidthBlocks = (renderWidth + RTXDI_RESERVOIR_BLOCK_SIZE - 1) / RTXDI_RESERVOIR_BLOCK_SIZE;
-    uint32_t renderHeightBlocks = (params.RenderHeight + RTXDI_RESERVOIR_BLOCK_SIZE - 1) / RTXDI_RESERVOIR_BLOCK_SIZE;
-    m_ReservoirBlockRowPitch = renderWidthBlocks * (RTXDI_RESERVOIR_BLOCK_SIZE * RTXDI_RESERVOIR_BLOCK_SIZE);
-    m_ReservoirArrayPitch = m_ReservoirBlockRowPitch * renderHeightBlocks;
+    ComputeReservoirPitches();
 
     m_RegirCellOffset = m_Params.TileCount * m_Params.TileSize;
 
+    if (m_Params.ReGIR.Mode == ReGIRMode::HashGrid)
+    {
+        assert(m_Params.ReGIR.HashGridCapacity > 0);
+        assert(m_Params.ReGIR.HashGridMaxProbes > 0);
+
+        m_RegirHashTableSize = 1;
+        while (m_RegirHashTableSize < m_Params.ReGIR.HashGridCapacity)
+            m_RegirHashTableSize <<= 1;
+    }
+
     InitializeOnion();
     ComputeOnionJitterCurve();
 }
 
+void Context::ComputeReservoirPitches()
+{
+    assert(m_Params.RenderWidth > 0);
+    assert(m_Params.RenderHeight > 0);
+
+    uint32_t renderWidth = (m_Params.CheckerboardSamplingMode == CheckerboardMode::Off)
+        ? m_Params.RenderWidth
+        : (m_Params.RenderWidth + 1) / 2;
+    uint32_t blockSize = m_Params.ReservoirBlockSize;
+    uint32_t renderWidthBlocks = (renderWidth + blockSize - 1) / blockSize;
+    uint32_t renderHeightBlocks = (m_Params.RenderHeight + blockSize - 1) / blockSize;
+    m_ReservoirBlockRowPitch = renderWidthBlocks * (blockSize * blockSize);
+    m_ReservoirViewPitch = m_ReservoirBlockRowPitch * renderHeightBlocks;
+    m_ReservoirArrayPitch = m_ReservoirViewPitch * m_Params.ViewCount;
+}
+
+void Context::Resize(uint32_t renderWidth, uint32_t renderHeight)
+{
+    if (m_Params.RenderWidth == renderWidth && m_Params.RenderHeight == renderHeight)
+        return;
+
+    m_Params.RenderWidth = renderWidth;
+    m_Params.RenderHeight = renderHeight;
+
+    ComputeReservoirPitches();
+
+    // The pitches are a part of the static runtime parameter block, force it to be rebuilt
+    m_StaticRuntimeParamsVersion = 0;
+}
+
 void Context::InitializeOnion()
 {
     int numLayerGroups = std::max(1, std::min(RTXDI_ONION_MAX_LAYER_GROUPS, int(m_Params.ReGIR.OnionDetailLayers)));
@@ -201,6 +259,146 @@ void Context::ComputeOnionJitterCurve()
     m_OnionLinearFactor = sumOfLinearFactors / std::max(float(linearFactors.size()), 1.f);
 }
 
+static uint32_t AsUint(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float AsFloat(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+uint32_t rtxdi::ReGIROnionReferenceRadiusToLayer(const RTXDI_ReGIROnionParameters& onion, float r)
+{
+    uint32_t layerOffset = 0;
+    for (uint32_t layerGroupIndex = 0; layerGroupIndex < onion.numLayerGroups; layerGroupIndex++)
+    {
+        const RTXDI_OnionLayerGroup& layerGroup = onion.layers[layerGroupIndex];
+
+        if (r <= layerGroup.outerRadius)
+        {
+            uint32_t layerIndex = uint32_t(floorf(std::max(0.f, logf(r / layerGroup.innerRadius) * layerGroup.invLogLayerScale)));
+            layerIndex = std::min(layerIndex, uint32_t(layerGroup.layerCount - 1)); // Guard against numeric errors at the outer shell
+            return layerOffset + layerIndex;
+        }
+
+        layerOffset += uint32_t(layerGroup.layerCount);
+    }
+
+    return layerOffset;
+}
+
+uint32_t rtxdi::ReGIROnionReferenceRing(const RTXDI_OnionLayerGroup& layerGroup, float absSinElevation)
+{
+    return uint32_t(floorf(asinf(absSinElevation) * layerGroup.invEquatorialCellAngle + 0.5f));
+}
+
+// Returns the smallest positive float in [first, last] whose bit pattern makes 'predicate' true, or 'last + 1' if there is none.
+// The predicate must be monotonic, and positive floats are ordered like their bit patterns.
+template<typename Predicate>
+static uint32_t FindFirstFloatBits(uint32_t first, uint32_t last, Predicate predicate)
+{
+    uint64_t begin = first;
+    uint64_t end = uint64_t(last) + 1;
+    while (begin < end)
+    {
+        const uint64_t middle = (begin + end) / 2;
+        if (predicate(AsFloat(uint32_t(middle))))
+            end = middle;
+        else
+            begin = middle + 1;
+    }
+    return uint32_t(begin);
+}
+
+// Fills the onion lookup tables from the layers and rings, which must already be scaled to world units.
+// The boundaries are placed exactly where the reference mappings switch to the next layer or ring,
+// so the table lookups return the same cells as the full computation.
+static void BuildOnionLookupTables(RTXDI_ReGIROnionParameters& onion)
+{
+    if (onion.numLayerGroups == 0)
+        return;
+
+    const uint32_t lastGroupIndex = onion.numLayerGroups - 1;
+    uint32_t totalLayers = 0;
+    for (uint32_t layerGroupIndex = 0; layerGroupIndex < onion.numLayerGroups; layerGroupIndex++)
+    {
+        // The shaders derive the group from the global layer index assuming this
+        assert(layerGroupIndex == lastGroupIndex || onion.layers[layerGroupIndex].layerCount == 1);
+        totalLayers += uint32_t(onion.layers[layerGroupIndex].layerCount);
+    }
+
+    const uint32_t innerBits = AsUint(onion.layers[0].innerRadius);
+    const uint32_t outerBits = AsUint(onion.layers[lastGroupIndex].outerRadius);
+
+    // Outer radius of every layer: the largest radius that still maps to it
+    onion.tableLayerCount = std::min(totalLayers, uint32_t(RTXDI_ONION_MAX_TABLE_LAYERS));
+    for (uint32_t layer = 0; layer < onion.tableLayerCount; layer++)
+    {
+        const uint32_t nextLayerBits = FindFirstFloatBits(innerBits + 1, outerBits + 1,
+            [&onion, layer](float r) { return ReGIROnionReferenceRadiusToLayer(onion, r) > layer; });
+
+        onion.layerOuterRadius[layer / 4][layer % 4] = AsFloat(nextLayerBits - 1);
+    }
+
+    onion.radiusBucketBase = innerBits >> RTXDI_ONION_RADIUS_BUCKET_SHIFT;
+    onion.radiusBucketCount = 0;
+    for (uint32_t bucket = 0; bucket < RTXDI_ONION_MAX_RADIUS_BUCKETS; bucket++)
+    {
+        const uint32_t bucketStartBits = std::max((onion.radiusBucketBase + bucket) << RTXDI_ONION_RADIUS_BUCKET_SHIFT, innerBits + 1);
+        const uint32_t bucketEndBits = ((onion.radiusBucketBase + bucket + 1) << RTXDI_ONION_RADIUS_BUCKET_SHIFT) - 1;
+
+        // The radii outside of the onion are rejected before the table lookup
+        if (bucketStartBits > outerBits)
+            break;
+
+        const uint32_t firstLayer = ReGIROnionReferenceRadiusToLayer(onion, AsFloat(bucketStartBits));
+        const uint32_t lastLayer = ReGIROnionReferenceRadiusToLayer(onion, AsFloat(std::min(bucketEndBits, outerBits)));
+
+        // Stop at the first bucket that can't be resolved with one comparison, the shaders use the full computation after it
+        const bool resolved = (firstLayer <= 0xff) && (lastLayer == firstLayer ||
+            (lastLayer == firstLayer + 1 && firstLayer < onion.tableLayerCount));
+        if (!resolved)
+            break;
+
+        onion.radiusBuckets[bucket / 16][(bucket / 4) % 4] |= firstLayer << ((bucket % 4) * 8);
+        onion.radiusBucketCount = bucket + 1;
+    }
+
+    for (uint32_t layerGroupIndex = 0; layerGroupIndex < onion.numLayerGroups; layerGroupIndex++)
+    {
+        const RTXDI_OnionLayerGroup& layerGroup = onion.layers[layerGroupIndex];
+
+        // Threshold of every ring: the smallest abs(sin(elevation)) that maps to it, or more than 1 if there is none
+        for (int ringIndex = 0; ringIndex < layerGroup.ringCount; ringIndex++)
+        {
+            const uint32_t thresholdBits = FindFirstFloatBits(0, AsUint(1.f),
+                [&layerGroup, ringIndex](float absSinElevation) { return ReGIROnionReferenceRing(layerGroup, absSinElevation) >= uint32_t(ringIndex); });
+
+            const int ring = layerGroup.ringOffset + ringIndex;
+            onion.ringThresholds[ring / 4][ring % 4] = AsFloat(thresholdBits);
+        }
+
+        for (uint32_t bucket = 0; bucket < RTXDI_ONION_RING_BUCKETS; bucket++)
+        {
+            const float bucketStart = float(bucket) / float(RTXDI_ONION_RING_BUCKETS);
+            [[maybe_unused]] const float bucketEnd = (bucket == RTXDI_ONION_RING_BUCKETS - 1) ? 1.f : AsFloat(AsUint(float(bucket + 1) / float(RTXDI_ONION_RING_BUCKETS)) - 1);
+
+            const uint32_t firstRing = ReGIROnionReferenceRing(layerGroup, bucketStart);
+            assert(firstRing < 16);
+            assert(ReGIROnionReferenceRing(layerGroup, bucketEnd) <= firstRing + 1); // The rings are wider than the buckets
+
+            const uint32_t entry = layerGroupIndex * RTXDI_ONION_RING_BUCKETS + bucket;
+            onion.ringBuckets[entry / 32][(entry / 8) % 4] |= firstRing << ((entry % 8) * 4);
+        }
+    }
+}
+
 const rtxdi::ContextParameters& rtxdi::Context::GetParameters() const
 {
     return m_Params;
@@ -217,6 +415,11 @@ uint32_t rtxdi::Context::GetRisBufferElementCount() const
 }
 
 uint32_t rtxdi::Context::GetReGIRLightSlotCount() const
+{
+    return GetReGIRCellCount() * m_Params.ReGIR.LightsPerCell;
+}
+
+uint32_t rtxdi::Context::GetReGIRCellCount() const
 {
     switch (m_Params.ReGIR.Mode)
     {
@@ -224,22 +427,75 @@ uint32_t rtxdi::Context::GetReGIRLightSlotCount() const
         return 0;
 
     case ReGIRMode::Grid:
-        return m_Params.ReGIR.GridSize.x
-            * m_Params.ReGIR.GridSize.y
-            * m_Params.ReGIR.GridSize.z
-            * m_Params.ReGIR.LightsPerCell;
     case ReGIRMode::AlignGrid:
         return m_Params.ReGIR.GridSize.x
             * m_Params.ReGIR.GridSize.y
-            * m_Params.ReGIR.GridSize.z
-            * m_Params.ReGIR.LightsPerCell;    
+            * m_Params.ReGIR.GridSize.z;
     case ReGIRMode::Onion:
-        return m_OnionCells * m_Params.ReGIR.LightsPerCell;
+        return m_OnionCells;
+    case ReGIRMode::HashGrid:
+        return m_RegirHashTableSize;
     }
 
     return 0;
 }
 
+uint64_t rtxdi::Context::GetVisibilityBufferElementCount(uint32_t maxEmitters) const
+{
+    if (!m_Params.enableVisibilityVairanceSampling)
+        return 0;
+
+    const uint64_t lightsPerCell = (m_Params.VisibilityLayout == VisibilityBufferLayout::Compact)
+        ? m_Params.VisibilityLightsPerCell
+        : maxEmitters;
+
+    // Two 32-bit elements per entry: (visible, total) counters or (key, packed counters)
+    return uint64_t(GetReGIRCellCount()) * lightsPerCell * 2;
+}
+
+uint32_t rtxdi::Context::GetReGIRHashTableSize() const
+{
+    return m_RegirHashTableSize;
+}
+
+uint32_t rtxdi::Context::GetReGIROccupancyMaskSize() const
+{
+    switch (m_Params.ReGIR.Mode)
+    {
+    case ReGIRMode::Grid:
+    case ReGIRMode::AlignGrid:
+    case ReGIRMode::Onion:
+        return (GetReGIRCellCount() + 31) / 32;
+    default:
+        return 0;
+    }
+}
+
+uint32_t rtxdi::Context::GetReGIRRefreshGroupCount(uint32_t refreshInterval) const
+{
+    if (GetReGIRCellCount() == 0 || refreshInterval <= 1 || m_Params.ReGIR.Mode == ReGIRMode::HashGrid)
+        return 1;
+
+    return refreshInterval;
+}
+
+rtxdi::ReGIRCellRange rtxdi::Context::GetReGIRCellRefreshRange(uint32_t frameIndex, uint32_t refreshInterval) const
+{
+    const uint32_t cellCount = GetReGIRCellCount();
+    const uint32_t groupCount = GetReGIRRefreshGroupCount(refreshInterval);
+    const uint32_t groupIndex = frameIndex % groupCount;
+
+    // Group i covers [i * cellCount / groupCount, (i + 1) * cellCount / groupCount), so the groups partition the cells
+    // for any interval and their sizes differ by at most one cell. Some groups are empty when there are more groups than cells.
+    const uint32_t firstCell = uint32_t(uint64_t(groupIndex) * cellCount / groupCount);
+    const uint32_t endCell = uint32_t(uint64_t(groupIndex + 1) * cellCount / groupCount);
+
+    ReGIRCellRange range;
+    range.firstCell = firstCell;
+    range.cellCount = endCell - firstCell;
+    return range;
+}
+
 uint32_t rtxdi::Context::GetReservoirBufferElementCount() const
 {
     return m_ReservoirArrayPitch;
@@ -258,33 +514,41 @@ static uint32_t JenkinsHash(uint32_t a)
     return a;
 }
 
-void rtxdi::Context::FillRuntimeParameters(
-    RTXDI_ResamplingRuntimeParameters& runtimeParams,
-    const FrameParameters& frame) const
+// Source of the static runtime parameter versions. It is shared between all contexts,
+// so that a structure filled by one context is never mistaken for a block from another one.
+static std::atomic<uint32_t> g_StaticRuntimeParamsVersion{ 0 };
+
+void rtxdi::Context::UpdateStaticRuntimeParameters(const FrameParameters& frame)
 {
-    runtimeParams.localLightParams.firstLocalLight = frame.firstLocalLight;
-    runtimeParams.localLightParams.numLocalLights = frame.numLocalLights;
-    runtimeParams.infiniteLightParams.firstInfiniteLight = frame.firstInfiniteLight;
-    runtimeParams.infiniteLightParams.numInfiniteLights = frame.numInfiniteLights;
-    runtimeParams.environmentLightParams.environmentLightPresent = frame.environmentLightPresent;
-    runtimeParams.environmentLightParams.environmentLightIndex = frame.environmentLightIndex;
+    if (m_StaticRuntimeParamsVersion != 0 &&
+        m_StaticRegirCellSize == frame.regirCellSize &&
+        m_StaticRegirSamplingJitter == frame.regirSamplingJitter)
+        return;
+
+    RTXDI_ResamplingRuntimeParameters& runtimeParams = m_StaticRuntimeParams;
+    runtimeParams = {};
+
     runtimeParams.neighborOffsetMask = m_Params.NeighborOffsetCount - 1;
     runtimeParams.risBufferParams.tileSize = m_Params.TileSize;
     runtimeParams.risBufferParams.tileCount = m_Params.TileCount;
-    runtimeParams.localLightParams.enableLocalLightImportanceSampling = frame.enableLocalLightImportanceSampling;
     runtimeParams.reservoirBlockRowPitch = m_ReservoirBlockRowPitch;
     runtimeParams.reservoirArrayPitch = m_ReservoirArrayPitch;
+    runtimeParams.reservoirBlockSizeLog2 = Log2OfPowerOf2(m_Params.ReservoirBlockSize);
+    runtimeParams.reservoirBlockLayout = uint32_t(m_Params.ReservoirLayout);
     runtimeParams.environmentLightParams.environmentRisBufferOffset = m_RegirCellOffset + GetReGIRLightSlotCount();
     runtimeParams.environmentLightParams.environmentTileCount = m_Params.EnvironmentTileCount;
     runtimeParams.environmentLightParams.environmentTileSize = m_Params.EnvironmentTileSize;
     runtimeParams.regirGrid.cellsX = m_Params.ReGIR.GridSize.x;
     runtimeParams.regirGrid.cellsY = m_Params.ReGIR.GridSize.y;
     runtimeParams.regirGrid.cellsZ = m_Params.ReGIR.GridSize.z;
+    runtimeParams.regirHashGrid.tableSize = m_RegirHashTableSize;
+    runtimeParams.regirHashGrid.maxProbes = m_Params.ReGIR.HashGridMaxProbes;
+    runtimeParams.visibilityBuffer.layout = uint32_t(m_Params.VisibilityLayout);
+    runtimeParams.visibilityBuffer.cellCount = m_Params.enableVisibilityVairanceSampling ? GetReGIRCellCount() : 0;
+    if (m_Params.VisibilityLayout == VisibilityBufferLayout::Compact)
+        runtimeParams.visibilityBuffer.lightsPerCell = m_Params.VisibilityLightsPerCell;
     runtimeParams.regirCommon.risBufferOffset = m_RegirCellOffset;
     runtimeParams.regirCommon.lightsPerCell = m_Params.ReGIR.LightsPerCell;
-    runtimeParams.regirCommon.centerX = frame.regirCenter.x;
-    runtimeParams.regirCommon.centerY = frame.regirCenter.y;
-    runtimeParams.regirCommon.centerZ = frame.regirCenter.z;
     runtimeParams.regirCommon.cellSize = (m_Params.ReGIR.Mode == ReGIRMode::Onion)
         ? frame.regirCellSize * 0.5f // Onion operates with radii, while "size" feels more like diameter
         : frame.regirCellSize;
@@ -293,19 +557,6 @@ void rtxdi::Context::FillRuntimeParameters(
     runtimeParams.regirOnion.cubicRootFactor = m_OnionCubicRootFactor;
     runtimeParams.regirOnion.linearFactor = m_OnionLinearFactor;
     runtimeParams.regirOnion.numLayerGroups = uint32_t(m_OnionLayers.size());
-    runtimeParams.uniformRandomNumber = JenkinsHash(frame.frameIndex);
-
-    switch (m_Params.CheckerboardSamplingMode)
-    {
-    case CheckerboardMode::Black:
-        runtimeParams.activeCheckerboardField = (frame.frameIndex & 1) ? 1 : 2;
-        break;
-    case CheckerboardMode::White:
-        runtimeParams.activeCheckerboardField = (frame.frameIndex & 1) ? 2 : 1;
-        break;
-    default:
-        runtimeParams.activeCheckerboardField = 0;
-    }
 
     assert(m_OnionLayers.size() <= RTXDI_ONION_MAX_LAYER_GROUPS);
     for(int group = 0; group < int(m_OnionLayers.size()); group++)
@@ -320,6 +571,87 @@ void rtxdi::Context::FillRuntimeParameters(
     {
         runtimeParams.regirOnion.rings[n] = m_OnionRings[n];
     }
+
+    if (m_Params.ReGIR.Mode == ReGIRMode::Onion)
+        BuildOnionLookupTables(runtimeParams.regirOnion);
+
+    m_StaticRegirCellSize = frame.regirCellSize;
+    m_StaticRegirSamplingJitter = frame.regirSamplingJitter;
+
+    // Skip 0 on wrap-around, it means "not initialized"
+    do
+    {
+        m_StaticRuntimeParamsVersion = ++g_StaticRuntimeParamsVersion;
+    } while (m_StaticRuntimeParamsVersion == 0);
+}
+
+void rtxdi::Context::FillFrameRuntimeParameters(
+    RTXDI_ResamplingRuntimeParameters& runtimeParams,
+    const FrameParameters& frame) const
+{
+    runtimeParams.localLightParams.firstLocalLight = frame.firstLocalLight;
+    runtimeParams.localLightParams.numLocalLights = frame.numLocalLights;
+    runtimeParams.localLightParams.enableLocalLightImportanceSampling = frame.enableLocalLightImportanceSampling;
+    runtimeParams.localLightParams.enableLightTree = frame.enableLightTree;
+    runtimeParams.infiniteLightParams.firstInfiniteLight = frame.firstInfiniteLight;
+    runtimeParams.infiniteLightParams.numInfiniteLights = frame.numInfiniteLights;
+    runtimeParams.environmentLightParams.environmentLightPresent = frame.environmentLightPresent;
+    runtimeParams.environmentLightParams.environmentLightIndex = frame.environmentLightIndex;
+    runtimeParams.regirCommon.centerX = frame.regirCenter.x;
+    runtimeParams.regirCommon.centerY = frame.regirCenter.y;
+    runtimeParams.regirCommon.centerZ = frame.regirCenter.z;
+    runtimeParams.reservoirViewOffset = frame.viewIndex * m_ReservoirViewPitch;
+
+    // Every view gets its own random sequence; with a single view, this is the same as hashing the frame index
+    runtimeParams.uniformRandomNumber = JenkinsHash(frame.frameIndex * m_Params.ViewCount + frame.viewIndex);
+
+    // The dense visibility layout is indexed with the emitter indices of the current frame
+    if (m_Params.VisibilityLayout == VisibilityBufferLayout::Dense)
+        runtimeParams.visibilityBuffer.lightsPerCell = frame.numEmissionThing;
+
+    assert(frame.viewIndex < m_Params.ViewCount);
+
+    // Odd views use the opposite checkerboard field, so that stereo views together cover every pixel on every frame
+    const uint32_t checkerboardPhase = frame.frameIndex + frame.viewIndex;
+
+    switch (m_Params.CheckerboardSamplingMode)
+    {
+    case CheckerboardMode::Black:
+        runtimeParams.activeCheckerboardField = (checkerboardPhase & 1) ? 1 : 2;
+        break;
+    case CheckerboardMode::White:
+        runtimeParams.activeCheckerboardField = (checkerboardPhase & 1) ? 2 : 1;
+        break;
+    default:
+        runtimeParams.activeCheckerboardField = 0;
+    }
+}
+
+void rtxdi::Context::FillRuntimeParameters(
+    RTXDI_ResamplingRuntimeParameters& runtimeParams,
+    const FrameParameters& frame)
+{
+    UpdateStaticRuntimeParameters(frame);
+
+    runtimeParams = m_StaticRuntimeParams;
+
+    FillFrameRuntimeParameters(runtimeParams, frame);
+}
+
+void rtxdi::Context::UpdateRuntimeParameters(
+    RTXDI_ResamplingRuntimeParameters& runtimeParams,
+    const FrameParameters& frame,
+    uint32_t& inoutStaticVersion)
+{
+    UpdateStaticRuntimeParameters(frame);
+
+    if (inoutStaticVersion != m_StaticRuntimeParamsVersion)
+    {
+        runtimeParams = m_StaticRuntimeParams;
+        inoutStaticVersion = m_StaticRuntimeParamsVersion;
+    }
+
+    FillFrameRuntimeParameters(runtimeParams, frame);
 }
 
 void rtxdi::Context::FillNeighborOffsetBuffer(uint8_t* buffer) const
@@ -360,3 +692,705 @@ void rtxdi::ComputePdfTextureSize(uint32_t maxItems, uint32_t& outWidth, uint32_
     outHeight = uint32_t(textureHeight);
     outMipLevels = uint32_t(textureMips);
 }
+
+uint32_t rtxdi::ReservoirPositionToPointer(
+    const RTXDI_ResamplingRuntimeParameters& params,
+    uint32_t reservoirPositionX,
+    uint32_t reservoirPositionY,
+    uint32_t reservoirArrayIndex)
+{
+    const uint32_t blockSizeLog2 = params.reservoirBlockSizeLog2;
+    const uint32_t blockMask = (1u << blockSizeLog2) - 1;
+    const uint32_t blockX = reservoirPositionX >> blockSizeLog2;
+    const uint32_t blockY = reservoirPositionY >> blockSizeLog2;
+    const uint32_t positionInBlockX = reservoirPositionX & blockMask;
+    const uint32_t positionInBlockY = reservoirPositionY & blockMask;
+
+    const uint32_t offsetInBlock = (params.reservoirBlockLayout == RTXDI_RESERVOIR_LAYOUT_ZCURVE)
+        ? IntegerExplode(positionInBlockX) | (IntegerExplode(positionInBlockY) << 1)
+        : (positionInBlockY << blockSizeLog2) + positionInBlockX;
+
+    return reservoirArrayIndex * params.reservoirArrayPitch
+        + params.reservoirViewOffset
+        + blockY * params.reservoirBlockRowPitch
+        + (blockX << (blockSizeLog2 * 2))
+        + offsetInBlock;
+}
+
+static uint32_t FloatToUnsignedFloat12(float value)
+{
+    uint32_t bits = AsUint(value);
+    return (bits + 0x3ffffu + ((bits >> 19) & 1u)) >> 19;
+}
+
+static float UnsignedFloat12ToFloat(uint32_t packedValue)
+{
+    return AsFloat((packedValue & 0xfffu) << 19);
+}
+
+static rtxdi::float3 RGBToXYZInRec709(const rtxdi::float3& c)
+{
+    return rtxdi::float3{
+        0.4123907992659595f * c.x + 0.3575843393838780f * c.y + 0.1804807884018343f * c.z,
+        0.2126390058715104f * c.x + 0.7151686787677559f * c.y + 0.0721923153607337f * c.z,
+        0.0193308187155918f * c.x + 0.1191947797946259f * c.y + 0.9505321522496608f * c.z
+    };
+}
+
+// Converts the luminance Y and the (u,v) chroma back to RGB and clamps the out-of-gamut colors
+static rtxdi::float3 LuvToRGBInRec709(float Y, float u, float v)
+{
+    const float invDenom = 1.f / (6.f * u - 16.f * v + 12.f);
+    const float x = 9.f * u * invDenom;
+    const float y = 4.f * v * invDenom;
+
+    const float s = Y / y;
+    const float X = s * x;
+    const float Z = s * (1.f - x - y);
+
+    return rtxdi::float3{
+        std::max(3.240969941904522f * X - 1.537383177570094f * Y - 0.4986107602930032f * Z, 0.f),
+        std::max(-0.9692436362808803f * X + 1.875967501507721f * Y + 0.04155505740717569f * Z, 0.f),
+        std::max(0.05563007969699373f * X - 0.2039769588889765f * Y + 1.056971514242878f * Z, 0.f)
+    };
+}
+
+uint32_t rtxdi::EncodeRGBToLogLuv(const float3& c)
+{
+    const float3 XYZ = RGBToXYZInRec709(c);
+
+    const float logY = 409.6f * (log2f(XYZ.y) + 20.f);
+    const uint32_t Le = uint32_t(std::min(std::max(logY, 0.f), 16383.f));
+
+    if (Le == 0)
+        return 0;
+
+    const float invDenom = 1.f / (-2.f * XYZ.x + 12.f * XYZ.y + 3.f * (XYZ.x + XYZ.y + XYZ.z));
+    const uint32_t ue = uint32_t(std::min(std::max(820.f * 4.f * XYZ.x * invDenom, 0.f), 511.f));
+    const uint32_t ve = uint32_t(std::min(std::max(820.f * 9.f * XYZ.y * invDenom, 0.f), 511.f));
+
+    return (Le << 18) | (ue << 9) | ve;
+}
+
+rtxdi::float3 rtxdi::DecodeLogLuvToRGB(uint32_t packedColor)
+{
+    const uint32_t Le = packedColor >> 18;
+    if (Le == 0)
+        return float3{ 0.f, 0.f, 0.f };
+
+    const float Y = powf(2.f, (float(Le) + 0.5f) / 409.6f - 20.f);
+    const float u = (float((packedColor >> 9) & 0x1ff) + 0.5f) / 820.f;
+    const float v = (float(packedColor & 0x1ff) + 0.5f) / 820.f;
+
+    return LuvToRGBInRec709(Y, u, v);
+}
+
+uint32_t rtxdi::EncodeRGBToLogLuv24(const float3& c)
+{
+    const float3 XYZ = RGBToXYZInRec709(c);
+
+    const float logY = 8.f * (log2f(XYZ.y) + 16.f);
+    const uint32_t Le = uint32_t(std::min(std::max(logY, 0.f), 255.f));
+
+    if (Le == 0)
+        return 0;
+
+    const float invDenom = 1.f / (-2.f * XYZ.x + 12.f * XYZ.y + 3.f * (XYZ.x + XYZ.y + XYZ.z));
+    const uint32_t ue = uint32_t(std::min(std::max(410.f * 4.f * XYZ.x * invDenom, 0.f), 255.f));
+    const uint32_t ve = uint32_t(std::min(std::max(410.f * 9.f * XYZ.y * invDenom, 0.f), 255.f));
+
+    return (Le << 16) | (ue << 8) | ve;
+}
+
+rtxdi::float3 rtxdi::DecodeLogLuv24ToRGB(uint32_t packedColor)
+{
+    const uint32_t Le = (packedColor >> 16) & 0xff;
+    if (Le == 0)
+        return float3{ 0.f, 0.f, 0.f };
+
+    const float Y = powf(2.f, (float(Le) + 0.5f) / 8.f - 16.f);
+    const float u = (float((packedColor >> 8) & 0xff) + 0.5f) / 410.f;
+    const float v = (float(packedColor & 0xff) + 0.5f) / 410.f;
+
+    return LuvToRGBInRec709(Y, u, v);
+}
+
+void rtxdi::PackCompactReservoirWeights(
+    float targetPdf,
+    float weight,
+    const float3& colorWeight,
+    uint32_t& inoutUvData,
+    uint32_t& inoutDistanceAge,
+    uint32_t& outPackedWeights)
+{
+    const uint32_t packedPdf = FloatToUnsignedFloat12(targetPdf);
+    const uint32_t packedWeight = FloatToUnsignedFloat12(weight);
+    inoutDistanceAge = (inoutDistanceAge & 0x00ffffffu) | (packedPdf >> 4) << 24;
+    inoutUvData = (inoutUvData & 0x00ffffffu) | (packedWeight >> 4) << 24;
+
+    const float storedWeight = UnsignedFloat12ToFloat(packedWeight);
+    const float colorScale = (storedWeight > 0.f) ? 1.f / storedWeight : 1.f;
+    outPackedWeights = (packedPdf & 0xfu)
+        | ((packedWeight & 0xfu) << 4)
+        | (EncodeRGBToLogLuv24(float3{ colorWeight.x * colorScale, colorWeight.y * colorScale, colorWeight.z * colorScale }) << 8);
+}
+
+void rtxdi::UnpackCompactReservoirWeights(
+    uint32_t uvData,
+    uint32_t distanceAge,
+    uint32_t packedWeights,
+    float& outTargetPdf,
+    float& outWeight,
+    float3& outColorWeight)
+{
+    outTargetPdf = UnsignedFloat12ToFloat(((distanceAge >> 24) << 4) | (packedWeights & 0xfu));
+    outWeight = UnsignedFloat12ToFloat(((uvData >> 24) << 4) | ((packedWeights >> 4) & 0xfu));
+
+    const float colorScale = (outWeight > 0.f) ? outWeight : 1.f;
+    const float3 color = DecodeLogLuv24ToRGB(packedWeights >> 8);
+    outColorWeight = float3{ color.x * colorScale, color.y * colorScale, color.z * colorScale };
+}
+
+// Mirror of the HLSL f32tof16 function: rounds to the nearest fp16 value, overflows to infinity
+static uint32_t FloatToHalf(float value)
+{
+    const uint32_t bits = AsUint(value);
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t absBits = bits & 0x7fffffffu;
+
+    if (absBits >= 0x7f800000u)
+        return sign | 0x7c00u | ((absBits > 0x7f800000u) ? 0x200u : 0u); // Inf or NaN
+
+    if (absBits >= 0x477ff000u)
+        return sign | 0x7c00u; // Rounds to a value above the fp16 range
+
+    if (absBits < 0x38800000u)
+    {
+        // Denormal or zero: scale into the denormal range, the FPU rounds to nearest even
+        return sign | uint32_t(lrintf(AsFloat(absBits) * 16777216.f));
+    }
+
+    const uint32_t rounded = absBits + 0xfffu + ((absBits >> 13) & 1u);
+    return sign | ((rounded - 0x38000000u) >> 13);
+}
+
+static float HalfToFloat(uint32_t packedValue)
+{
+    const uint32_t sign = (packedValue & 0x8000u) << 16;
+    const uint32_t exponent = (packedValue >> 10) & 0x1fu;
+    const uint32_t mantissa = packedValue & 0x3ffu;
+
+    if (exponent == 0)
+        return AsFloat(sign | AsUint(float(mantissa) / 16777216.f));
+
+    if (exponent == 0x1f)
+        return AsFloat(sign | 0x7f800000u | (mantissa << 13));
+
+    return AsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// Mirror of RTXDI_NormalizedVectorToOctahedralMapping, with the NaN handling and clamping of the snorm packing functions
+static void NormalizedVectorToOctahedralMapping(const float3& n, float& outX, float& outY)
+{
+    const float invL1 = 1.f / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+    float px = n.x * invL1;
+    float py = n.y * invL1;
+
+    if (n.z < 0.f)
+    {
+        const float fx = (1.f - fabsf(py)) * (px >= 0.f ? 1.f : -1.f);
+        const float fy = (1.f - fabsf(px)) * (py >= 0.f ? 1.f : -1.f);
+        px = fx;
+        py = fy;
+    }
+
+    if (isnan(px) || isnan(py))
+        px = py = 0.f;
+
+    outX = std::min(std::max(px, -1.f), 1.f);
+    outY = std::min(std::max(py, -1.f), 1.f);
+}
+
+// Mirror of RTXDI_OctahedralMappingToNormalizedVector
+static float3 OctahedralMappingToNormalizedVector(float px, float py)
+{
+    float3 n{ px, py, 1.f - fabsf(px) - fabsf(py) };
+    if (n.z < 0.f)
+    {
+        n.x = (1.f - fabsf(py)) * (px >= 0.f ? 1.f : -1.f);
+        n.y = (1.f - fabsf(px)) * (py >= 0.f ? 1.f : -1.f);
+    }
+
+    const float invLength = 1.f / sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+    return float3{ n.x * invLength, n.y * invLength, n.z * invLength };
+}
+
+// Mirrors of RTXDI_EncodeNormalizedVectorToSnorm2x16 and RTXDI_DecodeNormalizedVectorFromSnorm2x16
+static uint32_t EncodeNormalizedVectorToSnorm2x16(const float3& n)
+{
+    float px, py;
+    NormalizedVectorToOctahedralMapping(n, px, py);
+
+    const int32_t ix = int32_t(roundf(px * 32767.f));
+    const int32_t iy = int32_t(roundf(py * 32767.f));
+    return (uint32_t(ix) & 0xffffu) | (uint32_t(iy) << 16);
+}
+
+static float3 DecodeNormalizedVectorFromSnorm2x16(uint32_t packed)
+{
+    const float px = std::max(float(int32_t(packed << 16) >> 16) / 32767.f, -1.f);
+    const float py = std::max(float(int32_t(packed) >> 16) / 32767.f, -1.f);
+    return OctahedralMappingToNormalizedVector(px, py);
+}
+
+uint32_t rtxdi::EncodeNormalizedVectorToSnorm2x8(const float3& n)
+{
+    float px, py;
+    NormalizedVectorToOctahedralMapping(n, px, py);
+
+    const int32_t ix = int32_t(roundf(px * 127.f));
+    const int32_t iy = int32_t(roundf(py * 127.f));
+    return (uint32_t(ix) & 0xffu) | ((uint32_t(iy) & 0xffu) << 8);
+}
+
+rtxdi::float3 rtxdi::DecodeNormalizedVectorFromSnorm2x8(uint32_t packed)
+{
+    const float px = std::max(float(int32_t(packed << 24) >> 24) / 127.f, -1.f);
+    const float py = std::max(float(int32_t(packed << 16) >> 24) / 127.f, -1.f);
+    return OctahedralMappingToNormalizedVector(px, py);
+}
+
+void rtxdi::PackCompactGIReservoirPosition(
+    const float3& samplePosition,
+    const float3& surfacePosition,
+    uint32_t& outPackedDistance,
+    uint32_t& outPackedDirection)
+{
+    const float3 offset{ samplePosition.x - surfacePosition.x, samplePosition.y - surfacePosition.y, samplePosition.z - surfacePosition.z };
+    const float distance = sqrtf(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+    const float3 direction = (distance > 0.f)
+        ? float3{ offset.x / distance, offset.y / distance, offset.z / distance }
+        : float3{ 0.f, 0.f, 1.f };
+
+    outPackedDistance = FloatToHalf(std::min(distance, 65504.f));
+    outPackedDirection = EncodeNormalizedVectorToSnorm2x16(direction);
+}
+
+rtxdi::float3 rtxdi::UnpackCompactGIReservoirPosition(
+    uint32_t packedDistance,
+    uint32_t packedDirection,
+    const float3& surfacePosition)
+{
+    const float distance = HalfToFloat(packedDistance & 0xffffu);
+    const float3 direction = DecodeNormalizedVectorFromSnorm2x16(packedDirection);
+
+    return float3{
+        surfacePosition.x + direction.x * distance,
+        surfacePosition.y + direction.y * distance,
+        surfacePosition.z + direction.z * distance };
+}
+
+static int32_t FloorToInt(float x)
+{
+    return int32_t(floorf(x));
+}
+
+uint32_t rtxdi::ReGIRHashGridWorldPosToKey(const RTXDI_ResamplingRuntimeParameters& params, const float3& worldPos)
+{
+    const float cellSize = params.regirCommon.cellSize;
+    const int32_t range = RTXDI_REGIR_HASH_CELL_RANGE;
+
+    const int32_t offset[3] = {
+        FloorToInt(worldPos.x / cellSize) - FloorToInt(params.regirCommon.centerX / cellSize),
+        FloorToInt(worldPos.y / cellSize) - FloorToInt(params.regirCommon.centerY / cellSize),
+        FloorToInt(worldPos.z / cellSize) - FloorToInt(params.regirCommon.centerZ / cellSize)
+    };
+
+    uint32_t key = RTXDI_REGIR_HASH_KEY_VALID_BIT;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (offset[axis] < -range || offset[axis] >= range)
+            return RTXDI_REGIR_HASH_EMPTY_KEY;
+
+        key |= uint32_t(offset[axis] + range) << (axis * 10);
+    }
+
+    return key;
+}
+
+int rtxdi::ReGIRHashGridInsert(const RTXDI_ResamplingRuntimeParameters& params, uint32_t* table, const float3& worldPos)
+{
+    const uint32_t key = ReGIRHashGridWorldPosToKey(params, worldPos);
+    if (key == RTXDI_REGIR_HASH_EMPTY_KEY)
+        return -1;
+
+    const uint32_t tableMask = params.regirHashGrid.tableSize - 1;
+    uint32_t slot = JenkinsHash(key) & tableMask;
+
+    for (uint32_t probe = 0; probe < params.regirHashGrid.maxProbes; probe++)
+    {
+        // Same as the InterlockedCompareExchange in the shader, minus the atomicity
+        const uint32_t previousKey = table[slot];
+        if (previousKey == RTXDI_REGIR_HASH_EMPTY_KEY)
+            table[slot] = key;
+
+        if (previousKey == RTXDI_REGIR_HASH_EMPTY_KEY || previousKey == key)
+            return int(slot);
+
+        slot = (slot + 1) & tableMask;
+    }
+
+    return -1;
+}
+
+int rtxdi::ReGIRHashGridLookup(const RTXDI_ResamplingRuntimeParameters& params, const uint32_t* table, const float3& worldPos)
+{
+    const uint32_t key = ReGIRHashGridWorldPosToKey(params, worldPos);
+    if (key == RTXDI_REGIR_HASH_EMPTY_KEY)
+        return -1;
+
+    const uint32_t tableMask = params.regirHashGrid.tableSize - 1;
+    uint32_t slot = JenkinsHash(key) & tableMask;
+
+    for (uint32_t probe = 0; probe < params.regirHashGrid.maxProbes; probe++)
+    {
+        const uint32_t storedKey = table[slot];
+
+        if (storedKey == key)
+            return int(slot);
+
+        if (storedKey == RTXDI_REGIR_HASH_EMPTY_KEY)
+            return -1;
+
+        slot = (slot + 1) & tableMask;
+    }
+
+    return -1;
+}
+
+// Same as the modulo used by the AlignGrid mode in the shaders, with the result in [0, count) for negative values
+static int32_t WrapCellCoordinate(int32_t x, int32_t count)
+{
+    return ((x % count) + count) % count;
+}
+
+float rtxdi::ReGIRGetJitterScale(const RTXDI_ResamplingRuntimeParameters& params, ReGIRMode mode, const float3& worldPos)
+{
+    const float cellSize = params.regirCommon.cellSize;
+
+    if (mode != ReGIRMode::Onion)
+        return params.regirCommon.samplingJitter * cellSize;
+
+    const float3 translatedPos = {
+        worldPos.x - params.regirCommon.centerX,
+        worldPos.y - params.regirCommon.centerY,
+        worldPos.z - params.regirCommon.centerZ
+    };
+
+    const float distanceToCenter = Distance(translatedPos, float3{ 0.f, 0.f, 0.f }) / cellSize;
+    const float jitterScale = std::max(1.f, std::max(
+        powf(distanceToCenter, 1.f / 3.f) * params.regirOnion.cubicRootFactor,
+        distanceToCenter * params.regirOnion.linearFactor));
+
+    return jitterScale * params.regirCommon.samplingJitter * cellSize;
+}
+
+static int ReGIRGridWorldPosToCellIndex(const RTXDI_ResamplingRuntimeParameters& params, const float3& worldPos)
+{
+    const float cellSize = params.regirCommon.cellSize;
+    const int32_t cellCount[3] = { int32_t(params.regirGrid.cellsX), int32_t(params.regirGrid.cellsY), int32_t(params.regirGrid.cellsZ) };
+    const float center[3] = { params.regirCommon.centerX, params.regirCommon.centerY, params.regirCommon.centerZ };
+    const float position[3] = { worldPos.x, worldPos.y, worldPos.z };
+
+    int32_t gridCell[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float gridOrigin = center[axis] - float(cellCount[axis]) * (cellSize * 0.5f);
+        gridCell[axis] = FloorToInt((position[axis] - gridOrigin) / cellSize);
+
+        if (gridCell[axis] < 0 || gridCell[axis] >= cellCount[axis])
+            return -1;
+    }
+
+    return gridCell[0] + (gridCell[1] + gridCell[2] * cellCount[1]) * cellCount[0];
+}
+
+static int ReGIRAlignGridWorldPosToCellIndex(const RTXDI_ResamplingRuntimeParameters& params, const float3& worldPos)
+{
+    const float cellSize = params.regirCommon.cellSize;
+    const int32_t cellCount[3] = { int32_t(params.regirGrid.cellsX), int32_t(params.regirGrid.cellsY), int32_t(params.regirGrid.cellsZ) };
+    const float center[3] = { params.regirCommon.centerX, params.regirCommon.centerY, params.regirCommon.centerZ };
+    const float position[3] = { worldPos.x, worldPos.y, worldPos.z };
+
+    int32_t gridCell[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const int32_t cellIndex = FloorToInt(position[axis] / cellSize);
+        const int32_t offset = cellIndex - FloorToInt(center[axis] / cellSize);
+
+        if (float(offset) < -0.5f * float(cellCount[axis]) || float(offset) >= 0.5f * float(cellCount[axis]))
+            return -1;
+
+        gridCell[axis] = WrapCellCoordinate(cellIndex, cellCount[axis]);
+    }
+
+    return gridCell[0] + (gridCell[1] + gridCell[2] * cellCount[1]) * cellCount[0];
+}
+
+uint32_t rtxdi::ReGIROnionRadiusToLayer(const RTXDI_ReGIROnionParameters& onion, float r)
+{
+    const uint32_t radiusBucket = (AsUint(r) >> RTXDI_ONION_RADIUS_BUCKET_SHIFT) - onion.radiusBucketBase;
+    if (radiusBucket >= onion.radiusBucketCount)
+        return ReGIROnionReferenceRadiusToLayer(onion, r);
+
+    uint32_t layer = (onion.radiusBuckets[radiusBucket / 16][(radiusBucket / 4) % 4] >> ((radiusBucket % 4) * 8)) & 0xff;
+    if (layer < onion.tableLayerCount && r > onion.layerOuterRadius[layer / 4][layer % 4])
+        layer++;
+
+    return layer;
+}
+
+uint32_t rtxdi::ReGIROnionRing(const RTXDI_ReGIROnionParameters& onion, uint32_t layerGroupIndex, float absSinElevation)
+{
+    const RTXDI_OnionLayerGroup& layerGroup = onion.layers[layerGroupIndex];
+
+    const uint32_t ringBucket = std::min(uint32_t(absSinElevation * float(RTXDI_ONION_RING_BUCKETS)), uint32_t(RTXDI_ONION_RING_BUCKETS - 1));
+    const uint32_t ringEntry = layerGroupIndex * RTXDI_ONION_RING_BUCKETS + ringBucket;
+    uint32_t ringIndex = (onion.ringBuckets[ringEntry / 32][(ringEntry / 8) % 4] >> ((ringEntry % 8) * 4)) & 0xf;
+
+    const int nextRing = layerGroup.ringOffset + int(ringIndex) + 1;
+    if (int(ringIndex) + 1 < layerGroup.ringCount && absSinElevation >= onion.ringThresholds[nextRing / 4][nextRing % 4])
+        ringIndex++;
+
+    return ringIndex;
+}
+
+static int ReGIROnionWorldPosToCellIndex(const RTXDI_ResamplingRuntimeParameters& params, const float3& worldPos)
+{
+    const RTXDI_ReGIROnionParameters& onion = params.regirOnion;
+
+    const float3 translatedPos = {
+        worldPos.x - params.regirCommon.centerX,
+        worldPos.y - params.regirCommon.centerY,
+        worldPos.z - params.regirCommon.centerZ
+    };
+
+    const float r = Distance(translatedPos, float3{ 0.f, 0.f, 0.f });
+
+    if (r <= onion.layers[0].innerRadius)
+        return 0;
+
+    const uint32_t lastGroupIndex = onion.numLayerGroups - 1;
+    if (r > onion.layers[lastGroupIndex].outerRadius)
+        return -1;
+
+    const float3 direction = { translatedPos.x / r, translatedPos.y / r, translatedPos.z / r };
+    float azimuth = atan2f(direction.z, direction.x) + c_pi; // Add PI to make sure azimuth doesn't cross zero
+    const float absSinElevation = fabsf(direction.y);
+
+    const uint32_t layer = ReGIROnionRadiusToLayer(onion, r);
+    const uint32_t layerGroupIndex = std::min(layer, lastGroupIndex);
+    const uint32_t layerIndex = layer - layerGroupIndex;
+    const RTXDI_OnionLayerGroup& layerGroup = onion.layers[layerGroupIndex];
+
+    const uint32_t ringIndex = ReGIROnionRing(onion, layerGroupIndex, absSinElevation);
+    const RTXDI_OnionRing& ring = onion.rings[layerGroup.ringOffset + ringIndex];
+
+    if ((layerIndex & 1) != 0)
+    {
+        azimuth -= ring.cellAngle * 0.5f; // Add some variation to the repetitive layers
+        if (azimuth < 0.f)
+            azimuth += 2.f * c_pi;
+    }
+
+    const int cellIndex = FloorToInt(azimuth * ring.invCellAngle);
+
+    int ringCellOffset = ring.cellOffset;
+    if (direction.y < 0.f && ringIndex > 0)
+        ringCellOffset += ring.cellCount;
+
+    return cellIndex + ringCellOffset + int(layerIndex) * layerGroup.cellsPerLayer + layerGroup.layerCellOffset;
+}
+
+int rtxdi::ReGIRWorldPosToCellIndex(const RTXDI_ResamplingRuntimeParameters& params, ReGIRMode mode, const float3& worldPos)
+{
+    switch (mode)
+    {
+    case ReGIRMode::Grid:
+        return ReGIRGridWorldPosToCellIndex(params, worldPos);
+    case ReGIRMode::AlignGrid:
+        return ReGIRAlignGridWorldPosToCellIndex(params, worldPos);
+    case ReGIRMode::Onion:
+        return ReGIROnionWorldPosToCellIndex(params, worldPos);
+    default:
+        assert(!"The occupancy functions only support the Grid, AlignGrid and Onion modes");
+        return -1;
+    }
+}
+
+static void ReGIRMarkCellOccupied(int cellIndex, uint32_t* occupancyMask)
+{
+    if (cellIndex >= 0)
+        occupancyMask[uint32_t(cellIndex) >> 5] |= 1u << (uint32_t(cellIndex) & 31);
+}
+
+void rtxdi::ReGIRMarkOccupiedCells(const RTXDI_ResamplingRuntimeParameters& params, ReGIRMode mode, const float3& worldPos, uint32_t* occupancyMask)
+{
+    const float halfJitter = 0.5f * ReGIRGetJitterScale(params, mode, worldPos);
+    const float boxMin[3] = { worldPos.x - halfJitter, worldPos.y - halfJitter, worldPos.z - halfJitter };
+    const float boxMax[3] = { worldPos.x + halfJitter, worldPos.y + halfJitter, worldPos.z + halfJitter };
+
+    if (mode == ReGIRMode::Onion)
+    {
+        // The onion cells have no simple bounds, so mark the cells of a lattice of points in the jitter box.
+        // The jitter scale is samplingJitter times the local cell size, so this places about 3 points per cell
+        // along each axis. Smaller cells closer to the center can still be missed.
+        const int steps = int(ceilf(params.regirCommon.samplingJitter * 3.f));
+        for (int z = 0; z <= steps; z++)
+        for (int y = 0; y <= steps; y++)
+        for (int x = 0; x <= steps; x++)
+        {
+            const int step[3] = { x, y, z };
+            float position[3];
+            for (int axis = 0; axis < 3; axis++)
+                position[axis] = boxMin[axis] + (boxMax[axis] - boxMin[axis]) * float(step[axis]) / float(std::max(steps, 1));
+
+            ReGIRMarkCellOccupied(ReGIROnionWorldPosToCellIndex(params, float3{ position[0], position[1], position[2] }), occupancyMask);
+        }
+        return;
+    }
+
+    // The grid cells are aligned to the grid origin (Grid) or to the world origin (AlignGrid), so the cells
+    // overlapping the jitter box can be enumerated exactly, and mapped to indices through their centers.
+    const float cellSize = params.regirCommon.cellSize;
+    const int32_t cellCount[3] = { int32_t(params.regirGrid.cellsX), int32_t(params.regirGrid.cellsY), int32_t(params.regirGrid.cellsZ) };
+    const float center[3] = { params.regirCommon.centerX, params.regirCommon.centerY, params.regirCommon.centerZ };
+
+    float gridOrigin[3] = { 0.f, 0.f, 0.f };
+    int32_t cellMin[3], cellMax[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (mode == ReGIRMode::Grid)
+            gridOrigin[axis] = center[axis] - float(cellCount[axis]) * (cellSize * 0.5f);
+
+        cellMin[axis] = FloorToInt((boxMin[axis] - gridOrigin[axis]) / cellSize);
+        cellMax[axis] = FloorToInt((boxMax[axis] - gridOrigin[axis]) / cellSize);
+    }
+
+    for (int32_t z = cellMin[2]; z <= cellMax[2]; z++)
+    for (int32_t y = cellMin[1]; y <= cellMax[1]; y++)
+    for (int32_t x = cellMin[0]; x <= cellMax[0]; x++)
+    {
+        const float3 cellCenter = {
+            (float(x) + 0.5f) * cellSize + gridOrigin[0],
+            (float(y) + 0.5f) * cellSize + gridOrigin[1],
+            (float(z) + 0.5f) * cellSize + gridOrigin[2]
+        };
+
+        ReGIRMarkCellOccupied(ReGIRWorldPosToCellIndex(params, mode, cellCenter), occupancyMask);
+    }
+}
+
+uint32_t rtxdi::ReGIRCompactOccupiedCells(uint32_t cellCount, const uint32_t* occupancyMask, uint32_t* outCellList)
+{
+    uint32_t listedCellCount = 0;
+    for (uint32_t cellIndex = 0; cellIndex < cellCount; cellIndex++)
+    {
+        if (occupancyMask[cellIndex >> 5] & (1u << (cellIndex & 31)))
+            outCellList[listedCellCount++] = cellIndex;
+    }
+    return listedCellCount;
+}
+
+void rtxdi::ReGIRGetCellListDispatchSize(uint32_t listedCellCount, uint32_t& outGroupsY, uint32_t& outGroupsZ)
+{
+    outGroupsY = std::min(listedCellCount, 65535u);
+    outGroupsZ = (listedCellCount > 0) ? (listedCellCount - 1) / 65535 + 1 : 0;
+}
+
+int rtxdi::VisibilityBufferFindEntry(const RTXDI_ResamplingRuntimeParameters& params, uint32_t* visibilityBuffer, int cellIndex, uint32_t emitterIndex, bool allocate)
+{
+    const RTXDI_VisibilityBufferParameters& vis = params.visibilityBuffer;
+
+    if (cellIndex < 0 || uint32_t(cellIndex) >= vis.cellCount || vis.lightsPerCell == 0)
+        return -1;
+
+    const uint32_t cellBase = uint32_t(cellIndex) * vis.lightsPerCell;
+
+    if (vis.layout == RTXDI_VISIBILITY_LAYOUT_DENSE)
+    {
+        if (emitterIndex >= vis.lightsPerCell)
+            return -1;
+
+        return int((cellBase + emitterIndex) * 2);
+    }
+
+    const uint32_t key = emitterIndex + 1;
+    uint32_t slot = JenkinsHash(emitterIndex) % vis.lightsPerCell;
+
+    for (uint32_t probe = 0; probe < vis.lightsPerCell; probe++)
+    {
+        const uint32_t element = (cellBase + slot) * 2;
+
+        // Same as the InterlockedCompareExchange in the shader, minus the atomicity
+        const uint32_t storedKey = visibilityBuffer[element];
+        if (allocate && storedKey == RTXDI_VISIBILITY_EMPTY_KEY)
+            visibilityBuffer[element] = key;
+
+        if (storedKey == key || (allocate && storedKey == RTXDI_VISIBILITY_EMPTY_KEY))
+            return int(element);
+
+        if (storedKey == RTXDI_VISIBILITY_EMPTY_KEY)
+            return -1;
+
+        slot = (slot + 1 == vis.lightsPerCell) ? 0 : slot + 1;
+    }
+
+    return -1;
+}
+
+void rtxdi::RecordVisibility(const RTXDI_ResamplingRuntimeParameters& params, uint32_t* visibilityBuffer, int cellIndex, uint32_t emitterIndex, bool visible)
+{
+    const int element = VisibilityBufferFindEntry(params, visibilityBuffer, cellIndex, emitterIndex, true);
+    if (element < 0)
+        return;
+
+    if (params.visibilityBuffer.layout == RTXDI_VISIBILITY_LAYOUT_DENSE)
+    {
+        if (visible)
+            visibilityBuffer[element]++;
+        visibilityBuffer[element + 1]++;
+        return;
+    }
+
+    const uint32_t counters = visibilityBuffer[element + 1];
+    if ((counters >> 16) >= RTXDI_VISIBILITY_MAX_COUNT)
+        return;
+
+    visibilityBuffer[element + 1] += (1u << 16) | (visible ? 1u : 0u);
+}
+
+bool rtxdi::LoadVisibility(const RTXDI_ResamplingRuntimeParameters& params, const uint32_t* visibilityBuffer, int cellIndex, uint32_t emitterIndex, uint32_t& outVisibleCount, uint32_t& outTotalCount)
+{
+    outVisibleCount = 0;
+    outTotalCount = 0;
+
+    // The lookup doesn't write without 'allocate'
+    const int element = VisibilityBufferFindEntry(params, const_cast<uint32_t*>(visibilityBuffer), cellIndex, emitterIndex, false);
+    if (element < 0)
+        return false;
+
+    if (params.visibilityBuffer.layout == RTXDI_VISIBILITY_LAYOUT_DENSE)
+    {
+        outVisibleCount = visibilityBuffer[element];
+        outTotalCount = visibilityBuffer[element + 1];
+    }
+    else
+    {
+        const uint32_t counters = visibilityBuffer[element + 1];
+        outVisibleCount = counters & 0xffff;
+        outTotalCount = counters >> 16;
+    }
+
+    return outTotalCount != 0;
+}
@@ -0,0 +1,289 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/AliasTable.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    // Pearson's chi-square test of a histogram against the expected probabilities. Consecutive bins are merged
+    // until they expect at least 20 samples, so that the statistic is close to the chi-square distribution.
+    // Bins with zero probability must be empty. Returns false if the statistic is more than 5 standard deviations
+    // above its mean, which practically never happens for a correct sampler.
+    bool PassesChiSquareTest(const std::vector<uint64_t>& histogram, const std::vector<double>& probabilities, uint64_t numSamples)
+    {
+        double chiSquare = 0.0;
+        int degreesOfFreedom = -1;
+        double expectedInBin = 0.0;
+        double observedInBin = 0.0;
+
+        for (size_t index = 0; index < histogram.size(); index++)
+        {
+            if (probabilities[index] == 0.0)
+            {
+                RTXDI_CHECK_EQUAL(histogram[index], 0u);
+                continue;
+            }
+
+            expectedInBin += probabilities[index] * double(numSamples);
+            observedInBin += double(histogram[index]);
+
+            if (expectedInBin >= 20.0)
+            {
+                chiSquare += (observedInBin - expectedInBin) * (observedInBin - expectedInBin) / expectedInBin;
+                degreesOfFreedom++;
+                expectedInBin = 0.0;
+                observedInBin = 0.0;
+            }
+        }
+
+        if (degreesOfFreedom <= 0)
+            return true;
+
+        const double z = (chiSquare - double(degreesOfFreedom)) / std::sqrt(2.0 * double(degreesOfFreedom));
+        return z < 5.0;
+    }
+
+    // Cubed uniform values, with some zero, negative and NaN weights that must never be selected
+    std::vector<float> CreateWeights(uint32_t count, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::vector<float> weights(count);
+        for (uint32_t index = 0; index < count; index++)
+        {
+            const float rnd = uniform(rng);
+            weights[index] = (index % 5 == 3) ? 0.f : rnd * rnd * rnd * 100.f;
+        }
+
+        if (count > 2)
+        {
+            weights[1] = -1.f;
+            weights[2] = std::numeric_limits<float>::quiet_NaN();
+        }
+
+        return weights;
+    }
+
+    std::vector<double> GetProbabilities(const std::vector<float>& weights)
+    {
+        double weightSum = 0.0;
+        for (float weight : weights)
+            weightSum += (weight > 0.f) ? weight : 0.f;
+
+        std::vector<double> probabilities(weights.size());
+        for (size_t index = 0; index < weights.size(); index++)
+            probabilities[index] = (weights[index] > 0.f) ? weights[index] / weightSum : 0.0;
+
+        return probabilities;
+    }
+
+    // Weights of an environment map in the lat-long layout: random texels scaled by the solid angle of their row,
+    // with an all-black row to test rows that are never selected
+    std::vector<float> CreateGridWeights(uint32_t width, uint32_t height, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::vector<float> weights(size_t(width) * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float solidAngle = std::sin((float(y) + 0.5f) / float(height) * 3.14159265f);
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const float rnd = uniform(rng);
+                weights[size_t(y) * width + x] = (height > 2 && y == height / 3) ? 0.f : rnd * rnd * 10.f * solidAngle;
+            }
+        }
+        return weights;
+    }
+
+    bool AreEntriesIdentical(const AliasTable2D& a, const AliasTable2D& b)
+    {
+        const std::vector<RTXDI_AliasTableEntry>& entriesA = a.GetEntries();
+        const std::vector<RTXDI_AliasTableEntry>& entriesB = b.GetEntries();
+        return entriesA.size() == entriesB.size()
+            && memcmp(entriesA.data(), entriesB.data(), entriesA.size() * sizeof(RTXDI_AliasTableEntry)) == 0;
+    }
+}
+
+RTXDI_TEST(AliasTable_EntriesMatchWeights)
+{
+    std::mt19937 rng(1);
+
+    for (uint32_t count : { 1u, 7u, 100u, 1000u, 65536u })
+    {
+        const std::vector<float> weights = CreateWeights(count, rng);
+        const std::vector<double> probabilities = GetProbabilities(weights);
+
+        AliasTable table;
+        table.Build(weights.data(), count);
+        RTXDI_CHECK_EQUAL(table.GetSize(), count);
+
+        // The exact selection probability of every element, accumulated from the thresholds and aliases
+        std::vector<double> tableProbabilities(count, 0.0);
+        for (const RTXDI_AliasTableEntry& entry : table.GetEntries())
+        {
+            RTXDI_CHECK(entry.alias < count);
+            RTXDI_CHECK(entry.threshold >= 0.f && entry.threshold <= 1.f);
+        }
+        for (uint32_t index = 0; index < count; index++)
+        {
+            const RTXDI_AliasTableEntry& entry = table.GetEntries()[index];
+            tableProbabilities[index] += entry.threshold / double(count);
+            tableProbabilities[entry.alias] += (1.0 - entry.threshold) / double(count);
+        }
+
+        for (uint32_t index = 0; index < count; index++)
+        {
+            RTXDI_CHECK_NEAR(tableProbabilities[index], probabilities[index], 1e-6 * probabilities[index] + 1e-9);
+            RTXDI_CHECK_NEAR(table.EvaluatePdf(index), probabilities[index], 1e-6 * probabilities[index] + 1e-12);
+        }
+    }
+}
+
+RTXDI_TEST(AliasTable_SamplesPassChiSquareTest)
+{
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    for (uint32_t count : { 1u, 7u, 100u, 1000u, 65536u })
+    {
+        const std::vector<float> weights = CreateWeights(count, rng);
+        const std::vector<double> probabilities = GetProbabilities(weights);
+
+        AliasTable table;
+        table.Build(weights.data(), count);
+
+        const uint64_t numSamples = 50ull * count + 100000;
+        std::vector<uint64_t> histogram(count, 0);
+        for (uint64_t sample = 0; sample < numSamples; sample++)
+        {
+            uint32_t index = 0;
+            float pdf = 0.f;
+            const bool selected = table.Sample(uniform(rng), uniform(rng), index, pdf);
+            RTXDI_CHECK(selected);
+            if (!selected)
+                continue;
+
+            histogram[index]++;
+            RTXDI_CHECK_EQUAL(pdf, table.EvaluatePdf(index));
+        }
+
+        RTXDI_CHECK(PassesChiSquareTest(histogram, probabilities, numSamples));
+    }
+}
+
+RTXDI_TEST(AliasTable_ZeroWeights)
+{
+    const std::vector<float> weights(10, 0.f);
+    AliasTable table;
+    table.Build(weights.data(), uint32_t(weights.size()));
+
+    uint32_t index = 0;
+    float pdf = 1.f;
+    RTXDI_CHECK(!table.Sample(0.3f, 0.5f, index, pdf));
+    for (uint32_t i = 0; i < 10; i++)
+        RTXDI_CHECK_EQUAL(table.EvaluatePdf(i), 0.f);
+
+    AliasTable emptyTable;
+    emptyTable.Build(nullptr, 0);
+    RTXDI_CHECK(!emptyTable.Sample(0.3f, 0.5f, index, pdf));
+}
+
+RTXDI_TEST(AliasTable2D_ParallelRowsMatchSerialBuild)
+{
+    std::mt19937 rng(3);
+    const uint32_t width = 512;
+    const uint32_t height = 256;
+    const std::vector<float> weights = CreateGridWeights(width, height, rng);
+
+    AliasTable2D serial;
+    serial.Build(weights.data(), width, height);
+
+    // Uneven row ranges on separate threads, with the ranges finishing in any order
+    for (uint32_t numThreads : { 1u, 3u, 8u })
+    {
+        AliasTable2D parallel;
+        parallel.Resize(width, height);
+
+        std::vector<std::thread> threads;
+        for (uint32_t thread = 0; thread < numThreads; thread++)
+        {
+            const uint32_t beginRow = height * thread / numThreads;
+            const uint32_t endRow = height * (thread + 1) / numThreads;
+            threads.emplace_back([&parallel, &weights, beginRow, endRow]() { parallel.BuildRows(weights.data(), beginRow, endRow); });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        parallel.BuildMarginal();
+
+        RTXDI_CHECK(AreEntriesIdentical(parallel, serial));
+        RTXDI_CHECK_EQUAL(parallel.GetWeightSum(), serial.GetWeightSum());
+    }
+
+    // Rebuilding after a Resize to the same size must not depend on the previous contents
+    AliasTable2D rebuilt;
+    rebuilt.Build(CreateGridWeights(width, height, rng).data(), width, height);
+    rebuilt.Build(weights.data(), width, height);
+    RTXDI_CHECK(AreEntriesIdentical(rebuilt, serial));
+}
+
+RTXDI_TEST(AliasTable2D_SamplesPassChiSquareTest)
+{
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    for (uint32_t size : { 1u, 16u, 64u })
+    {
+        const uint32_t width = size * 2;
+        const uint32_t height = size;
+        const std::vector<float> weights = CreateGridWeights(width, height, rng);
+        const std::vector<double> probabilities = GetProbabilities(weights);
+
+        AliasTable2D table;
+        table.Build(weights.data(), width, height);
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const double probability = probabilities[size_t(y) * width + x];
+                RTXDI_CHECK_NEAR(table.EvaluatePdf(x, y), probability, 1e-5 * probability + 1e-12);
+            }
+        }
+
+        const uint64_t numSamples = 100ull * width * height + 100000;
+        std::vector<uint64_t> histogram(weights.size(), 0);
+        for (uint64_t sample = 0; sample < numSamples; sample++)
+        {
+            uint32_t x = 0;
+            uint32_t y = 0;
+            float pdf = 0.f;
+            const bool selected = table.Sample(uniform(rng), uniform(rng), uniform(rng), uniform(rng), x, y, pdf);
+            RTXDI_CHECK(selected);
+            if (!selected)
+                continue;
+
+            histogram[size_t(y) * width + x]++;
+            RTXDI_CHECK_EQUAL(pdf, table.EvaluatePdf(x, y));
+        }
+
+        RTXDI_CHECK(PassesChiSquareTest(histogram, probabilities, numSamples));
+    }
+}
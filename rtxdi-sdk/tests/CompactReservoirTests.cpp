@@ -0,0 +1,349 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    // The 12-bit floats of the compact light reservoir keep 5 significant bits,
+    // rounding to nearest is off by at most half a unit in the last place
+    const double c_Float12RelativeError = 1.0 / 32.0;
+
+    // LogLuv stores log2(luminance) in steps of 1/409.6, the decoder returns the middle of the step
+    const double c_LogLuvLuminanceRelativeError = std::exp2(0.5 / 409.6) - 1.0;
+
+    // The chromaticity is quantized to steps of 1/820 in u'v', which moves the channels by up to about 1% of the largest one
+    const double c_LogLuvChannelError = 0.015;
+
+    // The 24-bit LogLuv format stores log2(luminance) in steps of 1/8, and the chromaticity in steps of 1/410,
+    // which moves the channels by up to about 2% of the largest one on top of the luminance error
+    const double c_LogLuv24LuminanceRelativeError = std::exp2(0.5 / 8.0) - 1.0;
+    const double c_LogLuv24ChannelError = c_LogLuv24LuminanceRelativeError + 0.02;
+    const double c_LogLuv24GamutEdgeLuminanceError = c_LogLuv24LuminanceRelativeError + 0.02;
+
+    // Colors with a black channel are on the edge of the gamut, the decoder clamps the channels that come out negative
+    const double c_LogLuvGamutEdgeLuminanceError = 0.01;
+
+    // The angle between a normal and its round-trip through the 2x 8-bit snorm octahedral encoding, in radians
+    const double c_Snorm2x8MaxAngle = 0.02;
+
+    // The position is stored as an fp16 distance, rounded to nearest with 11 significant bits, and an octahedral
+    // direction with 2x 16-bit snorms, which moves the position by less than 1e-4 times the distance
+    const double c_CompactPositionRelativeError = 1.0 / 2048.0 + 1e-4;
+
+    double Luminance(const float3& color)
+    {
+        return 0.2126390058715104 * color.x + 0.7151686787677559 * color.y + 0.0721923153607337 * color.z;
+    }
+
+    double RelativeError(double actual, double expected)
+    {
+        return std::abs(actual - expected) / std::abs(expected);
+    }
+
+    double Distance(const float3& a, const float3& b)
+    {
+        const double dx = double(a.x) - double(b.x);
+        const double dy = double(a.y) - double(b.y);
+        const double dz = double(a.z) - double(b.z);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    float3 RandomDirection(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+        while (true)
+        {
+            const float3 v = { uniform(rng), uniform(rng), uniform(rng) };
+            const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+            if (length > 1e-3f && length <= 1.f)
+                return { v.x / length, v.y / length, v.z / length };
+        }
+    }
+
+    // Colors with random chromaticities, including saturated primaries, grays and black channels,
+    // and a luminance spread over most of the LogLuv range of [2^-20, 2^20], or of [2^-16, 2^16] with the 24-bit format
+    float3 RandomColor(std::mt19937& rng, int index, float maxExponent = 15.f)
+    {
+        std::uniform_real_distribution<float> uniform(0.1f, 1.f);
+        std::uniform_real_distribution<float> exponent(-maxExponent, maxExponent);
+
+        float3 color = { uniform(rng), uniform(rng), uniform(rng) };
+        if (index % 7 == 0)
+            color = { 1.f, 0.f, 0.f };
+        if (index % 7 == 1)
+            color = { 0.f, 0.f, 1.f };
+        if (index % 7 == 2)
+            color = { 0.5f, 0.5f, 0.5f };
+        if (index % 11 == 0)
+            color.y = 0.f;
+
+        const float scale = std::exp2(exponent(rng));
+        return { color.x * scale, color.y * scale, color.z * scale };
+    }
+}
+
+RTXDI_TEST(CompactReservoir_WeightsWithinFloat12Error)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(1.f, 2.f);
+    std::uniform_int_distribution<int> exponent(-120, 120);
+
+    double maxPdfError = 0.0;
+    double maxWeightError = 0.0;
+
+    for (int sample = 0; sample < 100000; sample++)
+    {
+        const float targetPdf = std::ldexp(uniform(rng), exponent(rng));
+        const float weight = std::ldexp(uniform(rng), exponent(rng));
+
+        // The exponents share the words with the sample UV and the visibility distance and age, which must be kept
+        const uint32_t uvData = rng() & 0x00ffffffu;
+        const uint32_t distanceAge = rng() & 0x00ffffffu;
+        uint32_t packedUvData = uvData;
+        uint32_t packedDistanceAge = distanceAge;
+        uint32_t packedWeights = 0;
+        PackCompactReservoirWeights(targetPdf, weight, { 0.f, 0.f, 0.f }, packedUvData, packedDistanceAge, packedWeights);
+        RTXDI_CHECK_EQUAL(packedUvData & 0x00ffffffu, uvData);
+        RTXDI_CHECK_EQUAL(packedDistanceAge & 0x00ffffffu, distanceAge);
+
+        float unpackedPdf = 0.f;
+        float unpackedWeight = 0.f;
+        float3 unpackedColor = { 1.f, 1.f, 1.f };
+        UnpackCompactReservoirWeights(packedUvData, packedDistanceAge, packedWeights, unpackedPdf, unpackedWeight, unpackedColor);
+
+        maxPdfError = std::max(maxPdfError, RelativeError(unpackedPdf, targetPdf));
+        maxWeightError = std::max(maxWeightError, RelativeError(unpackedWeight, weight));
+
+        RTXDI_CHECK_EQUAL(unpackedColor.x + unpackedColor.y + unpackedColor.z, 0.f);
+    }
+
+    RTXDI_CHECK(maxPdfError <= c_Float12RelativeError);
+    RTXDI_CHECK(maxWeightError <= c_Float12RelativeError);
+
+    // Values that the 12-bit floats represent exactly
+    for (float value : { 0.f, 1.f, 0.5f, 3.f, 1024.f, 0x1.fp100f, std::numeric_limits<float>::infinity() })
+    {
+        uint32_t packedUvData = 0;
+        uint32_t packedDistanceAge = 0;
+        uint32_t packedWeights = 0;
+        PackCompactReservoirWeights(value, value, { 0.f, 0.f, 0.f }, packedUvData, packedDistanceAge, packedWeights);
+
+        float unpackedPdf = 0.f;
+        float unpackedWeight = 0.f;
+        float3 unpackedColor;
+        UnpackCompactReservoirWeights(packedUvData, packedDistanceAge, packedWeights, unpackedPdf, unpackedWeight, unpackedColor);
+
+        RTXDI_CHECK_EQUAL(unpackedPdf, value);
+        RTXDI_CHECK_EQUAL(unpackedWeight, value);
+    }
+}
+
+RTXDI_TEST(CompactReservoir_ColorWeightWithinLogLuv24Error)
+{
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> uniform(1.f, 2.f);
+    std::uniform_int_distribution<int> exponent(-60, 60);
+
+    double maxLuminanceError = 0.0;
+    double maxEdgeLuminanceError = 0.0;
+    double maxChannelError = 0.0;
+
+    for (int sample = 0; sample < 100000; sample++)
+    {
+        // colorWeight is stored relative to the weight, so its range follows the weight
+        const float weight = (sample % 13 == 0) ? 0.f : std::ldexp(uniform(rng), exponent(rng));
+        const float3 color = RandomColor(rng, sample, 10.f);
+        const float colorScale = (weight > 0.f) ? weight : 1.f;
+        const float3 colorWeight = { color.x * colorScale, color.y * colorScale, color.z * colorScale };
+
+        uint32_t packedUvData = 0;
+        uint32_t packedDistanceAge = 0;
+        uint32_t packedWeights = 0;
+        PackCompactReservoirWeights(1.f, weight, colorWeight, packedUvData, packedDistanceAge, packedWeights);
+
+        float unpackedPdf = 0.f;
+        float unpackedWeight = 0.f;
+        float3 unpackedColorWeight;
+        UnpackCompactReservoirWeights(packedUvData, packedDistanceAge, packedWeights, unpackedPdf, unpackedWeight, unpackedColorWeight);
+
+        // The weight rounding cancels out, the stored color is multiplied back by the same stored weight.
+        // Colors on the edge of the gamut can decode to negative channels, which are clamped to zero
+        // and add to the luminance error.
+        const double luminanceError = RelativeError(Luminance(unpackedColorWeight), Luminance(colorWeight));
+        const bool onGamutEdge = color.x == 0.f || color.y == 0.f || color.z == 0.f;
+        if (onGamutEdge)
+            maxEdgeLuminanceError = std::max(maxEdgeLuminanceError, luminanceError);
+        else
+            maxLuminanceError = std::max(maxLuminanceError, luminanceError);
+
+        const float expected[3] = { colorWeight.x, colorWeight.y, colorWeight.z };
+        const float actual[3] = { unpackedColorWeight.x, unpackedColorWeight.y, unpackedColorWeight.z };
+        const double largestChannel = std::max({ expected[0], expected[1], expected[2] });
+        for (int channel = 0; channel < 3; channel++)
+        {
+            RTXDI_CHECK(actual[channel] >= 0.f);
+            maxChannelError = std::max(maxChannelError, std::abs(double(actual[channel]) - double(expected[channel])) / largestChannel);
+        }
+    }
+
+    // Some float rounding on top of the quantization
+    RTXDI_CHECK(maxLuminanceError <= c_LogLuv24LuminanceRelativeError * 1.01);
+    RTXDI_CHECK(maxEdgeLuminanceError <= c_LogLuv24GamutEdgeLuminanceError);
+    RTXDI_CHECK(maxChannelError <= c_LogLuv24ChannelError);
+}
+
+RTXDI_TEST(CompactReservoir_BlackColorWeight)
+{
+    for (float weight : { 0.f, 1e-30f, 1.f, 1e30f })
+    {
+        uint32_t packedUvData = 0;
+        uint32_t packedDistanceAge = 0;
+        uint32_t packedWeights = 0;
+        PackCompactReservoirWeights(1.f, weight, { 0.f, 0.f, 0.f }, packedUvData, packedDistanceAge, packedWeights);
+        RTXDI_CHECK_EQUAL(packedWeights >> 8, 0u);
+
+        float unpackedPdf = 0.f;
+        float unpackedWeight = 0.f;
+        float3 unpackedColorWeight = { 1.f, 1.f, 1.f };
+        UnpackCompactReservoirWeights(packedUvData, packedDistanceAge, packedWeights, unpackedPdf, unpackedWeight, unpackedColorWeight);
+        RTXDI_CHECK_EQUAL(unpackedColorWeight.x, 0.f);
+        RTXDI_CHECK_EQUAL(unpackedColorWeight.y, 0.f);
+        RTXDI_CHECK_EQUAL(unpackedColorWeight.z, 0.f);
+    }
+}
+
+RTXDI_TEST(CompactGIReservoir_RadianceWithinLogLuvError)
+{
+    std::mt19937 rng(3);
+
+    double maxLuminanceError = 0.0;
+    double maxChannelError = 0.0;
+
+    for (int sample = 0; sample < 100000; sample++)
+    {
+        const float3 radiance = RandomColor(rng, sample);
+        const float3 unpackedRadiance = DecodeLogLuvToRGB(EncodeRGBToLogLuv(radiance));
+
+        const bool onGamutEdge = radiance.x == 0.f || radiance.y == 0.f || radiance.z == 0.f;
+        if (!onGamutEdge)
+            maxLuminanceError = std::max(maxLuminanceError, RelativeError(Luminance(unpackedRadiance), Luminance(radiance)));
+
+        const double largestChannel = std::max({ radiance.x, radiance.y, radiance.z });
+        maxChannelError = std::max(maxChannelError, std::abs(double(unpackedRadiance.x) - double(radiance.x)) / largestChannel);
+        maxChannelError = std::max(maxChannelError, std::abs(double(unpackedRadiance.y) - double(radiance.y)) / largestChannel);
+        maxChannelError = std::max(maxChannelError, std::abs(double(unpackedRadiance.z) - double(radiance.z)) / largestChannel);
+    }
+
+    RTXDI_CHECK(maxLuminanceError <= c_LogLuvLuminanceRelativeError * 1.01);
+    RTXDI_CHECK(maxChannelError <= c_LogLuvChannelError);
+
+    // Black and the colors below the LogLuv range decode to black
+    RTXDI_CHECK_EQUAL(EncodeRGBToLogLuv({ 0.f, 0.f, 0.f }), 0u);
+    RTXDI_CHECK_EQUAL(EncodeRGBToLogLuv({ 1e-7f, 1e-7f, 1e-7f }), 0u);
+    const float3 black = DecodeLogLuvToRGB(0);
+    RTXDI_CHECK_EQUAL(black.x + black.y + black.z, 0.f);
+}
+
+RTXDI_TEST(CompactGIReservoir_NormalWithinSnorm2x8Error)
+{
+    std::mt19937 rng(4);
+
+    // Random directions, the axes, and directions on the folds of the octahedral map
+    std::vector<float3> normals = {
+        { 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f } };
+    for (int sample = 0; sample < 1000; sample++)
+    {
+        const float3 direction = RandomDirection(rng);
+        normals.push_back({ direction.x, direction.y, 0.f });
+        normals.push_back({ direction.x, 0.f, direction.z });
+    }
+    for (int sample = 0; sample < 200000; sample++)
+        normals.push_back(RandomDirection(rng));
+
+    double maxAngle = 0.0;
+    for (float3 normal : normals)
+    {
+        const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        normal = { normal.x / length, normal.y / length, normal.z / length };
+
+        const uint32_t packedNormal = EncodeNormalizedVectorToSnorm2x8(normal);
+        RTXDI_CHECK_EQUAL(packedNormal >> 16, 0u);
+
+        // The weight shares the packed field, the normal decoder must ignore it
+        const float3 unpackedNormal = DecodeNormalizedVectorFromSnorm2x8(packedNormal | 0xabcd0000u);
+        const double unpackedLength = std::sqrt(double(unpackedNormal.x) * unpackedNormal.x
+            + double(unpackedNormal.y) * unpackedNormal.y + double(unpackedNormal.z) * unpackedNormal.z);
+        RTXDI_CHECK_NEAR(unpackedLength, 1.0, 1e-5);
+
+        const double cosAngle = (double(normal.x) * unpackedNormal.x + double(normal.y) * unpackedNormal.y
+            + double(normal.z) * unpackedNormal.z) / unpackedLength;
+        maxAngle = std::max(maxAngle, std::acos(std::min(cosAngle, 1.0)));
+    }
+
+    // Steps of 1/127 in the octahedral map, which the projection to the sphere stretches near the folds
+    RTXDI_CHECK(maxAngle <= c_Snorm2x8MaxAngle);
+}
+
+RTXDI_TEST(CompactGIReservoir_PositionWithinBound)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    std::uniform_real_distribution<float> distanceExponent(-10.f, 15.9f);
+
+    double maxRelativeError = 0.0;
+
+    for (int sample = 0; sample < 200000; sample++)
+    {
+        // Surfaces near and far from the origin, samples from very close to the fp16 limit
+        const float surfaceScale = (sample % 3 == 0) ? 10000.f : 10.f;
+        const float3 surfacePosition = { uniform(rng) * surfaceScale, uniform(rng) * surfaceScale, uniform(rng) * surfaceScale };
+        const float3 direction = RandomDirection(rng);
+        const float distance = std::exp2(distanceExponent(rng));
+        const float3 samplePosition = {
+            surfacePosition.x + direction.x * distance,
+            surfacePosition.y + direction.y * distance,
+            surfacePosition.z + direction.z * distance };
+
+        uint32_t packedDistance = 0;
+        uint32_t packedDirection = 0;
+        PackCompactGIReservoirPosition(samplePosition, surfacePosition, packedDistance, packedDirection);
+        const float3 unpackedPosition = UnpackCompactGIReservoirPosition(packedDistance, packedDirection, surfacePosition);
+
+        const double error = Distance(unpackedPosition, samplePosition);
+
+        // Rounding of the float3 positions themselves, which the full-precision form has too
+        const double magnitude = std::max({ std::abs(surfacePosition.x), std::abs(surfacePosition.y), std::abs(surfacePosition.z),
+            std::abs(samplePosition.x), std::abs(samplePosition.y), std::abs(samplePosition.z) });
+        const double floatRounding = 4.0 * magnitude * std::numeric_limits<float>::epsilon();
+
+        maxRelativeError = std::max(maxRelativeError, (error - floatRounding) / distance);
+    }
+
+    RTXDI_CHECK(maxRelativeError <= c_CompactPositionRelativeError);
+
+    // A sample at the surface is reconstructed exactly
+    const float3 surfacePosition = { 12.5f, -3.f, 1000.25f };
+    uint32_t packedDistance = 0;
+    uint32_t packedDirection = 0;
+    PackCompactGIReservoirPosition(surfacePosition, surfacePosition, packedDistance, packedDirection);
+    const float3 unpackedPosition = UnpackCompactGIReservoirPosition(packedDistance, packedDirection, surfacePosition);
+    RTXDI_CHECK_EQUAL(Distance(unpackedPosition, surfacePosition), 0.0);
+}
@@ -0,0 +1,275 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/LightTree.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    const uint32_t c_NumLights = 1000;
+
+    float3 Normalize(const float3& v)
+    {
+        const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        return { v.x / length, v.y / length, v.z / length };
+    }
+
+    float Dot(const float3& a, const float3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    float3 RandomDirection(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+        while (true)
+        {
+            const float3 v = { uniform(rng), uniform(rng), uniform(rng) };
+            const float lengthSquared = Dot(v, v);
+            if (lengthSquared > 1e-4f && lengthSquared <= 1.f)
+                return Normalize(v);
+        }
+    }
+
+    // Omnidirectional point lights, one-sided area lights with random orientations, and some lights with zero power
+    std::vector<LightTreeLightBounds> CreateLights(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::vector<LightTreeLightBounds> lights(c_NumLights);
+
+        for (uint32_t index = 0; index < c_NumLights; index++)
+        {
+            LightTreeLightBounds& light = lights[index];
+            const float3 center = { uniform(rng) * 100.f, uniform(rng) * 20.f, uniform(rng) * 100.f };
+
+            if (index % 17 == 0)
+            {
+                light.boundsMin = center;
+                light.boundsMax = center;
+                continue;
+            }
+
+            if (index % 5 == 0)
+            {
+                light.boundsMin = center;
+                light.boundsMax = center;
+                light.power = uniform(rng) * 10.f;
+            }
+            else
+            {
+                const float size = uniform(rng) * 0.5f;
+                light.boundsMin = center;
+                light.boundsMax = { center.x + size, center.y + size * uniform(rng), center.z + size };
+                light.axis = RandomDirection(rng);
+                light.cosThetaO = 1.f;
+                light.power = uniform(rng);
+            }
+        }
+
+        return lights;
+    }
+
+    float3 RandomPosition(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        return { uniform(rng) * 100.f, uniform(rng) * 20.f, uniform(rng) * 100.f };
+    }
+
+    void CheckSampledPdfs(const LightTree& tree, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        for (int point = 0; point < 50; point++)
+        {
+            // Surfaces and, with a zero normal, points in a volume
+            const float3 position = RandomPosition(rng);
+            const float3 normal = (point % 3 == 0) ? float3{ 0.f, 0.f, 0.f } : RandomDirection(rng);
+
+            for (int sample = 0; sample < 200; sample++)
+            {
+                uint32_t lightIndex = 0;
+                float pdf = 0.f;
+                if (!tree.Sample(uniform(rng), position, normal, lightIndex, pdf))
+                    continue;
+
+                RTXDI_CHECK(lightIndex < c_NumLights);
+                RTXDI_CHECK(pdf > 0.f);
+                RTXDI_CHECK_NEAR(tree.EvaluatePdf(lightIndex, position, normal), pdf, pdf * 1e-5f);
+            }
+
+            // Sampling can fail when a node has a nonzero importance but its children don't,
+            // so the PDFs of all lights add up to the probability of success, at most 1
+            double pdfSum = 0.0;
+            for (uint32_t lightIndex = 0; lightIndex < c_NumLights; lightIndex++)
+                pdfSum += tree.EvaluatePdf(lightIndex, position, normal);
+
+            RTXDI_CHECK(pdfSum > 0.0);
+            RTXDI_CHECK(pdfSum <= 1.0 + 1e-4);
+        }
+    }
+
+    void CheckHistogram(const LightTree& tree, std::mt19937& rng)
+    {
+        const float3 position = { 50.f, 10.f, 50.f };
+        const float3 normal = { 0.f, 1.f, 0.f };
+        const uint32_t numSamples = 1000000;
+
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::vector<uint32_t> histogram(c_NumLights, 0);
+        uint32_t numSelected = 0;
+
+        for (uint32_t sample = 0; sample < numSamples; sample++)
+        {
+            uint32_t lightIndex = 0;
+            float pdf = 0.f;
+            if (tree.Sample(uniform(rng), position, normal, lightIndex, pdf))
+            {
+                histogram[lightIndex]++;
+                numSelected++;
+            }
+        }
+
+        double pdfSum = 0.0;
+        for (uint32_t lightIndex = 0; lightIndex < c_NumLights; lightIndex++)
+        {
+            const double pdf = tree.EvaluatePdf(lightIndex, position, normal);
+            const double expected = pdf * numSamples;
+            pdfSum += pdf;
+
+            if (pdf == 0.0)
+            {
+                RTXDI_CHECK_EQUAL(histogram[lightIndex], 0u);
+                continue;
+            }
+
+            // Binomial counts, 5 standard deviations for 1000 lights keeps false failures unlikely
+            if (expected >= 50.0)
+            {
+                const double sigma = std::sqrt(expected * (1.0 - pdf));
+                RTXDI_CHECK_NEAR(histogram[lightIndex], expected, 5.0 * sigma);
+            }
+        }
+
+        const double expectedSelected = pdfSum * numSamples;
+        RTXDI_CHECK_NEAR(numSelected, expectedSelected, 5.0 * std::sqrt(expectedSelected) + 1.0);
+    }
+
+    void CheckContributingLights(const LightTree& tree, const std::vector<LightTreeLightBounds>& lights, std::mt19937& rng)
+    {
+        for (int point = 0; point < 200; point++)
+        {
+            const float3 position = RandomPosition(rng);
+            const float3 normal = RandomDirection(rng);
+
+            for (uint32_t lightIndex = 0; lightIndex < c_NumLights; lightIndex++)
+            {
+                const LightTreeLightBounds& light = lights[lightIndex];
+                if (light.power <= 0.f)
+                {
+                    RTXDI_CHECK_EQUAL(tree.EvaluatePdf(lightIndex, position, normal), 0.f);
+                    continue;
+                }
+
+                const float3 center = {
+                    (light.boundsMin.x + light.boundsMax.x) * 0.5f,
+                    (light.boundsMin.y + light.boundsMax.y) * 0.5f,
+                    (light.boundsMin.z + light.boundsMax.z) * 0.5f };
+                const float3 toPoint = Normalize({ position.x - center.x, position.y - center.y, position.z - center.z });
+
+                // The light emits towards the point and the point faces the light, with some margin for the extent of the light
+                const bool emitsTowardsPoint = light.cosThetaO <= -1.f || Dot(toPoint, light.axis) > 0.01f;
+                const bool facesLight = -Dot(toPoint, normal) > 0.01f;
+
+                if (emitsTowardsPoint && facesLight)
+                    RTXDI_CHECK(tree.EvaluatePdf(lightIndex, position, normal) > 0.f);
+            }
+        }
+    }
+
+    void MoveLights(std::vector<LightTreeLightBounds>& lights, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        for (LightTreeLightBounds& light : lights)
+        {
+            const float offset = uniform(rng) * 2.f - 1.f;
+            light.boundsMin.x += offset;
+            light.boundsMax.x += offset;
+            if (light.power > 0.f)
+                light.power *= 0.5f + uniform(rng);
+        }
+    }
+}
+
+RTXDI_TEST(LightTree_SampledPdfMatchesEvaluatedPdf)
+{
+    std::mt19937 rng(1);
+    std::vector<LightTreeLightBounds> lights = CreateLights(rng);
+
+    LightTree tree;
+    tree.Build(lights.data(), c_NumLights);
+    RTXDI_CHECK_EQUAL(tree.GetNumLights(), c_NumLights);
+    CheckSampledPdfs(tree, rng);
+
+    MoveLights(lights, rng);
+    tree.Refit(lights.data(), c_NumLights);
+    CheckSampledPdfs(tree, rng);
+}
+
+RTXDI_TEST(LightTree_HistogramMatchesPdf)
+{
+    std::mt19937 rng(2);
+    std::vector<LightTreeLightBounds> lights = CreateLights(rng);
+
+    LightTree tree;
+    tree.Build(lights.data(), c_NumLights);
+    CheckHistogram(tree, rng);
+
+    MoveLights(lights, rng);
+    tree.Refit(lights.data(), c_NumLights);
+    CheckHistogram(tree, rng);
+}
+
+RTXDI_TEST(LightTree_ContributingLightsHaveNonzeroPdf)
+{
+    std::mt19937 rng(3);
+    std::vector<LightTreeLightBounds> lights = CreateLights(rng);
+
+    LightTree tree;
+    tree.Build(lights.data(), c_NumLights);
+
+    for (uint32_t lightIndex = 0; lightIndex < c_NumLights; lightIndex++)
+        RTXDI_CHECK_EQUAL(tree.GetLightTrails()[lightIndex] != 0, lights[lightIndex].power > 0.f);
+
+    CheckContributingLights(tree, lights, rng);
+
+    MoveLights(lights, rng);
+    tree.Refit(lights.data(), c_NumLights);
+    CheckContributingLights(tree, lights, rng);
+}
+
+RTXDI_TEST(LightTree_NoLights)
+{
+    LightTree tree;
+    tree.Build(nullptr, 0);
+    RTXDI_CHECK_EQUAL(tree.GetNodes().size(), size_t(1));
+
+    uint32_t lightIndex = 0;
+    float pdf = 1.f;
+    RTXDI_CHECK(!tree.Sample(0.5f, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, lightIndex, pdf));
+    RTXDI_CHECK_EQUAL(pdf, 0.f);
+    RTXDI_CHECK_EQUAL(tree.EvaluatePdf(0, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }), 0.f);
+}
@@ -0,0 +1,181 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    RTXDI_ResamplingRuntimeParameters CreateHashGridParameters(uint32_t capacity, uint32_t maxProbes, const float3& center)
+    {
+        ContextParameters params;
+        params.RenderWidth = 64;
+        params.RenderHeight = 64;
+        params.ReGIR.Mode = ReGIRMode::HashGrid;
+        params.ReGIR.HashGridCapacity = capacity;
+        params.ReGIR.HashGridMaxProbes = maxProbes;
+
+        FrameParameters frame;
+        frame.regirCellSize = 1.f;
+        frame.regirCenter = center;
+
+        Context context(params);
+        RTXDI_ResamplingRuntimeParameters runtimeParams{};
+        context.FillRuntimeParameters(runtimeParams, frame);
+        return runtimeParams;
+    }
+}
+
+RTXDI_TEST(ReGIRHashGrid_KeyIdentifiesCell)
+{
+    const float3 center = { 10.5f, -3.25f, 0.f };
+    const RTXDI_ResamplingRuntimeParameters params = CreateHashGridParameters(4096, 16, center);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    std::uniform_real_distribution<float> insideCell(0.01f, 0.99f);
+
+    for (int i = 0; i < 10000; i++)
+    {
+        // Cell coordinates relative to the center cell, see ReGIRHashGridWorldPosToKey
+        const float3 cellOrigin = { std::floor(position(rng)), std::floor(position(rng)), std::floor(position(rng)) };
+        const float3 a = { cellOrigin.x + insideCell(rng), cellOrigin.y + insideCell(rng), cellOrigin.z + insideCell(rng) };
+        const float3 b = { cellOrigin.x + insideCell(rng), cellOrigin.y + insideCell(rng), cellOrigin.z + insideCell(rng) };
+        const float3 neighbor = { a.x + 1.f, a.y, a.z };
+
+        const uint32_t key = ReGIRHashGridWorldPosToKey(params, a);
+        RTXDI_CHECK(key != RTXDI_REGIR_HASH_EMPTY_KEY);
+        RTXDI_CHECK((key & RTXDI_REGIR_HASH_KEY_VALID_BIT) != 0);
+        RTXDI_CHECK_EQUAL(ReGIRHashGridWorldPosToKey(params, b), key);
+        RTXDI_CHECK(ReGIRHashGridWorldPosToKey(params, neighbor) != key);
+    }
+
+    // The grid covers RTXDI_REGIR_HASH_CELL_RANGE cells on each side of the center cell
+    const float range = float(RTXDI_REGIR_HASH_CELL_RANGE);
+    RTXDI_CHECK(ReGIRHashGridWorldPosToKey(params, { 10.5f + range - 1.f, 0.f, 0.f }) != RTXDI_REGIR_HASH_EMPTY_KEY);
+    RTXDI_CHECK(ReGIRHashGridWorldPosToKey(params, { 10.5f + range, 0.f, 0.f }) == RTXDI_REGIR_HASH_EMPTY_KEY);
+    RTXDI_CHECK(ReGIRHashGridWorldPosToKey(params, { 10.5f - range, 0.f, 0.f }) != RTXDI_REGIR_HASH_EMPTY_KEY);
+    RTXDI_CHECK(ReGIRHashGridWorldPosToKey(params, { 10.5f - range - 1.f, 0.f, 0.f }) == RTXDI_REGIR_HASH_EMPTY_KEY);
+    RTXDI_CHECK(ReGIRHashGridWorldPosToKey(params, { 0.f, 0.f, -1e6f }) == RTXDI_REGIR_HASH_EMPTY_KEY);
+}
+
+RTXDI_TEST(ReGIRHashGrid_InsertThenLookup)
+{
+    const float3 center = { 0.f, 0.f, 0.f };
+
+    for (uint32_t loadPercentage : { 25u, 50u, 75u })
+    {
+        // With as many probes as slots, inserts only fail when the table is full
+        const RTXDI_ResamplingRuntimeParameters params = CreateHashGridParameters(1024, 1024, center);
+        const uint32_t tableSize = params.regirHashGrid.tableSize;
+        RTXDI_CHECK_EQUAL(tableSize, 1024u);
+
+        std::vector<uint32_t> table(tableSize, RTXDI_REGIR_HASH_EMPTY_KEY);
+        std::map<uint32_t, int> reference; // key -> slot
+
+        std::mt19937 rng(loadPercentage);
+        std::uniform_int_distribution<int> cell(-40, 39);
+
+        while (reference.size() < tableSize * loadPercentage / 100)
+        {
+            const float3 pos = { float(cell(rng)) + 0.5f, float(cell(rng)) + 0.5f, float(cell(rng)) + 0.5f };
+            const uint32_t key = ReGIRHashGridWorldPosToKey(params, pos);
+
+            const int slot = ReGIRHashGridInsert(params, table.data(), pos);
+            RTXDI_CHECK(slot >= 0 && slot < int(tableSize));
+            if (slot < 0)
+                continue;
+
+            RTXDI_CHECK_EQUAL(table[slot], key);
+
+            // Inserting an existing cell again returns the same slot
+            auto it = reference.find(key);
+            if (it != reference.end())
+                RTXDI_CHECK_EQUAL(slot, it->second);
+            else
+                reference[key] = slot;
+
+            RTXDI_CHECK_EQUAL(ReGIRHashGridLookup(params, table.data(), pos), slot);
+        }
+
+        // Every inserted cell is found in its slot, and every occupied slot belongs to a distinct inserted cell
+        uint32_t occupiedSlots = 0;
+        for (uint32_t slot = 0; slot < tableSize; slot++)
+        {
+            if (table[slot] == RTXDI_REGIR_HASH_EMPTY_KEY)
+                continue;
+
+            occupiedSlots++;
+            auto it = reference.find(table[slot]);
+            RTXDI_CHECK(it != reference.end() && it->second == int(slot));
+        }
+        RTXDI_CHECK_EQUAL(occupiedSlots, uint32_t(reference.size()));
+
+        // Cells outside of the inserted range are not found
+        for (int i = 0; i < 1000; i++)
+        {
+            const float3 pos = { float(cell(rng)) + 100.5f, float(cell(rng)) + 0.5f, float(cell(rng)) + 0.5f };
+            RTXDI_CHECK_EQUAL(ReGIRHashGridLookup(params, table.data(), pos), -1);
+        }
+    }
+}
+
+RTXDI_TEST(ReGIRHashGrid_ProbeLimit)
+{
+    const float3 center = { 0.f, 0.f, 0.f };
+    const uint32_t maxProbes = 4;
+    const RTXDI_ResamplingRuntimeParameters params = CreateHashGridParameters(64, maxProbes, center);
+    const uint32_t tableSize = params.regirHashGrid.tableSize;
+
+    std::vector<uint32_t> table(tableSize, RTXDI_REGIR_HASH_EMPTY_KEY);
+
+    // Insert more cells than the table can hold: some of them must fail, and the ones that succeed must be found
+    std::vector<float3> inserted;
+    uint32_t failedInserts = 0;
+    for (int i = 0; i < int(tableSize) * 2; i++)
+    {
+        const float3 pos = { float(i) + 0.5f, 0.5f, 0.5f };
+        const int slot = ReGIRHashGridInsert(params, table.data(), pos);
+        if (slot < 0)
+        {
+            failedInserts++;
+            RTXDI_CHECK_EQUAL(ReGIRHashGridLookup(params, table.data(), pos), -1);
+        }
+        else
+        {
+            inserted.push_back(pos);
+        }
+    }
+
+    RTXDI_CHECK(failedInserts >= tableSize);
+    RTXDI_CHECK(inserted.size() <= tableSize);
+
+    for (const float3& pos : inserted)
+    {
+        const int slot = ReGIRHashGridLookup(params, table.data(), pos);
+        RTXDI_CHECK(slot >= 0);
+
+        // Linear probing never moves a cell further than maxProbes - 1 slots from its home slot, so re-inserting finds it
+        RTXDI_CHECK_EQUAL(ReGIRHashGridInsert(params, table.data(), pos), slot);
+    }
+
+    // Positions outside of the grid are never inserted
+    std::vector<uint32_t> emptyTable(tableSize, RTXDI_REGIR_HASH_EMPTY_KEY);
+    RTXDI_CHECK_EQUAL(ReGIRHashGridInsert(params, emptyTable.data(), { 1e6f, 0.f, 0.f }), -1);
+    for (uint32_t key : emptyTable)
+        RTXDI_CHECK_EQUAL(key, uint32_t(RTXDI_REGIR_HASH_EMPTY_KEY));
+}
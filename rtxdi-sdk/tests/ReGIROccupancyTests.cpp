@@ -0,0 +1,252 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    const uint32_t c_LightsPerCell = 300;
+    const uint32_t c_BuildGroupSize = 256;
+
+    struct ReGIRSetup
+    {
+        std::unique_ptr<Context> context;
+        FrameParameters frame;
+        RTXDI_ResamplingRuntimeParameters params{};
+    };
+
+    ReGIRSetup CreateSetup(ReGIRMode mode, const uint3& gridSize, float jitter, const float3& center)
+    {
+        ContextParameters contextParams;
+        contextParams.RenderWidth = 64;
+        contextParams.RenderHeight = 64;
+        contextParams.ReGIR.Mode = mode;
+        contextParams.ReGIR.GridSize = gridSize;
+        contextParams.ReGIR.LightsPerCell = c_LightsPerCell;
+
+        ReGIRSetup setup;
+        setup.context = std::make_unique<Context>(contextParams);
+        setup.frame.regirSamplingJitter = jitter;
+        setup.frame.regirCenter = center;
+        setup.context->FillRuntimeParameters(setup.params, setup.frame);
+        return setup;
+    }
+
+    bool IsCellMarked(const std::vector<uint32_t>& occupancyMask, int cellIndex)
+    {
+        return (occupancyMask[uint32_t(cellIndex) >> 5] & (1u << (uint32_t(cellIndex) & 31))) != 0;
+    }
+
+    // Runs the cell list variant of PresampleReGIR over the compacted list, and returns how many times
+    // each light slot has been built. The full build writes every slot of every cell once.
+    std::vector<uint32_t> SimulateCellListBuild(const std::vector<uint32_t>& cellList, uint32_t listedCellCount, uint32_t cellCount)
+    {
+        std::vector<uint32_t> slotBuildCount(size_t(cellCount) * c_LightsPerCell, 0);
+
+        uint32_t groupsY = 0;
+        uint32_t groupsZ = 0;
+        ReGIRGetCellListDispatchSize(listedCellCount, groupsY, groupsZ);
+        const uint32_t groupsX = (c_LightsPerCell + c_BuildGroupSize - 1) / c_BuildGroupSize;
+
+        RTXDI_CHECK(groupsY <= 65535);
+        RTXDI_CHECK(uint64_t(groupsY) * groupsZ >= listedCellCount);
+
+        for (uint32_t groupZ = 0; groupZ < groupsZ; groupZ++)
+        for (uint32_t groupY = 0; groupY < groupsY; groupY++)
+        {
+            const uint32_t listIndex = groupZ * 65535 + groupY;
+            if (listIndex >= listedCellCount)
+                continue;
+
+            for (uint32_t groupX = 0; groupX < groupsX; groupX++)
+            for (uint32_t thread = 0; thread < c_BuildGroupSize; thread++)
+            {
+                const uint32_t slotInCell = groupX * c_BuildGroupSize + thread;
+                if (slotInCell >= c_LightsPerCell)
+                    continue;
+
+                slotBuildCount[size_t(cellList[listIndex]) * c_LightsPerCell + slotInCell]++;
+            }
+        }
+
+        return slotBuildCount;
+    }
+
+    // Checks that the compacted list holds exactly the marked cells, and that the cell list build writes
+    // every slot of the marked cells once, with the same slot indices (and so the same samples) as the full build.
+    void CheckCompactedBuild(const std::vector<uint32_t>& occupancyMask, uint32_t cellCount)
+    {
+        std::vector<uint32_t> cellList(cellCount, ~0u);
+        const uint32_t listedCellCount = ReGIRCompactOccupiedCells(cellCount, occupancyMask.data(), cellList.data());
+        RTXDI_CHECK(listedCellCount <= cellCount);
+
+        uint32_t markedCellCount = 0;
+        for (uint32_t cellIndex = 0; cellIndex < cellCount; cellIndex++)
+            markedCellCount += IsCellMarked(occupancyMask, int(cellIndex)) ? 1 : 0;
+        RTXDI_CHECK_EQUAL(listedCellCount, markedCellCount);
+
+        for (uint32_t listIndex = 0; listIndex < listedCellCount; listIndex++)
+        {
+            RTXDI_CHECK(cellList[listIndex] < cellCount);
+            RTXDI_CHECK(IsCellMarked(occupancyMask, int(cellList[listIndex])));
+            if (listIndex > 0)
+                RTXDI_CHECK(cellList[listIndex] > cellList[listIndex - 1]);
+        }
+
+        const std::vector<uint32_t> slotBuildCount = SimulateCellListBuild(cellList, listedCellCount, cellCount);
+
+        uint32_t wrongSlots = 0;
+        for (uint32_t cellIndex = 0; cellIndex < cellCount; cellIndex++)
+        {
+            const uint32_t expectedCount = IsCellMarked(occupancyMask, int(cellIndex)) ? 1 : 0;
+            for (uint32_t slot = 0; slot < c_LightsPerCell; slot++)
+                wrongSlots += (slotBuildCount[size_t(cellIndex) * c_LightsPerCell + slot] != expectedCount) ? 1 : 0;
+        }
+        RTXDI_CHECK_EQUAL(wrongSlots, 0u);
+    }
+
+    struct CoverageStats
+    {
+        uint64_t reachedCells = 0;
+        uint64_t missedCells = 0;
+    };
+
+    // Marks the cells of random surfaces, and looks up the cells from jittered positions around them, like
+    // RTXDI_SampleLocalLightsFromReGIR does. Returns how many lookups reached an unmarked cell, which the
+    // occupied-only build would have left stale while the full build would have refreshed it.
+    CoverageStats CheckLookupsReachMarkedCells(const ReGIRSetup& setup, ReGIRMode mode, float extent, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        const uint32_t cellCount = setup.context->GetReGIRCellCount();
+        const float3& center = setup.frame.regirCenter;
+
+        CoverageStats stats;
+        std::vector<uint32_t> occupancyMask(setup.context->GetReGIROccupancyMaskSize(), 0);
+
+        for (int surface = 0; surface < 100; surface++)
+        {
+            const float3 position = {
+                center.x + (uniform(rng) * 2.f - 1.f) * extent,
+                center.y + (uniform(rng) * 2.f - 1.f) * extent,
+                center.z + (uniform(rng) * 2.f - 1.f) * extent };
+
+            std::fill(occupancyMask.begin(), occupancyMask.end(), 0);
+            ReGIRMarkOccupiedCells(setup.params, mode, position, occupancyMask.data());
+
+            // The padding bits of the last mask element are never set
+            if (cellCount % 32 != 0)
+                RTXDI_CHECK_EQUAL(occupancyMask.back() >> (cellCount % 32), 0u);
+
+            const float jitterScale = ReGIRGetJitterScale(setup.params, mode, position);
+            for (int lookup = 0; lookup < 500; lookup++)
+            {
+                const float3 samplePosition = {
+                    position.x + (uniform(rng) - 0.5f) * jitterScale,
+                    position.y + (uniform(rng) - 0.5f) * jitterScale,
+                    position.z + (uniform(rng) - 0.5f) * jitterScale };
+
+                const int cellIndex = ReGIRWorldPosToCellIndex(setup.params, mode, samplePosition);
+                if (cellIndex < 0)
+                    continue;
+
+                RTXDI_CHECK(uint32_t(cellIndex) < cellCount);
+                stats.reachedCells++;
+                stats.missedCells += IsCellMarked(occupancyMask, cellIndex) ? 0 : 1;
+            }
+
+            if (surface % 10 == 0)
+                CheckCompactedBuild(occupancyMask, cellCount);
+        }
+
+        return stats;
+    }
+}
+
+RTXDI_TEST(ReGIROccupancy_GridMarksAllReachableCells)
+{
+    std::mt19937 rng(1);
+
+    // The grid centers are not multiples of the cell size, to cover the AlignGrid wrap of negative cell coordinates
+    for (ReGIRMode mode : { ReGIRMode::Grid, ReGIRMode::AlignGrid })
+    for (float jitter : { 0.f, 0.5f, 1.f, 2.5f })
+    for (float centerOffset : { 0.f, -13.7f, 101.3f })
+    {
+        const ReGIRSetup setup = CreateSetup(mode, { 8, 5, 7 }, jitter, { centerOffset, centerOffset * 0.5f, -centerOffset });
+        const CoverageStats stats = CheckLookupsReachMarkedCells(setup, mode, 14.f, rng);
+
+        RTXDI_CHECK(stats.reachedCells > 0);
+        RTXDI_CHECK_EQUAL(stats.missedCells, 0u);
+    }
+}
+
+RTXDI_TEST(ReGIROccupancy_OnionMarksMostReachableCells)
+{
+    std::mt19937 rng(2);
+
+    // The onion mode marks a point lattice in the jitter box, spaced for the cell size at the surface, so it misses
+    // some of the smaller cells closer to the center. The box spans more layers with a larger jitter.
+    const struct { float jitter; double maxMissRate; } cases[] = { { 0.5f, 0.01 }, { 1.f, 0.01 }, { 2.5f, 0.1 } };
+
+    for (const auto& testCase : cases)
+    {
+        const ReGIRSetup setup = CreateSetup(ReGIRMode::Onion, { 8, 5, 7 }, testCase.jitter, { -13.7f, 2.f, 40.f });
+        const CoverageStats stats = CheckLookupsReachMarkedCells(setup, ReGIRMode::Onion, 150.f, rng);
+
+        RTXDI_CHECK(stats.reachedCells > 0);
+        RTXDI_CHECK(double(stats.missedCells) <= testCase.maxMissRate * double(stats.reachedCells));
+    }
+}
+
+RTXDI_TEST(ReGIROccupancy_FullMaskMatchesFullBuild)
+{
+    // More than 65535 cells, so that the cell list build wraps into a second row of groups
+    const ReGIRSetup setup = CreateSetup(ReGIRMode::Grid, { 64, 32, 40 }, 1.f, { 0.f, 0.f, 0.f });
+    const uint32_t cellCount = setup.context->GetReGIRCellCount();
+    RTXDI_CHECK(cellCount > 65535);
+
+    std::vector<uint32_t> occupancyMask(setup.context->GetReGIROccupancyMaskSize(), ~0u);
+    if (cellCount % 32 != 0)
+        occupancyMask.back() = (1u << (cellCount % 32)) - 1;
+
+    CheckCompactedBuild(occupancyMask, cellCount);
+
+    uint32_t groupsY = 0;
+    uint32_t groupsZ = 0;
+    ReGIRGetCellListDispatchSize(cellCount, groupsY, groupsZ);
+    RTXDI_CHECK_EQUAL(groupsY, 65535u);
+    RTXDI_CHECK_EQUAL(groupsZ, 2u);
+}
+
+RTXDI_TEST(ReGIROccupancy_EmptyMask)
+{
+    const ReGIRSetup setup = CreateSetup(ReGIRMode::Onion, { 8, 5, 7 }, 1.f, { 0.f, 0.f, 0.f });
+    const uint32_t cellCount = setup.context->GetReGIRCellCount();
+
+    const std::vector<uint32_t> occupancyMask(setup.context->GetReGIROccupancyMaskSize(), 0);
+    std::vector<uint32_t> cellList(cellCount, ~0u);
+    RTXDI_CHECK_EQUAL(ReGIRCompactOccupiedCells(cellCount, occupancyMask.data(), cellList.data()), 0u);
+
+    uint32_t groupsY = 1;
+    uint32_t groupsZ = 1;
+    ReGIRGetCellListDispatchSize(0, groupsY, groupsZ);
+    RTXDI_CHECK_EQUAL(groupsY, 0u);
+    RTXDI_CHECK_EQUAL(groupsZ, 0u);
+
+    CheckCompactedBuild(occupancyMask, cellCount);
+}
@@ -0,0 +1,161 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    uint32_t AsUint(float f)
+    {
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+
+    float AsFloat(uint32_t u)
+    {
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    RTXDI_ResamplingRuntimeParameters CreateOnionParameters(uint32_t detailLayers, uint32_t coverageLayers, float cellSize)
+    {
+        ContextParameters contextParams;
+        contextParams.RenderWidth = 64;
+        contextParams.RenderHeight = 64;
+        contextParams.ReGIR.Mode = ReGIRMode::Onion;
+        contextParams.ReGIR.OnionDetailLayers = detailLayers;
+        contextParams.ReGIR.OnionCoverageLayers = coverageLayers;
+
+        FrameParameters frame;
+        frame.regirCellSize = cellSize;
+
+        Context context(contextParams);
+        RTXDI_ResamplingRuntimeParameters params{};
+        context.FillRuntimeParameters(params, frame);
+        return params;
+    }
+
+    // Adds the floats within 'ulps' steps of 'value', so that both sides of every table boundary are tested
+    void AddNeighbors(std::vector<float>& values, float value, int ulps)
+    {
+        for (int offset = -ulps; offset <= ulps; offset++)
+            values.push_back(AsFloat(uint32_t(int64_t(AsUint(value)) + offset)));
+    }
+
+    void CheckLayerLookup(const RTXDI_ReGIROnionParameters& onion, std::mt19937& rng)
+    {
+        const float innerRadius = onion.layers[0].innerRadius;
+        const float outerRadius = onion.layers[onion.numLayerGroups - 1].outerRadius;
+
+        // The table must cover some layers, or the test would only compare the reference with itself
+        RTXDI_CHECK(onion.radiusBucketCount > 0);
+        RTXDI_CHECK(onion.tableLayerCount > 0);
+
+        std::vector<float> radii;
+        for (uint32_t layer = 0; layer < onion.tableLayerCount; layer++)
+            AddNeighbors(radii, onion.layerOuterRadius[layer / 4][layer % 4], 3);
+        for (uint32_t layerGroupIndex = 0; layerGroupIndex < onion.numLayerGroups; layerGroupIndex++)
+            AddNeighbors(radii, onion.layers[layerGroupIndex].outerRadius, 3);
+        for (uint32_t bucket = 0; bucket <= onion.radiusBucketCount; bucket++)
+            AddNeighbors(radii, AsFloat((onion.radiusBucketBase + bucket) << RTXDI_ONION_RADIUS_BUCKET_SHIFT), 2);
+        AddNeighbors(radii, innerRadius, 2);
+
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        for (int sample = 0; sample < 100000; sample++)
+            radii.push_back(innerRadius * powf(outerRadius / innerRadius, uniform(rng)));
+
+        uint32_t testedRadii = 0;
+        uint32_t mismatches = 0;
+        for (float r : radii)
+        {
+            // The lookup is only used within the onion, see RTXDI_ReGIR_WorldPosToCellIndex
+            if (!(r > innerRadius && r <= outerRadius))
+                continue;
+
+            testedRadii++;
+            if (ReGIROnionRadiusToLayer(onion, r) != ReGIROnionReferenceRadiusToLayer(onion, r))
+                mismatches++;
+        }
+
+        RTXDI_CHECK(testedRadii > 100000);
+        RTXDI_CHECK_EQUAL(mismatches, 0u);
+    }
+
+    void CheckRingLookup(const RTXDI_ReGIROnionParameters& onion, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        for (uint32_t layerGroupIndex = 0; layerGroupIndex < onion.numLayerGroups; layerGroupIndex++)
+        {
+            const RTXDI_OnionLayerGroup& layerGroup = onion.layers[layerGroupIndex];
+
+            std::vector<float> values = { 0.f, 1.f };
+            for (int ringIndex = 0; ringIndex < layerGroup.ringCount; ringIndex++)
+            {
+                const int ring = layerGroup.ringOffset + ringIndex;
+                AddNeighbors(values, onion.ringThresholds[ring / 4][ring % 4], 3);
+            }
+            for (uint32_t bucket = 1; bucket < RTXDI_ONION_RING_BUCKETS; bucket++)
+                AddNeighbors(values, float(bucket) / float(RTXDI_ONION_RING_BUCKETS), 2);
+            for (int sample = 0; sample < 20000; sample++)
+                values.push_back(uniform(rng));
+
+            uint32_t mismatches = 0;
+            for (float absSinElevation : values)
+            {
+                if (!(absSinElevation >= 0.f && absSinElevation <= 1.f))
+                    continue;
+
+                const uint32_t ring = ReGIROnionRing(onion, layerGroupIndex, absSinElevation);
+                RTXDI_CHECK(int(ring) < layerGroup.ringCount);
+                if (ring != ReGIROnionReferenceRing(layerGroup, absSinElevation))
+                    mismatches++;
+            }
+
+            RTXDI_CHECK_EQUAL(mismatches, 0u);
+        }
+    }
+}
+
+RTXDI_TEST(ReGIROnion_LayerTableMatchesReference)
+{
+    std::mt19937 rng(1);
+
+    for (uint32_t detailLayers : { 1u, 2u, 5u, 8u })
+    for (uint32_t coverageLayers : { 0u, 10u, 60u })
+    for (float cellSize : { 0.3f, 2.5f, 17.f })
+    {
+        const RTXDI_ResamplingRuntimeParameters params = CreateOnionParameters(detailLayers, coverageLayers, cellSize);
+        CheckLayerLookup(params.regirOnion, rng);
+    }
+}
+
+RTXDI_TEST(ReGIROnion_RingTableMatchesReference)
+{
+    std::mt19937 rng(2);
+
+    for (uint32_t detailLayers : { 1u, 2u, 5u, 8u })
+    for (float cellSize : { 0.3f, 2.5f, 17.f })
+    {
+        const RTXDI_ResamplingRuntimeParameters params = CreateOnionParameters(detailLayers, 10, cellSize);
+        CheckRingLookup(params.regirOnion, rng);
+    }
+}
@@ -0,0 +1,110 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    ContextParameters CreateContextParameters(ReGIRMode mode, const uint3& gridSize)
+    {
+        ContextParameters params;
+        params.RenderWidth = 64;
+        params.RenderHeight = 64;
+        params.ReGIR.Mode = mode;
+        params.ReGIR.GridSize = gridSize;
+        return params;
+    }
+
+    // Every window of 'refreshInterval' consecutive frames, starting anywhere, must rebuild every cell exactly once
+    void CheckRefreshCoversCellsOnce(const Context& context, uint32_t refreshInterval)
+    {
+        const uint32_t cellCount = context.GetReGIRCellCount();
+        const uint32_t groupCount = context.GetReGIRRefreshGroupCount(refreshInterval);
+        const uint32_t window = std::max(refreshInterval, 1u);
+
+        RTXDI_CHECK_EQUAL(groupCount, window);
+
+        uint32_t minGroupSize = ~0u;
+        uint32_t maxGroupSize = 0;
+
+        for (uint32_t firstFrame : { 0u, 1u, 17u, window - 1, 1000003u })
+        {
+            std::vector<uint32_t> refreshCount(cellCount, 0);
+
+            for (uint32_t frame = firstFrame; frame < firstFrame + window; frame++)
+            {
+                const ReGIRCellRange range = context.GetReGIRCellRefreshRange(frame, refreshInterval);
+                RTXDI_CHECK(range.firstCell + range.cellCount <= cellCount);
+                minGroupSize = std::min(minGroupSize, range.cellCount);
+                maxGroupSize = std::max(maxGroupSize, range.cellCount);
+
+                for (uint32_t cell = range.firstCell; cell < std::min(range.firstCell + range.cellCount, cellCount); cell++)
+                    refreshCount[cell]++;
+            }
+
+            uint32_t cellsNotRefreshedOnce = 0;
+            for (uint32_t count : refreshCount)
+                cellsNotRefreshedOnce += (count != 1) ? 1 : 0;
+
+            RTXDI_CHECK_EQUAL(cellsNotRefreshedOnce, 0u);
+        }
+
+        // The groups are balanced
+        RTXDI_CHECK(maxGroupSize - minGroupSize <= 1);
+    }
+}
+
+RTXDI_TEST(ReGIRRefresh_GridCellsRefreshedOncePerInterval)
+{
+    // Cell counts that are prime, a power of two, and smaller than some intervals
+    const uint3 gridSizes[] = { { 1, 1, 1 }, { 7, 1, 1 }, { 2, 3, 5 }, { 10, 10, 10 }, { 16, 16, 16 } };
+    const uint32_t intervals[] = { 0, 1, 2, 3, 5, 7, 8, 29, 30, 31, 64, 100, 999, 1000, 1001, 4097 };
+
+    for (const uint3& gridSize : gridSizes)
+    {
+        Context context(CreateContextParameters(ReGIRMode::Grid, gridSize));
+        RTXDI_CHECK_EQUAL(context.GetReGIRCellCount(), gridSize.x * gridSize.y * gridSize.z);
+
+        for (uint32_t interval : intervals)
+            CheckRefreshCoversCellsOnce(context, interval);
+    }
+}
+
+RTXDI_TEST(ReGIRRefresh_OnionCellsRefreshedOncePerInterval)
+{
+    Context context(CreateContextParameters(ReGIRMode::Onion, { 16, 16, 16 }));
+    const uint32_t cellCount = context.GetReGIRCellCount();
+    RTXDI_CHECK(cellCount > 0);
+
+    for (uint32_t interval : { 2u, 3u, 7u, 16u, 100u, cellCount - 1, cellCount, cellCount + 1, 2 * cellCount + 3 })
+        CheckRefreshCoversCellsOnce(context, interval);
+}
+
+RTXDI_TEST(ReGIRRefresh_NotAmortized)
+{
+    // The hash grid is rebuilt entirely on every frame
+    Context hashGridContext(CreateContextParameters(ReGIRMode::HashGrid, { 16, 16, 16 }));
+    RTXDI_CHECK_EQUAL(hashGridContext.GetReGIRRefreshGroupCount(8), 1u);
+
+    const ReGIRCellRange hashGridRange = hashGridContext.GetReGIRCellRefreshRange(5, 8);
+    RTXDI_CHECK_EQUAL(hashGridRange.firstCell, 0u);
+    RTXDI_CHECK_EQUAL(hashGridRange.cellCount, hashGridContext.GetReGIRCellCount());
+
+    Context disabledContext(CreateContextParameters(ReGIRMode::Disabled, { 16, 16, 16 }));
+    RTXDI_CHECK_EQUAL(disabledContext.GetReGIRRefreshGroupCount(8), 1u);
+    RTXDI_CHECK_EQUAL(disabledContext.GetReGIRCellRefreshRange(5, 8).cellCount, 0u);
+}
@@ -0,0 +1,150 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    const uint32_t c_NumReservoirArrays = 3;
+
+    // Maps every reservoir position of every view and array through ReservoirPositionToPointer and checks that
+    // no two positions share an element and that all elements are inside the buffer. Returns the number of used elements.
+    uint32_t CheckLayoutIsInjective(const ContextParameters& params)
+    {
+        Context context(params);
+
+        const uint32_t reservoirWidth = (params.CheckerboardSamplingMode == CheckerboardMode::Off)
+            ? params.RenderWidth
+            : (params.RenderWidth + 1) / 2;
+        const uint32_t elementCount = context.GetReservoirBufferElementCount() * c_NumReservoirArrays;
+
+        std::vector<uint8_t> used(elementCount, 0);
+        uint32_t usedCount = 0;
+
+        for (uint32_t viewIndex = 0; viewIndex < params.ViewCount; viewIndex++)
+        {
+            FrameParameters frame;
+            frame.viewIndex = viewIndex;
+
+            RTXDI_ResamplingRuntimeParameters runtimeParams{};
+            context.FillRuntimeParameters(runtimeParams, frame);
+
+            for (uint32_t arrayIndex = 0; arrayIndex < c_NumReservoirArrays; arrayIndex++)
+            {
+                for (uint32_t y = 0; y < params.RenderHeight; y++)
+                {
+                    for (uint32_t x = 0; x < reservoirWidth; x++)
+                    {
+                        const uint32_t pointer = ReservoirPositionToPointer(runtimeParams, x, y, arrayIndex);
+
+                        RTXDI_CHECK(pointer < elementCount);
+                        if (pointer >= elementCount)
+                            continue;
+
+                        RTXDI_CHECK(!used[pointer]);
+                        if (!used[pointer])
+                            usedCount++;
+                        used[pointer] = 1;
+                    }
+                }
+            }
+        }
+
+        return usedCount;
+    }
+}
+
+RTXDI_TEST(ReservoirLayout_IsInjective)
+{
+    const uint32_t blockSizes[] = { 8, 16, 32 };
+    const ReservoirBlockLayout layouts[] = { ReservoirBlockLayout::RowMajor, ReservoirBlockLayout::ZCurve };
+    const CheckerboardMode checkerboardModes[] = { CheckerboardMode::Off, CheckerboardMode::Black, CheckerboardMode::White };
+
+    // Odd sizes leave partially covered blocks on the right and bottom edges
+    const uint32_t renderSizes[][2] = { { 1, 1 }, { 7, 5 }, { 33, 17 }, { 127, 65 }, { 641, 359 } };
+
+    for (uint32_t blockSize : blockSizes)
+    for (ReservoirBlockLayout layout : layouts)
+    for (CheckerboardMode checkerboardMode : checkerboardModes)
+    for (const auto& renderSize : renderSizes)
+    for (uint32_t viewCount = 1; viewCount <= 2; viewCount++)
+    {
+        ContextParameters params;
+        params.RenderWidth = renderSize[0];
+        params.RenderHeight = renderSize[1];
+        params.ReservoirBlockSize = blockSize;
+        params.ReservoirLayout = layout;
+        params.CheckerboardSamplingMode = checkerboardMode;
+        params.ViewCount = viewCount;
+
+        CheckLayoutIsInjective(params);
+    }
+}
+
+RTXDI_TEST(ReservoirLayout_FullBlocksAreBijective)
+{
+    const uint32_t blockSizes[] = { 8, 16, 32 };
+    const ReservoirBlockLayout layouts[] = { ReservoirBlockLayout::RowMajor, ReservoirBlockLayout::ZCurve };
+
+    for (uint32_t blockSize : blockSizes)
+    for (ReservoirBlockLayout layout : layouts)
+    for (uint32_t checkerboard = 0; checkerboard < 2; checkerboard++)
+    {
+        // When the render size is a multiple of the block size, there is no padding and every element is used
+        ContextParameters params;
+        params.RenderWidth = blockSize * 5 * (checkerboard ? 2 : 1);
+        params.RenderHeight = blockSize * 3;
+        params.ReservoirBlockSize = blockSize;
+        params.ReservoirLayout = layout;
+        params.CheckerboardSamplingMode = checkerboard ? CheckerboardMode::Black : CheckerboardMode::Off;
+        params.ViewCount = 2;
+
+        const uint32_t usedCount = CheckLayoutIsInjective(params);
+
+        Context context(params);
+        RTXDI_CHECK_EQUAL(usedCount, context.GetReservoirBufferElementCount() * c_NumReservoirArrays);
+    }
+}
+
+RTXDI_TEST(ReservoirLayout_ZCurveKeepsQuadsTogether)
+{
+    ContextParameters params;
+    params.RenderWidth = 64;
+    params.RenderHeight = 64;
+    params.ReservoirLayout = ReservoirBlockLayout::ZCurve;
+
+    for (uint32_t blockSize : { 8u, 16u, 32u })
+    {
+        params.ReservoirBlockSize = blockSize;
+
+        Context context(params);
+        RTXDI_ResamplingRuntimeParameters runtimeParams{};
+        context.FillRuntimeParameters(runtimeParams, FrameParameters());
+
+        // Every aligned 2x2 quad occupies 4 consecutive elements in the Z-curve order
+        for (uint32_t y = 0; y < params.RenderHeight; y += 2)
+        {
+            for (uint32_t x = 0; x < params.RenderWidth; x += 2)
+            {
+                const uint32_t base = ReservoirPositionToPointer(runtimeParams, x, y, 0);
+                RTXDI_CHECK_EQUAL(base % 4, 0u);
+                RTXDI_CHECK_EQUAL(ReservoirPositionToPointer(runtimeParams, x + 1, y, 0), base + 1);
+                RTXDI_CHECK_EQUAL(ReservoirPositionToPointer(runtimeParams, x, y + 1, 0), base + 2);
+                RTXDI_CHECK_EQUAL(ReservoirPositionToPointer(runtimeParams, x + 1, y + 1, 0), base + 3);
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Minimal test framework for the host-side code, so that the tests don't need any third-party libraries.
+// Tests are registered with RTXDI_TEST and run by TestMain.cpp. A failed check marks the current test
+// as failed and prints the location, but the test keeps running to report all failures at once.
+
+#pragma once
+
+#include <cmath>
+
+namespace rtxdi::test
+{
+    typedef void (*TestFunction)();
+
+    struct TestRegistration
+    {
+        TestRegistration(const char* name, TestFunction function);
+    };
+
+    void ReportFailure(const char* file, int line, const char* format, ...);
+}
+
+#define RTXDI_TEST(name) \
+    static void name(); \
+    static rtxdi::test::TestRegistration name##_Registration(#name, name); \
+    static void name()
+
+#define RTXDI_CHECK(condition) \
+    do { \
+        if (!(condition)) \
+            rtxdi::test::ReportFailure(__FILE__, __LINE__, "%s", #condition); \
+    } while (false)
+
+#define RTXDI_CHECK_EQUAL(actual, expected) \
+    do { \
+        const auto actualValue_ = (actual); \
+        const auto expectedValue_ = (expected); \
+        if (!(actualValue_ == expectedValue_)) \
+            rtxdi::test::ReportFailure(__FILE__, __LINE__, "%s == %s (%.9g vs. %.9g)", #actual, #expected, \
+                double(actualValue_), double(expectedValue_)); \
+    } while (false)
+
+#define RTXDI_CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        const double actualValue_ = double(actual); \
+        const double expectedValue_ = double(expected); \
+        if (!(std::abs(actualValue_ - expectedValue_) <= double(tolerance))) \
+            rtxdi::test::ReportFailure(__FILE__, __LINE__, "%s ~= %s (%.9g vs. %.9g, tolerance %.3g)", #actual, #expected, \
+                actualValue_, expectedValue_, double(tolerance)); \
+    } while (false)
@@ -0,0 +1,96 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Runs all registered tests, or the tests whose name contains the substring given on the command line.
+// Returns a nonzero exit code if any test fails, which is what CTest checks.
+//
+// Usage: rtxdi-sdk-tests [<substring>]
+
+#include "TestFramework.h"
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct TestCase
+    {
+        const char* name;
+        rtxdi::test::TestFunction function;
+    };
+
+    // Function-local, so that the list exists before the static registrations in other files run
+    std::vector<TestCase>& GetTestCases()
+    {
+        static std::vector<TestCase> testCases;
+        return testCases;
+    }
+
+    uint32_t g_FailureCount = 0;
+
+    // Loops over many inputs can fail thousands of times, only the first few failures of a test are printed
+    const uint32_t c_MaxPrintedFailures = 10;
+}
+
+rtxdi::test::TestRegistration::TestRegistration(const char* name, TestFunction function)
+{
+    GetTestCases().push_back({ name, function });
+}
+
+void rtxdi::test::ReportFailure(const char* file, int line, const char* format, ...)
+{
+    if (g_FailureCount++ >= c_MaxPrintedFailures)
+        return;
+
+    printf("%s(%d): check failed: ", file, line);
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    const std::string filter = (argc > 1) ? argv[1] : "";
+
+    uint32_t testCount = 0;
+    uint32_t failedTestCount = 0;
+
+    for (const TestCase& testCase : GetTestCases())
+    {
+        if (!filter.empty() && std::string(testCase.name).find(filter) == std::string::npos)
+            continue;
+
+        g_FailureCount = 0;
+        testCase.function();
+        testCount++;
+
+        if (g_FailureCount == 0)
+        {
+            printf("[ OK ] %s\n", testCase.name);
+        }
+        else
+        {
+            printf("[FAIL] %s: %u failed checks\n", testCase.name, g_FailureCount);
+            failedTestCount++;
+        }
+        fflush(stdout);
+    }
+
+    printf("%u of %u tests passed\n", testCount - failedTestCount, testCount);
+
+    return (failedTestCount == 0) ? 0 : 1;
+}
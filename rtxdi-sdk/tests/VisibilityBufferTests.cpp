@@ -0,0 +1,180 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace rtxdi;
+
+namespace
+{
+    struct VisibilityCounts
+    {
+        uint32_t visible = 0;
+        uint32_t total = 0;
+    };
+
+    ContextParameters GetVisibilityContextParameters(VisibilityBufferLayout layout)
+    {
+        ContextParameters params;
+        params.RenderWidth = 64;
+        params.RenderHeight = 64;
+        params.ReGIR.Mode = ReGIRMode::Grid;
+        params.ReGIR.GridSize = { 4, 4, 2 };
+        params.VisibilityLayout = layout;
+        params.VisibilityLightsPerCell = 8;
+        return params;
+    }
+}
+
+RTXDI_TEST(VisibilityBuffer_DenseIndexing)
+{
+    const uint32_t numEmitters = 37;
+
+    Context context(GetVisibilityContextParameters(VisibilityBufferLayout::Dense));
+    FrameParameters frame;
+    frame.numEmissionThing = numEmitters;
+
+    RTXDI_ResamplingRuntimeParameters runtimeParams{};
+    context.FillRuntimeParameters(runtimeParams, frame);
+
+    const uint32_t cellCount = context.GetReGIRCellCount();
+    std::vector<uint32_t> buffer(size_t(context.GetVisibilityBufferElementCount(numEmitters)), 0);
+    RTXDI_CHECK_EQUAL(buffer.size(), size_t(cellCount) * numEmitters * 2);
+
+    // Every (cell, emitter) pair has its own pair of elements
+    std::vector<uint8_t> used(buffer.size(), 0);
+    for (uint32_t cell = 0; cell < cellCount; cell++)
+    {
+        for (uint32_t emitter = 0; emitter < numEmitters; emitter++)
+        {
+            const int element = VisibilityBufferFindEntry(runtimeParams, buffer.data(), int(cell), emitter, true);
+            RTXDI_CHECK(element >= 0 && size_t(element) + 1 < buffer.size());
+            if (element < 0 || size_t(element) + 1 >= buffer.size())
+                continue;
+
+            RTXDI_CHECK(!used[element] && !used[element + 1]);
+            used[element] = used[element + 1] = 1;
+        }
+
+        RTXDI_CHECK_EQUAL(VisibilityBufferFindEntry(runtimeParams, buffer.data(), int(cell), numEmitters, true), -1);
+    }
+
+    RTXDI_CHECK_EQUAL(VisibilityBufferFindEntry(runtimeParams, buffer.data(), -1, 0, true), -1);
+    RTXDI_CHECK_EQUAL(VisibilityBufferFindEntry(runtimeParams, buffer.data(), int(cellCount), 0, true), -1);
+
+    // Finding the entries doesn't write anything with the dense layout
+    for (uint32_t value : buffer)
+        RTXDI_CHECK_EQUAL(value, 0u);
+
+    RecordVisibility(runtimeParams, buffer.data(), 3, 5, true);
+    RecordVisibility(runtimeParams, buffer.data(), 3, 5, false);
+    RecordVisibility(runtimeParams, buffer.data(), 3, 5, true);
+
+    uint32_t visible = 0, total = 0;
+    RTXDI_CHECK(LoadVisibility(runtimeParams, buffer.data(), 3, 5, visible, total));
+    RTXDI_CHECK_EQUAL(visible, 2u);
+    RTXDI_CHECK_EQUAL(total, 3u);
+    RTXDI_CHECK(!LoadVisibility(runtimeParams, buffer.data(), 3, 6, visible, total));
+    RTXDI_CHECK(!LoadVisibility(runtimeParams, buffer.data(), 4, 5, visible, total));
+}
+
+RTXDI_TEST(VisibilityBuffer_CompactTracksFirstEmitters)
+{
+    const ContextParameters params = GetVisibilityContextParameters(VisibilityBufferLayout::Compact);
+    const uint32_t lightsPerCell = params.VisibilityLightsPerCell;
+    const uint32_t numEmitters = 40;
+
+    Context context(params);
+    RTXDI_ResamplingRuntimeParameters runtimeParams{};
+    context.FillRuntimeParameters(runtimeParams, FrameParameters());
+
+    const uint32_t cellCount = context.GetReGIRCellCount();
+    std::vector<uint32_t> buffer(size_t(context.GetVisibilityBufferElementCount(numEmitters)), RTXDI_VISIBILITY_EMPTY_KEY);
+    RTXDI_CHECK_EQUAL(buffer.size(), size_t(cellCount) * lightsPerCell * 2);
+
+    // Reference: each cell tracks the first 'lightsPerCell' emitters recorded in it
+    std::vector<std::map<uint32_t, VisibilityCounts>> reference(cellCount);
+
+    std::mt19937 rng(3);
+    for (int i = 0; i < 20000; i++)
+    {
+        const uint32_t cell = rng() % cellCount;
+        const uint32_t emitter = rng() % numEmitters;
+        const bool visible = (rng() % 3) != 0;
+
+        RecordVisibility(runtimeParams, buffer.data(), int(cell), emitter, visible);
+
+        auto& cellReference = reference[cell];
+        auto it = cellReference.find(emitter);
+        if (it == cellReference.end())
+        {
+            if (cellReference.size() >= lightsPerCell)
+                continue;
+            it = cellReference.insert({ emitter, VisibilityCounts() }).first;
+        }
+
+        it->second.total++;
+        if (visible)
+            it->second.visible++;
+    }
+
+    for (uint32_t cell = 0; cell < cellCount; cell++)
+    {
+        for (uint32_t emitter = 0; emitter < numEmitters; emitter++)
+        {
+            uint32_t visible = 0, total = 0;
+            const bool found = LoadVisibility(runtimeParams, buffer.data(), int(cell), emitter, visible, total);
+
+            auto it = reference[cell].find(emitter);
+            if (it == reference[cell].end())
+            {
+                RTXDI_CHECK(!found);
+                continue;
+            }
+
+            RTXDI_CHECK(found);
+            RTXDI_CHECK_EQUAL(visible, it->second.visible);
+            RTXDI_CHECK_EQUAL(total, it->second.total);
+
+            // The entry stays within the cell's part of the buffer
+            const int element = VisibilityBufferFindEntry(runtimeParams, buffer.data(), int(cell), emitter, false);
+            RTXDI_CHECK(element >= int(cell * lightsPerCell * 2) && element < int((cell + 1) * lightsPerCell * 2));
+        }
+    }
+}
+
+RTXDI_TEST(VisibilityBuffer_CompactCountersSaturate)
+{
+    Context context(GetVisibilityContextParameters(VisibilityBufferLayout::Compact));
+    RTXDI_ResamplingRuntimeParameters runtimeParams{};
+    context.FillRuntimeParameters(runtimeParams, FrameParameters());
+
+    std::vector<uint32_t> buffer(size_t(context.GetVisibilityBufferElementCount(0)), RTXDI_VISIBILITY_EMPTY_KEY);
+
+    for (uint32_t i = 0; i < RTXDI_VISIBILITY_MAX_COUNT + 1000; i++)
+        RecordVisibility(runtimeParams, buffer.data(), 0, 12, (i % 2) == 0);
+
+    uint32_t visible = 0, total = 0;
+    RTXDI_CHECK(LoadVisibility(runtimeParams, buffer.data(), 0, 12, visible, total));
+    RTXDI_CHECK_EQUAL(total, uint32_t(RTXDI_VISIBILITY_MAX_COUNT));
+    RTXDI_CHECK_EQUAL(visible, (uint32_t(RTXDI_VISIBILITY_MAX_COUNT) + 1) / 2);
+
+    // The saturated entry doesn't affect the other emitters of the cell
+    RecordVisibility(runtimeParams, buffer.data(), 0, 13, true);
+    RTXDI_CHECK(LoadVisibility(runtimeParams, buffer.data(), 0, 13, visible, total));
+    RTXDI_CHECK_EQUAL(visible, 1u);
+    RTXDI_CHECK_EQUAL(total, 1u);
+}
@@ -0,0 +1,45 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma pack_matrix(row_major)
+
+#include "RtxdiApplicationBridge.hlsli"
+
+#include <rtxdi/ResamplingFunctions.hlsli>
+
+// Allocates the ReGIR hash grid cells for the primary surfaces.
+// Each pixel inserts the cell containing its surface, and the cell containing a jittered copy
+// of the surface position, so that the neighbor cells reached by the sampling jitter get allocated too.
+[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
+void main(uint2 GlobalIndex : SV_DispatchThreadID)
+{
+    const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
+
+    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, params);
+
+    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+
+    if (!RAB_IsSurfaceValid(surface))
+        return;
+
+    RAB_RandomSamplerState rng = RAB_InitRandomSampler(pixelPosition, 9);
+
+    float3 worldPos = RAB_GetSurfaceWorldPos(surface);
+    RTXDI_ReGIR_HashGridInsert(params, worldPos);
+
+    float3 cellJitter = float3(
+        RAB_GetNextRandom(rng),
+        RAB_GetNextRandom(rng),
+        RAB_GetNextRandom(rng));
+    cellJitter -= 0.5;
+
+    float3 jitteredPos = worldPos + cellJitter * RTXDI_ReGIR_GetJitterScale(params, worldPos);
+    RTXDI_ReGIR_HashGridInsert(params, jitteredPos);
+}
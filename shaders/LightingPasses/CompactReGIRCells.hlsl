@@ -0,0 +1,39 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma pack_matrix(row_major)
+
+#include "RtxdiApplicationBridge.hlsli"
+
+#include <rtxdi/ResamplingFunctions.hlsli>
+
+// Appends the cells marked by MarkReGIRCells to the cell list, and computes the group counts
+// of the indirect PresampleReGIR dispatch. u_ReGIRCellCount holds:
+// [0] - number of listed cells;
+// [1] - groups per cell (X), written by the application;
+// [2], [3] - Y and Z group counts: each group row processes one cell, and the rows wrap every 65535 cells
+//            to stay within the dispatch size limits.
+// rtxdi::ReGIRCompactOccupiedCells and rtxdi::ReGIRGetCellListDispatchSize are the host-side mirror of this pass.
+[numthreads(256, 1, 1)]
+void main(uint GlobalIndex : SV_DispatchThreadID)
+{
+    if (GlobalIndex >= g_Const.regirCellCount)
+        return;
+
+    if (!RTXDI_ReGIR_IsCellOccupied(int(GlobalIndex)))
+        return;
+
+    uint listIndex;
+    InterlockedAdd(u_ReGIRCellCount[0], 1, listIndex);
+    u_ReGIRCellList[listIndex] = GlobalIndex;
+
+    InterlockedMax(u_ReGIRCellCount[2], min(listIndex + 1, 65535));
+    InterlockedMax(u_ReGIRCellCount[3], listIndex / 65535 + 1);
+}
@@ -68,7 +68,7 @@ void RayGen()
     const RAB_Surface primarySurface = RAB_GetGBufferSurface(pixelPosition, false);
     
     const uint2 reservoirPosition = RTXDI_PixelPosToReservoirPos(pixelPosition, g_Const.runtimeParams);
-    const RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPosition, g_Const.shadeInputBufferIndex);
+    const RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPosition, g_Const.shadeInputBufferIndex, RAB_GetSurfaceWorldPos(primarySurface));
     
     float3 diffuse = 0;
     float3 specular = 0;
@@ -36,7 +36,7 @@ void RayGen()
     const RAB_Surface primarySurface = RAB_GetGBufferSurface(pixelPosition, false);
     
     const uint2 reservoirPosition = RTXDI_PixelPosToReservoirPos(pixelPosition, g_Const.runtimeParams);
-    RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPosition, g_Const.spatialInputBufferIndex);
+    RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPosition, g_Const.spatialInputBufferIndex, RAB_GetSurfaceWorldPos(primarySurface));
 
     if (RAB_IsSurfaceValid(primarySurface)) {
         RTXDI_GISpatialResamplingParameters sparams;
@@ -52,5 +52,5 @@ void RayGen()
         reservoir = RTXDI_GISpatialResampling(pixelPosition, primarySurface, reservoir, rng, sparams, g_Const.runtimeParams);
     }
 
-    RTXDI_StoreGIReservoir(reservoir, g_Const.runtimeParams, reservoirPosition, g_Const.spatialOutputBufferIndex);
+    RTXDI_StoreGIReservoir(reservoir, RAB_GetSurfaceWorldPos(primarySurface), g_Const.runtimeParams, reservoirPosition, g_Const.spatialOutputBufferIndex);
 }
@@ -0,0 +1,32 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma pack_matrix(row_major)
+
+#include "RtxdiApplicationBridge.hlsli"
+
+#include <rtxdi/ResamplingFunctions.hlsli>
+
+// Marks the ReGIR cells that can be reached from the primary surfaces, including the sampling jitter.
+// Only these cells are built by PresampleReGIR on this frame, see CompactReGIRCells.hlsl
+[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
+void main(uint2 GlobalIndex : SV_DispatchThreadID)
+{
+    const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
+
+    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, params);
+
+    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+
+    if (!RAB_IsSurfaceValid(surface))
+        return;
+
+    RTXDI_ReGIR_MarkOccupiedCells(params, RAB_GetSurfaceWorldPos(surface));
+}
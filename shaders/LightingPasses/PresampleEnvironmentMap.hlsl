@@ -17,11 +17,23 @@ void main(uint2 GlobalIndex : SV_DispatchThreadID)
 {    
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex.xy, 0);
 
-    RTXDI_PresampleEnvironmentMap(
-        rng,
-        t_EnvironmentPdfTexture,
-        g_Const.environmentPdfTextureSize,
-        GlobalIndex.y,
-        GlobalIndex.x,
-        g_Const.runtimeParams.environmentLightParams);
+    if (g_Const.environmentMapAliasTable)
+    {
+        RTXDI_PresampleEnvironmentMapFromAliasTable(
+            rng,
+            g_Const.environmentPdfTextureSize,
+            GlobalIndex.y,
+            GlobalIndex.x,
+            g_Const.runtimeParams.environmentLightParams);
+    }
+    else
+    {
+        RTXDI_PresampleEnvironmentMap(
+            rng,
+            t_EnvironmentPdfTexture,
+            g_Const.environmentPdfTextureSize,
+            GlobalIndex.y,
+            GlobalIndex.x,
+            g_Const.runtimeParams.environmentLightParams);
+    }
 }
\ No newline at end of file
@@ -17,11 +17,22 @@ void main(uint2 GlobalIndex : SV_DispatchThreadID)
 {
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex.xy, 0);
 
-    RTXDI_PresampleLocalLights(
-        rng,
-        t_LocalLightPdfTexture,
-        g_Const.localLightPdfTextureSize,
-        GlobalIndex.y,
-        GlobalIndex.x,
-        g_Const.runtimeParams);
+    if (g_Const.enableLocalLightAliasTable)
+    {
+        RTXDI_PresampleLocalLightsFromAliasTable(
+            rng,
+            GlobalIndex.y,
+            GlobalIndex.x,
+            g_Const.runtimeParams);
+    }
+    else
+    {
+        RTXDI_PresampleLocalLights(
+            rng,
+            t_LocalLightPdfTexture,
+            g_Const.localLightPdfTextureSize,
+            GlobalIndex.y,
+            GlobalIndex.x,
+            g_Const.runtimeParams);
+    }
 }
\ No newline at end of file
@@ -14,14 +14,76 @@
 
 #include <rtxdi/ResamplingFunctions.hlsli>
 
-[numthreads(256, 1, 1)]
+// Returns true if the light stored in the given ReGIR slot has been changed by PrepareLights on this frame.
+bool IsReGIRSlotLightDirty(uint lightSlot, RTXDI_ResamplingRuntimeParameters params)
+{
+    uint2 slotData = RTXDI_RIS_BUFFER[params.regirCommon.risBufferOffset + lightSlot];
+
+    // Empty samples are refreshed together with their cells
+    if (asfloat(slotData.y) <= 0)
+        return false;
+
+    uint localLightIndex = (slotData.x & RTXDI_LIGHT_INDEX_MASK) - params.localLightParams.firstLocalLight;
+
+    // The light has been removed from the end of the local light range
+    if (localLightIndex >= params.localLightParams.numLocalLights)
+        return true;
+
+    return (t_DirtyLocalLightMask[localLightIndex >> 5] & (1u << (localLightIndex & 31))) != 0;
+}
+
+#if REGIR_CELL_LIST
+
+// Occupancy-driven build: only the cells listed by CompactReGIRCells are built, through an indirect dispatch.
+// Each row of regirGroupsPerCell groups covers the light slots of one listed cell.
+[numthreads(RTXDI_GRID_BUILD_GROUP_SIZE, 1, 1)]
+void main(uint3 GroupId : SV_GroupID, uint ThreadIndex : SV_GroupIndex)
+{
+    const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
+
+    uint listIndex = GroupId.z * 65535 + GroupId.y;
+    if (listIndex >= u_ReGIRCellCount[0])
+        return;
+
+    uint slotInCell = GroupId.x * RTXDI_GRID_BUILD_GROUP_SIZE + ThreadIndex;
+    if (slotInCell >= params.regirCommon.lightsPerCell)
+        return;
+
+    uint lightSlot = u_ReGIRCellList[listIndex] * params.regirCommon.lightsPerCell + slotInCell;
+
+    RAB_RandomSamplerState rng = RAB_InitRandomSampler(uint2(lightSlot & 0xfff, lightSlot >> 12), 1);
+    RAB_RandomSamplerState coherentRng = RAB_InitRandomSampler(uint2(lightSlot >> 8, 0), 1);
+
+    RTXDI_PresampleLocalLightsForReGIR(rng, coherentRng, lightSlot, 
+        g_Const.numRegirBuildSamples, params);
+}
+
+#else
+
+[numthreads(RTXDI_GRID_BUILD_GROUP_SIZE, 1, 1)]
 void main(uint GlobalIndex : SV_DispatchThreadID)
 {
     const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
+
+    // The amortized build covers either the cells refreshed on this frame, or all cells when some lights have changed.
+    // Every slot holds an independent sample of its cell, so outside of the refreshed cells, only the slots
+    // that reference the changed lights need to be resampled.
+    if (GlobalIndex >= g_Const.regirBuildSlotCount)
+        return;
+
+    uint lightSlot = g_Const.regirBuildFirstSlot + GlobalIndex;
+
+    if (lightSlot - g_Const.regirRefreshFirstSlot >= g_Const.regirRefreshSlotCount)
+    {
+        if (!g_Const.regirCheckDirtyLights || !IsReGIRSlotLightDirty(lightSlot, params))
+            return;
+    }
     
-    RAB_RandomSamplerState rng = RAB_InitRandomSampler(uint2(GlobalIndex & 0xfff, GlobalIndex >> 12), 1);
-    RAB_RandomSamplerState coherentRng = RAB_InitRandomSampler(uint2(GlobalIndex >> 8, 0), 1);
+    RAB_RandomSamplerState rng = RAB_InitRandomSampler(uint2(lightSlot & 0xfff, lightSlot >> 12), 1);
+    RAB_RandomSamplerState coherentRng = RAB_InitRandomSampler(uint2(lightSlot >> 8, 0), 1);
 
-    RTXDI_PresampleLocalLightsForReGIR(rng, coherentRng, GlobalIndex, 
+    RTXDI_PresampleLocalLightsForReGIR(rng, coherentRng, lightSlot, 
         g_Const.numRegirBuildSamples, params);
-}
\ No newline at end of file
+}
+
+#endif
@@ -57,6 +57,8 @@ RaytracingAccelerationStructure PrevSceneBVH : register(t31);
 StructuredBuffer<InstanceData> t_InstanceData : register(t32);
 StructuredBuffer<GeometryData> t_GeometryData : register(t33);
 StructuredBuffer<MaterialConstants> t_MaterialConstants : register(t34);
+StructuredBuffer<RTXDI_AliasTableEntry> t_EnvironmentAliasTable : register(t35);
+Buffer<uint> t_DirtyLocalLightMask : register(t36);
 
 // RTXDI resources
 StructuredBuffer<PolymorphicLightInfo> t_LightDataBuffer : register(t20);
@@ -66,6 +68,9 @@ Texture2D t_EnvironmentPdfTexture : register(t23);
 Texture2D t_LocalLightPdfTexture : register(t24);
 StructuredBuffer<uint> t_GeometryInstanceToLight : register(t25);
 Buffer<uint> t_VisibleLightIndex : register(t26);
+StructuredBuffer<RTXDI_LightTreeNode> t_LightTreeNodes : register(t27);
+Buffer<uint> t_LightTreeTrails : register(t28);
+StructuredBuffer<RTXDI_AliasTableEntry> t_LocalLightAliasTable : register(t29);
 
 // Screen-sized UAVs
 RWStructuredBuffer<RTXDI_PackedReservoir> u_LightReservoirs : register(u0);
@@ -82,6 +87,10 @@ RWBuffer<uint4> u_RisLightDataBuffer : register(u11);
 RWBuffer<uint> u_RayCountBuffer : register(u12);
 RWStructuredBuffer<SecondaryGBufferData> u_SecondaryGBuffer : register(u13);
 RWBuffer<uint> u_GridVisibility : register(u14);
+RWBuffer<uint> u_ReGIRHashTable : register(u15);
+RWBuffer<uint> u_ReGIROccupancy : register(u16);
+RWBuffer<uint> u_ReGIRCellList : register(u17);
+RWBuffer<uint> u_ReGIRCellCount : register(u18);
 
 // Other
 ConstantBuffer<ResamplingConstants> g_Const : register(b0);
@@ -94,6 +103,12 @@ SamplerState s_EnvironmentSampler : register(s1);
 #define RTXDI_NEIGHBOR_OFFSETS_BUFFER t_NeighborOffsets
 #define RTXDI_GI_RESERVOIR_BUFFER u_GIReservoirs
 #define RTXDI_VISIBILITY_BUFFER u_GridVisibility
+#define RTXDI_REGIR_HASH_BUFFER u_ReGIRHashTable
+#define RTXDI_REGIR_OCCUPANCY_BUFFER u_ReGIROccupancy
+#define RTXDI_LIGHT_TREE_BUFFER t_LightTreeNodes
+#define RTXDI_LIGHT_TREE_TRAIL_BUFFER t_LightTreeTrails
+#define RTXDI_LOCAL_LIGHT_ALIAS_TABLE_BUFFER t_LocalLightAliasTable
+#define RTXDI_ENVIRONMENT_ALIAS_TABLE_BUFFER t_EnvironmentAliasTable
 
 #define IES_SAMPLER s_EnvironmentSampler
 
@@ -529,7 +544,12 @@ float RAB_EvaluateEnvironmentMapSamplingPdf(float3 L)
     float2 uv = RAB_GetEnvironmentMapRandXYFromDir(L);
 
     uint2 pdfTextureSize = g_Const.environmentPdfTextureSize.xy;
-    uint2 texelPosition = uint2(pdfTextureSize * uv);
+    uint2 texelPosition = min(uint2(pdfTextureSize * uv), pdfTextureSize - 1);
+
+    // Same scale as below: the texel selection probability times the number of texels
+    if (g_Const.environmentMapAliasTable)
+        return RTXDI_EvaluateEnvironmentAliasTablePdf(texelPosition, pdfTextureSize) * float(pdfTextureSize.x * pdfTextureSize.y);
+
     float texelValue = t_EnvironmentPdfTexture[texelPosition].r;
     
     int lastMipLevel = max(0, int(floor(log2(max(pdfTextureSize.x, pdfTextureSize.y)))) - 1);
@@ -549,6 +569,9 @@ float RAB_EvaluateEnvironmentMapSamplingPdf(float3 L)
 // Evaluates pdf for a particular light
 float RAB_EvaluateLocalLightSourcePdf(RTXDI_ResamplingRuntimeParameters params, uint lightIndex)
 {
+    if (g_Const.enableLocalLightAliasTable)
+        return RTXDI_EvaluateAliasTablePdf(lightIndex - params.localLightParams.firstLocalLight);
+
     uint2 pdfTextureSize = g_Const.localLightPdfTextureSize.xy;
     // verify
     uint2 texelPosition = RTXDI_LinearIndexToZCurve(lightIndex);
@@ -860,44 +883,21 @@ uint getLightIndex(uint instanceID, uint geometryIndex, uint primitiveIndex)
     return lightIndex;
 }
 
+// Returns the index of the emissive mesh or primitive light that contains the given light,
+// or -1 if the light is not in the current frame's part of the light buffer or is a free slot.
+// t_VisibleLightIndex is filled by PrepareLights.hlsl with one emitter index per light.
 int GetVisibilityBufferLightIndex(uint lightIndex)
 {
-    // Use binary search to find the task that EmissionMesh or Primitive Light Index
-    // int left = 0;
-    // int right = int(g_Const.numTasks) - 1;
-
-    // while (right >= left)
-    // {
-    //     int middle = (left + right) / 2;
-    //     task = t_TaskBuffer[middle];
-
-    //     int tri = int(dispatchThreadId) - int(task.lightBufferOffset); // signed
-
-    //     if (tri < 0)
-    //     {
-    //         // Go left
-    //         right = middle - 1;
-    //     }
-    //     else if (tri < (task.triangleCount & 0xFFF))
-    //     {
-    //         // Found it!
-    //         return true;
-    //     }
-    //     else
-    //     {
-    //         // Go right
-    //         left = middle + 1;
-    //     }
-    // }
+    // The infinite lights and the environment light are placed at the end of the light buffer half.
+    // Free slots store TASK_EMPTY_SLOTS, which converts to -1.
+    const RTXDI_EnvironmentLightRuntimeParameters envParams = g_Const.runtimeParams.environmentLightParams;
+    uint numLightsInBuffer = envParams.environmentLightIndex + envParams.environmentLightPresent - g_Const.currentFrameLightOffset;
 
     uint lightBufferOffset = lightIndex - g_Const.currentFrameLightOffset;
-    for(int n = 0; n < g_Const.numEmissionThing; n++)
-    {
-        if(lightBufferOffset < t_VisibleLightIndex[n])
-            return n;
-    }
+    if (lightBufferOffset >= numLightsInBuffer)
+        return -1;
 
-    return -1;
+    return int(t_VisibleLightIndex[lightBufferOffset]);
 }
 
 // Return true if anything was hit. If false, RTXDI will do environment map sampling
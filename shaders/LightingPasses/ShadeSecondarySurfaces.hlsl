@@ -174,7 +174,7 @@ void RayGen()
                 secondarySurface.normal, radiance, secondaryGBufferData.pdf);
         }
         uint2 reservoirPosition = RTXDI_PixelPosToReservoirPos(pixelPosition, g_Const.runtimeParams);
-        RTXDI_StoreGIReservoir(reservoir, g_Const.runtimeParams, reservoirPosition, g_Const.initialOutputBufferIndex);
+        RTXDI_StoreGIReservoir(reservoir, RAB_GetSurfaceWorldPos(primarySurface), g_Const.runtimeParams, reservoirPosition, g_Const.initialOutputBufferIndex);
 
         // Save the initial sample radiance for MIS in the final shading pass
         secondaryGBufferData.emission = outputShadingResult ? 0 : radiance;
@@ -20,6 +20,7 @@ VK_PUSH_CONSTANT ConstantBuffer<PrepareLightsConstants> g_Const : register(b0);
 RWStructuredBuffer<PolymorphicLightInfo> u_LightDataBuffer : register(u0);
 RWBuffer<uint> u_LightIndexMappingBuffer : register(u1);
 RWTexture2D<float> u_LocalLightPdfTexture : register(u2);
+RWBuffer<uint> u_VisibleLightIndex : register(u3);
 StructuredBuffer<PrepareLightsTask> t_TaskBuffer : register(t0);
 StructuredBuffer<PolymorphicLightInfo> t_PrimitiveLights : register(t1);
 StructuredBuffer<InstanceData> t_InstanceData : register(t2);
@@ -36,8 +37,10 @@ VK_BINDING(1, 1) Texture2D t_BindlessTextures[] : register(t0, space2);
 
 bool FindTask(uint dispatchThreadId, out PrepareLightsTask task)
 {
-    // Use binary search to find the task that contains the current thread's output index:
-    //   task.lightBufferOffset <= dispatchThreadId < (task.lightBufferOffset + task.triangleCount)
+    // Use binary search to find the task that contains the current thread's index:
+    //   task.dispatchOffset <= dispatchThreadId < (task.dispatchOffset + task.triangleCount)
+    // The dispatch covers either all tasks, with dispatchOffset == lightBufferOffset,
+    // or only the tasks that have changed since the previous frame.
 
     int left = 0;
     int right = int(g_Const.numTasks) - 1;
@@ -47,7 +50,7 @@ bool FindTask(uint dispatchThreadId, out PrepareLightsTask task)
         int middle = (left + right) / 2;
         task = t_TaskBuffer[middle];
 
-        int tri = int(dispatchThreadId) - int(task.lightBufferOffset); // signed
+        int tri = int(dispatchThreadId) - int(task.dispatchOffset); // signed
 
         if (tri < 0)
         {
@@ -77,12 +80,19 @@ void main(uint dispatchThreadId : SV_DispatchThreadID, uint groupThreadId : SV_G
     if (!FindTask(dispatchThreadId, task))
         return;
 
-    uint triangleIdx = dispatchThreadId - task.lightBufferOffset;
+    uint triangleIdx = dispatchThreadId - task.dispatchOffset;
+    bool isEmptySlot = task.instanceAndGeometryIndex == TASK_EMPTY_SLOTS;
     bool isPrimitiveLight = (task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT) != 0;
     
     PolymorphicLightInfo lightInfo = (PolymorphicLightInfo)0;
 
-    if (!isPrimitiveLight)
+    if (isEmptySlot)
+    {
+        // Free slots can still be picked by uniform local light sampling, so store a point light
+        // with zero flux there, which is safe to sample and contributes nothing.
+        lightInfo.colorTypeAndFlags = uint(PolymorphicLightType::kPoint) << kPolymorphicLightTypeShift;
+    }
+    else if (!isPrimitiveLight)
     {
         InstanceData instance = t_InstanceData[task.instanceAndGeometryIndex >> 12];
         GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + task.instanceAndGeometryIndex & 0xfff];
@@ -183,6 +193,8 @@ void main(uint dispatchThreadId : SV_DispatchThreadID, uint groupThreadId : SV_G
     uint lightBufferPtr = task.lightBufferOffset + triangleIdx;
     u_LightDataBuffer[g_Const.currentFrameLightOffset + lightBufferPtr] = lightInfo;
 
+    u_VisibleLightIndex[lightBufferPtr] = task.emitterIndex;
+
     // If this light has existed on the previous frame, write the index mapping information
     // so that temporal resampling can be applied to the light correctly when it changes
     // the index inside the light buffer.
@@ -200,6 +212,12 @@ void main(uint dispatchThreadId : SV_DispatchThreadID, uint groupThreadId : SV_G
         u_LightIndexMappingBuffer[g_Const.currentFrameLightOffset + lightBufferPtr] = 
             g_Const.previousFrameLightOffset + prevBufferPtr + 1;
     }
+    else
+    {
+        // The slot might have been used by a different light on the previous frame when it's updated in place,
+        // so invalidate its mapping explicitly instead of relying on the mapping buffer being cleared.
+        u_LightIndexMappingBuffer[g_Const.currentFrameLightOffset + lightBufferPtr] = 0;
+    }
 
     // Calculate the total flux
     float emissiveFlux = PolymorphicLight::getPower(lightInfo);
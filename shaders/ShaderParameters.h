@@ -17,6 +17,7 @@
 #include <rtxdi/RtxdiParameters.h>
 
 #define TASK_PRIMITIVE_LIGHT_BIT 0x80000000u
+#define TASK_EMPTY_SLOTS 0xffffffffu // task that clears a range of free slots in the light buffer
 
 #define RTXDI_PRESAMPLING_GROUP_SIZE 256
 #define RTXDI_GRID_BUILD_GROUP_SIZE 256
@@ -79,6 +80,8 @@ struct PrepareLightsTask
     uint triangleCount; 
     uint lightBufferOffset;
     int previousLightBufferOffset; // -1 means no previous data
+    uint dispatchOffset; // index of the first thread processing this task, tasks are sorted by this field
+    uint emitterIndex; // index of the emissive geometry or primitive light, see GetVisibilityBufferLightIndex
 };
 
 struct RenderEnvironmentMapConstants
@@ -305,8 +308,20 @@ struct ResamplingConstants
     uint colorDenoiserMode;
     uint numEmissionThing; //visibility buffer size
     uint currentFrameLightOffset;
-    //uint3 padding;
-
+    uint enableLocalLightAliasTable;
+    uint environmentMapAliasTable;
+    uint regirCheckDirtyLights;
+
+    // Amortized ReGIR build, see LightingPasses::PrepareForLightSampling
+    uint regirBuildFirstSlot; // light slot processed by the first thread of PresampleReGIR
+    uint regirBuildSlotCount;
+    uint regirRefreshFirstSlot; // slots that are rebuilt unconditionally
+    uint regirRefreshSlotCount;
+
+    // Occupancy-driven ReGIR build, see CompactReGIRCells.hlsl
+    uint regirCellCount;
+    uint regirGroupsPerCell; // PresampleReGIR thread groups per listed cell
+    uint2 regirOccupancyPadding;
 };
 
 struct PerPassConstants
@@ -108,13 +108,14 @@ float4 main(float4 i_position : SV_Position) : SV_Target
     }
                                    
     case VIS_MODE_GI_WEIGHT: {
-        RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPos, g_Const.inputBufferIndex);
+        // The sample position is not used here, so the surface position doesn't matter
+        RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPos, g_Const.inputBufferIndex, float3(0, 0, 0));
         input = reservoir.weightSum;
         break;
     }
 
     case VIS_MODE_GI_M: {
-        RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPos, g_Const.inputBufferIndex);
+        RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.runtimeParams, reservoirPos, g_Const.inputBufferIndex, float3(0, 0, 0));
         input = reservoir.M;
         break;
     }
@@ -0,0 +1,309 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentMapAliasTable.h"
+#include "ParallelFor.h"
+
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+#include <rtxdi/AliasTable.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// Change the version when the weights or the table layout change, so that old cache files are ignored
+static const uint32_t c_CacheFileMagic = 0x54414e45; // 'ENAT'
+static const uint32_t c_CacheFileVersion = 1;
+
+static const size_t c_RowsPerChunk = 16;
+
+// Maximum value that can be encoded in the float16 PDF texture, applied to the weights to match it
+static const float c_MaxPixelWeight = 65504.f;
+
+static const float c_pi = 3.14159265f;
+
+struct CacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileHash;
+    uint32_t width;
+    uint32_t height;
+};
+
+// 64-bit FNV-1a
+static uint64_t HashBytes(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static float HalfToFloat(uint16_t value)
+{
+    const uint32_t sign = uint32_t(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0)
+    {
+        // Zero or denormal
+        const float result = float(mantissa) * (1.f / float(1 << 24));
+        return sign ? -result : result;
+    }
+
+    uint32_t bits;
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13); // Inf or NaN
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+EnvironmentMapAliasTable::EnvironmentMapAliasTable(
+    nvrhi::IDevice* device,
+    std::shared_ptr<donut::vfs::IFileSystem> fileSystem,
+    std::filesystem::path cacheDirectory)
+    : m_Device(device)
+    , m_FileSystem(std::move(fileSystem))
+    , m_CacheDirectory(std::move(cacheDirectory))
+{
+}
+
+// Reads the first mip level of the texture back and computes luminance times relative solid angle for every pixel,
+// same as getPixelWeight in PreprocessEnvironmentMap.hlsl.
+bool EnvironmentMapAliasTable::ComputePixelWeights(nvrhi::ITexture* texture, std::vector<float>& outWeights) const
+{
+    nvrhi::TextureDesc stagingDesc = texture->getDesc();
+
+    uint32_t channels;
+    bool halfFloat;
+    switch (stagingDesc.format)
+    {
+    case nvrhi::Format::RGBA32_FLOAT: channels = 4; halfFloat = false; break;
+    case nvrhi::Format::RGB32_FLOAT: channels = 3; halfFloat = false; break;
+    case nvrhi::Format::RGBA16_FLOAT: channels = 4; halfFloat = true; break;
+    default:
+        return false;
+    }
+
+    stagingDesc.mipLevels = 1;
+    stagingDesc.isRenderTarget = false;
+    stagingDesc.isUAV = false;
+    stagingDesc.debugName = "EnvironmentMapReadback";
+    nvrhi::StagingTextureHandle stagingTexture = m_Device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+
+    nvrhi::CommandListHandle commandList = m_Device->createCommandList();
+    commandList->open();
+    commandList->copyTexture(stagingTexture, nvrhi::TextureSlice(), texture, nvrhi::TextureSlice());
+    commandList->close();
+    m_Device->executeCommandList(commandList);
+    m_Device->waitForIdle();
+
+    size_t rowPitch = 0;
+    const uint8_t* mappedData = static_cast<const uint8_t*>(
+        m_Device->mapStagingTexture(stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+    if (!mappedData)
+        return false;
+
+    const uint32_t width = stagingDesc.width;
+    const uint32_t height = stagingDesc.height;
+    outWeights.resize(size_t(width) * height);
+
+    ParallelForChunks(m_Executor, height, c_RowsPerChunk, [&](size_t chunk, size_t beginRow, size_t endRow)
+    {
+        for (size_t y = beginRow; y < endRow; y++)
+        {
+            const uint8_t* row = mappedData + y * rowPitch;
+            float* rowWeights = outWeights.data() + y * width;
+
+            const float elevation = ((float(y) + 0.5f) / float(height) - 0.5f) * c_pi;
+            const float relativeSolidAngle = cosf(elevation);
+
+            for (uint32_t x = 0; x < width; x++)
+            {
+                float rgb[3];
+                if (halfFloat)
+                {
+                    const uint16_t* pixel = reinterpret_cast<const uint16_t*>(row) + x * channels;
+                    for (int c = 0; c < 3; c++)
+                        rgb[c] = HalfToFloat(pixel[c]);
+                }
+                else
+                {
+                    const float* pixel = reinterpret_cast<const float*>(row) + x * channels;
+                    for (int c = 0; c < 3; c++)
+                        rgb[c] = pixel[c];
+                }
+
+                const float luma = std::max(rgb[0] * 0.299f + rgb[1] * 0.587f + rgb[2] * 0.114f, 0.f);
+
+                // Do not sample invalid colors.
+                rowWeights[x] = std::isfinite(luma) ? std::min(luma * relativeSolidAngle, c_MaxPixelWeight) : 0.f;
+            }
+        }
+    });
+
+    m_Device->unmapStagingTexture(stagingTexture);
+    return true;
+}
+
+bool EnvironmentMapAliasTable::Build(nvrhi::ITexture* texture)
+{
+    std::vector<float> weights;
+    if (!ComputePixelWeights(texture, weights))
+        return false;
+
+    const uint32_t width = texture->getDesc().width;
+    const uint32_t height = texture->getDesc().height;
+
+    rtxdi::AliasTable2D table;
+    table.Resize(width, height);
+
+    ParallelForChunks(m_Executor, height, c_RowsPerChunk, [&](size_t chunk, size_t beginRow, size_t endRow)
+    {
+        table.BuildRows(weights.data(), uint32_t(beginRow), uint32_t(endRow));
+    });
+
+    table.BuildMarginal();
+
+    m_Entries = table.GetEntries();
+    m_Width = width;
+    m_Height = height;
+    return true;
+}
+
+bool EnvironmentMapAliasTable::ReadCacheFile(const std::filesystem::path& cacheFile, uint64_t fileHash, uint32_t width, uint32_t height)
+{
+    std::ifstream file(cacheFile, std::ios::binary);
+    if (!file)
+        return false;
+
+    CacheFileHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != c_CacheFileMagic || header.version != c_CacheFileVersion || header.fileHash != fileHash)
+        return false;
+
+    // Check the size against the texture before allocating anything, the header of a corrupt file can't be trusted
+    if (header.width != width || header.height != height)
+        return false;
+
+    const uint64_t entriesSize = GetBufferSize(width, height);
+    std::error_code error;
+    const uintmax_t fileSize = std::filesystem::file_size(cacheFile, error);
+    if (error || fileSize != sizeof(header) + entriesSize)
+        return false;
+
+    std::vector<RTXDI_AliasTableEntry> entries(size_t(entriesSize / sizeof(RTXDI_AliasTableEntry)));
+    file.read(reinterpret_cast<char*>(entries.data()), std::streamsize(entriesSize));
+    if (!file)
+        return false;
+
+    m_Entries = std::move(entries);
+    m_Width = width;
+    m_Height = height;
+    return true;
+}
+
+void EnvironmentMapAliasTable::WriteCacheFile(const std::filesystem::path& cacheFile, uint64_t fileHash) const
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_CacheDirectory, error);
+
+    // Write into a temporary file first, so that an interrupted write doesn't leave a truncated cache file behind
+    std::filesystem::path temporaryFile = cacheFile;
+    temporaryFile += ".tmp";
+
+    {
+        std::ofstream file(temporaryFile, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            donut::log::warning("Cannot write the environment map cache file %s", temporaryFile.generic_string().c_str());
+            return;
+        }
+
+        const CacheFileHeader header = { c_CacheFileMagic, c_CacheFileVersion, fileHash, m_Width, m_Height };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(m_Entries.data()), std::streamsize(m_Entries.size() * sizeof(RTXDI_AliasTableEntry)));
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(temporaryFile, error);
+            return;
+        }
+    }
+
+    std::filesystem::rename(temporaryFile, cacheFile, error);
+}
+
+bool EnvironmentMapAliasTable::Load(const std::string& path, nvrhi::ITexture* texture)
+{
+    Clear();
+
+    std::shared_ptr<donut::vfs::IBlob> fileData = m_FileSystem->readFile(path);
+    if (!fileData)
+        return false;
+
+    const uint64_t fileHash = HashBytes(fileData->data(), fileData->size());
+    fileData = nullptr;
+
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)fileHash);
+    const std::filesystem::path cacheFile = m_CacheDirectory / fileName;
+
+    const auto& textureDesc = texture->getDesc();
+    if (ReadCacheFile(cacheFile, fileHash, textureDesc.width, textureDesc.height))
+    {
+        donut::log::info("Loaded the alias table for %s from the cache", path.c_str());
+        return true;
+    }
+
+    Clear();
+
+    if (!Build(texture))
+    {
+        donut::log::info("Environment map %s has an unsupported format for the alias table, using the PDF texture", path.c_str());
+        return false;
+    }
+
+    WriteCacheFile(cacheFile, fileHash);
+    return true;
+}
+
+void EnvironmentMapAliasTable::Clear()
+{
+    m_Entries.clear();
+    m_Width = 0;
+    m_Height = 0;
+}
+
+uint64_t EnvironmentMapAliasTable::GetBufferSize(uint32_t width, uint32_t height)
+{
+    return sizeof(RTXDI_AliasTableEntry) * (uint64_t(width) * height + height);
+}
+
+void EnvironmentMapAliasTable::Upload(nvrhi::ICommandList* commandList, nvrhi::IBuffer* buffer) const
+{
+    assert(buffer->getDesc().byteSize >= GetBufferSize(m_Width, m_Height));
+
+    commandList->writeBuffer(buffer, m_Entries.data(), m_Entries.size() * sizeof(RTXDI_AliasTableEntry));
+}
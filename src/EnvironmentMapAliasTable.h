@@ -0,0 +1,75 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <rtxdi/RtxdiParameters.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+namespace tf
+{
+    class Executor;
+}
+
+// Two-level alias table over the pixels of an environment map file, which replaces the PDF texture mip chain
+// that GenerateMipsPass builds on the GPU. The table is built on the CPU from the texture that the texture cache
+// has decoded, using the same pixel weights as PreprocessEnvironmentMap.hlsl, and it's cached on disk
+// under a hash of the file contents. Loading the same map again only reads the cache file.
+class EnvironmentMapAliasTable
+{
+private:
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::vfs::IFileSystem> m_FileSystem;
+    std::filesystem::path m_CacheDirectory;
+    tf::Executor* m_Executor = nullptr;
+
+    std::vector<RTXDI_AliasTableEntry> m_Entries;
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+
+    bool ComputePixelWeights(nvrhi::ITexture* texture, std::vector<float>& outWeights) const;
+    bool Build(nvrhi::ITexture* texture);
+    bool ReadCacheFile(const std::filesystem::path& cacheFile, uint64_t fileHash, uint32_t width, uint32_t height);
+    void WriteCacheFile(const std::filesystem::path& cacheFile, uint64_t fileHash) const;
+
+public:
+    EnvironmentMapAliasTable(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::vfs::IFileSystem> fileSystem,
+        std::filesystem::path cacheDirectory);
+
+    // Builds the table in parallel on the given executor, or serially if it's null.
+    void SetExecutor(tf::Executor* executor) { m_Executor = executor; }
+
+    // Loads the table for the environment map file at 'path' from the cache, or builds it from 'texture',
+    // which must contain the decoded file. Returns false if the texture format is not supported,
+    // in which case the PDF texture should be used instead.
+    bool Load(const std::string& path, nvrhi::ITexture* texture);
+
+    void Clear();
+
+    bool IsValid() const { return !m_Entries.empty(); }
+    uint32_t GetWidth() const { return m_Width; }
+    uint32_t GetHeight() const { return m_Height; }
+
+    // Size of the buffer that the table is uploaded into for an environment map of the given size.
+    static uint64_t GetBufferSize(uint32_t width, uint32_t height);
+
+    void Upload(nvrhi::ICommandList* commandList, nvrhi::IBuffer* buffer) const;
+};
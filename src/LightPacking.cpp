@@ -0,0 +1,419 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "LightPacking.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define LIGHT_PACKING_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LIGHT_PACKING_AVX2_TARGET
+#else
+#define LIGHT_PACKING_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#else
+#define LIGHT_PACKING_X64 0
+#endif
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+static inline uint floatToUInt(float _V, float _Scale)
+{
+    return (uint)floor(_V * _Scale + 0.5f);
+}
+
+static inline uint FLOAT3_to_R8G8B8_UNORM(float unpackedInputX, float unpackedInputY, float unpackedInputZ)
+{
+    return (floatToUInt(saturate(unpackedInputX), 0xFF) & 0xFF) |
+        ((floatToUInt(saturate(unpackedInputY), 0xFF) & 0xFF) << 8) |
+        ((floatToUInt(saturate(unpackedInputZ), 0xFF) & 0xFF) << 16);
+}
+
+void packLightColor(const float3& color, PolymorphicLightInfo& lightInfo)
+{
+    float maxRadiance = std::max(color.x, std::max(color.y, color.z));
+
+    if (maxRadiance <= 0.f)
+        return;
+
+    float logRadiance = (::log2f(maxRadiance) - kPolymorphicLightMinLog2Radiance) / (kPolymorphicLightMaxLog2Radiance - kPolymorphicLightMinLog2Radiance);
+    logRadiance = saturate(logRadiance);
+    uint32_t packedRadiance = std::min(uint32_t(ceilf(logRadiance * 65534.f)) + 1, 0xffffu);
+    float unpackedRadiance = ::exp2f((float(packedRadiance - 1) / 65534.f) * (kPolymorphicLightMaxLog2Radiance - kPolymorphicLightMinLog2Radiance) + kPolymorphicLightMinLog2Radiance);
+
+    lightInfo.colorTypeAndFlags |= FLOAT3_to_R8G8B8_UNORM(color.x / unpackedRadiance, color.y / unpackedRadiance, color.z / unpackedRadiance);
+    lightInfo.logRadiance |= packedRadiance;
+}
+
+static float2 unitVectorToOctahedron(const float3 N)
+{
+    float m = abs(N.x) + abs(N.y) + abs(N.z);
+    float2 XY = { N.x, N.y };
+    XY.x /= m;
+    XY.y /= m;
+    if (N.z <= 0.0f)
+    {
+        float2 signs;
+        signs.x = XY.x >= 0.0f ? 1.0f : -1.0f;
+        signs.y = XY.y >= 0.0f ? 1.0f : -1.0f;
+        float x = (1.0f - abs(XY.y)) * signs.x;
+        float y = (1.0f - abs(XY.x)) * signs.y;
+        XY.x = x;
+        XY.y = y;
+    }
+    return { XY.x, XY.y };
+}
+
+uint32_t packNormalizedVector(const float3 x)
+{
+    float2 XY = unitVectorToOctahedron(x);
+    XY.x = XY.x * .5f + .5f;
+    XY.y = XY.y * .5f + .5f;
+    uint X = floatToUInt(saturate(XY.x), (1 << 16) - 1);
+    uint Y = floatToUInt(saturate(XY.y), (1 << 16) - 1);
+    uint packedOutput = X;
+    packedOutput |= Y << 16;
+    return packedOutput;
+}
+
+// Modified from original, based on the method from the DX fallback layer sample
+uint16_t fp32ToFp16(float v)
+{
+    // Multiplying by 2^-112 causes exponents below -14 to denormalize
+    static const union FU {
+        uint ui;
+        float f;
+    } multiple = { 0x07800000 }; // 2**-112
+
+    FU BiasedFloat;
+    BiasedFloat.f = v * multiple.f;
+    const uint u = BiasedFloat.ui;
+
+    const uint sign = u & 0x80000000;
+    uint body = u & 0x0fffffff;
+
+    return (uint16_t)(sign >> 16 | body >> 13) & 0xFFFF;
+}
+
+
+void PackLight(const LightPackingInput& input, PolymorphicLightInfo& output)
+{
+    output = PolymorphicLightInfo();
+    output.colorTypeAndFlags = input.colorTypeAndFlags;
+    packLightColor(input.radiance, output);
+    output.center = input.center;
+    output.scalars = fp32ToFp16(input.scalars[0]) | (fp32ToFp16(input.scalars[1]) << 16);
+
+    if (any(input.direction1 != 0.f))
+        output.direction1 = packNormalizedVector(input.direction1);
+
+    if (any(input.direction2 != 0.f))
+        output.direction2 = packNormalizedVector(input.direction2);
+
+    if (any(input.primaryAxis != 0.f))
+        output.primaryAxis = packNormalizedVector(input.primaryAxis);
+
+    output.cosConeAngleAndSoftness = fp32ToFp16(input.cosConeAngleAndSoftness[0]) | (fp32ToFp16(input.cosConeAngleAndSoftness[1]) << 16);
+    output.iesProfileIndex = input.iesProfileIndex;
+}
+
+bool IsLightPackingSimdSupported()
+{
+#if LIGHT_PACKING_X64
+#ifdef _MSC_VER
+    static const bool supported = []()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX and OS support for saving the YMM registers
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+#else
+    return false;
+#endif
+}
+
+void LightPackingBatch::Clear()
+{
+    m_OutputIndices.clear();
+    m_ColorTypeAndFlags.clear();
+    m_IesProfileIndices.clear();
+
+    for (int i = 0; i < 3; i++)
+    {
+        m_Radiance[i].clear();
+        m_Center[i].clear();
+        m_Direction1[i].clear();
+        m_Direction2[i].clear();
+        m_PrimaryAxis[i].clear();
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        m_Scalars[i].clear();
+        m_CosConeAngleAndSoftness[i].clear();
+    }
+}
+
+void LightPackingBatch::Append(const LightPackingInput& input, uint32_t outputIndex)
+{
+    m_OutputIndices.push_back(outputIndex);
+    m_ColorTypeAndFlags.push_back(input.colorTypeAndFlags);
+    m_IesProfileIndices.push_back(input.iesProfileIndex);
+
+    for (int i = 0; i < 3; i++)
+    {
+        m_Radiance[i].push_back(input.radiance[i]);
+        m_Center[i].push_back(input.center[i]);
+        m_Direction1[i].push_back(input.direction1[i]);
+        m_Direction2[i].push_back(input.direction2[i]);
+        m_PrimaryAxis[i].push_back(input.primaryAxis[i]);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        m_Scalars[i].push_back(input.scalars[i]);
+        m_CosConeAngleAndSoftness[i].push_back(input.cosConeAngleAndSoftness[i]);
+    }
+}
+
+LightPackingInput LightPackingBatch::GetInput(size_t index) const
+{
+    LightPackingInput input;
+    input.colorTypeAndFlags = m_ColorTypeAndFlags[index];
+    input.iesProfileIndex = m_IesProfileIndices[index];
+
+    for (int i = 0; i < 3; i++)
+    {
+        input.radiance[i] = m_Radiance[i][index];
+        input.center[i] = m_Center[i][index];
+        input.direction1[i] = m_Direction1[i][index];
+        input.direction2[i] = m_Direction2[i][index];
+        input.primaryAxis[i] = m_PrimaryAxis[i][index];
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        input.scalars[i] = m_Scalars[i][index];
+        input.cosConeAngleAndSoftness[i] = m_CosConeAngleAndSoftness[i][index];
+    }
+
+    return input;
+}
+
+void LightPackingBatch::PackScalar(size_t begin, size_t end, PolymorphicLightInfo* outLights) const
+{
+    for (size_t index = begin; index < end; ++index)
+        PackLight(GetInput(index), outLights[m_OutputIndices[index]]);
+}
+
+void LightPackingBatch::Pack(PolymorphicLightInfo* outLights, bool allowSimd) const
+{
+    size_t numVectorized = 0;
+
+    if (allowSimd && IsLightPackingSimdSupported())
+    {
+        numVectorized = GetSize() & ~size_t(7);
+        PackAVX2(0, numVectorized, outLights);
+    }
+
+    PackScalar(numVectorized, GetSize(), outLights);
+}
+
+#if LIGHT_PACKING_X64
+
+// The radiance that packLightColor divides the color by only depends on the packed radiance,
+// so it's precomputed for all 2^16 values with the same expression.
+static const float* GetUnpackedRadianceTable()
+{
+    static const std::vector<float> table = []()
+    {
+        std::vector<float> values(0x10000, 0.f);
+        for (uint32_t packedRadiance = 1; packedRadiance <= 0xffff; packedRadiance++)
+            values[packedRadiance] = ::exp2f((float(packedRadiance - 1) / 65534.f) * (kPolymorphicLightMaxLog2Radiance - kPolymorphicLightMinLog2Radiance) + kPolymorphicLightMinLog2Radiance);
+        return values;
+    }();
+    return table.data();
+}
+
+LIGHT_PACKING_AVX2_TARGET static inline __m256 Saturate8(__m256 v)
+{
+    return _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+}
+
+// Same as floatToUInt, for values that fit into int32
+LIGHT_PACKING_AVX2_TARGET static inline __m256i FloatToUInt8(__m256 v, float scale)
+{
+    __m256 scaled = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(scale)), _mm256_set1_ps(0.5f));
+    return _mm256_cvttps_epi32(_mm256_floor_ps(scaled));
+}
+
+LIGHT_PACKING_AVX2_TARGET static inline __m256i Fp32ToFp16x8(__m256 v)
+{
+    __m256i u = _mm256_castps_si256(_mm256_mul_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x07800000))));
+    __m256i sign = _mm256_and_si256(u, _mm256_set1_epi32(int(0x80000000)));
+    __m256i body = _mm256_and_si256(u, _mm256_set1_epi32(0x0fffffff));
+    __m256i result = _mm256_or_si256(_mm256_srli_epi32(sign, 16), _mm256_srli_epi32(body, 13));
+    return _mm256_and_si256(result, _mm256_set1_epi32(0xffff));
+}
+
+LIGHT_PACKING_AVX2_TARGET static inline __m256i PackTwoFp16x8(__m256 low, __m256 high)
+{
+    return _mm256_or_si256(Fp32ToFp16x8(low), _mm256_slli_epi32(Fp32ToFp16x8(high), 16));
+}
+
+// Same as packNormalizedVector, returns zero for the lanes where the vector is zero
+LIGHT_PACKING_AVX2_TARGET static inline __m256i PackNormalizedVector8(__m256 x, __m256 y, __m256 z)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 half = _mm256_set1_ps(.5f);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+    __m256 m = _mm256_add_ps(_mm256_add_ps(_mm256_and_ps(x, absMask), _mm256_and_ps(y, absMask)), _mm256_and_ps(z, absMask));
+    __m256 X = _mm256_div_ps(x, m);
+    __m256 Y = _mm256_div_ps(y, m);
+
+    __m256 signX = _mm256_blendv_ps(_mm256_set1_ps(-1.f), one, _mm256_cmp_ps(X, zero, _CMP_GE_OQ));
+    __m256 signY = _mm256_blendv_ps(_mm256_set1_ps(-1.f), one, _mm256_cmp_ps(Y, zero, _CMP_GE_OQ));
+    __m256 foldedX = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_and_ps(Y, absMask)), signX);
+    __m256 foldedY = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_and_ps(X, absMask)), signY);
+
+    __m256 lowerHemisphere = _mm256_cmp_ps(z, zero, _CMP_LE_OQ);
+    X = _mm256_blendv_ps(X, foldedX, lowerHemisphere);
+    Y = _mm256_blendv_ps(Y, foldedY, lowerHemisphere);
+
+    X = _mm256_add_ps(_mm256_mul_ps(X, half), half);
+    Y = _mm256_add_ps(_mm256_mul_ps(Y, half), half);
+
+    __m256i packed = _mm256_or_si256(FloatToUInt8(Saturate8(X), 65535.f), _mm256_slli_epi32(FloatToUInt8(Saturate8(Y), 65535.f), 16));
+
+    __m256 nonZero = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(x, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(y, zero, _CMP_NEQ_UQ)), _mm256_cmp_ps(z, zero, _CMP_NEQ_UQ));
+    return _mm256_and_si256(packed, _mm256_castps_si256(nonZero));
+}
+
+LIGHT_PACKING_AVX2_TARGET void LightPackingBatch::PackAVX2(size_t begin, size_t end, PolymorphicLightInfo* outLights) const
+{
+    const float* unpackedRadianceTable = GetUnpackedRadianceTable();
+    const __m256 zero = _mm256_setzero_ps();
+
+    alignas(32) float maxRadiance[8];
+    alignas(32) float log2Radiance[8];
+    alignas(32) uint32_t colorTypeAndFlags[8];
+    alignas(32) uint32_t logRadiance[8];
+    alignas(32) uint32_t scalars[8];
+    alignas(32) uint32_t direction1[8];
+    alignas(32) uint32_t direction2[8];
+    alignas(32) uint32_t primaryAxis[8];
+    alignas(32) uint32_t cosConeAngleAndSoftness[8];
+
+    for (size_t base = begin; base < end; base += 8)
+    {
+        // packLightColor
+        __m256 r = _mm256_loadu_ps(m_Radiance[0].data() + base);
+        __m256 g = _mm256_loadu_ps(m_Radiance[1].data() + base);
+        __m256 b = _mm256_loadu_ps(m_Radiance[2].data() + base);
+        __m256 maxRad = _mm256_max_ps(r, _mm256_max_ps(g, b));
+        _mm256_store_ps(maxRadiance, maxRad);
+
+        // log2f has no bit-exact vector equivalent, so it's evaluated per lane
+        for (int lane = 0; lane < 8; lane++)
+            log2Radiance[lane] = maxRadiance[lane] > 0.f ? ::log2f(maxRadiance[lane]) : 0.f;
+
+        __m256 logRad = _mm256_div_ps(
+            _mm256_sub_ps(_mm256_load_ps(log2Radiance), _mm256_set1_ps(kPolymorphicLightMinLog2Radiance)),
+            _mm256_set1_ps(kPolymorphicLightMaxLog2Radiance - kPolymorphicLightMinLog2Radiance));
+        logRad = Saturate8(logRad);
+
+        __m256i packedRadiance = _mm256_add_epi32(_mm256_cvttps_epi32(_mm256_ceil_ps(_mm256_mul_ps(logRad, _mm256_set1_ps(65534.f)))), _mm256_set1_epi32(1));
+        packedRadiance = _mm256_min_epu32(packedRadiance, _mm256_set1_epi32(0xffff));
+        __m256 unpackedRadiance = _mm256_i32gather_ps(unpackedRadianceTable, packedRadiance, 4);
+
+        __m256i color = _mm256_and_si256(FloatToUInt8(Saturate8(_mm256_div_ps(r, unpackedRadiance)), 255.f), _mm256_set1_epi32(0xff));
+        color = _mm256_or_si256(color, _mm256_slli_epi32(_mm256_and_si256(FloatToUInt8(Saturate8(_mm256_div_ps(g, unpackedRadiance)), 255.f), _mm256_set1_epi32(0xff)), 8));
+        color = _mm256_or_si256(color, _mm256_slli_epi32(_mm256_and_si256(FloatToUInt8(Saturate8(_mm256_div_ps(b, unpackedRadiance)), 255.f), _mm256_set1_epi32(0xff)), 16));
+
+        // Lights with zero radiance keep the color and radiance fields empty
+        __m256i hasRadiance = _mm256_castps_si256(_mm256_cmp_ps(maxRad, zero, _CMP_NLE_UQ));
+        color = _mm256_and_si256(color, hasRadiance);
+        packedRadiance = _mm256_and_si256(packedRadiance, hasRadiance);
+
+        __m256i typeAndFlags = _mm256_loadu_si256((const __m256i*)(m_ColorTypeAndFlags.data() + base));
+        _mm256_store_si256((__m256i*)colorTypeAndFlags, _mm256_or_si256(typeAndFlags, color));
+        _mm256_store_si256((__m256i*)logRadiance, packedRadiance);
+
+        _mm256_store_si256((__m256i*)scalars, PackTwoFp16x8(
+            _mm256_loadu_ps(m_Scalars[0].data() + base),
+            _mm256_loadu_ps(m_Scalars[1].data() + base)));
+
+        _mm256_store_si256((__m256i*)cosConeAngleAndSoftness, PackTwoFp16x8(
+            _mm256_loadu_ps(m_CosConeAngleAndSoftness[0].data() + base),
+            _mm256_loadu_ps(m_CosConeAngleAndSoftness[1].data() + base)));
+
+        _mm256_store_si256((__m256i*)direction1, PackNormalizedVector8(
+            _mm256_loadu_ps(m_Direction1[0].data() + base),
+            _mm256_loadu_ps(m_Direction1[1].data() + base),
+            _mm256_loadu_ps(m_Direction1[2].data() + base)));
+
+        _mm256_store_si256((__m256i*)direction2, PackNormalizedVector8(
+            _mm256_loadu_ps(m_Direction2[0].data() + base),
+            _mm256_loadu_ps(m_Direction2[1].data() + base),
+            _mm256_loadu_ps(m_Direction2[2].data() + base)));
+
+        _mm256_store_si256((__m256i*)primaryAxis, PackNormalizedVector8(
+            _mm256_loadu_ps(m_PrimaryAxis[0].data() + base),
+            _mm256_loadu_ps(m_PrimaryAxis[1].data() + base),
+            _mm256_loadu_ps(m_PrimaryAxis[2].data() + base)));
+
+        for (int lane = 0; lane < 8; lane++)
+        {
+            const size_t index = base + lane;
+            PolymorphicLightInfo& output = outLights[m_OutputIndices[index]];
+            output.center = float3(m_Center[0][index], m_Center[1][index], m_Center[2][index]);
+            output.colorTypeAndFlags = colorTypeAndFlags[lane];
+            output.direction1 = direction1[lane];
+            output.direction2 = direction2[lane];
+            output.scalars = scalars[lane];
+            output.logRadiance = logRadiance[lane];
+            output.iesProfileIndex = m_IesProfileIndices[index];
+            output.primaryAxis = primaryAxis[lane];
+            output.cosConeAngleAndSoftness = cosConeAngleAndSoftness[lane];
+            output.padding = 0;
+        }
+    }
+}
+
+#else
+
+void LightPackingBatch::PackAVX2(size_t begin, size_t end, PolymorphicLightInfo* outLights) const
+{
+    PackScalar(begin, end, outLights);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <cstdint>
+#include <vector>
+
+struct PolymorphicLightInfo;
+
+// Helpers that pack light parameters into the PolymorphicLightInfo encoding.
+void packLightColor(const dm::float3& color, PolymorphicLightInfo& lightInfo);
+uint32_t packNormalizedVector(const dm::float3 x);
+uint16_t fp32ToFp16(float v);
+
+// Parameters of an analytic light (point, sphere, spot, cylinder, disk, rect), computed from the scene light,
+// that only need to be packed to produce its PolymorphicLightInfo.
+struct LightPackingInput
+{
+    uint32_t colorTypeAndFlags = 0; // light type and flags, the packed color is added to it
+    dm::float3 radiance = 0.f; // flux for point lights
+    dm::float3 center = 0.f;
+    float scalars[2] = { 0.f, 0.f };
+    dm::float3 direction1 = 0.f; // normalized, or zero if the light doesn't use it
+    dm::float3 direction2 = 0.f; // normalized, or zero if the light doesn't use it
+    dm::float3 primaryAxis = 0.f; // normalized, or zero if the light doesn't use it
+    float cosConeAngleAndSoftness[2] = { 0.f, 0.f };
+    uint32_t iesProfileIndex = 0;
+};
+
+// Packs a single light. This is the reference for LightPackingBatch.
+void PackLight(const LightPackingInput& input, PolymorphicLightInfo& output);
+
+// Returns true if the CPU supports the vectorized path of LightPackingBatch::Pack.
+bool IsLightPackingSimdSupported();
+
+// Structure-of-arrays storage for the packing inputs of many analytic lights of any type,
+// which allows packing them with SIMD instructions. The results are bit-identical to PackLight
+// for finite inputs.
+class LightPackingBatch
+{
+private:
+    std::vector<uint32_t> m_OutputIndices;
+    std::vector<uint32_t> m_ColorTypeAndFlags;
+    std::vector<float> m_Radiance[3];
+    std::vector<float> m_Center[3];
+    std::vector<float> m_Scalars[2];
+    std::vector<float> m_Direction1[3];
+    std::vector<float> m_Direction2[3];
+    std::vector<float> m_PrimaryAxis[3];
+    std::vector<float> m_CosConeAngleAndSoftness[2];
+    std::vector<uint32_t> m_IesProfileIndices;
+
+    LightPackingInput GetInput(size_t index) const;
+    void PackScalar(size_t begin, size_t end, PolymorphicLightInfo* outLights) const;
+    void PackAVX2(size_t begin, size_t end, PolymorphicLightInfo* outLights) const;
+
+public:
+    void Clear();
+
+    // Adds a light whose packed data will be written into outLights[outputIndex] by Pack.
+    void Append(const LightPackingInput& input, uint32_t outputIndex);
+
+    size_t GetSize() const { return m_OutputIndices.size(); }
+
+    // Packs all lights, using AVX2 if 'allowSimd' is true and the CPU supports it.
+    void Pack(PolymorphicLightInfo* outLights, bool allowSimd = true) const;
+};
@@ -0,0 +1,131 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "LightSlotAllocator.h"
+
+#include <cassert>
+#include <iterator>
+
+LightSlotAllocator::LightSlotAllocator(uint32_t capacity)
+{
+    Reset(capacity);
+}
+
+void LightSlotAllocator::Reset(uint32_t capacity)
+{
+    m_FreeRanges.clear();
+    m_Capacity = capacity;
+    m_AllocatedSlots = 0;
+
+    if (capacity > 0)
+        m_FreeRanges[0] = capacity;
+}
+
+bool LightSlotAllocator::SetCapacity(uint32_t capacity)
+{
+    if (capacity == m_Capacity)
+        return true;
+
+    if (capacity > m_Capacity)
+    {
+        // Extend the last free range if it ends at the old capacity, or add a new one
+        auto last = m_FreeRanges.empty() ? m_FreeRanges.end() : std::prev(m_FreeRanges.end());
+        if (last != m_FreeRanges.end() && last->first + last->second == m_Capacity)
+            last->second += capacity - m_Capacity;
+        else
+            m_FreeRanges[m_Capacity] = capacity - m_Capacity;
+
+        m_Capacity = capacity;
+        return true;
+    }
+
+    if (GetUsedRangeEnd() > capacity)
+        return false;
+
+    // All slots beyond the new capacity are in the last free range
+    auto last = std::prev(m_FreeRanges.end());
+    if (last->first >= capacity)
+        m_FreeRanges.erase(last);
+    else
+        last->second = capacity - last->first;
+
+    m_Capacity = capacity;
+    return true;
+}
+
+bool LightSlotAllocator::Allocate(uint32_t count, uint32_t& outOffset)
+{
+    assert(count > 0);
+
+    for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+    {
+        if (it->second < count)
+            continue;
+
+        outOffset = it->first;
+        const uint32_t remaining = it->second - count;
+        m_FreeRanges.erase(it);
+
+        if (remaining > 0)
+            m_FreeRanges[outOffset + count] = remaining;
+
+        m_AllocatedSlots += count;
+        return true;
+    }
+
+    return false;
+}
+
+void LightSlotAllocator::Free(uint32_t offset, uint32_t count)
+{
+    assert(count > 0);
+    assert(offset + count <= m_Capacity);
+    assert(count <= m_AllocatedSlots);
+
+    m_AllocatedSlots -= count;
+
+    auto next = m_FreeRanges.lower_bound(offset);
+    assert(next == m_FreeRanges.end() || next->first >= offset + count);
+
+    // Merge with the preceding free range
+    if (next != m_FreeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        assert(prev->first + prev->second <= offset);
+
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            count += prev->second;
+            m_FreeRanges.erase(prev);
+        }
+    }
+
+    // Merge with the following free range
+    if (next != m_FreeRanges.end() && next->first == offset + count)
+    {
+        count += next->second;
+        m_FreeRanges.erase(next);
+    }
+
+    m_FreeRanges[offset] = count;
+}
+
+uint32_t LightSlotAllocator::GetUsedRangeEnd() const
+{
+    if (m_FreeRanges.empty())
+        return m_Capacity;
+
+    auto last = std::prev(m_FreeRanges.end());
+    if (last->first + last->second == m_Capacity)
+        return last->first;
+
+    return m_Capacity;
+}
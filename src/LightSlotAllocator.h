@@ -0,0 +1,55 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+// Allocates ranges of slots in the light buffer, so that emitters keep their slots while
+// other emitters are added or removed. Uses first fit over a list of free ranges that is
+// sorted by offset and coalesced on every release, so the allocated slots stay packed
+// towards the beginning of the buffer.
+class LightSlotAllocator
+{
+private:
+    std::map<uint32_t, uint32_t> m_FreeRanges; // offset -> size
+    uint32_t m_Capacity = 0;
+    uint32_t m_AllocatedSlots = 0;
+
+public:
+    explicit LightSlotAllocator(uint32_t capacity = 0);
+
+    // Releases all allocations.
+    void Reset(uint32_t capacity);
+
+    // Changes the capacity while keeping the allocations.
+    // Returns false and leaves the allocator unchanged if some slots at or beyond 'capacity' are allocated.
+    bool SetCapacity(uint32_t capacity);
+
+    // Returns false if there is no free range of 'count' slots.
+    bool Allocate(uint32_t count, uint32_t& outOffset);
+
+    // Releases a range that was returned by Allocate.
+    void Free(uint32_t offset, uint32_t count);
+
+    uint32_t GetCapacity() const { return m_Capacity; }
+    uint32_t GetAllocatedSlots() const { return m_AllocatedSlots; }
+
+    // Returns one past the last allocated slot, i.e. the size of the range that needs to be
+    // covered to reach all allocations.
+    uint32_t GetUsedRangeEnd() const;
+
+    // Returns the number of free slots below GetUsedRangeEnd().
+    uint32_t GetHoleSlots() const { return GetUsedRangeEnd() - m_AllocatedSlots; }
+
+    // Free ranges, offset -> size, sorted by offset. Adjacent ranges are always merged.
+    const std::map<uint32_t, uint32_t>& GetFreeRanges() const { return m_FreeRanges; }
+};
@@ -0,0 +1,262 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "LightSlotTable.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cassert>
+
+// Number of free slots in the local light range that is tolerated before the lights are packed again
+static const uint32_t c_MinCompactionSlack = 1024;
+
+// Granularity of the parallel loop over the emitters
+static const size_t c_EmittersPerChunk = 1024;
+
+static const uint32_t c_InvalidOffset = ~0u;
+
+void LightSlotTable::Reset()
+{
+    m_InstanceSlots.clear();
+    m_PrimitiveSlots.clear();
+    m_NextInstanceSlots.clear();
+    m_NextPrimitiveSlots.clear();
+    m_InstanceFirstGeometry.clear();
+    m_SlotCount = 0;
+    m_SlotAllocator.Reset(0);
+    m_FreeEmitterIndices.clear();
+    m_EmitterIndexCount = 0;
+}
+
+uint32_t LightSlotTable::AllocateEmitterIndex()
+{
+    if (!m_FreeEmitterIndices.empty())
+    {
+        uint32_t emitterIndex = m_FreeEmitterIndices.back();
+        m_FreeEmitterIndices.pop_back();
+        return emitterIndex;
+    }
+
+    return m_EmitterIndexCount++;
+}
+
+void LightSlotTable::ReleaseSlot(const LightSlot& slot, std::vector<std::pair<uint32_t, uint32_t>>& freedRanges)
+{
+    m_FreeEmitterIndices.push_back(slot.emitterIndex);
+
+    if (!slot.infinite)
+        m_SlotAllocator.Free(slot.offset, slot.count);
+
+    // Infinite light slots are not owned by the allocator, but they may end up in the local light range
+    // when the number of infinite lights decreases, so they need to be cleared like the local ones.
+    freedRanges.push_back({ slot.offset, slot.count });
+}
+
+bool LightSlotTable::Update(
+    tf::Executor* executor,
+    std::vector<LayoutEmitter>& emitters,
+    uint32_t geometryInstanceCount,
+    uint32_t firstInfiniteLightSlot,
+    std::vector<std::pair<uint32_t, uint32_t>>& freedRanges)
+{
+    const uint32_t previousUpdate = m_UpdateIndex;
+    const uint32_t update = ++m_UpdateIndex;
+    bool relocate = false;
+
+    uint32_t instanceIdCount = 0;
+    uint32_t lightIdCount = 0;
+    for (const LayoutEmitter& emitter : emitters)
+    {
+        assert(emitter.owner.IsValid());
+        uint32_t& idCount = emitter.IsPrimitiveLight() ? lightIdCount : instanceIdCount;
+        idCount = std::max(idCount, emitter.owner.index + 1);
+    }
+
+    // The tables for this update are the ones from the update before the last, so they are not allocated and cleared
+    // on every update: only the entries of the current emitters are written, and the others are stale.
+    // An entry is only valid if it has been written or taken over by the update that it belongs to.
+    std::vector<LightSlot>& instanceSlots = m_NextInstanceSlots;
+    std::vector<LightSlot>& primitiveSlots = m_NextPrimitiveSlots;
+    instanceSlots.resize(geometryInstanceCount);
+    primitiveSlots.resize(lightIdCount);
+    if (m_InstanceFirstGeometry.size() < instanceIdCount)
+        m_InstanceFirstGeometry.resize(instanceIdCount, c_InvalidOffset);
+
+    auto isPreviousSlot = [previousUpdate](const LightSlot& slot)
+    {
+        return slot.owner.IsValid() && slot.lastUpdate == previousUpdate;
+    };
+
+    // Table entry of every emitter for this update, null if the emitter doesn't have a slot from the last update
+    m_EmitterSlots.assign(emitters.size(), nullptr);
+
+    // Take over the slots of the emitters from the last update, marking them with the current update.
+    // The slot of a geometry emitter is found through the first geometry instance index of its mesh instance
+    // in the last update, so emitters whose instances have moved in the scene graph keep their slots too,
+    // and the slot of a primitive light is at its ID. Every emitter only accesses its own table entries,
+    // so this can run in parallel.
+    ParallelForChunks(executor, emitters.size(), c_EmittersPerChunk, [&](size_t chunk, size_t begin, size_t end)
+    {
+        for (size_t index = begin; index < end; ++index)
+        {
+            LayoutEmitter& emitter = emitters[index];
+            emitter.previousLightBufferOffset = -1;
+
+            uint32_t previousIndex = emitter.owner.index;
+            if (!emitter.IsPrimitiveLight())
+            {
+                if (emitter.owner.index >= m_InstanceFirstGeometry.size() || m_InstanceFirstGeometry[emitter.owner.index] == c_InvalidOffset)
+                    continue;
+
+                previousIndex = m_InstanceFirstGeometry[emitter.owner.index] + emitter.geometryIndex;
+            }
+
+            std::vector<LightSlot>& previousSlots = emitter.IsPrimitiveLight() ? m_PrimitiveSlots : m_InstanceSlots;
+            if (previousIndex >= previousSlots.size())
+                continue;
+
+            LightSlot& previousSlot = previousSlots[previousIndex];
+            if (!isPreviousSlot(previousSlot) || previousSlot.owner != emitter.owner || previousSlot.geometryIndex != emitter.geometryIndex)
+                continue;
+
+            previousSlot.lastUpdate = update;
+            LightSlot& slot = emitter.IsPrimitiveLight() ? primitiveSlots[emitter.owner.index] : instanceSlots[emitter.geometryInstanceIndex];
+            slot = previousSlot;
+            m_EmitterSlots[index] = &slot;
+            emitter.previousLightBufferOffset = int(slot.offset);
+        }
+    });
+
+    // Emitters that don't fit into their slots anymore are released like the removed ones and get new slots
+    std::vector<uint32_t> newEmitters;
+    std::vector<uint32_t> infiniteEmitters;
+    size_t numPreviousSlotsFound = 0;
+    for (size_t index = 0; index < emitters.size(); ++index)
+    {
+        LayoutEmitter& emitter = emitters[index];
+        LightSlot* slot = m_EmitterSlots[index];
+
+        if (slot)
+        {
+            ++numPreviousSlotsFound;
+
+            if (slot->count != emitter.count || slot->infinite != emitter.infinite)
+            {
+                ReleaseSlot(*slot, freedRanges);
+                m_EmitterSlots[index] = nullptr;
+                emitter.previousLightBufferOffset = -1;
+            }
+        }
+
+        if (!m_EmitterSlots[index])
+            newEmitters.push_back(uint32_t(index));
+
+        if (emitter.infinite)
+            infiniteEmitters.push_back(uint32_t(index));
+    }
+
+    // Release the slots of the emitters that have been removed before allocating the new ones,
+    // so that replacing emitters reuses their emitter indices instead of growing the index range.
+    // The tables only need to be searched if some of the previous emitters haven't been found.
+    if (numPreviousSlotsFound < m_SlotCount)
+    {
+        for (const std::vector<LightSlot>* previousSlots : { &m_InstanceSlots, &m_PrimitiveSlots })
+        {
+            for (const LightSlot& slot : *previousSlots)
+            {
+                if (isPreviousSlot(slot))
+                    ReleaseSlot(slot, freedRanges);
+            }
+        }
+    }
+
+    // New slots are created serially, in emitter order, so that the layout is deterministic
+    for (uint32_t index : newEmitters)
+    {
+        LayoutEmitter& emitter = emitters[index];
+        LightSlot& slot = emitter.IsPrimitiveLight() ? primitiveSlots[emitter.owner.index] : instanceSlots[emitter.geometryInstanceIndex];
+
+        slot = LightSlot();
+        slot.owner = emitter.owner;
+        slot.geometryIndex = emitter.geometryIndex;
+        slot.offset = c_InvalidOffset;
+        slot.count = emitter.count;
+        slot.emitterIndex = AllocateEmitterIndex();
+        slot.lastUpdate = update;
+        slot.infinite = emitter.infinite;
+        m_EmitterSlots[index] = &slot;
+    }
+
+    for (size_t infiniteIndex = 0; infiniteIndex < infiniteEmitters.size(); ++infiniteIndex)
+    {
+        LayoutEmitter& emitter = emitters[infiniteEmitters[infiniteIndex]];
+        LightSlot& slot = *m_EmitterSlots[infiniteEmitters[infiniteIndex]];
+
+        const uint32_t offset = firstInfiniteLightSlot + uint32_t(infiniteIndex);
+        if (emitter.previousLightBufferOffset >= 0 && slot.offset != offset)
+            relocate = true;
+        slot.offset = offset;
+    }
+
+    // Allocate the slots for new local emitters. If the local lights don't fit or are too fragmented,
+    // pack them again from the start of the buffer.
+    bool compact = !m_SlotAllocator.SetCapacity(firstInfiniteLightSlot);
+
+    for (uint32_t index : newEmitters)
+    {
+        LightSlot* slot = m_EmitterSlots[index];
+        if (compact || slot->infinite)
+            continue;
+
+        if (!m_SlotAllocator.Allocate(slot->count, slot->offset))
+            compact = true;
+    }
+
+    if (!compact && m_SlotAllocator.GetHoleSlots() > std::max(c_MinCompactionSlack, m_SlotAllocator.GetUsedRangeEnd() / 4))
+        compact = true;
+
+    if (compact)
+    {
+        m_SlotAllocator.Reset(firstInfiniteLightSlot);
+
+        for (LightSlot* slot : m_EmitterSlots)
+        {
+            if (slot->infinite)
+                continue;
+
+            bool allocated = m_SlotAllocator.Allocate(slot->count, slot->offset);
+            assert(allocated);
+            (void)allocated;
+        }
+
+        relocate = true;
+    }
+
+    // Record where the geometries of every mesh instance start, which is written by the first emitter of the instance.
+    // The emitters of a mesh instance are consecutive, so only one emitter writes each entry.
+    ParallelForChunks(executor, emitters.size(), c_EmittersPerChunk, [&](size_t chunk, size_t begin, size_t end)
+    {
+        for (size_t index = begin; index < end; ++index)
+        {
+            LayoutEmitter& emitter = emitters[index];
+            emitter.lightBufferOffset = m_EmitterSlots[index]->offset;
+            emitter.emitterIndex = m_EmitterSlots[index]->emitterIndex;
+
+            if (!emitter.IsPrimitiveLight() && (index == 0 || emitters[index - 1].owner != emitter.owner))
+                m_InstanceFirstGeometry[emitter.owner.index] = emitter.geometryInstanceIndex - emitter.geometryIndex;
+        }
+    });
+
+    m_InstanceSlots.swap(m_NextInstanceSlots);
+    m_PrimitiveSlots.swap(m_NextPrimitiveSlots);
+    m_SlotCount = emitters.size();
+
+    return relocate;
+}
@@ -0,0 +1,113 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "LightSlotAllocator.h"
+#include "StableIdTable.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace tf
+{
+    class Executor;
+}
+
+// An emissive geometry or a primitive light in a layout update of PrepareLightsPass.
+struct LayoutEmitter
+{
+    static constexpr uint32_t c_NoGeometryInstance = ~0u;
+
+    // Identity of the emitter, used to find its slot from the last update
+    StableId owner; // ID of the mesh instance or light
+    uint32_t geometryIndex = 0;
+
+    // Geometry emitters: index of the geometry instance, and position of the mesh instance in the scene graph.
+    // Primitive lights: c_NoGeometryInstance, and the index of the light in the primitive light buffer.
+    uint32_t geometryInstanceIndex = c_NoGeometryInstance;
+    uint32_t instance = 0;
+
+    uint32_t instanceAndGeometryIndex = 0; // see PrepareLightsTask
+    uint32_t count = 0; // number of lights: the triangle count of a geometry, or 1 for a primitive light
+    bool infinite = false; // infinite lights are placed at the end of the buffer, outside of the allocator
+
+    // Placement in the light buffer, written by LightSlotTable::Update
+    uint32_t lightBufferOffset = 0;
+    uint32_t emitterIndex = 0;
+    int previousLightBufferOffset = -1; // -1 if the emitter is new or doesn't fit into its previous slot
+
+    bool IsPrimitiveLight() const { return geometryInstanceIndex == c_NoGeometryInstance; }
+};
+
+// Keeps every emitter in the same range of the light buffer and with the same emitter index across layout updates,
+// until it's removed or the local light range is compacted, so that temporal resampling doesn't lose its history.
+// The ranges of the local lights are allocated with a LightSlotAllocator, and the infinite lights are placed
+// after them, in emitter order.
+class LightSlotTable
+{
+private:
+    struct LightSlot
+    {
+        StableId owner; // invalid if the table entry is empty
+        uint32_t geometryIndex = 0;
+        uint32_t offset = 0;
+        uint32_t count = 0;
+        uint32_t emitterIndex = 0;
+        uint32_t lastUpdate = 0; // last update that has written or taken over this slot
+        bool infinite = false;
+    };
+
+    // Slots from the last update, indexed by geometry instance index and by light ID index. An entry belongs
+    // to an emitter on the next update if the owner ID, including its generation, and the geometry index match.
+    std::vector<LightSlot> m_InstanceSlots;
+    std::vector<LightSlot> m_PrimitiveSlots;
+    std::vector<uint32_t> m_InstanceFirstGeometry; // first geometry instance index of every mesh instance ID in the last update
+    size_t m_SlotCount = 0; // number of emitters in the last update
+    LightSlotAllocator m_SlotAllocator;
+    uint32_t m_UpdateIndex = 0;
+
+    // Scratch space of Update, kept to avoid the allocations
+    std::vector<LightSlot> m_NextInstanceSlots;
+    std::vector<LightSlot> m_NextPrimitiveSlots;
+    std::vector<LightSlot*> m_EmitterSlots;
+
+    // Emitter indices are stable as well, and the indices of removed emitters are reused.
+    std::vector<uint32_t> m_FreeEmitterIndices;
+    uint32_t m_EmitterIndexCount = 0;
+
+    uint32_t AllocateEmitterIndex();
+    void ReleaseSlot(const LightSlot& slot, std::vector<std::pair<uint32_t, uint32_t>>& freedRanges);
+
+public:
+    // Forgets all emitters, e.g. when the light buffer has been recreated.
+    void Reset();
+
+    // Places the emitters of a layout update: emitters from the last update keep their slots and emitter indices,
+    // the slots of the emitters that are gone are released, and new emitters get slots and emitter indices,
+    // reusing the released ones. Infinite lights are placed from 'firstInfiniteLightSlot' on, in emitter order.
+    // If the local lights don't fit below the infinite lights or are too fragmented, they are packed again.
+    // The emitters of a mesh instance must be consecutive in 'emitters'.
+    // Appends the released ranges of the buffer to 'freedRanges', some of which may have been reused.
+    // Returns true if some lights have been moved, in which case the whole buffer needs to be rewritten.
+    bool Update(
+        tf::Executor* executor,
+        std::vector<LayoutEmitter>& emitters,
+        uint32_t geometryInstanceCount,
+        uint32_t firstInfiniteLightSlot,
+        std::vector<std::pair<uint32_t, uint32_t>>& freedRanges);
+
+    const LightSlotAllocator& GetSlotAllocator() const { return m_SlotAllocator; }
+
+    // Returns one past the highest emitter index that may be in use, which is at most the largest number
+    // of emitters in any update since the last reset.
+    uint32_t GetEmitterIndexCount() const { return m_EmitterIndexCount; }
+};
@@ -23,6 +23,9 @@
 #include <nvrhi/utils.h>
 #include <rtxdi/RTXDI.h>
 
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
 #include <utility>
 
 #include "RtxgiIntegration.h"
@@ -50,6 +53,7 @@ LightingPasses::LightingPasses(
     , m_CommonPasses(std::move(commonPasses))
     , m_Scene(std::move(scene))
     , m_Profiler(std::move(profiler))
+    , m_ResamplingConstants(std::make_unique<ResamplingConstants>())
 {
     // The binding layout descriptor must match the binding set descriptor defined in CreateBindingSet(...) below
 
@@ -83,6 +87,11 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::Texture_SRV(24),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(25),
         nvrhi::BindingLayoutItem::TypedBuffer_SRV(26),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(27),
+        nvrhi::BindingLayoutItem::TypedBuffer_SRV(28),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(29),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(35),
+        nvrhi::BindingLayoutItem::TypedBuffer_SRV(36),
 
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
         nvrhi::BindingLayoutItem::Texture_UAV(1),
@@ -97,6 +106,10 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(12),
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(13),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(14),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(15),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(16),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(17),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(18),
 
         nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
         nvrhi::BindingLayoutItem::PushConstants(1, sizeof(PerPassConstants)),
@@ -162,6 +175,11 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::Texture_SRV(24, resources.LocalLightPdfTexture),
             nvrhi::BindingSetItem::StructuredBuffer_SRV(25, resources.GeometryInstanceToLightBuffer),
             nvrhi::BindingSetItem::TypedBuffer_SRV(26, resources.VisibleLightIndexBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(27, resources.LightTreeNodeBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_SRV(28, resources.LightTreeTrailBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(29, resources.LocalLightAliasTableBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(35, resources.EnvironmentAliasTableBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_SRV(36, resources.DirtyLocalLightMaskBuffer),
 
             nvrhi::BindingSetItem::StructuredBuffer_UAV(0, resources.LightReservoirBuffer),
             nvrhi::BindingSetItem::Texture_UAV(1, renderTargets.DiffuseLighting),
@@ -176,6 +194,10 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::TypedBuffer_UAV(12, m_Profiler->GetRayCountBuffer()),
             nvrhi::BindingSetItem::StructuredBuffer_UAV(13, resources.SecondaryGBuffer),
             nvrhi::BindingSetItem::TypedBuffer_UAV(14, resources.VisibilityBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(15, resources.ReGIRHashTableBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(16, resources.ReGIROccupancyBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(17, resources.ReGIRCellListBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(18, resources.ReGIRCellCountBuffer),
 
             nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
             nvrhi::BindingSetItem::PushConstants(1, sizeof(PerPassConstants)),
@@ -214,6 +236,13 @@ void LightingPasses::CreateBindingSet(
     m_SecondarySurfaceBuffer = resources.SecondaryGBuffer;
     m_GIReservoirBuffer = resources.GIReservoirBuffer;
     m_VisibilityBuffer = resources.VisibilityBuffer;
+    m_VisibilityBufferNeedsClear = true;
+    m_ReGIRHashTableBuffer = resources.ReGIRHashTableBuffer;
+    m_ReGIROccupancyBuffer = resources.ReGIROccupancyBuffer;
+    m_ReGIRCellCountBuffer = resources.ReGIRCellCountBuffer;
+    m_ReGIRIndirectArgsBuffer = resources.ReGIRIndirectArgsBuffer;
+    m_ReGIROccupancyMaskFull = false;
+    m_ReGIRCellsValid = false;
 }
 
 void LightingPasses::CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros)
@@ -248,6 +277,27 @@ void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, Comput
     commandList->endMarker();
 }
 
+void LightingPasses::ExecuteComputePassIndirect(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, nvrhi::IBuffer* argumentBuffer, ProfilerSection::Enum profilerSection)
+{
+    commandList->beginMarker(passName);
+    m_Profiler->BeginSection(commandList, profilerSection);
+
+    nvrhi::ComputeState state;
+    state.bindings = { m_BindingSet, m_Scene->GetDescriptorTable() };
+    state.pipeline = pass.Pipeline;
+    state.indirectParams = argumentBuffer;
+    commandList->setComputeState(state);
+
+    PerPassConstants pushConstants{};
+    pushConstants.rayCountBufferIndex = -1;
+    commandList->setPushConstants(&pushConstants, sizeof(pushConstants));
+
+    commandList->dispatchIndirect(0);
+
+    m_Profiler->EndSection(commandList, profilerSection);
+    commandList->endMarker();
+}
+
 void LightingPasses::ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet)
 {
     commandList->beginMarker(passName);
@@ -280,6 +330,9 @@ donut::engine::ShaderMacro LightingPasses::GetRegirMacro(const rtxdi::ContextPar
     case rtxdi::ReGIRMode::AlignGrid:
         regirMode = "RTXDI_REGIR_ALIGNGRID";
         break;    
+    case rtxdi::ReGIRMode::HashGrid:
+        regirMode = "RTXDI_REGIR_HASHGRID";
+        break;
     }
 
     return { "RTXDI_REGIR_MODE", regirMode };
@@ -299,6 +352,23 @@ void LightingPasses::CreatePipelines(const rtxdi::ContextParameters& contextPara
         CreateComputePass(m_PresampleReGIR, "app/LightingPasses/PresampleReGIR.hlsl", regirMacros);
     }
 
+    if (contextParameters.ReGIR.Mode == rtxdi::ReGIRMode::HashGrid)
+    {
+        CreateComputePass(m_BuildReGIRHashGridPass, "app/LightingPasses/BuildReGIRHashGrid.hlsl", regirMacros);
+    }
+
+    if (contextParameters.ReGIR.Mode == rtxdi::ReGIRMode::Grid ||
+        contextParameters.ReGIR.Mode == rtxdi::ReGIRMode::AlignGrid ||
+        contextParameters.ReGIR.Mode == rtxdi::ReGIRMode::Onion)
+    {
+        std::vector<donut::engine::ShaderMacro> cellListMacros = regirMacros;
+        cellListMacros.push_back({ "REGIR_CELL_LIST", "1" });
+
+        CreateComputePass(m_MarkReGIRCellsPass, "app/LightingPasses/MarkReGIRCells.hlsl", regirMacros);
+        CreateComputePass(m_CompactReGIRCellsPass, "app/LightingPasses/CompactReGIRCells.hlsl", regirMacros);
+        CreateComputePass(m_PresampleReGIRCellListPass, "app/LightingPasses/PresampleReGIR.hlsl", cellListMacros);
+    }
+
     m_GenerateInitialSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GenerateInitialSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_TemporalResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/TemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_SpatialResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/SpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
@@ -324,6 +394,29 @@ static void NrdHitDistanceParamsToFloat4(const nrd::HitDistanceParameters* param
 }
 #endif
 
+LightingPasses::~LightingPasses() = default;
+
+// Clears everything in the pass constants except the runtime parameters, and brings those up to date.
+// Keeping the runtime parameters between passes and frames means that only their per-frame fields are written,
+// instead of copying the whole structure including the onion tables for every pass.
+ResamplingConstants& LightingPasses::ResetResamplingConstants(
+    rtxdi::Context& context,
+    const rtxdi::FrameParameters& frameParameters)
+{
+    static_assert(std::is_trivially_copyable_v<ResamplingConstants>);
+
+    ResamplingConstants& constants = *m_ResamplingConstants;
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&constants);
+    const size_t runtimeParamsBegin = offsetof(ResamplingConstants, runtimeParams);
+    const size_t runtimeParamsEnd = runtimeParamsBegin + sizeof(constants.runtimeParams);
+    memset(bytes, 0, runtimeParamsBegin);
+    memset(bytes + runtimeParamsEnd, 0, sizeof(constants) - runtimeParamsEnd);
+
+    context.UpdateRuntimeParameters(constants.runtimeParams, frameParameters, m_RuntimeParamsStaticVersion);
+
+    return constants;
+}
+
 void LightingPasses::FillResamplingConstants(
     ResamplingConstants& constants,
     const RenderSettings& lightingSettings,
@@ -415,6 +508,8 @@ void LightingPasses::FillResamplingConstants(
     }
 
     constants.localLightPdfTextureSize = m_LocalLightPdfTextureSize;
+    constants.enableLocalLightAliasTable = lightingSettings.enableLocalLightAliasTable &&
+        frameParameters.enableLocalLightImportanceSampling && !frameParameters.enableLightTree;
     
     if (frameParameters.environmentLightPresent)
     {
@@ -422,6 +517,7 @@ void LightingPasses::FillResamplingConstants(
         constants.numPrimaryEnvironmentSamples = lightingSettings.numPrimaryEnvironmentSamples;
         constants.numIndirectEnvironmentSamples = lightingSettings.numIndirectEnvironmentSamples;
         constants.environmentMapImportanceSampling = 1;
+        constants.environmentMapAliasTable = lightingSettings.enableEnvironmentAliasTable;
     }
 
     constants.numEmissionThing = frameParameters.numEmissionThing;
@@ -430,15 +526,86 @@ void LightingPasses::FillResamplingConstants(
     m_CurrentFrameOutputReservoir = constants.shadeInputBufferIndex;
 }
 
+bool LightingPasses::ReGIRBuildInputs::Matches(const ReGIRBuildInputs& other) const
+{
+    return staticParamsVersion == other.staticParamsVersion &&
+        mode == other.mode &&
+        center.x == other.center.x &&
+        center.y == other.center.y &&
+        center.z == other.center.z &&
+        numBuildSamples == other.numBuildSamples &&
+        enableImportanceSampling == other.enableImportanceSampling &&
+        enableLightTree == other.enableLightTree &&
+        enableAliasTable == other.enableAliasTable;
+}
+
+// Selects the ReGIR light slots rebuilt by PresampleReGIR on this frame. With the amortized build, one group of cells
+// is rebuilt per frame, and the other cells are kept as long as they remain valid: the lights haven't moved
+// to other indices and the cells have been built on the previous frame with the same parameters.
+// The hash grid is rebuilt for the visible surfaces on every frame, and its slots can map to other cells then,
+// so it always builds all cells.
+void LightingPasses::FillReGIRBuildConstants(
+    ResamplingConstants& constants,
+    const rtxdi::Context& context,
+    const RenderSettings& localSettings,
+    const rtxdi::FrameParameters& frameParameters,
+    bool lightsRelocated,
+    bool localLightsChanged)
+{
+    ReGIRBuildInputs inputs;
+    inputs.staticParamsVersion = m_RuntimeParamsStaticVersion;
+    inputs.mode = context.GetParameters().ReGIR.Mode;
+    inputs.center = frameParameters.regirCenter;
+    inputs.numBuildSamples = localSettings.numRegirBuildSamples;
+    inputs.enableImportanceSampling = frameParameters.enableLocalLightImportanceSampling;
+    inputs.enableLightTree = frameParameters.enableLightTree;
+    inputs.enableAliasTable = constants.enableLocalLightAliasTable != 0;
+
+    const bool keepCells = m_ReGIRCellsValid &&
+        inputs.mode != rtxdi::ReGIRMode::HashGrid &&
+        !lightsRelocated &&
+        frameParameters.frameIndex == m_ReGIRLastBuildFrame + 1 &&
+        inputs.Matches(m_ReGIRBuildInputs);
+
+    const uint32_t cellCount = context.GetReGIRCellCount();
+    const uint32_t lightsPerCell = context.GetParameters().ReGIR.LightsPerCell;
+
+    rtxdi::ReGIRCellRange refreshRange;
+    refreshRange.cellCount = cellCount;
+    if (keepCells)
+        refreshRange = context.GetReGIRCellRefreshRange(frameParameters.frameIndex, localSettings.regirRefreshInterval);
+
+    constants.regirRefreshFirstSlot = refreshRange.firstCell * lightsPerCell;
+    constants.regirRefreshSlotCount = refreshRange.cellCount * lightsPerCell;
+
+    // The changed lights can be stored in any cell, so the build covers all slots then,
+    // and outside of the refreshed cells, it only resamples the slots that store these lights
+    constants.regirCheckDirtyLights = keepCells && localLightsChanged && refreshRange.cellCount < cellCount;
+
+    if (constants.regirCheckDirtyLights)
+    {
+        constants.regirBuildFirstSlot = 0;
+        constants.regirBuildSlotCount = context.GetReGIRLightSlotCount();
+    }
+    else
+    {
+        constants.regirBuildFirstSlot = constants.regirRefreshFirstSlot;
+        constants.regirBuildSlotCount = constants.regirRefreshSlotCount;
+    }
+
+    m_ReGIRBuildInputs = inputs;
+    m_ReGIRLastBuildFrame = frameParameters.frameIndex;
+    m_ReGIRCellsValid = true;
+}
+
 void LightingPasses::FillConstantBufferForProbeTracing(
     nvrhi::ICommandList* commandList,
     rtxdi::Context& context,
     const RenderSettings& localSettings,
     const rtxdi::FrameParameters& frameParameters)
 {
-    ResamplingConstants constants = {};
+    ResamplingConstants& constants = ResetResamplingConstants(context, frameParameters);
     constants.frameIndex = frameParameters.frameIndex;
-    context.FillRuntimeParameters(constants.runtimeParams, frameParameters);
     FillResamplingConstants(constants, localSettings, frameParameters);
 
     constants.numIndirectRegirSamples = localSettings.enableReGIR ? localSettings.numRtxgiRegirSamples : 0;
@@ -456,19 +623,44 @@ void LightingPasses::PrepareForLightSampling(
     const donut::engine::IView& previousView,
     const RenderSettings& localSettings,
     const rtxdi::FrameParameters& frameParameters,
+    bool lightsRelocated,
+    bool localLightsChanged,
     bool enableAccumulation)
 {
-    ResamplingConstants constants = {};
+    ResamplingConstants& constants = ResetResamplingConstants(context, frameParameters);
     constants.frameIndex = frameParameters.frameIndex;
     view.FillPlanarViewConstants(constants.view);
     previousView.FillPlanarViewConstants(constants.prevView);
-    context.FillRuntimeParameters(constants.runtimeParams, frameParameters);
     FillResamplingConstants(constants, localSettings, frameParameters);
     constants.enableAccumulation = enableAccumulation;
 
+    const bool buildReGIR = context.GetParameters().ReGIR.Mode != rtxdi::ReGIRMode::Disabled &&
+        localSettings.enableReGIR &&
+        frameParameters.numLocalLights > 0;
+
+    // The occupancy-driven build selects the cells on the GPU, so it can't keep the cells from the previous frames
+    const bool buildOccupiedReGIRCells = buildReGIR &&
+        localSettings.enableReGIROccupancyBuild &&
+        context.GetReGIROccupancyMaskSize() != 0;
+
+    const uint32_t regirGroupsPerCell = dm::div_ceil(context.GetParameters().ReGIR.LightsPerCell, RTXDI_GRID_BUILD_GROUP_SIZE);
+
+    if (buildOccupiedReGIRCells)
+    {
+        constants.regirCellCount = context.GetReGIRCellCount();
+        constants.regirGroupsPerCell = regirGroupsPerCell;
+        m_ReGIRCellsValid = false;
+    }
+    else if (buildReGIR)
+        FillReGIRBuildConstants(constants, context, localSettings, frameParameters, lightsRelocated, localLightsChanged);
+    else
+        m_ReGIRCellsValid = false;
+
     commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
 
+    // The light tree selects the local lights per surface, so the presampled tiles are not used
     if (frameParameters.enableLocalLightImportanceSampling &&
+        !frameParameters.enableLightTree &&
         frameParameters.numLocalLights > 0)
     {
         dm::int2 presampleDispatchSize = {
@@ -489,16 +681,71 @@ void LightingPasses::PrepareForLightSampling(
         ExecuteComputePass(commandList, m_PresampleEnvironmentMapPass, "PresampleEnvironmentMap", presampleDispatchSize, ProfilerSection::PresampleEnvMap);
     }
 
-    if (context.GetParameters().ReGIR.Mode != rtxdi::ReGIRMode::Disabled &&
-        localSettings.enableReGIR &&
-        frameParameters.numLocalLights > 0)
+    // The visibility statistics are stored per ReGIR cell. Hash grid cells are reallocated every frame,
+    // so their statistics can't be carried over; the other modes keep accumulating.
+    if (context.GetParameters().enableVisibilityVairanceSampling &&
+        (m_VisibilityBufferNeedsClear || context.GetParameters().ReGIR.Mode == rtxdi::ReGIRMode::HashGrid))
+    {
+        commandList->clearBufferUInt(m_VisibilityBuffer, 0);
+        m_VisibilityBufferNeedsClear = false;
+    }
+
+    // Without the occupancy-driven build, all cells are valid for the lookups
+    if (!buildOccupiedReGIRCells && context.GetReGIROccupancyMaskSize() != 0 && !m_ReGIROccupancyMaskFull)
     {
+        commandList->clearBufferUInt(m_ReGIROccupancyBuffer, ~0u);
+        m_ReGIROccupancyMaskFull = true;
+    }
+
+    dm::int2 surfaceDispatchSize = {
+        dm::div_ceil(view.GetViewExtent().width(), RTXDI_SCREEN_SPACE_GROUP_SIZE),
+        dm::div_ceil(view.GetViewExtent().height(), RTXDI_SCREEN_SPACE_GROUP_SIZE)
+    };
+
+    if (context.GetParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
+        surfaceDispatchSize.x = dm::div_ceil(view.GetViewExtent().width() / 2, RTXDI_SCREEN_SPACE_GROUP_SIZE);
+
+    if (buildOccupiedReGIRCells)
+    {
+        // Mark the cells reachable from the visible surfaces, list them, and build only the listed cells
+        commandList->clearBufferUInt(m_ReGIROccupancyBuffer, 0);
+        m_ReGIROccupancyMaskFull = false;
+
+        const uint32_t cellCountInit[4] = { 0, regirGroupsPerCell, 0, 0 };
+        commandList->writeBuffer(m_ReGIRCellCountBuffer, cellCountInit, sizeof(cellCountInit));
+
+        ExecuteComputePass(commandList, m_MarkReGIRCellsPass, "MarkReGIRCells", surfaceDispatchSize, ProfilerSection::MarkReGIRCells);
+
+        dm::int2 compactDispatchSize = {
+            dm::div_ceil(constants.regirCellCount, 256),
+            1
+        };
+
+        ExecuteComputePass(commandList, m_CompactReGIRCellsPass, "CompactReGIRCells", compactDispatchSize, ProfilerSection::CompactReGIRCells);
+
+        // The group counts follow the listed cell count in the count buffer
+        commandList->copyBuffer(m_ReGIRIndirectArgsBuffer, 0, m_ReGIRCellCountBuffer, sizeof(uint32_t), sizeof(uint32_t) * 3);
+
+        ExecuteComputePassIndirect(commandList, m_PresampleReGIRCellListPass, "PresampleReGIR", m_ReGIRIndirectArgsBuffer, ProfilerSection::PresampleReGIR);
+    }
+    else if (buildReGIR)
+    {
+        if (context.GetParameters().ReGIR.Mode == rtxdi::ReGIRMode::HashGrid)
+        {
+            // Allocate the hash grid cells for the visible surfaces, the build pass below skips the empty slots
+            commandList->clearBufferUInt(m_ReGIRHashTableBuffer, RTXDI_REGIR_HASH_EMPTY_KEY);
+
+            ExecuteComputePass(commandList, m_BuildReGIRHashGridPass, "BuildReGIRHashGrid", surfaceDispatchSize, ProfilerSection::BuildReGIRHashGrid);
+        }
+
         dm::int2 worldGridDispatchSize = {
-            dm::div_ceil(context.GetReGIRLightSlotCount(), RTXDI_GRID_BUILD_GROUP_SIZE),
+            dm::div_ceil(constants.regirBuildSlotCount, RTXDI_GRID_BUILD_GROUP_SIZE),
             1
         };
 
-        ExecuteComputePass(commandList, m_PresampleReGIR, "PresampleReGIR", worldGridDispatchSize, ProfilerSection::PresampleReGIR);
+        // The amortized build selects an empty group of cells on some frames when the refresh interval exceeds the cell count
+        if (worldGridDispatchSize.x > 0)
+            ExecuteComputePass(commandList, m_PresampleReGIR, "PresampleReGIR", worldGridDispatchSize, ProfilerSection::PresampleReGIR);
     }
 }
 
@@ -576,7 +823,7 @@ void LightingPasses::RenderBrdfRays(
     bool enableReStirGI
     )
 {
-    ResamplingConstants constants = {};
+    ResamplingConstants& constants = ResetResamplingConstants(context, frameParameters);
     view.FillPlanarViewConstants(constants.view);
     previousView.FillPlanarViewConstants(constants.prevView);
 
@@ -596,7 +843,6 @@ void LightingPasses::RenderBrdfRays(
     constants.minSecondaryRoughness = localSettings.minSecondaryRoughness;
     constants.enableFallbackSampling = localSettings.reStirGI.enableFallbackSampling;
     constants.giEnableFinalMIS = localSettings.reStirGI.enableFinalMIS;
-    context.FillRuntimeParameters(constants.runtimeParams, frameParameters);
     FillResamplingConstants(constants, localSettings, frameParameters);
 
     // Override various DI related settings set in FillResamplingConstants
@@ -104,6 +104,10 @@ private:
     ComputePass m_PresampleLightsPass;
     ComputePass m_PresampleEnvironmentMapPass;
     ComputePass m_PresampleReGIR;
+    ComputePass m_BuildReGIRHashGridPass;
+    ComputePass m_MarkReGIRCellsPass;
+    ComputePass m_CompactReGIRCellsPass;
+    ComputePass m_PresampleReGIRCellListPass;
     RayTracingPass m_GenerateInitialSamplesPass;
     RayTracingPass m_TemporalResamplingPass;
     RayTracingPass m_SpatialResamplingPass;
@@ -127,6 +131,32 @@ private:
     nvrhi::BufferHandle m_SecondarySurfaceBuffer;
     nvrhi::BufferHandle m_GIReservoirBuffer;
     nvrhi::BufferHandle m_VisibilityBuffer;
+    bool m_VisibilityBufferNeedsClear = false;
+    nvrhi::BufferHandle m_ReGIRHashTableBuffer;
+    nvrhi::BufferHandle m_ReGIROccupancyBuffer;
+    nvrhi::BufferHandle m_ReGIRCellCountBuffer;
+    nvrhi::BufferHandle m_ReGIRIndirectArgsBuffer;
+    // The occupancy mask is also read by the ReGIR lookups, so it must have all bits set when the occupancy-driven build is off
+    bool m_ReGIROccupancyMaskFull = false;
+
+    // Inputs of the last ReGIR build. The amortized build only keeps the cells built on the previous frames
+    // while they match, see FillReGIRBuildConstants(...)
+    struct ReGIRBuildInputs
+    {
+        uint32_t staticParamsVersion = 0;
+        rtxdi::ReGIRMode mode = rtxdi::ReGIRMode::Disabled;
+        rtxdi::float3 center{};
+        uint32_t numBuildSamples = 0;
+        bool enableImportanceSampling = false;
+        bool enableLightTree = false;
+        bool enableAliasTable = false;
+
+        bool Matches(const ReGIRBuildInputs& other) const;
+    };
+
+    ReGIRBuildInputs m_ReGIRBuildInputs;
+    uint32_t m_ReGIRLastBuildFrame = 0;
+    bool m_ReGIRCellsValid = false;
 
     dm::uint2 m_EnvironmentPdfTextureSize;
     dm::uint2 m_LocalLightPdfTextureSize;
@@ -135,6 +165,11 @@ private:
     uint32_t m_CurrentFrameOutputReservoir = 0;
     uint32_t m_CurrentFrameGIOutputReservoir = 0;
 
+    // Constants of the last pass. The runtime parameters in them are patched in place by the context,
+    // which only copies the static block into them when m_RuntimeParamsStaticVersion is out of date.
+    std::unique_ptr<ResamplingConstants> m_ResamplingConstants;
+    uint32_t m_RuntimeParamsStaticVersion = 0;
+
     std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
     std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
     std::shared_ptr<donut::engine::Scene> m_Scene;
@@ -142,6 +177,7 @@ private:
 
     void CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros);
     void ExecuteComputePass(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection);
+    void ExecuteComputePassIndirect(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, nvrhi::IBuffer* argumentBuffer, ProfilerSection::Enum profilerSection);
     void ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet = nullptr);
 
 public:
@@ -159,6 +195,8 @@ public:
         ibool enableRayCounts = true;
         ibool enablePermutationSampling = true;
         ibool visualizeRegirCells = false;
+        ibool enableLocalLightAliasTable = false;
+        ibool enableEnvironmentAliasTable = true;
 
         ColorDenoiserMode colorDenoiserMode = ColorDenoiserMode::DiffuseOnly;
 
@@ -214,6 +252,14 @@ public:
         
         ibool enableReGIR = true;
         uint32_t numRegirBuildSamples = 8;
+
+        // Number of frames over which all ReGIR cells are rebuilt, see rtxdi::Context::GetReGIRCellRefreshRange.
+        // 1 rebuilds all cells on every frame.
+        uint32_t regirRefreshInterval = 1;
+
+        // Builds only the ReGIR cells reachable from the visible surfaces, through an indirect dispatch.
+        // Applies to the Grid, AlignGrid and Onion modes, and replaces the amortized build.
+        ibool enableReGIROccupancyBuild = false;
         
         ibool enableGradients = true;
         float gradientLogDarknessBias = -12.f;
@@ -236,6 +282,8 @@ public:
         std::shared_ptr<Profiler> profiler,
         nvrhi::IBindingLayout* bindlessLayout);
 
+    ~LightingPasses();
+
     void CreatePipelines(const rtxdi::ContextParameters& contextParameters, bool useRayQuery);
 
     void CreateBindingSet(
@@ -252,6 +300,8 @@ public:
         const donut::engine::IView& previousView,
         const RenderSettings& localSettings,
         const rtxdi::FrameParameters& frameParameters,
+        bool lightsRelocated,
+        bool localLightsChanged,
         bool enableAccumulation);
 
     void RenderDirectLighting(
@@ -293,8 +343,20 @@ public:
     static donut::engine::ShaderMacro GetRegirMacro(const rtxdi::ContextParameters& contextParameters);
 
 private:
+    ResamplingConstants& ResetResamplingConstants(
+        rtxdi::Context& context,
+        const rtxdi::FrameParameters& frameParameters);
+
     void FillResamplingConstants(
         ResamplingConstants& constants,
         const RenderSettings& lightingSettings,
         const rtxdi::FrameParameters& frameParameters);
+
+    void FillReGIRBuildConstants(
+        ResamplingConstants& constants,
+        const rtxdi::Context& context,
+        const RenderSettings& localSettings,
+        const rtxdi::FrameParameters& frameParameters,
+        bool lightsRelocated,
+        bool localLightsChanged);
 };
@@ -0,0 +1,80 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+namespace tf
+{
+    class Executor;
+}
+
+inline size_t GetNumChunks(size_t count, size_t chunkSize)
+{
+    return (count + chunkSize - 1) / chunkSize;
+}
+
+// Calls func(chunkIndex, begin, end) for every chunk of [0, count), in parallel on the executor if there is one.
+// The chunks don't depend on the number of workers, so the results are the same with and without the executor
+// as long as every chunk only writes its own outputs.
+template<typename Func>
+void ParallelForChunks(tf::Executor* executor, size_t count, size_t chunkSize, const Func& func)
+{
+    const size_t numChunks = GetNumChunks(count, chunkSize);
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor && numChunks > 1)
+    {
+        tf::Taskflow taskflow;
+        for (size_t chunk = 0; chunk < numChunks; ++chunk)
+        {
+            taskflow.emplace([&func, chunk, chunkSize, count]()
+            {
+                func(chunk, chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+            });
+        }
+        executor->run(taskflow).wait();
+        return;
+    }
+#else
+    (void)executor;
+#endif
+
+    for (size_t chunk = 0; chunk < numChunks; ++chunk)
+        func(chunk, chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+}
+
+// Calls countFunc(chunkIndex, begin, end) for every chunk of [0, count), possibly in parallel, and returns the prefix sums
+// of the returned counts: element i is the sum of the counts of the chunks before chunk i, and the last element is the total.
+// Chunks that produce a variable number of outputs can then write them starting at element i in a second pass,
+// which gives the same output order as serial processing.
+template<typename CountFunc>
+std::vector<uint32_t> ParallelCountChunks(tf::Executor* executor, size_t count, size_t chunkSize, const CountFunc& countFunc)
+{
+    std::vector<uint32_t> offsets(GetNumChunks(count, chunkSize) + 1, 0);
+
+    ParallelForChunks(executor, count, chunkSize, [&](size_t chunk, size_t begin, size_t end)
+    {
+        offsets[chunk + 1] = countFunc(chunk, begin, end);
+    });
+
+    for (size_t chunk = 1; chunk < offsets.size(); ++chunk)
+        offsets[chunk] += offsets[chunk - 1];
+
+    return offsets;
+}
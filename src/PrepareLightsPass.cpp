@@ -9,6 +9,9 @@
  **************************************************************************/
 
 #include "PrepareLightsPass.h"
+#include "LightPacking.h"
+#include "ParallelFor.h"
+#include "PrepareLightsTasks.h"
 #include "RtxdiResources.h"
 #include "SampleScene.h"
 
@@ -19,6 +22,7 @@
 #include <rtxdi/RTXDI.h>
 
 #include <algorithm>
+#include <cstring>
 #include <utility>
 
 using namespace donut::math;
@@ -26,6 +30,8 @@ using namespace donut::math;
 
 using namespace donut::engine;
 
+// Granularity of the parallel loops over emitters
+static const size_t c_EmittersPerChunk = 1024;
 
 PrepareLightsPass::PrepareLightsPass(
     nvrhi::IDevice* device, 
@@ -46,6 +52,7 @@ PrepareLightsPass::PrepareLightsPass(
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(1),
         nvrhi::BindingLayoutItem::Texture_UAV(2),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(3),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
@@ -57,6 +64,9 @@ PrepareLightsPass::PrepareLightsPass(
     m_BindingLayout = m_Device->createBindingLayout(bindingLayoutDesc);
 }
 
+// Defined here because the cached light data types are only complete in this file
+PrepareLightsPass::~PrepareLightsPass() = default;
+
 void PrepareLightsPass::CreatePipeline()
 {
     donut::log::debug("Initializing PrepareLightsPass...");
@@ -77,6 +87,7 @@ void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources)
         nvrhi::BindingSetItem::StructuredBuffer_UAV(0, resources.LightDataBuffer),
         nvrhi::BindingSetItem::TypedBuffer_UAV(1, resources.LightIndexMappingBuffer),
         nvrhi::BindingSetItem::Texture_UAV(2, resources.LocalLightPdfTexture),
+        nvrhi::BindingSetItem::TypedBuffer_UAV(3, resources.VisibleLightIndexBuffer),
         nvrhi::BindingSetItem::StructuredBuffer_SRV(0, resources.TaskBuffer),
         nvrhi::BindingSetItem::StructuredBuffer_SRV(1, resources.PrimitiveLightBuffer),
         nvrhi::BindingSetItem::StructuredBuffer_SRV(2, m_Scene->GetInstanceBuffer()),
@@ -91,8 +102,22 @@ void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources)
     m_LightIndexMappingBuffer = resources.LightIndexMappingBuffer;
     m_GeometryInstanceToLightBuffer = resources.GeometryInstanceToLightBuffer;
     m_LocalLightPdfTexture = resources.LocalLightPdfTexture;
+    m_LightTreeNodeBuffer = resources.LightTreeNodeBuffer;
+    m_LightTreeTrailBuffer = resources.LightTreeTrailBuffer;
+    m_LocalLightAliasTableBuffer = resources.LocalLightAliasTableBuffer;
+    m_DirtyLocalLightMaskBuffer = resources.DirtyLocalLightMaskBuffer;
     m_MaxLightsInBuffer = uint32_t(resources.LightDataBuffer->getDesc().byteSize / (sizeof(PolymorphicLightInfo) * 2));
-    m_VisibleLightIndexBuffer = resources.VisibleLightIndexBuffer;
+
+    // The buffers have been recreated, so their contents can't be updated incrementally,
+    // and the lights can be placed anywhere.
+    m_LayoutCacheValid = false;
+    m_IdentityMapping = false;
+    m_LightSlots.Reset();
+    m_EmitterStates.clear();
+    m_MaxEmitters = resources.GetMaxEmissiveMeshes() + resources.GetMaxPrimitiveLights();
+    m_LightBoundsValid = false;
+    m_LightTreeValid = false;
+    m_AliasTableValid = false;
 }
 
 void PrepareLightsPass::CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles)
@@ -114,120 +139,31 @@ void PrepareLightsPass::CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t
     }
 }
 
-static inline uint floatToUInt(float _V, float _Scale)
-{
-    return (uint)floor(_V * _Scale + 0.5f);
-}
-
-static inline uint FLOAT3_to_R8G8B8_UNORM(float unpackedInputX, float unpackedInputY, float unpackedInputZ)
-{
-    return (floatToUInt(saturate(unpackedInputX), 0xFF) & 0xFF) |
-        ((floatToUInt(saturate(unpackedInputY), 0xFF) & 0xFF) << 8) |
-        ((floatToUInt(saturate(unpackedInputZ), 0xFF) & 0xFF) << 16);
-}
-
-static void packLightColor(const float3& color, PolymorphicLightInfo& lightInfo)
-{
-    float maxRadiance = std::max(color.x, std::max(color.y, color.z));
-
-    if (maxRadiance <= 0.f)
-        return;
-
-    float logRadiance = (::log2f(maxRadiance) - kPolymorphicLightMinLog2Radiance) / (kPolymorphicLightMaxLog2Radiance - kPolymorphicLightMinLog2Radiance);
-    logRadiance = saturate(logRadiance);
-    uint32_t packedRadiance = std::min(uint32_t(ceilf(logRadiance * 65534.f)) + 1, 0xffffu);
-    float unpackedRadiance = ::exp2f((float(packedRadiance - 1) / 65534.f) * (kPolymorphicLightMaxLog2Radiance - kPolymorphicLightMinLog2Radiance) + kPolymorphicLightMinLog2Radiance);
-
-    lightInfo.colorTypeAndFlags |= FLOAT3_to_R8G8B8_UNORM(color.x / unpackedRadiance, color.y / unpackedRadiance, color.z / unpackedRadiance);
-    lightInfo.logRadiance |= packedRadiance;
-}
-
-static float2 unitVectorToOctahedron(const float3 N)
-{
-    float m = abs(N.x) + abs(N.y) + abs(N.z);
-    float2 XY = { N.x, N.y };
-    XY.x /= m;
-    XY.y /= m;
-    if (N.z <= 0.0f)
-    {
-        float2 signs;
-        signs.x = XY.x >= 0.0f ? 1.0f : -1.0f;
-        signs.y = XY.y >= 0.0f ? 1.0f : -1.0f;
-        float x = (1.0f - abs(XY.y)) * signs.x;
-        float y = (1.0f - abs(XY.x)) * signs.y;
-        XY.x = x;
-        XY.y = y;
-    }
-    return { XY.x, XY.y };
-}
-
-static uint32_t packNormalizedVector(const float3 x)
-{
-    float2 XY = unitVectorToOctahedron(x);
-    XY.x = XY.x * .5f + .5f;
-    XY.y = XY.y * .5f + .5f;
-    uint X = floatToUInt(saturate(XY.x), (1 << 16) - 1);
-    uint Y = floatToUInt(saturate(XY.y), (1 << 16) - 1);
-    uint packedOutput = X;
-    packedOutput |= Y << 16;
-    return packedOutput;
-}
-
-// Modified from original, based on the method from the DX fallback layer sample
-static uint16_t fp32ToFp16(float v)
-{
-    // Multiplying by 2^-112 causes exponents below -14 to denormalize
-    static const union FU {
-        uint ui;
-        float f;
-    } multiple = { 0x07800000 }; // 2**-112
-
-    FU BiasedFloat;
-    BiasedFloat.f = v * multiple.f;
-    const uint u = BiasedFloat.ui;
-
-    const uint sign = u & 0x80000000;
-    uint body = u & 0x0fffffff;
-
-    return (uint16_t)(sign >> 16 | body >> 13) & 0xFFFF;
-}
-
-static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight)
+// Computes the parameters of an analytic light that only need to be packed, see LightPackingBatch.
+// Returns false for the light types that are not handled by the batch packing.
+static bool GetLightPackingInput(const donut::engine::Light& light, LightPackingInput& input)
 {
     switch (light.GetLightType())
     {
-    case LightType_Directional: {
-        auto& directional = static_cast<const donut::engine::DirectionalLight&>(light);
-        float halfAngularSizeRad = 0.5f * dm::radians(directional.angularSize);
-        float solidAngle = float(2 * dm::PI_d * (1.0 - cos(halfAngularSizeRad)));
-        float3 radiance = directional.color * directional.irradiance / solidAngle;
-
-        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kDirectional << kPolymorphicLightTypeShift;
-        packLightColor(radiance, polymorphic);
-        polymorphic.direction1 = packNormalizedVector(float3(normalize(directional.GetDirection())));
-        // Can't pass cosines of small angles reliably with fp16
-        polymorphic.scalars = fp32ToFp16(halfAngularSizeRad) | (fp32ToFp16(solidAngle) << 16);
-        return true;
-    }
     case LightType_Spot: {
         auto& spot = static_cast<const SpotLightWithProfile&>(light);
         float projectedArea = dm::PI_f * square(spot.radius);
         float3 radiance = spot.color * spot.intensity / projectedArea;
         float softness = saturate(1.f - spot.innerAngle / spot.outerAngle);
 
-        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kSphere << kPolymorphicLightTypeShift;
-        polymorphic.colorTypeAndFlags |= kPolymorphicLightShapingEnableBit;
-        packLightColor(radiance, polymorphic);
-        polymorphic.center = float3(spot.GetPosition());
-        polymorphic.scalars = fp32ToFp16(spot.radius);
-        polymorphic.primaryAxis = packNormalizedVector(float3(normalize(spot.GetDirection())));
-        polymorphic.cosConeAngleAndSoftness = fp32ToFp16(cosf(dm::radians(spot.outerAngle)));
-        polymorphic.cosConeAngleAndSoftness |= fp32ToFp16(softness) << 16;
+        input.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kSphere << kPolymorphicLightTypeShift;
+        input.colorTypeAndFlags |= kPolymorphicLightShapingEnableBit;
+        input.radiance = radiance;
+        input.center = float3(spot.GetPosition());
+        input.scalars[0] = spot.radius;
+        input.primaryAxis = float3(normalize(spot.GetDirection()));
+        input.cosConeAngleAndSoftness[0] = cosf(dm::radians(spot.outerAngle));
+        input.cosConeAngleAndSoftness[1] = softness;
 
         if (spot.profileTextureIndex >= 0)
         {
-            polymorphic.iesProfileIndex = spot.profileTextureIndex;
-            polymorphic.colorTypeAndFlags |= kPolymorphicLightIesProfileEnableBit;
+            input.iesProfileIndex = spot.profileTextureIndex;
+            input.colorTypeAndFlags |= kPolymorphicLightIesProfileEnableBit;
         }
 
         return true;
@@ -238,48 +174,34 @@ static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo
         {
             float3 flux = point.color * point.intensity;
 
-            polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kPoint << kPolymorphicLightTypeShift;
-            packLightColor(flux, polymorphic);
-            polymorphic.center = float3(point.GetPosition());
+            input.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kPoint << kPolymorphicLightTypeShift;
+            input.radiance = flux;
+            input.center = float3(point.GetPosition());
         }
         else
         {
             float projectedArea = dm::PI_f * square(point.radius);
             float3 radiance = point.color * point.intensity / projectedArea;
 
-            polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kSphere << kPolymorphicLightTypeShift;
-            packLightColor(radiance, polymorphic);
-            polymorphic.center = float3(point.GetPosition());
-            polymorphic.scalars = fp32ToFp16(point.radius);
+            input.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kSphere << kPolymorphicLightTypeShift;
+            input.radiance = radiance;
+            input.center = float3(point.GetPosition());
+            input.scalars[0] = point.radius;
         }
 
         return true;
     }
-    case LightType_Environment: {
-        auto& env = static_cast<const EnvironmentLight&>(light);
-
-        if (env.textureIndex < 0)
-            return false;
-        
-        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kEnvironment << kPolymorphicLightTypeShift;
-        packLightColor(env.radianceScale, polymorphic);
-        polymorphic.direction1 = (uint32_t)env.textureIndex;
-        polymorphic.scalars = fp32ToFp16(env.rotation);
-        if (enableImportanceSampledEnvironmentLight)
-            polymorphic.scalars |= (1 << 16);
-
-        return true;
-    }
     case LightType_Cylinder: {
         auto& cylinder = static_cast<const CylinderLight&>(light);
         float surfaceArea = 2.f * dm::PI_f * cylinder.radius * cylinder.length;
         float3 radiance = cylinder.color * cylinder.flux / surfaceArea;
 
-        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kCylinder << kPolymorphicLightTypeShift;
-        packLightColor(radiance, polymorphic); 
-        polymorphic.center = float3(cylinder.GetPosition());
-        polymorphic.scalars = fp32ToFp16(cylinder.radius) | (fp32ToFp16(cylinder.length) <<  16);
-        polymorphic.direction1 = packNormalizedVector(float3(normalize(cylinder.GetDirection())));
+        input.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kCylinder << kPolymorphicLightTypeShift;
+        input.radiance = radiance;
+        input.center = float3(cylinder.GetPosition());
+        input.scalars[0] = cylinder.radius;
+        input.scalars[1] = cylinder.length;
+        input.direction1 = float3(normalize(cylinder.GetDirection()));
 
         return true;
     }
@@ -288,11 +210,11 @@ static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo
         float surfaceArea = 2.f * dm::PI_f * dm::square(disk.radius);
         float3 radiance = disk.color * disk.flux / surfaceArea;
 
-        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kDisk << kPolymorphicLightTypeShift;
-        packLightColor(radiance, polymorphic);
-        polymorphic.center = float3(disk.GetPosition());
-        polymorphic.scalars = fp32ToFp16(disk.radius);
-        polymorphic.direction1 = packNormalizedVector(float3(normalize(disk.GetDirection())));
+        input.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kDisk << kPolymorphicLightTypeShift;
+        input.radiance = radiance;
+        input.center = float3(disk.GetPosition());
+        input.scalars[0] = disk.radius;
+        input.direction1 = float3(normalize(disk.GetDirection()));
 
         return true;
     }
@@ -308,14 +230,131 @@ static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo
 
         float3 right = normalize(localToWorld.m_linear.row0);
         float3 up = normalize(localToWorld.m_linear.row1);
-        float3 normal = normalize(-localToWorld.m_linear.row2);
 
-        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kRect << kPolymorphicLightTypeShift;
+        input.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kRect << kPolymorphicLightTypeShift;
+        input.radiance = radiance;
+        input.center = float3(rect.GetPosition());
+        input.scalars[0] = rect.width;
+        input.scalars[1] = rect.height;
+        input.direction1 = normalize(right);
+        input.direction2 = normalize(up);
+
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Same weights as calcLuminance in the shaders, so that the light tree power matches PolymorphicLight::getPower
+static float GetLuminance(const float3& color)
+{
+    return dot(color, float3(0.299f, 0.587f, 0.114f));
+}
+
+static rtxdi::float3 ToRtxdiFloat3(const float3& v)
+{
+    return { v.x, v.y, v.z };
+}
+
+// Computes the light tree bounds of an analytic light. The power is the same as PolymorphicLight::getPower,
+// except that the shaping of spot lights is only represented by the emission cone.
+static rtxdi::LightTreeLightBounds GetLightTreeBounds(const LightPackingInput& input)
+{
+    rtxdi::LightTreeLightBounds bounds;
+    const float luminance = GetLuminance(input.radiance);
+    float3 extent = 0.f;
+
+    switch (PolymorphicLightType((input.colorTypeAndFlags >> kPolymorphicLightTypeShift) & kPolymorphicLightTypeMask))
+    {
+    case PolymorphicLightType::kPoint:
+        bounds.power = 4.f * dm::PI_f * luminance;
+        break;
+
+    case PolymorphicLightType::kSphere: {
+        const float radius = input.scalars[0];
+        extent = radius;
+        bounds.power = 4.f * dm::PI_f * square(radius) * dm::PI_f * luminance;
+
+        if (input.colorTypeAndFlags & kPolymorphicLightShapingEnableBit)
+        {
+            bounds.axis = ToRtxdiFloat3(input.primaryAxis);
+            bounds.cosThetaO = 1.f;
+            bounds.cosThetaE = input.cosConeAngleAndSoftness[0];
+        }
+        break;
+    }
+    case PolymorphicLightType::kCylinder: {
+        const float radius = input.scalars[0];
+        const float length = input.scalars[1];
+        extent = abs(input.direction1) * (0.5f * length) + radius;
+        bounds.power = 2.f * dm::PI_f * radius * length * dm::PI_f * luminance;
+        break;
+    }
+    case PolymorphicLightType::kDisk: {
+        const float radius = input.scalars[0];
+        extent = radius;
+        bounds.axis = ToRtxdiFloat3(input.direction1);
+        bounds.cosThetaO = 1.f;
+        bounds.cosThetaE = 0.f;
+        bounds.power = dm::PI_f * square(radius) * dm::PI_f * luminance;
+        break;
+    }
+    case PolymorphicLightType::kRect: {
+        const float width = input.scalars[0];
+        const float height = input.scalars[1];
+        extent = (abs(input.direction1) * width + abs(input.direction2) * height) * 0.5f;
+        bounds.axis = ToRtxdiFloat3(normalize(cross(input.direction1, input.direction2)));
+        bounds.cosThetaO = 1.f;
+        bounds.cosThetaE = 0.f;
+        bounds.power = width * height * dm::PI_f * luminance;
+        break;
+    }
+    default:
+        return rtxdi::LightTreeLightBounds();
+    }
+
+    bounds.boundsMin = ToRtxdiFloat3(input.center - extent);
+    bounds.boundsMax = ToRtxdiFloat3(input.center + extent);
+    return bounds;
+}
+
+static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight)
+{
+    LightPackingInput packingInput;
+    if (GetLightPackingInput(light, packingInput))
+    {
+        PackLight(packingInput, polymorphic);
+        return true;
+    }
+
+    switch (light.GetLightType())
+    {
+    case LightType_Directional: {
+        auto& directional = static_cast<const donut::engine::DirectionalLight&>(light);
+        float halfAngularSizeRad = 0.5f * dm::radians(directional.angularSize);
+        float solidAngle = float(2 * dm::PI_d * (1.0 - cos(halfAngularSizeRad)));
+        float3 radiance = directional.color * directional.irradiance / solidAngle;
+
+        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kDirectional << kPolymorphicLightTypeShift;
         packLightColor(radiance, polymorphic);
-        polymorphic.center = float3(rect.GetPosition());
-        polymorphic.scalars = fp32ToFp16(rect.width) | (fp32ToFp16(rect.height) << 16);
-        polymorphic.direction1 = packNormalizedVector(normalize(right));
-        polymorphic.direction2 = packNormalizedVector(normalize(up));
+        polymorphic.direction1 = packNormalizedVector(float3(normalize(directional.GetDirection())));
+        // Can't pass cosines of small angles reliably with fp16
+        polymorphic.scalars = fp32ToFp16(halfAngularSizeRad) | (fp32ToFp16(solidAngle) << 16);
+        return true;
+    }
+    case LightType_Environment: {
+        auto& env = static_cast<const EnvironmentLight&>(light);
+
+        if (env.textureIndex < 0)
+            return false;
+        
+        polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kEnvironment << kPolymorphicLightTypeShift;
+        packLightColor(env.radianceScale, polymorphic);
+        polymorphic.direction1 = (uint32_t)env.textureIndex;
+        polymorphic.scalars = fp32ToFp16(env.rotation);
+        if (enableImportanceSampledEnvironmentLight)
+            polymorphic.scalars |= (1 << 16);
 
         return true;
     }
@@ -339,162 +378,683 @@ static int isInfiniteLight(const donut::engine::Light& light)
     }
 }
 
-void PrepareLightsPass::Process(
-    nvrhi::ICommandList* commandList, 
-    const rtxdi::Context& context,
-    const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
-    bool enableImportanceSampledEnvironmentLight,
-    rtxdi::FrameParameters& outFrameParameters)
+static bool IsEmissiveMaterial(const Material& material)
 {
-    const rtxdi::ContextParameters& contextParameters = context.GetParameters();
+    return any(material.emissiveColor != 0.f) && material.emissiveIntensity > 0.f;
+}
 
-    commandList->beginMarker("PrepareLights");
+static bool IsEmissiveGeometry(const MeshGeometry& geometry)
+{
+    return IsEmissiveMaterial(*geometry.material) && geometry.numIndices >= 3;
+}
 
-    std::vector<PrepareLightsTask> tasks;
-    std::vector<PolymorphicLightInfo> primitiveLightInfos;
-    uint32_t lightBufferOffset = 0;
-    uint32_t numEmissionInstance = 0;
-    std::vector<uint32_t> geometryInstanceToLight(m_Scene->GetSceneGraph()->GetGeometryInstancesCount(), RTXDI_INVALID_LIGHT_INDEX);
-    std::vector<uint32_t> visibleLightIndex;
+// The mesh instances of the donut scene graph for GatherGeometryEmitters
+class SceneGraphEmitterView : public EmitterSceneView
+{
+private:
+    const std::vector<std::shared_ptr<MeshInstance>>& m_Instances;
+    const std::vector<StableId>& m_InstanceIds;
+
+public:
+    SceneGraphEmitterView(const std::vector<std::shared_ptr<MeshInstance>>& instances, const std::vector<StableId>& instanceIds)
+        : m_Instances(instances)
+        , m_InstanceIds(instanceIds)
+    {
+        assert(instanceIds.size() == instances.size());
+    }
 
-    const auto& instances = m_Scene->GetSceneGraph()->GetMeshInstances();
-    for (const auto& instance : instances)
+    size_t GetInstanceCount() const override { return m_Instances.size(); }
+    StableId GetInstanceId(size_t instance) const override { return m_InstanceIds[instance]; }
+    uint32_t GetInstanceIndex(size_t instance) const override { return m_Instances[instance]->GetInstanceIndex(); }
+    uint32_t GetFirstGeometryInstanceIndex(size_t instance) const override { return m_Instances[instance]->GetGeometryInstanceIndex(); }
+    uint32_t GetGeometryCount(size_t instance) const override { return uint32_t(m_Instances[instance]->GetMesh()->geometries.size()); }
+
+    uint32_t GetEmissiveTriangleCount(size_t instance, uint32_t geometryIndex) const override
     {
-        const auto& mesh = instance->GetMesh();
+        const MeshGeometry& geometry = *m_Instances[instance]->GetMesh()->geometries[geometryIndex];
+        return IsEmissiveGeometry(geometry) ? geometry.numIndices / 3 : 0;
+    }
+};
 
-        assert(instance->GetGeometryInstanceIndex() < geometryInstanceToLight.size());
-        uint32_t firstGeometryInstanceIndex = instance->GetGeometryInstanceIndex();
-        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
-        {
-            const auto& geometry = mesh->geometries[geometryIndex];
+bool PrepareLightsPass::UpdateEmitterState(EmitterState& state)
+{
+    const auto& geometry = state.instance->GetMesh()->geometries[state.geometryIndex];
+    const Material& material = *geometry->material;
 
-            size_t instanceHash = 0;
-            nvrhi::hash_combine(instanceHash, instance.get());
-            nvrhi::hash_combine(instanceHash, geometryIndex);
+    affine3 transform = affine3::identity();
+    if (auto node = state.instance->GetNode())
+        transform = node->GetLocalToWorldTransformFloat();
 
-            if (!any(geometry->material->emissiveColor != 0.f) || geometry->material->emissiveIntensity <= 0.f)
-            {
-                // remove the info about this instance, just in case it was emissive and now it's not
-                m_InstanceLightBufferOffsets.erase(instanceHash);
-                continue;
-            }
+    const float3 emissiveRadiance = material.emissiveColor * material.emissiveIntensity;
+    const void* emissiveTexture = material.emissiveTexture.get();
+    const uint32_t skinningFrameIndex = state.skinnedInstance ? state.skinnedInstance->GetLastUpdateFrameIndex() : 0;
+
+    const bool changed = !(transform == state.transform)
+        || any(emissiveRadiance != state.emissiveRadiance)
+        || emissiveTexture != state.emissiveTexture
+        || skinningFrameIndex != state.skinningFrameIndex;
+
+    state.transform = transform;
+    state.emissiveRadiance = emissiveRadiance;
+    state.emissiveTexture = emissiveTexture;
+    state.skinningFrameIndex = skinningFrameIndex;
+
+    return changed;
+}
+
+bool PrepareLightsPass::IsLayoutCacheValid(bool enableImportanceSampledEnvironmentLight) const
+{
+    if (!m_LayoutCacheValid || enableImportanceSampledEnvironmentLight != m_CachedEnvironmentImportanceSampling)
+        return false;
 
-            geometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = lightBufferOffset;
-            visibleLightIndex.push_back(lightBufferOffset);
+    // Added, removed and replaced mesh instances and lights are found through their IDs
+    const auto& sceneGraph = m_Scene->GetSceneGraph();
+    if (sceneGraph->GetGeometryInstancesCount() != m_CachedGeometryInstanceCount)
+        return false;
 
-            // find the previous offset of this instance in the light buffer
-            auto pOffset = m_InstanceLightBufferOffsets.find(instanceHash);
+    // A material that becomes emissive or stops being emissive adds or removes emitters
+    size_t materialIndex = 0;
+    for (const auto& material : sceneGraph->GetMaterials())
+    {
+        if (materialIndex >= m_CachedMaterialEmissive.size())
+            return false;
 
-            assert(geometryIndex < 0xfff);
+        const auto& [cachedMaterial, cachedEmissive] = m_CachedMaterialEmissive[materialIndex];
+        if (cachedMaterial != material.get() || cachedEmissive != IsEmissiveMaterial(*material))
+            return false;
 
-            PrepareLightsTask task;
-            task.instanceAndGeometryIndex = (instance->GetInstanceIndex() << 12) | uint32_t(geometryIndex & 0xfff);
-            task.lightBufferOffset = lightBufferOffset;
-            task.triangleCount = geometry->numIndices / 3;
-            task.previousLightBufferOffset = (pOffset != m_InstanceLightBufferOffsets.end()) ? int(pOffset->second) : -1;
+        ++materialIndex;
+    }
 
-            // record the current offset of this instance for use on the next frame
-            m_InstanceLightBufferOffsets[instanceHash] = lightBufferOffset;
+    return materialIndex == m_CachedMaterialEmissive.size();
+}
 
-            lightBufferOffset += task.triangleCount;
+// Collects the parts of 'ranges' that are free in the allocator, sorted and merged.
+static void ClipToFreeRanges(
+    const std::vector<std::pair<uint32_t, uint32_t>>& ranges,
+    const LightSlotAllocator& allocator,
+    std::vector<std::pair<uint32_t, uint32_t>>& outRanges)
+{
+    const auto& freeRanges = allocator.GetFreeRanges();
+
+    for (const auto& [offset, count] : ranges)
+    {
+        auto it = freeRanges.upper_bound(offset);
+        if (it != freeRanges.begin())
+            --it;
 
-            tasks.push_back(task);
-            numEmissionInstance++;
+        for (; it != freeRanges.end() && it->first < offset + count; ++it)
+        {
+            const uint32_t begin = std::max(offset, it->first);
+            const uint32_t end = std::min(offset + count, it->first + it->second);
+            if (begin < end)
+                outRanges.push_back({ begin, end - begin });
         }
     }
 
-    commandList->writeBuffer(m_GeometryInstanceToLightBuffer, geometryInstanceToLight.data(), geometryInstanceToLight.size() * sizeof(uint32_t));
+    std::sort(outRanges.begin(), outRanges.end());
 
-    outFrameParameters.firstLocalLight = 0;
-    outFrameParameters.numLocalLights = lightBufferOffset;
+    // Merge the overlapping ranges
+    size_t numMerged = 0;
+    for (const auto& range : outRanges)
+    {
+        if (numMerged > 0 && outRanges[numMerged - 1].first + outRanges[numMerged - 1].second >= range.first)
+        {
+            auto& last = outRanges[numMerged - 1];
+            last.second = std::max(last.first + last.second, range.first + range.second) - last.first;
+        }
+        else
+            outRanges[numMerged++] = range;
+    }
+    outRanges.resize(numMerged);
+}
 
-    auto sortedLights = sceneLights;
-    std::sort(sortedLights.begin(), sortedLights.end(), [](const auto& a, const auto& b) 
-        { return isInfiniteLight(*a) < isInfiniteLight(*b); });
+void PrepareLightsPass::ProcessLayoutUpdate(nvrhi::ICommandList* commandList, bool enableImportanceSampledEnvironmentLight, bool enableIncrementalUpdates)
+{
+    const auto& sceneGraph = m_Scene->GetSceneGraph();
 
-    uint32_t numFinitePrimLights = 0;
+    // Infinite lights are placed at the end of the light buffer, in the sorted order.
+    // Local lights are allocated below them, so that both ranges stay contiguous.
     uint32_t numInfinitePrimLights = 0;
     uint32_t numImportanceSampledEnvironmentLights = 0;
+    for (const Light* pLight : m_FramePrimitiveLights)
+    {
+        if (!isInfiniteLight(*pLight))
+            continue;
+
+        if (pLight->GetLightType() == LightType_Environment && enableImportanceSampledEnvironmentLight)
+            numImportanceSampledEnvironmentLights++;
+        else
+            numInfinitePrimLights++;
+    }
+
+    assert(numImportanceSampledEnvironmentLights <= 1);
+
+    const uint32_t numInfiniteLightSlots = numInfinitePrimLights + numImportanceSampledEnvironmentLights;
+    assert(numInfiniteLightSlots <= m_MaxLightsInBuffer);
+    const uint32_t firstInfiniteLightSlot = m_MaxLightsInBuffer - numInfiniteLightSlots;
+
+    // An in-place update keeps the light buffer half and only writes the new, changed and removed emitters.
+    // When some lights need to move, the update relocates: it writes all lights into the other half
+    // and maps the previous frame's lights onto the new ones. The contents of the buffers
+    // are only known to be valid if the previous update was done with the same bindings.
+    bool relocate = !enableIncrementalUpdates || !m_LayoutCacheValid;
+
+    // Find the emissive geometries. Emitters that are not found here, e.g. because they are not emissive anymore,
+    // are released by the slot table.
+    const auto& instances = sceneGraph->GetMeshInstances();
+    const SceneGraphEmitterView sceneView(instances, m_InstanceIds.GetIds());
 
-    for (const std::shared_ptr<Light>& pLight : sortedLights)
+    std::vector<LayoutEmitter> emitters;
+    GatherGeometryEmitters(m_Executor, sceneView, emitters);
+    const size_t numGeometryEmitters = emitters.size();
+
+    emitters.reserve(emitters.size() + m_FramePrimitiveLights.size());
+    for (size_t primitiveLightIndex = 0; primitiveLightIndex < m_FramePrimitiveLights.size(); ++primitiveLightIndex)
     {
-        PolymorphicLightInfo polymorphicLight = {};
+        const Light* pLight = m_FramePrimitiveLights[primitiveLightIndex];
+
+        LayoutEmitter emitter;
+        emitter.owner = m_LightIds.GetIds()[primitiveLightIndex];
+        emitter.instance = uint32_t(primitiveLightIndex);
+        emitter.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(primitiveLightIndex);
+        // For primitive lights, technically zero, but we need to allocate 1 thread in the grid to process this light
+        emitter.count = 1;
+        emitter.infinite = isInfiniteLight(*pLight) != 0;
+        emitters.push_back(emitter);
+    }
 
-        if (!ConvertLight(*pLight, polymorphicLight, enableImportanceSampledEnvironmentLight))
-            continue;
+    std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+    relocate |= m_LightSlots.Update(m_Executor, emitters, uint32_t(sceneGraph->GetGeometryInstancesCount()), firstInfiniteLightSlot, freedRanges);
+
+    const LightSlotAllocator& slotAllocator = m_LightSlots.GetSlotAllocator();
+    m_EmitterStates.resize(m_LightSlots.GetEmitterIndexCount());
+
+    // Find the geometry emitters that have changed. New emitters start from an empty state, and every emitter
+    // has its own state, so this can run in parallel. The indices of primitive lights in the primitive light buffer
+    // change with the set of lights, so they are always processed.
+    std::vector<uint8_t> emitterDirty(emitters.size(), 1);
+    ParallelForChunks(m_Executor, numGeometryEmitters, c_EmittersPerChunk, [&](size_t chunk, size_t begin, size_t end)
+    {
+        for (size_t index = begin; index < end; ++index)
+        {
+            const LayoutEmitter& emitter = emitters[index];
+            EmitterState& state = m_EmitterStates[emitter.emitterIndex];
+            const bool isNew = emitter.previousLightBufferOffset < 0;
+
+            if (isNew)
+            {
+                const MeshInstance* instance = instances[emitter.instance].get();
+                state = EmitterState();
+                state.instance = instance;
+                state.skinnedInstance = dynamic_cast<const SkinnedMeshInstance*>(instance);
+                state.geometryIndex = emitter.geometryIndex;
+            }
 
-        // find the previous offset of this instance in the light buffer
-        auto pOffset = m_PrimitiveLightBufferOffsets.find(pLight.get());
+            const bool changed = UpdateEmitterState(state);
+            emitterDirty[index] = (changed || isNew) ? 1 : 0;
+        }
+    });
 
+    if (relocate)
+    {
+        m_CurrentFrameLightOffset = m_MaxLightsInBuffer * m_OddFrame;
+        m_OddFrame = !m_OddFrame;
+    }
+    else
+    {
+        m_CurrentFrameLightOffset = m_PreviousFrameLightOffset;
+    }
+
+    // Build the tasks in light buffer order
+    std::vector<uint32_t> geometryInstanceToLight;
+    BuildLayoutTasks(m_Executor, emitters, uint32_t(sceneGraph->GetGeometryInstancesCount()), m_Tasks, geometryInstanceToLight);
+
+    // In place, the lights that are not new keep their offsets and the mapping is the identity,
+    // except on the first update after a relocation where the mapping still points at the other half
+    m_DirtyTasks.clear();
+    for (size_t index = 0; index < emitters.size(); ++index)
+    {
+        if (relocate || emitterDirty[index] || !m_IdentityMapping)
+            m_DirtyTasks.push_back(m_Tasks[index]);
+    }
+
+    // Clear the slots that have been released and not reused, and on relocation, all the holes
+    // in the local light range, because the other half of the buffer contains older lights there.
+    std::vector<std::pair<uint32_t, uint32_t>> emptyRanges;
+    if (relocate)
+    {
+        for (const auto& [offset, count] : slotAllocator.GetFreeRanges())
+        {
+            if (offset < slotAllocator.GetUsedRangeEnd())
+                freedRanges.push_back({ offset, count });
+        }
+    }
+    ClipToFreeRanges(freedRanges, slotAllocator, emptyRanges);
+
+    for (const auto& [offset, count] : emptyRanges)
+    {
         PrepareLightsTask task;
-        task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(primitiveLightInfos.size());
-        task.lightBufferOffset = lightBufferOffset;
-        task.triangleCount = 1; // technically zero, but we need to allocate 1 thread in the grid to process this light
-        task.previousLightBufferOffset = (pOffset != m_PrimitiveLightBufferOffsets.end()) ? pOffset->second : -1;
+        task.instanceAndGeometryIndex = TASK_EMPTY_SLOTS;
+        task.lightBufferOffset = offset;
+        task.triangleCount = count;
+        task.previousLightBufferOffset = -1;
+        task.emitterIndex = TASK_EMPTY_SLOTS;
+        m_DirtyTasks.push_back(task);
+    }
 
-        // record the current offset of this instance for use on the next frame
-        m_PrimitiveLightBufferOffsets[pLight.get()] = lightBufferOffset;
+    auto byLightBufferOffset = [](const PrepareLightsTask& a, const PrepareLightsTask& b)
+        { return a.lightBufferOffset < b.lightBufferOffset; };
 
-        visibleLightIndex.push_back(lightBufferOffset);
-        lightBufferOffset += task.triangleCount;
+    std::sort(m_Tasks.begin(), m_Tasks.end(), byLightBufferOffset);
+    std::sort(m_DirtyTasks.begin(), m_DirtyTasks.end(), byLightBufferOffset);
 
-        tasks.push_back(task);
-        primitiveLightInfos.push_back(polymorphicLight);
+    uint32_t numDirtyThreads = 0;
+    for (PrepareLightsTask& task : m_DirtyTasks)
+    {
+        task.dispatchOffset = numDirtyThreads;
+        numDirtyThreads += task.triangleCount;
+    }
 
-        if (pLight->GetLightType() == LightType_Environment && enableImportanceSampledEnvironmentLight)
-            numImportanceSampledEnvironmentLights++;
-        else if (isInfiniteLight(*pLight))
-            numInfinitePrimLights++;
-        else
-            numFinitePrimLights++;
+    commandList->writeBuffer(m_GeometryInstanceToLightBuffer, geometryInstanceToLight.data(), geometryInstanceToLight.size() * sizeof(uint32_t));
+
+    if (!m_FramePrimitiveLightInfos.empty())
+    {
+        commandList->writeBuffer(m_PrimitiveLightBuffer, m_FramePrimitiveLightInfos.data(), m_FramePrimitiveLightInfos.size() * sizeof(PolymorphicLightInfo));
     }
 
-    commandList->writeBuffer(m_VisibleLightIndexBuffer, visibleLightIndex.data(), visibleLightIndex.size() * sizeof(uint32_t));
+    if (relocate)
+    {
+        // clear the mapping buffer - value of 0 means all mappings are invalid
+        commandList->clearBufferUInt(m_LightIndexMappingBuffer, 0);
 
-    assert(numImportanceSampledEnvironmentLights <= 1);
-    
-    outFrameParameters.numLocalLights += numFinitePrimLights;
-    outFrameParameters.firstInfiniteLight = outFrameParameters.numLocalLights;
-    outFrameParameters.numInfiniteLights = numInfinitePrimLights;
-    outFrameParameters.environmentLightIndex = outFrameParameters.firstInfiniteLight + outFrameParameters.numInfiniteLights;
-    outFrameParameters.environmentLightPresent = numImportanceSampledEnvironmentLights;
-    
-    commandList->writeBuffer(m_TaskBuffer, tasks.data(), tasks.size() * sizeof(PrepareLightsTask));
+        // Clear the PDF texture mip 0 - not all of it might be written by this shader
+        commandList->clearTextureFloat(m_LocalLightPdfTexture, 
+            nvrhi::TextureSubresourceSet(0, 1, 0, 1), 
+            nvrhi::Color(0.f));
+    }
 
-    if (!primitiveLightInfos.empty())
+    if (!m_DirtyTasks.empty())
     {
-        commandList->writeBuffer(m_PrimitiveLightBuffer, primitiveLightInfos.data(), primitiveLightInfos.size() * sizeof(PolymorphicLightInfo));
+        commandList->writeBuffer(m_TaskBuffer, m_DirtyTasks.data(), m_DirtyTasks.size() * sizeof(PrepareLightsTask));
+
+        DispatchTasks(commandList, uint32_t(m_DirtyTasks.size()), numDirtyThreads);
     }
 
-    // clear the mapping buffer - value of 0 means all mappings are invalid
-    commandList->clearBufferUInt(m_LightIndexMappingBuffer, 0);
+    m_NumLocalLights = slotAllocator.GetUsedRangeEnd();
+    m_FirstInfiniteLight = firstInfiniteLightSlot;
+    m_NumInfiniteLights = numInfinitePrimLights;
+    m_EnvironmentLightPresent = numImportanceSampledEnvironmentLights != 0;
+
+    m_LayoutCacheValid = enableIncrementalUpdates;
+    m_IdentityMapping = !relocate;
 
-    // Clear the PDF texture mip 0 - not all of it might be written by this shader
-    commandList->clearTextureFloat(m_LocalLightPdfTexture, 
-        nvrhi::TextureSubresourceSet(0, 1, 0, 1), 
-        nvrhi::Color(0.f));
+    if (enableIncrementalUpdates)
+    {
+        m_CachedGeometryInstanceCount = sceneGraph->GetGeometryInstancesCount();
+        m_CachedEnvironmentImportanceSampling = enableImportanceSampledEnvironmentLight;
+        m_CachedPrimitiveLightInfos = m_FramePrimitiveLightInfos;
 
+        m_CachedMaterialEmissive.clear();
+        for (const auto& material : sceneGraph->GetMaterials())
+            m_CachedMaterialEmissive.push_back({ material.get(), IsEmissiveMaterial(*material) });
+    }
+}
+
+void PrepareLightsPass::ProcessIncremental(nvrhi::ICommandList* commandList)
+{
+    // On the first frame after a relocating update, the index mapping buffer still maps between the two halves
+    // of the light buffer. Process all lights once in place to replace it with the identity mapping.
+    const bool processAllLights = !m_IdentityMapping;
+
+    // Find the changed emitters in chunks, possibly in parallel
+    std::vector<uint8_t> chunkPrimitiveLightsChanged(GetNumChunks(m_Tasks.size(), c_EmittersPerChunk), 0);
+    m_TaskDirty.resize(m_Tasks.size());
+
+    ParallelForChunks(m_Executor, m_Tasks.size(), c_EmittersPerChunk, [&](size_t chunkIndex, size_t begin, size_t end)
+    {
+        for (size_t index = begin; index < end; ++index)
+        {
+            const PrepareLightsTask& task = m_Tasks[index];
+
+            bool dirty;
+            if (task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT)
+            {
+                const uint32_t primitiveLightIndex = task.instanceAndGeometryIndex & ~TASK_PRIMITIVE_LIGHT_BIT;
+                dirty = memcmp(&m_FramePrimitiveLightInfos[primitiveLightIndex], &m_CachedPrimitiveLightInfos[primitiveLightIndex], sizeof(PolymorphicLightInfo)) != 0;
+                chunkPrimitiveLightsChanged[chunkIndex] |= dirty ? 1 : 0;
+            }
+            else
+            {
+                dirty = UpdateEmitterState(m_EmitterStates[task.emitterIndex]);
+            }
+
+            m_TaskDirty[index] = (dirty || processAllLights) ? 1 : 0;
+        }
+    });
+
+    const bool primitiveLightsChanged = std::find(chunkPrimitiveLightsChanged.begin(), chunkPrimitiveLightsChanged.end(), 1) != chunkPrimitiveLightsChanged.end();
+    const uint32_t numDirtyThreads = BuildInPlaceDirtyTasks(m_Executor, m_Tasks, m_TaskDirty, m_DirtyTasks);
+
+    if (primitiveLightsChanged)
+    {
+        commandList->writeBuffer(m_PrimitiveLightBuffer, m_FramePrimitiveLightInfos.data(), m_FramePrimitiveLightInfos.size() * sizeof(PolymorphicLightInfo));
+        m_CachedPrimitiveLightInfos = m_FramePrimitiveLightInfos;
+    }
+
+    if (!m_DirtyTasks.empty())
+    {
+        commandList->writeBuffer(m_TaskBuffer, m_DirtyTasks.data(), m_DirtyTasks.size() * sizeof(PrepareLightsTask));
+
+        DispatchTasks(commandList, uint32_t(m_DirtyTasks.size()), numDirtyThreads);
+    }
+
+    m_IdentityMapping = true;
+}
+
+void PrepareLightsPass::DispatchTasks(nvrhi::ICommandList* commandList, uint32_t numTasks, uint32_t numThreads)
+{
     nvrhi::ComputeState state;
     state.pipeline = m_ComputePipeline;
     state.bindings = { m_BindingSet, m_Scene->GetDescriptorTable() };
     commandList->setComputeState(state);
 
     PrepareLightsConstants constants;
-    constants.numTasks = uint32_t(tasks.size());
-    constants.currentFrameLightOffset = m_MaxLightsInBuffer * m_OddFrame;
-    constants.previousFrameLightOffset = m_MaxLightsInBuffer * !m_OddFrame;
+    constants.numTasks = numTasks;
+    constants.currentFrameLightOffset = m_CurrentFrameLightOffset;
+    constants.previousFrameLightOffset = m_PreviousFrameLightOffset;
     commandList->setPushConstants(&constants, sizeof(constants));
 
-    commandList->dispatch(dm::div_ceil(lightBufferOffset, 256));
+    commandList->dispatch(dm::div_ceil(numThreads, 256));
+}
 
-    commandList->endMarker();
+// Writes the light tree bounds of all lights in the slot range of the task into m_LightTreeBounds.
+void PrepareLightsPass::ComputeLightTreeBounds(const PrepareLightsTask& task)
+{
+    // Infinite lights are not in the tree
+    if (task.instanceAndGeometryIndex == TASK_EMPTY_SLOTS || task.lightBufferOffset >= m_LightTreeBounds.size())
+        return;
+
+    rtxdi::LightTreeLightBounds* outBounds = m_LightTreeBounds.data() + task.lightBufferOffset;
+
+    if (task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT)
+    {
+        const Light& light = *m_FramePrimitiveLights[task.instanceAndGeometryIndex & ~TASK_PRIMITIVE_LIGHT_BIT];
+
+        LightPackingInput packingInput;
+        *outBounds = GetLightPackingInput(light, packingInput) ? GetLightTreeBounds(packingInput) : rtxdi::LightTreeLightBounds();
+        return;
+    }
+
+    const EmitterState& state = m_EmitterStates[task.emitterIndex];
+    const auto& mesh = state.instance->GetMesh();
+    const auto& geometry = mesh->geometries[state.geometryIndex];
+    const float luminance = GetLuminance(state.emissiveRadiance);
+    const auto& buffers = mesh->buffers;
+
+    // Skinned meshes don't have their current vertex positions on the CPU, and meshes may have dropped their CPU data.
+    // Those emitters are bounded by their node, with all triangles emitting in all directions,
+    // and the total power is estimated from the surface area of the bounding box.
+    if (state.skinnedInstance || !buffers || buffers->positionData.empty() || buffers->indexData.empty())
+    {
+        box3 worldBounds = geometry->objectSpaceBounds;
+        if (auto node = state.instance->GetNode())
+            worldBounds = node->GetGlobalBoundingBox();
+
+        const float3 diagonal = worldBounds.diagonal();
+        const float boxArea = 2.f * (diagonal.x * diagonal.y + diagonal.y * diagonal.z + diagonal.z * diagonal.x);
+        const float trianglePower = 0.5f * boxArea * dm::PI_f * luminance / float(std::max(task.triangleCount, 1u));
+
+        rtxdi::LightTreeLightBounds bounds;
+        bounds.boundsMin = ToRtxdiFloat3(worldBounds.m_mins);
+        bounds.boundsMax = ToRtxdiFloat3(worldBounds.m_maxs);
+        bounds.power = trianglePower > 0.f ? trianglePower : 1e-6f; // emitters must stay in the tree to be sampled at all
+
+        std::fill(outBounds, outBounds + task.triangleCount, bounds);
+        return;
+    }
+
+    // Same vertices and winding as in PrepareLights.hlsl, the triangles emit on the side of cross(e1, e2)
+    const uint32_t* indices = buffers->indexData.data() + mesh->indexOffset + geometry->indexOffsetInMesh;
+    const float3* positions = buffers->positionData.data() + mesh->vertexOffset + geometry->vertexOffsetInMesh;
 
-    outFrameParameters.firstLocalLight += constants.currentFrameLightOffset;
-    outFrameParameters.firstInfiniteLight += constants.currentFrameLightOffset;
-    outFrameParameters.environmentLightIndex += constants.currentFrameLightOffset;
+    for (uint32_t triangleIndex = 0; triangleIndex < task.triangleCount; ++triangleIndex)
+    {
+        const float3 p0 = state.transform.transformPoint(positions[indices[triangleIndex * 3 + 0]]);
+        const float3 p1 = state.transform.transformPoint(positions[indices[triangleIndex * 3 + 1]]);
+        const float3 p2 = state.transform.transformPoint(positions[indices[triangleIndex * 3 + 2]]);
+
+        const float3 normal = cross(p1 - p0, p2 - p0);
+        const float normalLength = length(normal);
+
+        rtxdi::LightTreeLightBounds& bounds = outBounds[triangleIndex];
+        bounds = rtxdi::LightTreeLightBounds();
+        bounds.boundsMin = ToRtxdiFloat3(min(p0, min(p1, p2)));
+        bounds.boundsMax = ToRtxdiFloat3(max(p0, max(p1, p2)));
+
+        // Degenerate triangles have zero power in the shaders as well
+        if (normalLength > 0.f)
+        {
+            bounds.axis = ToRtxdiFloat3(normal / normalLength);
+            bounds.cosThetaO = 1.f;
+            bounds.cosThetaE = 0.f;
+            bounds.power = 0.5f * normalLength * dm::PI_f * luminance;
+        }
+    }
+}
+
+// Computes the bounds and power of all local lights on layout updates, or of the lights of the changed emitters otherwise.
+void PrepareLightsPass::UpdateLocalLightBounds(bool rebuild)
+{
+    if (rebuild)
+    {
+        m_LightTreeBounds.assign(m_NumLocalLights, rtxdi::LightTreeLightBounds());
+
+        ParallelForChunks(m_Executor, m_Tasks.size(), c_EmittersPerChunk, [this](size_t chunk, size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; ++index)
+                ComputeLightTreeBounds(m_Tasks[index]);
+        });
+    }
+    else
+    {
+        ParallelForChunks(m_Executor, m_DirtyTasks.size(), c_EmittersPerChunk, [this](size_t chunk, size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; ++index)
+                ComputeLightTreeBounds(m_DirtyTasks[index]);
+        });
+    }
+}
+
+void PrepareLightsPass::UpdateLightTree(nvrhi::ICommandList* commandList, bool rebuild)
+{
+    if (rebuild)
+    {
+        m_LightTree.Build(m_LightTreeBounds.data(), m_NumLocalLights);
+    }
+    else
+    {
+        if (m_DirtyTasks.empty())
+            return;
+
+        // Lights that had zero power on the last build are not in the tree, so the tree needs to be rebuilt when they turn on
+        const auto& trails = m_LightTree.GetLightTrails();
+        bool lightsAdded = false;
+        for (const PrepareLightsTask& task : m_DirtyTasks)
+        {
+            for (uint32_t slot = task.lightBufferOffset; slot < task.lightBufferOffset + task.triangleCount && slot < m_NumLocalLights; ++slot)
+                lightsAdded |= m_LightTreeBounds[slot].power > 0.f && trails[slot] == 0;
+        }
+
+        if (lightsAdded)
+            m_LightTree.Build(m_LightTreeBounds.data(), m_NumLocalLights);
+        else
+            m_LightTree.Refit(m_LightTreeBounds.data(), m_NumLocalLights);
+    }
+
+    const auto& nodes = m_LightTree.GetNodes();
+    commandList->writeBuffer(m_LightTreeNodeBuffer, nodes.data(), nodes.size() * sizeof(RTXDI_LightTreeNode));
+
+    const auto& trails = m_LightTree.GetLightTrails();
+    if (!trails.empty())
+        commandList->writeBuffer(m_LightTreeTrailBuffer, trails.data(), trails.size() * sizeof(uint32_t));
+
+    m_LightTreeValid = true;
+}
+
+void PrepareLightsPass::UpdateAliasTable(nvrhi::ICommandList* commandList, bool rebuild)
+{
+    if (!rebuild)
+    {
+        // Moving lights keep their power, and the table only depends on the power
+        bool powerChanged = false;
+        for (const PrepareLightsTask& task : m_DirtyTasks)
+        {
+            for (uint32_t slot = task.lightBufferOffset; slot < task.lightBufferOffset + task.triangleCount && slot < m_NumLocalLights; ++slot)
+                powerChanged |= m_LightTreeBounds[slot].power != m_LightPowers[slot];
+        }
+
+        if (!powerChanged)
+            return;
+    }
+
+    m_LightPowers.resize(m_NumLocalLights);
+    for (uint32_t slot = 0; slot < m_NumLocalLights; ++slot)
+        m_LightPowers[slot] = m_LightTreeBounds[slot].power;
+
+    m_AliasTable.Build(m_LightPowers.data(), m_NumLocalLights);
+
+    const auto& entries = m_AliasTable.GetEntries();
+    if (!entries.empty())
+        commandList->writeBuffer(m_LocalLightAliasTableBuffer, entries.data(), entries.size() * sizeof(RTXDI_AliasTableEntry));
+
+    m_AliasTableValid = true;
+}
 
-    outFrameParameters.numEmissionThing = uint32_t(visibleLightIndex.size());
-    outFrameParameters.currentFrameLightOffset = m_MaxLightsInBuffer * m_OddFrame;
+void PrepareLightsPass::UpdateDirtyLocalLightMask(nvrhi::ICommandList* commandList)
+{
+    m_LocalLightsChanged = false;
+
+    if (m_LightsRelocated || m_DirtyTasks.empty())
+        return;
+
+    // The dirty tasks include the changed and new emitters, and the released slots
+    m_DirtyLocalLightMask.assign((m_NumLocalLights + 31) / 32, 0);
+    for (const PrepareLightsTask& task : m_DirtyTasks)
+    {
+        const uint32_t end = std::min(task.lightBufferOffset + task.triangleCount, m_NumLocalLights);
+        for (uint32_t slot = task.lightBufferOffset; slot < end; ++slot)
+            m_DirtyLocalLightMask[slot >> 5] |= 1u << (slot & 31);
+
+        m_LocalLightsChanged |= task.lightBufferOffset < end;
+    }
+
+    if (m_LocalLightsChanged)
+        commandList->writeBuffer(m_DirtyLocalLightMaskBuffer, m_DirtyLocalLightMask.data(), m_DirtyLocalLightMask.size() * sizeof(uint32_t));
+}
+
+void PrepareLightsPass::Process(
+    nvrhi::ICommandList* commandList, 
+    const rtxdi::Context& context,
+    const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+    bool enableImportanceSampledEnvironmentLight,
+    bool enableIncrementalUpdates,
+    bool enableLightTree,
+    bool enableAliasTable,
+    rtxdi::FrameParameters& outFrameParameters)
+{
+    commandList->beginMarker("PrepareLights");
+
+    std::vector<uint32_t> sortedLightIndices(sceneLights.size());
+    for (uint32_t index = 0; index < uint32_t(sceneLights.size()); ++index)
+        sortedLightIndices[index] = index;
+    std::sort(sortedLightIndices.begin(), sortedLightIndices.end(), [&sceneLights](uint32_t a, uint32_t b)
+        { return isInfiniteLight(*sceneLights[a]) < isInfiniteLight(*sceneLights[b]); });
+
+    // Primitive lights are converted on every frame and compared with the cached ones to find the changes.
+    // The analytic lights are packed together in a batch, which uses SIMD instructions.
+    m_FramePrimitiveLights.clear();
+    m_FramePrimitiveLightInfos.clear();
+    m_LightPackingBatch.Clear();
+    std::vector<uint32_t> frameLightIndices;
+    for (uint32_t lightIndex : sortedLightIndices)
+    {
+        const std::shared_ptr<Light>& pLight = sceneLights[lightIndex];
+        PolymorphicLightInfo polymorphicLight = {};
+        LightPackingInput packingInput;
+
+        if (GetLightPackingInput(*pLight, packingInput))
+            m_LightPackingBatch.Append(packingInput, uint32_t(m_FramePrimitiveLightInfos.size()));
+        else if (!ConvertLight(*pLight, polymorphicLight, enableImportanceSampledEnvironmentLight))
+            continue;
+
+        m_FramePrimitiveLights.push_back(pLight.get());
+        m_FramePrimitiveLightInfos.push_back(polymorphicLight);
+        frameLightIndices.push_back(lightIndex);
+    }
+
+    m_LightPackingBatch.Pack(m_FramePrimitiveLightInfos.data());
+
+    // The emitters are identified by the stable IDs of their mesh instances and lights, which don't match
+    // a new object that has been created at the address of a removed one.
+    const auto& instances = m_Scene->GetSceneGraph()->GetMeshInstances();
+    bool idsChanged = m_InstanceIds.Update(m_Executor, instances.size(),
+        [&instances](size_t position) -> const std::shared_ptr<MeshInstance>& { return instances[position]; });
+    idsChanged |= m_LightIds.Update(m_Executor, frameLightIndices.size(),
+        [&](size_t position) -> const std::shared_ptr<Light>& { return sceneLights[frameLightIndices[position]]; });
+
+    // When the set of emitters hasn't changed since the last layout update, the layout is the same,
+    // and the incremental update only processes the changed emitters in place. Otherwise, the layout update
+    // keeps the slots of the existing emitters and allocates slots for the new ones.
+    const bool incremental = enableIncrementalUpdates && !idsChanged && IsLayoutCacheValid(enableImportanceSampledEnvironmentLight);
+
+    m_PreviousFrameLightOffset = m_MaxLightsInBuffer * !m_OddFrame;
+
+    if (incremental)
+    {
+        m_CurrentFrameLightOffset = m_PreviousFrameLightOffset;
+        ProcessIncremental(commandList);
+    }
+    else
+    {
+        ProcessLayoutUpdate(commandList, enableImportanceSampledEnvironmentLight, enableIncrementalUpdates);
+    }
+
+    // The light tree and the alias table are both built from the per-light power computed on the CPU,
+    // which ignores the emissive textures, unlike the PDF texture that is written by the shader.
+    if (enableLightTree || enableAliasTable)
+    {
+        const bool rebuild = !incremental || !m_LightBoundsValid;
+        UpdateLocalLightBounds(rebuild);
+        m_LightBoundsValid = true;
+
+        if (enableLightTree)
+            UpdateLightTree(commandList, rebuild || !m_LightTreeValid);
+
+        if (enableAliasTable)
+            UpdateAliasTable(commandList, rebuild || !m_AliasTableValid);
+    }
+    else
+        m_LightBoundsValid = false;
+
+    m_LightTreeValid &= enableLightTree;
+    m_AliasTableValid &= enableAliasTable;
+
+    m_LightsRelocated = m_CurrentFrameLightOffset != m_PreviousFrameLightOffset;
+    UpdateDirtyLocalLightMask(commandList);
+
+    commandList->endMarker();
 
-    m_OddFrame = !m_OddFrame;
+    outFrameParameters.firstLocalLight = m_CurrentFrameLightOffset;
+    outFrameParameters.numLocalLights = m_NumLocalLights;
+    outFrameParameters.firstInfiniteLight = m_CurrentFrameLightOffset + m_FirstInfiniteLight;
+    outFrameParameters.numInfiniteLights = m_NumInfiniteLights;
+    outFrameParameters.environmentLightIndex = outFrameParameters.firstInfiniteLight + m_NumInfiniteLights;
+    outFrameParameters.environmentLightPresent = m_EnvironmentLightPresent;
+
+    // The shader writes the light -> emitter mapping into VisibleLightIndexBuffer.
+    // Emitter indices are stable and reused, so they are not necessarily contiguous. The visibility buffer
+    // is sized for the emitter capacity of the resources, and the emitters beyond it are not tracked.
+    outFrameParameters.numEmissionThing = std::min(m_LightSlots.GetEmitterIndexCount(), m_MaxEmitters);
+    outFrameParameters.currentFrameLightOffset = m_CurrentFrameLightOffset;
 }
@@ -10,11 +10,16 @@
 
 #pragma once
 
+#include "LightPacking.h"
+#include "LightSlotTable.h"
+
 #include <donut/engine/SceneGraph.h>
 #include <nvrhi/nvrhi.h>
 #include <rtxdi/RTXDI.h>
+#include <rtxdi/AliasTable.h>
+#include <rtxdi/LightTree.h>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
 
 namespace donut::engine
@@ -25,7 +30,14 @@ namespace donut::engine
     class Light;
 }
 
+namespace tf
+{
+    class Executor;
+}
+
 class RtxdiResources;
+struct PolymorphicLightInfo;
+struct PrepareLightsTask;
 
 class PrepareLightsPass
 {
@@ -43,17 +55,97 @@ private:
     nvrhi::BufferHandle m_LightIndexMappingBuffer;
     nvrhi::BufferHandle m_GeometryInstanceToLightBuffer;
     nvrhi::TextureHandle m_LocalLightPdfTexture;
-    nvrhi::BufferHandle m_VisibleLightIndexBuffer;
+    nvrhi::BufferHandle m_LightTreeNodeBuffer;
+    nvrhi::BufferHandle m_LightTreeTrailBuffer;
+    nvrhi::BufferHandle m_LocalLightAliasTableBuffer;
+    nvrhi::BufferHandle m_DirtyLocalLightMaskBuffer;
     
     uint32_t m_MaxLightsInBuffer;
-    bool m_OddFrame = false;
+    bool m_OddFrame = false; // selects the half of the light buffer written by the next relocating layout update
     
     std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
     std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
     std::shared_ptr<donut::engine::Scene> m_Scene;
+    tf::Executor* m_Executor = nullptr;
+
+    // Stable IDs of the mesh instances and of the primitive lights in m_FramePrimitiveLights, updated on every frame
+    StableIdTable<donut::engine::MeshInstance> m_InstanceIds;
+    StableIdTable<donut::engine::Light> m_LightIds;
+
+    // Light buffer ranges and emitter indices of the emitters, kept across layout updates
+    LightSlotTable m_LightSlots;
+    uint32_t m_MaxEmitters = 0; // emitter capacity of the visibility buffer
+
+    // State of an emissive geometry as of the last time it was processed, used to find the emitters
+    // that need to be processed again. Indexed by emitter index, unused for primitive lights.
+    struct EmitterState
+    {
+        const donut::engine::MeshInstance* instance = nullptr;
+        const donut::engine::SkinnedMeshInstance* skinnedInstance = nullptr;
+        uint32_t geometryIndex = 0;
+        dm::affine3 transform = dm::affine3::identity();
+        dm::float3 emissiveRadiance = 0.f;
+        const void* emissiveTexture = nullptr;
+        uint32_t skinningFrameIndex = 0;
+    };
+
+    // Light buffer layout from the last layout update: one task per emitter, sorted by light buffer offset.
+    std::vector<PrepareLightsTask> m_Tasks;
+    std::vector<PrepareLightsTask> m_DirtyTasks;
+    std::vector<uint8_t> m_TaskDirty; // per task in m_Tasks, on the incremental path
+    std::vector<EmitterState> m_EmitterStates;
+    uint32_t m_NumLocalLights = 0; // including the free slots between the local lights
+    uint32_t m_FirstInfiniteLight = 0; // relative to the current half of the light buffer
+    uint32_t m_NumInfiniteLights = 0;
+    bool m_EnvironmentLightPresent = false;
+    uint32_t m_CurrentFrameLightOffset = 0;
+    uint32_t m_PreviousFrameLightOffset = 0;
+
+    std::vector<const donut::engine::Light*> m_FramePrimitiveLights;
+    std::vector<PolymorphicLightInfo> m_FramePrimitiveLightInfos;
+    LightPackingBatch m_LightPackingBatch;
 
-    std::unordered_map<size_t, uint32_t> m_InstanceLightBufferOffsets; // hash(instance*, geometryIndex) -> bufferOffset
-    std::unordered_map<const donut::engine::Light*, uint32_t> m_PrimitiveLightBufferOffsets;
+    // Scene state that determines the layout, recorded on the last layout update.
+    // The incremental path is only taken while all of it matches the current scene.
+    bool m_LayoutCacheValid = false;
+    size_t m_CachedGeometryInstanceCount = 0;
+    bool m_CachedEnvironmentImportanceSampling = false;
+    std::vector<std::pair<const donut::engine::Material*, bool>> m_CachedMaterialEmissive;
+    std::vector<PolymorphicLightInfo> m_CachedPrimitiveLightInfos;
+
+    // The index mapping buffer maps every light in the current half of the light buffer onto itself.
+    bool m_IdentityMapping = false;
+
+    // Bounds and power of the local lights, indexed by slot. They are recomputed for all lights on layout updates,
+    // and for the lights of the changed emitters on incremental updates.
+    std::vector<rtxdi::LightTreeLightBounds> m_LightTreeBounds;
+    bool m_LightBoundsValid = false;
+
+    // Light tree over the local light range. It's rebuilt on layout updates, and refit on incremental updates.
+    rtxdi::LightTree m_LightTree;
+    bool m_LightTreeValid = false;
+
+    // Alias table over the local light power, rebuilt whenever the power of any light changes.
+    rtxdi::AliasTable m_AliasTable;
+    std::vector<float> m_LightPowers;
+    bool m_AliasTableValid = false;
+
+    // Local lights changed by the last update, one bit per slot. The mask is only uploaded when the lights
+    // have been updated in place, otherwise all light indices have changed and the mask is not meaningful.
+    std::vector<uint32_t> m_DirtyLocalLightMask;
+    bool m_LightsRelocated = true;
+    bool m_LocalLightsChanged = false;
+
+    static bool UpdateEmitterState(EmitterState& state);
+    bool IsLayoutCacheValid(bool enableImportanceSampledEnvironmentLight) const;
+    void ProcessLayoutUpdate(nvrhi::ICommandList* commandList, bool enableImportanceSampledEnvironmentLight, bool enableIncrementalUpdates);
+    void ProcessIncremental(nvrhi::ICommandList* commandList);
+    void DispatchTasks(nvrhi::ICommandList* commandList, uint32_t numTasks, uint32_t numThreads);
+    void ComputeLightTreeBounds(const PrepareLightsTask& task);
+    void UpdateLocalLightBounds(bool rebuild);
+    void UpdateLightTree(nvrhi::ICommandList* commandList, bool rebuild);
+    void UpdateAliasTable(nvrhi::ICommandList* commandList, bool rebuild);
+    void UpdateDirtyLocalLightMask(nvrhi::ICommandList* commandList);
 
 public:
     PrepareLightsPass(
@@ -62,15 +154,31 @@ public:
         std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
         std::shared_ptr<donut::engine::Scene> scene,
         nvrhi::IBindingLayout* bindlessLayout);
+    ~PrepareLightsPass();
 
     void CreatePipeline();
     void CreateBindingSet(RtxdiResources& resources);
     void CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles);
+
+    // Processes the instances and emitters on the CPU in parallel on the given executor, or serially if it's null.
+    // Both modes produce the same tasks and buffer contents.
+    void SetExecutor(tf::Executor* executor) { m_Executor = executor; }
     
     void Process(
         nvrhi::ICommandList* commandList, 
         const rtxdi::Context& context, 
         const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
         bool enableImportanceSampledEnvironmentLight,
+        bool enableIncrementalUpdates,
+        bool enableLightTree,
+        bool enableAliasTable,
         rtxdi::FrameParameters& outFrameParameters);
+
+    // Returns true if the last Process call has moved the lights to the other half of the light buffer,
+    // which changes the indices of all lights.
+    bool HaveLightsRelocated() const { return m_LightsRelocated; }
+
+    // Returns true if the last Process call has changed, added or removed some local lights in place.
+    // These lights are marked in RtxdiResources::DirtyLocalLightMaskBuffer.
+    bool HaveLocalLightsChanged() const { return m_LocalLightsChanged; }
 };
@@ -0,0 +1,220 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "PrepareLightsTasks.h"
+#include "ParallelFor.h"
+
+#include <donut/core/math/math.h>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+#include <cassert>
+
+// Granularity of the parallel loops over instances and tasks
+static const size_t c_InstancesPerChunk = 1024;
+static const size_t c_TasksPerChunk = 1024;
+
+int FindPrepareLightsTask(const std::vector<PrepareLightsTask>& tasks, uint32_t dispatchThreadId)
+{
+    int left = 0;
+    int right = int(tasks.size()) - 1;
+
+    while (right >= left)
+    {
+        int middle = (left + right) / 2;
+        const PrepareLightsTask& task = tasks[middle];
+
+        int tri = int(dispatchThreadId) - int(task.dispatchOffset); // signed
+
+        if (tri < 0)
+            right = middle - 1;
+        else if (tri < int(task.triangleCount))
+            return middle;
+        else
+            left = middle + 1;
+    }
+
+    return -1;
+}
+
+void WriteVisibleLightIndices(
+    const std::vector<PrepareLightsTask>& tasks,
+    uint32_t numThreads,
+    std::vector<uint32_t>& visibleLightIndex)
+{
+    for (uint32_t dispatchThreadId = 0; dispatchThreadId < numThreads; dispatchThreadId++)
+    {
+        const int taskIndex = FindPrepareLightsTask(tasks, dispatchThreadId);
+        if (taskIndex < 0)
+            continue;
+
+        const PrepareLightsTask& task = tasks[taskIndex];
+        const uint32_t lightBufferPtr = task.lightBufferOffset + dispatchThreadId - task.dispatchOffset;
+
+        assert(lightBufferPtr < visibleLightIndex.size());
+        visibleLightIndex[lightBufferPtr] = task.emitterIndex;
+    }
+}
+
+int GetVisibilityBufferLightIndex(
+    const std::vector<uint32_t>& visibleLightIndex,
+    uint32_t lightBufferOffset,
+    uint32_t numLightsInBuffer)
+{
+    if (lightBufferOffset >= numLightsInBuffer)
+        return -1;
+
+    // Free slots store TASK_EMPTY_SLOTS, which converts to -1
+    return int(visibleLightIndex[lightBufferOffset]);
+}
+
+uint32_t BuildInPlaceDirtyTasks(
+    tf::Executor* executor,
+    const std::vector<PrepareLightsTask>& tasks,
+    const std::vector<uint8_t>& taskDirty,
+    std::vector<PrepareLightsTask>& dirtyTasks)
+{
+    assert(taskDirty.size() == tasks.size());
+
+    // The chunks write their dirty tasks at the prefix sums of the task and thread counts of the previous chunks,
+    // which is the same as appending them serially
+    std::vector<uint32_t> chunkThreadOffsets(GetNumChunks(tasks.size(), c_TasksPerChunk) + 1, 0);
+
+    const std::vector<uint32_t> chunkTaskOffsets = ParallelCountChunks(executor, tasks.size(), c_TasksPerChunk,
+        [&](size_t chunk, size_t begin, size_t end)
+    {
+        uint32_t numTasks = 0;
+        uint32_t numThreads = 0;
+        for (size_t index = begin; index < end; ++index)
+        {
+            if (taskDirty[index])
+            {
+                numTasks += 1;
+                numThreads += tasks[index].triangleCount;
+            }
+        }
+        chunkThreadOffsets[chunk + 1] = numThreads;
+        return numTasks;
+    });
+
+    for (size_t chunk = 1; chunk < chunkThreadOffsets.size(); ++chunk)
+        chunkThreadOffsets[chunk] += chunkThreadOffsets[chunk - 1];
+
+    dirtyTasks.resize(chunkTaskOffsets.back());
+
+    ParallelForChunks(executor, tasks.size(), c_TasksPerChunk, [&](size_t chunk, size_t begin, size_t end)
+    {
+        uint32_t dirtyTaskIndex = chunkTaskOffsets[chunk];
+        uint32_t dispatchOffset = chunkThreadOffsets[chunk];
+        for (size_t index = begin; index < end; ++index)
+        {
+            if (!taskDirty[index])
+                continue;
+
+            const PrepareLightsTask& task = tasks[index];
+
+            PrepareLightsTask& dirtyTask = dirtyTasks[dirtyTaskIndex++];
+            dirtyTask = task;
+            dirtyTask.previousLightBufferOffset = int(task.lightBufferOffset);
+            dirtyTask.dispatchOffset = dispatchOffset;
+            dispatchOffset += task.triangleCount;
+        }
+    });
+
+    return chunkThreadOffsets.back();
+}
+
+void GatherGeometryEmitters(
+    tf::Executor* executor,
+    const EmitterSceneView& scene,
+    std::vector<LayoutEmitter>& emitters)
+{
+    const size_t instanceCount = scene.GetInstanceCount();
+
+    const std::vector<uint32_t> chunkEmitterOffsets = ParallelCountChunks(executor, instanceCount, c_InstancesPerChunk,
+        [&](size_t chunk, size_t begin, size_t end)
+    {
+        uint32_t numEmitters = 0;
+        for (size_t instance = begin; instance < end; ++instance)
+        {
+            const uint32_t geometryCount = scene.GetGeometryCount(instance);
+            for (uint32_t geometryIndex = 0; geometryIndex < geometryCount; ++geometryIndex)
+            {
+                if (scene.GetEmissiveTriangleCount(instance, geometryIndex) != 0)
+                    ++numEmitters;
+            }
+        }
+        return numEmitters;
+    });
+
+    emitters.resize(chunkEmitterOffsets.back());
+
+    ParallelForChunks(executor, instanceCount, c_InstancesPerChunk, [&](size_t chunk, size_t begin, size_t end)
+    {
+        uint32_t emitterIndex = chunkEmitterOffsets[chunk];
+        for (size_t instance = begin; instance < end; ++instance)
+        {
+            const uint32_t geometryCount = scene.GetGeometryCount(instance);
+            const uint32_t firstGeometryInstanceIndex = scene.GetFirstGeometryInstanceIndex(instance);
+            for (uint32_t geometryIndex = 0; geometryIndex < geometryCount; ++geometryIndex)
+            {
+                const uint32_t triangleCount = scene.GetEmissiveTriangleCount(instance, geometryIndex);
+                if (triangleCount == 0)
+                    continue;
+
+                assert(geometryIndex < 0xfff);
+
+                LayoutEmitter& emitter = emitters[emitterIndex++];
+                emitter = LayoutEmitter();
+                emitter.owner = scene.GetInstanceId(instance);
+                emitter.geometryIndex = geometryIndex;
+                emitter.geometryInstanceIndex = firstGeometryInstanceIndex + geometryIndex;
+                emitter.instance = uint32_t(instance);
+                emitter.instanceAndGeometryIndex = (scene.GetInstanceIndex(instance) << 12) | (geometryIndex & 0xfff);
+                emitter.count = triangleCount;
+            }
+        }
+    });
+}
+
+void BuildLayoutTasks(
+    tf::Executor* executor,
+    const std::vector<LayoutEmitter>& emitters,
+    uint32_t geometryInstanceCount,
+    std::vector<PrepareLightsTask>& tasks,
+    std::vector<uint32_t>& geometryInstanceToLight)
+{
+    geometryInstanceToLight.assign(geometryInstanceCount, RTXDI_INVALID_LIGHT_INDEX);
+    tasks.resize(emitters.size());
+
+    // Every emitter has its own geometry instance, so the chunks write disjoint elements
+    ParallelForChunks(executor, emitters.size(), c_TasksPerChunk, [&](size_t chunk, size_t begin, size_t end)
+    {
+        for (size_t index = begin; index < end; ++index)
+        {
+            const LayoutEmitter& emitter = emitters[index];
+
+            if (!emitter.IsPrimitiveLight())
+            {
+                assert(emitter.geometryInstanceIndex < geometryInstanceCount);
+                geometryInstanceToLight[emitter.geometryInstanceIndex] = emitter.lightBufferOffset;
+            }
+
+            PrepareLightsTask& task = tasks[index];
+            task.instanceAndGeometryIndex = emitter.instanceAndGeometryIndex;
+            task.lightBufferOffset = emitter.lightBufferOffset;
+            task.triangleCount = emitter.count;
+            task.previousLightBufferOffset = emitter.previousLightBufferOffset;
+            task.dispatchOffset = emitter.lightBufferOffset;
+            task.emitterIndex = emitter.emitterIndex;
+        }
+    });
+}
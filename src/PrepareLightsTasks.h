@@ -0,0 +1,91 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "LightSlotTable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct PrepareLightsTask;
+
+namespace tf
+{
+    class Executor;
+}
+
+// Host-side parts of the task generation of PrepareLightsPass, and mirrors of the task processing in PrepareLights.hlsl
+// and of GetVisibilityBufferLightIndex in RtxdiApplicationBridge.hlsli, so that the task layouts built by
+// PrepareLightsPass can be tested without a GPU.
+
+// The mesh instances of a scene graph as seen by GatherGeometryEmitters, which PrepareLightsPass implements
+// over the donut scene graph. Instances are addressed by their position in the scene graph's list.
+class EmitterSceneView
+{
+public:
+    virtual ~EmitterSceneView() = default;
+
+    virtual size_t GetInstanceCount() const = 0;
+    virtual StableId GetInstanceId(size_t instance) const = 0;
+    virtual uint32_t GetInstanceIndex(size_t instance) const = 0; // index of the instance in the TLAS
+    virtual uint32_t GetFirstGeometryInstanceIndex(size_t instance) const = 0;
+    virtual uint32_t GetGeometryCount(size_t instance) const = 0;
+
+    // Returns the number of triangles of an emissive geometry, or 0 if the geometry doesn't emit light
+    virtual uint32_t GetEmissiveTriangleCount(size_t instance, uint32_t geometryIndex) const = 0;
+};
+
+// Finds the emissive geometries of the scene and stores them in 'emitters', in scene graph order.
+// The instances are processed in chunks on the executor if there is one, and every chunk stores its emitters
+// at the prefix sum of the emitter counts of the previous chunks, so the output is the same as with serial processing.
+void GatherGeometryEmitters(
+    tf::Executor* executor,
+    const EmitterSceneView& scene,
+    std::vector<LayoutEmitter>& emitters);
+
+// Builds one task per emitter, in emitter order, from emitters that have been placed by LightSlotTable::Update,
+// with every task dispatched at its light buffer offset. Fills 'geometryInstanceToLight' with the light buffer
+// offsets of the geometry emitters, and RTXDI_INVALID_LIGHT_INDEX for the geometry instances that don't emit light.
+void BuildLayoutTasks(
+    tf::Executor* executor,
+    const std::vector<LayoutEmitter>& emitters,
+    uint32_t geometryInstanceCount,
+    std::vector<PrepareLightsTask>& tasks,
+    std::vector<uint32_t>& geometryInstanceToLight);
+
+// Mirror of FindTask: returns the index of the task that processes the given thread, or -1 if there is none.
+// The tasks must be sorted by dispatchOffset.
+int FindPrepareLightsTask(const std::vector<PrepareLightsTask>& tasks, uint32_t dispatchThreadId);
+
+// Runs the threads [0, numThreads) of a PrepareLights dispatch over 'tasks' and stores the emitter index
+// of every light that they process, like the u_VisibleLightIndex writes in the shader.
+// Elements of 'visibleLightIndex' that no thread writes keep their values.
+void WriteVisibleLightIndices(
+    const std::vector<PrepareLightsTask>& tasks,
+    uint32_t numThreads,
+    std::vector<uint32_t>& visibleLightIndex);
+
+// Mirror of GetVisibilityBufferLightIndex, with the light index relative to the current half of the light buffer.
+// Returns -1 for free slots and for lights at or beyond 'numLightsInBuffer'.
+int GetVisibilityBufferLightIndex(
+    const std::vector<uint32_t>& visibleLightIndex,
+    uint32_t lightBufferOffset,
+    uint32_t numLightsInBuffer);
+
+// Copies the tasks with a nonzero 'taskDirty' flag into 'dirtyTasks' for an in-place update, where every light maps
+// onto itself, and packs their threads into one dispatch in task order. Runs in chunks on the executor if there is one,
+// with the same output as serial processing. Returns the number of threads in the dispatch.
+uint32_t BuildInPlaceDirtyTasks(
+    tf::Executor* executor,
+    const std::vector<PrepareLightsTask>& tasks,
+    const std::vector<uint8_t>& taskDirty,
+    std::vector<PrepareLightsTask>& dirtyTasks);
@@ -10,7 +10,9 @@
 
 #include "Profiler.h"
 #include <donut/app/DeviceManager.h>
+#include <donut/core/json.h>
 #include <imgui.h>
+#include <json/writer.h>
 #include <sstream>
 
 #include "RenderTargets.h"
@@ -24,6 +26,9 @@ static const char* g_SectionNames[ProfilerSection::Count] = {
     "Light PDF Map",
     "Presample Lights",
     "Presample Env. Map",
+    "ReGIR Hash Grid",
+    "ReGIR Cell Marking",
+    "ReGIR Cell Compaction",
     "ReGIR Build",
     "Initial Samples",
     "Temporal Resampling",
@@ -79,6 +84,13 @@ void Profiler::EnableProfiler(bool enable)
 
 void Profiler::EnableAccumulation(bool enable)
 {
+    // The history keeps the recent interactive frames, and starts over when a benchmark run starts or ends
+    if (enable != m_IsAccumulating)
+    {
+        for (auto& history : m_TimerHistory)
+            history.Reset();
+    }
+
     m_IsAccumulating = enable;
 }
 
@@ -88,6 +100,9 @@ void Profiler::ResetAccumulation()
     m_TimerValues.fill(0.0);
     m_RayCounts.fill(0);
     m_HitCounts.fill(0);
+
+    for (auto& history : m_TimerHistory)
+        history.Reset();
 }
 
 void Profiler::ResolvePreviousFrame()
@@ -119,6 +134,9 @@ void Profiler::ResolvePreviousFrame()
             }
         }
 
+        if (m_TimersUsed[timerIndex])
+            m_TimerHistory[section].AddSample(time);
+
         m_TimersUsed[timerIndex] = false;
 
         if (m_IsAccumulating)
@@ -219,6 +237,11 @@ double Profiler::GetHitCount(ProfilerSection::Enum section)
     return double(m_HitCounts[section]) / double(m_AccumulatedFrames);
 }
 
+TimingStatistics Profiler::GetTimerStatistics(ProfilerSection::Enum section)
+{
+    return m_TimerHistory[section].ComputeStatistics();
+}
+
 int Profiler::GetMaterialReadback()
 {
     return int(m_RayCounts[ProfilerSection::MaterialReadback]) - 1;
@@ -321,6 +344,13 @@ std::string Profiler::GetAsText()
         text.precision(3);
         text << std::fixed << time << " ms";
 
+        const TimingStatistics stats = GetTimerStatistics(ProfilerSection::Enum(section));
+        if (stats.sampleCount > 1)
+        {
+            text << " [min " << stats.min << ", p50 " << stats.p50 << ", p95 " << stats.p95
+                << ", p99 " << stats.p99 << ", max " << stats.max << "]";
+        }
+
         if (section == ProfilerSection::Frame)
         {
             text.precision(2);
@@ -343,6 +373,123 @@ std::string Profiler::GetAsText()
     return text.str();
 }
 
+std::string Profiler::GetAsJson()
+{
+    auto renderTargets = m_RenderTargets.lock();
+    if (!renderTargets)
+        return "";
+
+    const int renderPixels = renderTargets->Size.x * renderTargets->Size.y;
+
+    Json::Value root(Json::objectValue);
+    root["renderer"] = m_DeviceManager.GetRendererString();
+    root["width"] = renderTargets->Size.x;
+    root["height"] = renderTargets->Size.y;
+    root["frames"] = m_AccumulatedFrames;
+
+    Json::Value& sections = root["sections"];
+    sections = Json::Value(Json::arrayValue);
+
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+    {
+        const double time = GetTimer(ProfilerSection::Enum(section));
+        const double rayCount = GetRayCount(ProfilerSection::Enum(section));
+        const double hitCount = GetHitCount(ProfilerSection::Enum(section));
+
+        if (time == 0.0 && rayCount == 0.0)
+            continue;
+
+        const TimingStatistics stats = GetTimerStatistics(ProfilerSection::Enum(section));
+
+        Json::Value node(Json::objectValue);
+        node["name"] = g_SectionNames[section];
+        node["mean"] = time;
+        node["samples"] = stats.sampleCount;
+        node["min"] = stats.min;
+        node["p50"] = stats.p50;
+        node["p95"] = stats.p95;
+        node["p99"] = stats.p99;
+        node["max"] = stats.max;
+
+        Json::Value& histogram = node["histogram"];
+        histogram = Json::Value(Json::arrayValue);
+        for (uint32_t count : stats.histogram)
+            histogram.append(count);
+
+        if (rayCount != 0.0)
+        {
+            node["raysPerPixel"] = rayCount / renderPixels;
+            node["hitPercentage"] = 100.0 * hitCount / rayCount;
+        }
+
+        sections.append(node);
+    }
+
+    Json::StreamWriterBuilder builder;
+    builder.settings_["precision"] = 6;
+    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+
+    std::stringstream ss;
+    writer->write(root, &ss);
+    ss << std::endl;
+
+    return ss.str();
+}
+
+std::string Profiler::GetAsCsv()
+{
+    auto renderTargets = m_RenderTargets.lock();
+    if (!renderTargets)
+        return "";
+
+    const int renderPixels = renderTargets->Size.x * renderTargets->Size.y;
+
+    // One row per section; the histogram bins go into a single column, separated with semicolons,
+    // so that the number of columns doesn't depend on the bin count.
+    std::stringstream text;
+    text << "section,mean_ms,samples,min_ms,p50_ms,p95_ms,p99_ms,max_ms,rays_per_pixel,hit_percentage,histogram" << std::endl;
+    text.precision(4);
+    text << std::fixed;
+
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+    {
+        const double time = GetTimer(ProfilerSection::Enum(section));
+        const double rayCount = GetRayCount(ProfilerSection::Enum(section));
+        const double hitCount = GetHitCount(ProfilerSection::Enum(section));
+
+        if (time == 0.0 && rayCount == 0.0)
+            continue;
+
+        const TimingStatistics stats = GetTimerStatistics(ProfilerSection::Enum(section));
+
+        text << "\"" << g_SectionNames[section] << "\","
+            << time << ","
+            << stats.sampleCount << ","
+            << stats.min << ","
+            << stats.p50 << ","
+            << stats.p95 << ","
+            << stats.p99 << ","
+            << stats.max << ",";
+
+        if (rayCount != 0.0)
+            text << rayCount / renderPixels << "," << 100.0 * hitCount / rayCount;
+        else
+            text << ",";
+
+        text << ",";
+        for (size_t bin = 0; bin < stats.histogram.size(); bin++)
+        {
+            if (bin > 0)
+                text << ";";
+            text << stats.histogram[bin];
+        }
+
+        text << std::endl;
+    }
+
+    return text.str();
+}
+
 ProfilerScope::ProfilerScope(Profiler& profiler, nvrhi::ICommandList* commandList, ProfilerSection::Enum section)
     : m_Profiler(profiler)
     , m_CommandList(commandList)
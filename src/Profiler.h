@@ -1,5 +1,5 @@
 /***************************************************************************
- # Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
  #
  # NVIDIA CORPORATION and its licensors retain all intellectual property
  # and proprietary rights in and to this software, related documentation
@@ -15,6 +15,7 @@
 #include <memory>
 
 #include "ProfilerSections.h"
+#include "ProfilerStatistics.h"
 
 class RenderTargets;
 
@@ -36,6 +37,7 @@ private:
     std::array<size_t, ProfilerSection::Count> m_RayCounts{};
     std::array<size_t, ProfilerSection::Count> m_HitCounts{};
     std::array<bool, ProfilerSection::Count * 2> m_TimersUsed{};
+    std::array<TimingHistory, ProfilerSection::Count> m_TimerHistory;
 
     donut::app::DeviceManager& m_DeviceManager;
     nvrhi::DeviceHandle m_Device;
@@ -58,12 +60,17 @@ public:
     void SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTargets) { m_RenderTargets = renderTargets; }
 
     double GetTimer(ProfilerSection::Enum section);
+    // Statistics over the frames in which the section was executed, limited to the last
+    // TimingHistory::c_DefaultCapacity frames. Starts over when the accumulation is enabled or disabled.
+    TimingStatistics GetTimerStatistics(ProfilerSection::Enum section);
     double GetRayCount(ProfilerSection::Enum section);
     double GetHitCount(ProfilerSection::Enum section);
     int GetMaterialReadback();
 
     void BuildUI(bool enableRayCounts);
     std::string GetAsText();
+    std::string GetAsJson();
+    std::string GetAsCsv();
 
     [[nodiscard]] nvrhi::IBuffer* GetRayCountBuffer() const { return m_RayCountBuffer; }
 };
@@ -21,6 +21,9 @@ struct ProfilerSection
         LocalLightPdfMap,
         PresampleLights,
         PresampleEnvMap,
+        BuildReGIRHashGrid,
+        MarkReGIRCells,
+        CompactReGIRCells,
         PresampleReGIR,
         InitialSamples,
         TemporalResampling,
@@ -0,0 +1,100 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ProfilerStatistics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+double TimingStatistics::GetHistogramBinWidth() const
+{
+    if (histogram.empty())
+        return 0.0;
+
+    return (max - min) / double(histogram.size());
+}
+
+TimingHistory::TimingHistory(size_t capacity)
+    : m_Capacity(capacity)
+{
+    assert(capacity > 0);
+}
+
+void TimingHistory::AddSample(double value)
+{
+    if (m_Samples.size() < m_Capacity)
+    {
+        m_Samples.push_back(value);
+        return;
+    }
+
+    m_Samples[m_NextSample] = value;
+    m_NextSample = (m_NextSample + 1) % m_Capacity;
+}
+
+void TimingHistory::Reset()
+{
+    m_Samples.clear();
+    m_NextSample = 0;
+}
+
+double TimingHistory::GetPercentile(const std::vector<double>& sortedSamples, double p)
+{
+    assert(!sortedSamples.empty());
+
+    const double rank = std::clamp(p, 0.0, 100.0) * 0.01 * double(sortedSamples.size() - 1);
+    const size_t lower = size_t(std::floor(rank));
+    const size_t upper = std::min(lower + 1, sortedSamples.size() - 1);
+    const double fraction = rank - double(lower);
+
+    return sortedSamples[lower] + (sortedSamples[upper] - sortedSamples[lower]) * fraction;
+}
+
+TimingStatistics TimingHistory::ComputeStatistics(uint32_t histogramBins) const
+{
+    TimingStatistics stats;
+
+    if (m_Samples.empty())
+        return stats;
+
+    // The order of the samples doesn't matter for the statistics, so the ring buffer can be sorted as is
+    std::vector<double> sorted = m_Samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (double sample : sorted)
+        sum += sample;
+
+    stats.sampleCount = uint32_t(sorted.size());
+    stats.mean = sum / double(sorted.size());
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    stats.p50 = GetPercentile(sorted, 50.0);
+    stats.p95 = GetPercentile(sorted, 95.0);
+    stats.p99 = GetPercentile(sorted, 99.0);
+
+    if (histogramBins == 0)
+        return stats;
+
+    stats.histogram.resize(histogramBins, 0);
+
+    const double range = stats.max - stats.min;
+    for (double sample : sorted)
+    {
+        uint32_t bin = 0;
+        if (range > 0.0)
+            bin = std::min(uint32_t((sample - stats.min) / range * double(histogramBins)), histogramBins - 1);
+
+        stats.histogram[bin]++;
+    }
+
+    return stats;
+}
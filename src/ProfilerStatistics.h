@@ -0,0 +1,62 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Order statistics and histogram of a set of timings, in the units of the samples.
+struct TimingStatistics
+{
+    uint32_t sampleCount = 0;
+    double mean = 0.0;
+    double min = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+
+    // Sample counts in equally sized bins between 'min' and 'max'; the last bin includes 'max'.
+    // When all samples are equal, they are all in the first bin.
+    std::vector<uint32_t> histogram;
+
+    double GetHistogramBinWidth() const;
+};
+
+// Keeps the last N timings of a profiler section, and computes the statistics over them.
+// Doesn't depend on the GPU, so that it can be tested with synthetic timings.
+class TimingHistory
+{
+private:
+    std::vector<double> m_Samples; // ring buffer, grows up to m_Capacity
+    size_t m_Capacity;
+    size_t m_NextSample = 0;
+
+public:
+    explicit TimingHistory(size_t capacity = c_DefaultCapacity);
+
+    // Adds a sample, replacing the oldest one if the history is full.
+    void AddSample(double value);
+    void Reset();
+
+    size_t GetSampleCount() const { return m_Samples.size(); }
+    size_t GetCapacity() const { return m_Capacity; }
+
+    // The percentiles are interpolated linearly between the closest ranks.
+    TimingStatistics ComputeStatistics(uint32_t histogramBins = c_DefaultHistogramBins) const;
+
+    // Percentile 'p' in [0, 100] of the sorted, non-empty array.
+    static double GetPercentile(const std::vector<double>& sortedSamples, double p);
+
+    static constexpr size_t c_DefaultCapacity = 4096;
+    static constexpr uint32_t c_DefaultHistogramBins = 16;
+};
@@ -9,16 +9,27 @@
  **************************************************************************/
 
 #include "RenderTargets.h"
+#include "TransientResourcePlanner.h"
 
 #include <donut/engine/FramebufferFactory.h>
 
+#include <algorithm>
+
 using namespace dm;
 using namespace donut;
 
 #include "../shaders/ShaderParameters.h"
 
-RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
+bool TransientRenderTargetSettings::operator==(const TransientRenderTargetSettings& other) const
+{
+    return enableDenoiser == other.enableDenoiser &&
+        enableGradients == other.enableGradients &&
+        enableDebugOutput == other.enableDebugOutput;
+}
+
+RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size, const TransientRenderTargetSettings& transientSettings)
     : Size(size)
+    , m_TransientSettings(transientSettings)
 {
     nvrhi::TextureDesc desc;
     desc.width = size.x;
@@ -135,32 +146,12 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
 
     desc.isRenderTarget = false;
 
-    desc.format = nvrhi::Format::RGBA16_FLOAT;
-    desc.debugName = "DiffuseLighting";
-    DiffuseLighting = device->createTexture(desc);
-
-    desc.format = nvrhi::Format::RGBA16_FLOAT;
-    desc.debugName = "SpecularLighting";
-    SpecularLighting = device->createTexture(desc);
-
-    desc.format = nvrhi::Format::RGBA16_FLOAT;
-    desc.debugName = "DenoisedDiffuseLighting";
-    DenoisedDiffuseLighting = device->createTexture(desc);
-
-    desc.format = nvrhi::Format::RGBA16_FLOAT;
-    desc.debugName = "DenoisedSpecularLighting";
-    DenoisedSpecularLighting = device->createTexture(desc);
-
     desc.format = nvrhi::Format::RGBA16_SNORM;
     desc.debugName = "TaaFeedback1";
     TaaFeedback1 = device->createTexture(desc);
     desc.debugName = "TaaFeedback2";
     TaaFeedback2 = device->createTexture(desc);
 
-    desc.format = nvrhi::Format::RGBA16_FLOAT;
-    desc.debugName = "HdrColor";
-    HdrColor = device->createTexture(desc);
-
     desc.format = nvrhi::Format::RGBA32_FLOAT;
     desc.debugName = "AccumulatedColor";
     AccumulatedColor = device->createTexture(desc);
@@ -171,27 +162,81 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     desc.debugName = "PrevRestirLuminance";
     PrevRestirLuminance = device->createTexture(desc);
 
+    CreateTransientTargets(device);
+}
+
+namespace
+{
+    struct TransientTarget
+    {
+        nvrhi::TextureHandle RenderTargets::* texture;
+        nvrhi::TextureDesc desc;
+        FrameStage firstStage;
+        FrameStage lastStage;
+    };
+}
+
+// Describes the render targets that are only live during a part of the frame, or only in some modes.
+// Render targets (as opposed to UAV-only textures) are not included because they would need a clear
+// or discard every time they become active in the aliased memory.
+static std::vector<TransientTarget> GetTransientTargets(int2 size, const TransientRenderTargetSettings& settings)
+{
+    nvrhi::TextureDesc desc;
+    desc.width = size.x;
+    desc.height = size.y;
+    desc.keepInitialState = true;
+    desc.isUAV = true;
+    desc.isRenderTarget = false;
+    desc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+
+    const FrameStage lastLightingUse = settings.enableDebugOutput ? FrameStage::Output : FrameStage::Compositing;
+
+    std::vector<TransientTarget> targets;
+
+    desc.format = nvrhi::Format::RGBA16_FLOAT;
+    desc.debugName = "DiffuseLighting";
+    targets.push_back({ &RenderTargets::DiffuseLighting, desc, FrameStage::Lighting, lastLightingUse });
+    desc.debugName = "SpecularLighting";
+    targets.push_back({ &RenderTargets::SpecularLighting, desc, FrameStage::Lighting, lastLightingUse });
+
+    // Without the denoiser, the denoised textures are only bound and never accessed
+    const FrameStage lastDenoisedUse = settings.enableDenoiser ? lastLightingUse : FrameStage::Denoising;
+    desc.debugName = "DenoisedDiffuseLighting";
+    targets.push_back({ &RenderTargets::DenoisedDiffuseLighting, desc, FrameStage::Denoising, lastDenoisedUse });
+    desc.debugName = "DenoisedSpecularLighting";
+    targets.push_back({ &RenderTargets::DenoisedSpecularLighting, desc, FrameStage::Denoising, lastDenoisedUse });
+
+    // HdrColor is also shown when the frame stepping is paused and tone mapping is off
+    desc.debugName = "HdrColor";
+    targets.push_back({ &RenderTargets::HdrColor, desc, FrameStage::Compositing, FrameStage::Output });
+
+    // The confidence textures keep their history between frames when the gradients are enabled
+    const FrameStage firstConfidenceUse = settings.enableGradients ? FrameStage::GBuffer : FrameStage::Confidence;
+    const FrameStage lastConfidenceUse = settings.enableGradients ? FrameStage::Output : FrameStage::Confidence;
     desc.format = nvrhi::Format::R8_UNORM;
     desc.debugName = "DiffuseConfidence";
-    DiffuseConfidence = device->createTexture(desc);
+    targets.push_back({ &RenderTargets::DiffuseConfidence, desc, firstConfidenceUse, lastConfidenceUse });
     desc.debugName = "PrevDiffuseConfidence";
-    PrevDiffuseConfidence = device->createTexture(desc);
+    targets.push_back({ &RenderTargets::PrevDiffuseConfidence, desc, firstConfidenceUse, lastConfidenceUse });
     desc.debugName = "SpecularConfidence";
-    SpecularConfidence = device->createTexture(desc);
+    targets.push_back({ &RenderTargets::SpecularConfidence, desc, firstConfidenceUse, lastConfidenceUse });
     desc.debugName = "PrevSpecularConfidence";
-    PrevSpecularConfidence = device->createTexture(desc);
+    targets.push_back({ &RenderTargets::PrevSpecularConfidence, desc, firstConfidenceUse, lastConfidenceUse });
 
     desc.format = nvrhi::Format::RG16_SINT;
     desc.debugName = "TemporalSamplePositions";
-    TemporalSamplePositions = device->createTexture(desc);
-
-    desc.dimension = nvrhi::TextureDimension::Texture2DArray;
-    desc.arraySize = 2;
-    desc.width = (size.x + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR;
-    desc.height = (size.y + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR;
-    desc.format = nvrhi::Format::RGBA16_FLOAT;
-    desc.debugName = "Gradients";
-    Gradients = device->createTexture(desc);
+    targets.push_back({ &RenderTargets::TemporalSamplePositions, desc, FrameStage::Lighting, FrameStage::Lighting });
+
+    nvrhi::TextureDesc gradientsDesc = desc;
+    gradientsDesc.dimension = nvrhi::TextureDimension::Texture2DArray;
+    gradientsDesc.arraySize = 2;
+    gradientsDesc.width = (size.x + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR;
+    gradientsDesc.height = (size.y + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR;
+    gradientsDesc.format = nvrhi::Format::RGBA16_FLOAT;
+    gradientsDesc.debugName = "Gradients";
+    const FrameStage lastGradientsUse = settings.enableDebugOutput ? FrameStage::Output
+        : settings.enableGradients ? FrameStage::Confidence : FrameStage::Lighting;
+    targets.push_back({ &RenderTargets::Gradients, gradientsDesc, FrameStage::Lighting, lastGradientsUse });
 
     nvrhi::TextureDesc debugDesc;
     debugDesc.width = size.x;
@@ -202,14 +247,95 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     debugDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
     debugDesc.format = nvrhi::Format::RGBA16_FLOAT;
     debugDesc.debugName = "DebugColor";
-    DebugColor = device->createTexture(debugDesc);
+    targets.push_back({ &RenderTargets::DebugColor, debugDesc, FrameStage::Output, FrameStage::Output });
+
+    return targets;
 }
 
-bool RenderTargets::IsUpdateRequired(int2 size)
+void RenderTargets::CreateTransientTargets(nvrhi::IDevice* device)
+{
+    const std::vector<TransientTarget> targets = GetTransientTargets(Size, m_TransientSettings);
+
+    if (!device->queryFeatureSupport(nvrhi::Feature::VirtualResources))
+    {
+        // No placed resources, give every target its own allocation
+        for (const TransientTarget& target : targets)
+            this->*target.texture = device->createTexture(target.desc);
+
+        return;
+    }
+
+    TransientResourcePlanner planner;
+
+    for (const TransientTarget& target : targets)
+    {
+        nvrhi::TextureDesc desc = target.desc;
+        desc.isVirtual = true;
+        nvrhi::TextureHandle texture = device->createTexture(desc);
+
+        const nvrhi::MemoryRequirements memReq = device->getTextureMemoryRequirements(texture);
+        planner.AddResource(desc.debugName.c_str(), memReq.size, std::max<uint64_t>(memReq.alignment, 1),
+            uint32_t(target.firstStage), uint32_t(target.lastStage));
+
+        this->*target.texture = texture;
+    }
+
+    planner.Plan();
+
+    nvrhi::HeapDesc heapDesc;
+    heapDesc.type = nvrhi::HeapType::DeviceLocal;
+    heapDesc.capacity = planner.GetHeapSize();
+    heapDesc.debugName = "TransientRenderTargets";
+    m_TransientHeap = device->createHeap(heapDesc);
+
+    for (uint32_t index = 0; index < uint32_t(targets.size()); index++)
+    {
+        nvrhi::ITexture* texture = this->*targets[index].texture;
+        device->bindTextureMemory(texture, m_TransientHeap, planner.GetOffset(index));
+
+        if (planner.IsAliased(index))
+            m_AliasedTextures.push_back(texture);
+    }
+
+    m_TransientHeapSize = planner.GetHeapSize();
+    m_TransientSavedBytes = planner.GetSavedBytes();
+}
+
+uint64_t RenderTargets::EstimateTransientSavedBytes(int2 size, const TransientRenderTargetSettings& transientSettings)
+{
+    // D3D12 places textures at 64 KB boundaries, Vulkan implementations usually have similar requirements
+    const uint64_t placementAlignment = 65536;
+
+    TransientResourcePlanner planner;
+
+    for (const TransientTarget& target : GetTransientTargets(size, transientSettings))
+    {
+        const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(target.desc.format);
+        uint64_t bytes = uint64_t(target.desc.width) * uint64_t(target.desc.height) * uint64_t(target.desc.arraySize) * formatInfo.bytesPerBlock;
+        bytes = (bytes + placementAlignment - 1) & ~(placementAlignment - 1);
+
+        planner.AddResource(target.desc.debugName.c_str(), bytes, placementAlignment,
+            uint32_t(target.firstStage), uint32_t(target.lastStage));
+    }
+
+    planner.Plan();
+
+    return planner.GetSavedBytes();
+}
+
+bool RenderTargets::IsAliased(nvrhi::ITexture* texture) const
+{
+    return std::find(m_AliasedTextures.begin(), m_AliasedTextures.end(), texture) != m_AliasedTextures.end();
+}
+
+bool RenderTargets::IsUpdateRequired(int2 size, const TransientRenderTargetSettings& transientSettings)
 {
     if (any(Size != size))
         return true;
 
+    if (m_TransientSettings != transientSettings)
+        return true;
+
     return false;
 }
 
@@ -13,12 +13,42 @@
 #include <donut/core/math/math.h>
 #include <nvrhi/nvrhi.h>
 #include <memory>
+#include <vector>
 
 namespace donut::engine
 {
     class FramebufferFactory;
 }
 
+// Stages of a frame in the order of execution, used to describe the lifetimes of the transient render targets.
+enum class FrameStage : uint32_t
+{
+    GBuffer,
+    Lighting,       // All lighting passes, including the gradients
+    Confidence,     // Gradient filtering and confidence
+    Denoising,
+    Compositing,    // Compositing, glass and RTXGI probe visualization
+    Resolve,        // TAA, DLSS or accumulation
+    PostProcess,    // Bloom and tone mapping
+    Output,         // Visualization, debug outputs and presentation
+
+    Count
+};
+
+// Render settings that determine the lifetimes of the transient render targets.
+// The render targets need to be recreated when these settings change, see RenderTargets::IsUpdateRequired.
+struct TransientRenderTargetSettings
+{
+    bool enableDenoiser = false;
+    bool enableGradients = false;
+
+    // The visualization modes and debug outputs can read most targets at the end of the frame
+    bool enableDebugOutput = false;
+
+    bool operator==(const TransientRenderTargetSettings& other) const;
+    bool operator!=(const TransientRenderTargetSettings& other) const { return !(*this == other); }
+};
+
 class RenderTargets
 {
 public:
@@ -67,8 +97,30 @@ public:
 
     dm::int2 Size;
 
-    RenderTargets(nvrhi::IDevice* device, dm::int2 size);
+    RenderTargets(nvrhi::IDevice* device, dm::int2 size, const TransientRenderTargetSettings& transientSettings);
 
-    bool IsUpdateRequired(dm::int2 size);
+    bool IsUpdateRequired(dm::int2 size, const TransientRenderTargetSettings& transientSettings);
     void NextFrame();
+
+    // Returns true if the texture shares memory with other transient render targets.
+    // The contents of such textures are undefined at the beginning of their lifetime.
+    bool IsAliased(nvrhi::ITexture* texture) const;
+
+    // Size of the heap that holds the transient render targets, and the memory saved by aliasing them.
+    // Both are zero when the device doesn't support placed resources.
+    uint64_t GetTransientHeapSize() const { return m_TransientHeapSize; }
+    uint64_t GetTransientSavedBytes() const { return m_TransientSavedBytes; }
+
+    // Estimates the memory saved by aliasing the transient render targets, without a device.
+    // The texture sizes are computed from the formats and rounded to 64 KB, the actual sizes depend on the driver.
+    static uint64_t EstimateTransientSavedBytes(dm::int2 size, const TransientRenderTargetSettings& transientSettings);
+
+private:
+    TransientRenderTargetSettings m_TransientSettings;
+    nvrhi::HeapHandle m_TransientHeap;
+    std::vector<nvrhi::ITexture*> m_AliasedTextures;
+    uint64_t m_TransientHeapSize = 0;
+    uint64_t m_TransientSavedBytes = 0;
+
+    void CreateTransientTargets(nvrhi::IDevice* device);
 };
@@ -9,6 +9,7 @@
  **************************************************************************/
 
 #include "RtxdiResources.h"
+#include "EnvironmentMapAliasTable.h"
 #include <rtxdi/RTXDI.h>
 
 #include <donut/core/math/math.h>
@@ -30,27 +31,11 @@ RtxdiResources::RtxdiResources(
     , m_MaxPrimitiveLights(maxPrimitiveLights)
     , m_MaxGeometryInstances(maxGeometryInstances)
 {
-    nvrhi::BufferDesc taskBufferDesc;
-    taskBufferDesc.byteSize = sizeof(PrepareLightsTask) * (maxEmissiveMeshes + maxPrimitiveLights);
-    taskBufferDesc.structStride = sizeof(PrepareLightsTask);
-    taskBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    taskBufferDesc.keepInitialState = true;
-    taskBufferDesc.debugName = "TaskBuffer";
-    taskBufferDesc.canHaveUAVs = true;
-    TaskBuffer = device->createBuffer(taskBufferDesc);
-
-
-    nvrhi::BufferDesc primitiveLightBufferDesc;
-    primitiveLightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * maxPrimitiveLights;
-    primitiveLightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
-    primitiveLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    primitiveLightBufferDesc.keepInitialState = true;
-    primitiveLightBufferDesc.debugName = "PrimitiveLightBuffer";
-    PrimitiveLightBuffer = device->createBuffer(primitiveLightBufferDesc);
-
+    const RtxdiMemoryFootprint footprint = ComputeMemoryFootprint(context, maxEmissiveMeshes, maxEmissiveTriangles,
+        maxPrimitiveLights, maxGeometryInstances, environmentMapWidth, environmentMapHeight);
 
     nvrhi::BufferDesc risBufferDesc;
-    risBufferDesc.byteSize = sizeof(uint32_t) * 2 * std::max(context.GetRisBufferElementCount(), 1u); // RG32_UINT per element
+    risBufferDesc.byteSize = footprint.risBuffer;
     risBufferDesc.format = nvrhi::Format::RG32_UINT;
     risBufferDesc.canHaveTypedViews = true;
     risBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
@@ -60,17 +45,394 @@ RtxdiResources::RtxdiResources(
     RisBuffer = device->createBuffer(risBufferDesc);
 
 
-    risBufferDesc.byteSize = sizeof(uint32_t) * 8 * std::max(context.GetRisBufferElementCount(), 1u); // RGBA32_UINT x 2 per element
+    risBufferDesc.byteSize = footprint.risLightDataBuffer;
     risBufferDesc.format = nvrhi::Format::RGBA32_UINT;
     risBufferDesc.debugName = "RisLightDataBuffer";
     RisLightDataBuffer = device->createBuffer(risBufferDesc);
 
 
-    uint32_t maxLocalLights = maxEmissiveTriangles + maxPrimitiveLights;
-    uint32_t lightBufferElements = maxLocalLights * 2;
+    nvrhi::BufferDesc neighborOffsetBufferDesc;
+    neighborOffsetBufferDesc.byteSize = footprint.neighborOffsetsBuffer;
+    neighborOffsetBufferDesc.format = nvrhi::Format::RG8_SNORM;
+    neighborOffsetBufferDesc.canHaveTypedViews = true;
+    neighborOffsetBufferDesc.debugName = "NeighborOffsets";
+    neighborOffsetBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    neighborOffsetBufferDesc.keepInitialState = true;
+    NeighborOffsetsBuffer = device->createBuffer(neighborOffsetBufferDesc);
+
+
+    CreateReservoirBuffers(device, context.GetReservoirBufferElementCount());
+
+
+    nvrhi::TextureDesc environmentPdfDesc;
+    environmentPdfDesc.width = environmentMapWidth;
+    environmentPdfDesc.height = environmentMapHeight;
+    environmentPdfDesc.mipLevels = uint32_t(ceilf(::log2f(float(std::max(environmentPdfDesc.width, environmentPdfDesc.height))))); // Stop at 2x1 or 2x2
+    environmentPdfDesc.isUAV = true;
+    environmentPdfDesc.debugName = "EnvironmentPdf";
+    environmentPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    environmentPdfDesc.keepInitialState = true;
+    environmentPdfDesc.format = nvrhi::Format::R16_FLOAT;
+    EnvironmentPdfTexture = device->createTexture(environmentPdfDesc);
+
+    CreateEmitterBuffers(device, footprint);
+    CreatePrimitiveLightBuffer(device, footprint);
+    CreateLocalLightBuffers(device, footprint);
+    CreateGeometryInstanceBuffer(device, footprint);
+
+    nvrhi::BufferDesc regirHashTableBufferDesc;
+    regirHashTableBufferDesc.byteSize = footprint.regirHashTableBuffer;
+    regirHashTableBufferDesc.format = nvrhi::Format::R32_UINT;
+    regirHashTableBufferDesc.canHaveTypedViews = true;
+    regirHashTableBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    regirHashTableBufferDesc.keepInitialState = true;
+    regirHashTableBufferDesc.debugName = "ReGIRHashTable";
+    regirHashTableBufferDesc.canHaveUAVs = true;
+    ReGIRHashTableBuffer = device->createBuffer(regirHashTableBufferDesc);
+
+    nvrhi::BufferDesc environmentAliasTableBufferDesc;
+    environmentAliasTableBufferDesc.byteSize = footprint.environmentAliasTableBuffer;
+    environmentAliasTableBufferDesc.structStride = sizeof(RTXDI_AliasTableEntry);
+    environmentAliasTableBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    environmentAliasTableBufferDesc.keepInitialState = true;
+    environmentAliasTableBufferDesc.debugName = "EnvironmentAliasTable";
+    EnvironmentAliasTableBuffer = device->createBuffer(environmentAliasTableBufferDesc);
+
+    nvrhi::BufferDesc regirOccupancyBufferDesc;
+    regirOccupancyBufferDesc.byteSize = footprint.regirOccupancyBuffer;
+    regirOccupancyBufferDesc.format = nvrhi::Format::R32_UINT;
+    regirOccupancyBufferDesc.canHaveTypedViews = true;
+    regirOccupancyBufferDesc.canHaveUAVs = true;
+    regirOccupancyBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    regirOccupancyBufferDesc.keepInitialState = true;
+    regirOccupancyBufferDesc.debugName = "ReGIROccupancy";
+    ReGIROccupancyBuffer = device->createBuffer(regirOccupancyBufferDesc);
+
+    nvrhi::BufferDesc regirCellListBufferDesc;
+    regirCellListBufferDesc.byteSize = footprint.regirCellListBuffer;
+    regirCellListBufferDesc.format = nvrhi::Format::R32_UINT;
+    regirCellListBufferDesc.canHaveTypedViews = true;
+    regirCellListBufferDesc.canHaveUAVs = true;
+    regirCellListBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    regirCellListBufferDesc.keepInitialState = true;
+    regirCellListBufferDesc.debugName = "ReGIRCellList";
+    ReGIRCellListBuffer = device->createBuffer(regirCellListBufferDesc);
+
+    nvrhi::BufferDesc regirCellCountBufferDesc;
+    regirCellCountBufferDesc.byteSize = footprint.regirCellCountBuffer;
+    regirCellCountBufferDesc.format = nvrhi::Format::R32_UINT;
+    regirCellCountBufferDesc.canHaveTypedViews = true;
+    regirCellCountBufferDesc.canHaveUAVs = true;
+    regirCellCountBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    regirCellCountBufferDesc.keepInitialState = true;
+    regirCellCountBufferDesc.debugName = "ReGIRCellCount";
+    ReGIRCellCountBuffer = device->createBuffer(regirCellCountBufferDesc);
+
+    nvrhi::BufferDesc regirIndirectArgsBufferDesc;
+    regirIndirectArgsBufferDesc.byteSize = footprint.regirIndirectArgsBuffer;
+    regirIndirectArgsBufferDesc.isDrawIndirectArgs = true;
+    regirIndirectArgsBufferDesc.initialState = nvrhi::ResourceStates::IndirectArgument;
+    regirIndirectArgsBufferDesc.keepInitialState = true;
+    regirIndirectArgsBufferDesc.debugName = "ReGIRIndirectArgs";
+    ReGIRIndirectArgsBuffer = device->createBuffer(regirIndirectArgsBufferDesc);
+}
+
+static uint64_t GetTextureMipChainBytes(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t bytesPerPixel)
+{
+    uint64_t bytes = 0;
+    for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++)
+    {
+        bytes += uint64_t(std::max(width >> mipLevel, 1u)) * uint64_t(std::max(height >> mipLevel, 1u)) * bytesPerPixel;
+    }
+    return bytes;
+}
+
+uint64_t RtxdiMemoryFootprint::GetTotalBytes() const
+{
+    uint64_t total = 0;
+    for (const auto& entry : GetEntries())
+        total += entry.second;
+    return total;
+}
+
+std::vector<std::pair<const char*, uint64_t>> RtxdiMemoryFootprint::GetEntries() const
+{
+    return {
+        { "TaskBuffer", taskBuffer },
+        { "PrimitiveLightBuffer", primitiveLightBuffer },
+        { "RisBuffer", risBuffer },
+        { "RisLightDataBuffer", risLightDataBuffer },
+        { "LightDataBuffer", lightDataBuffer },
+        { "GeometryInstanceToLightBuffer", geometryInstanceToLightBuffer },
+        { "LightIndexMappingBuffer", lightIndexMappingBuffer },
+        { "NeighborOffsets", neighborOffsetsBuffer },
+        { "LightReservoirBuffer", lightReservoirBuffer },
+        { "SecondaryGBuffer", secondaryGBuffer },
+        { "GIReservoirBuffer", giReservoirBuffer },
+        { "EnvironmentPdf", environmentPdfTexture },
+        { "LocalLightPdf", localLightPdfTexture },
+        { "VisibilityBuffer", visibilityBuffer },
+        { "VisibleLightIndexBuffer", visibleLightIndexBuffer },
+        { "ReGIRHashTable", regirHashTableBuffer },
+        { "LightTreeNodes", lightTreeNodeBuffer },
+        { "LightTreeTrails", lightTreeTrailBuffer },
+        { "LocalLightAliasTable", localLightAliasTableBuffer },
+        { "EnvironmentAliasTable", environmentAliasTableBuffer },
+        { "DirtyLocalLightMask", dirtyLocalLightMaskBuffer },
+        { "ReGIROccupancy", regirOccupancyBuffer },
+        { "ReGIRCellList", regirCellListBuffer },
+        { "ReGIRCellCount", regirCellCountBuffer },
+        { "ReGIRIndirectArgs", regirIndirectArgsBuffer },
+    };
+}
+
+RtxdiMemoryFootprint RtxdiResources::ComputeMemoryFootprint(
+    const rtxdi::Context& context,
+    uint32_t maxEmissiveMeshes,
+    uint32_t maxEmissiveTriangles,
+    uint32_t maxPrimitiveLights,
+    uint32_t maxGeometryInstances,
+    uint32_t environmentMapWidth,
+    uint32_t environmentMapHeight)
+{
+    const rtxdi::ContextParameters& contextParams = context.GetParameters();
+    const uint64_t risBufferElements = std::max(context.GetRisBufferElementCount(), 1u);
+    const uint64_t reservoirBufferElements = context.GetReservoirBufferElementCount();
+    const uint64_t maxLocalLights = uint64_t(maxEmissiveTriangles) + maxPrimitiveLights;
+    const uint64_t lightBufferElements = maxLocalLights * 2;
+    const uint64_t maxEmissiveLights = uint64_t(maxEmissiveMeshes) + maxPrimitiveLights;
+
+    RtxdiMemoryFootprint footprint;
+    footprint.taskBuffer = sizeof(PrepareLightsTask) * maxEmissiveLights;
+    footprint.primitiveLightBuffer = sizeof(PolymorphicLightInfo) * uint64_t(maxPrimitiveLights);
+    footprint.risBuffer = sizeof(uint32_t) * 2 * risBufferElements; // RG32_UINT per element
+    footprint.risLightDataBuffer = sizeof(uint32_t) * 8 * risBufferElements; // RGBA32_UINT x 2 per element
+    footprint.lightDataBuffer = sizeof(PolymorphicLightInfo) * lightBufferElements;
+    footprint.geometryInstanceToLightBuffer = sizeof(uint32_t) * uint64_t(maxGeometryInstances);
+    footprint.lightIndexMappingBuffer = sizeof(uint32_t) * lightBufferElements;
+    footprint.neighborOffsetsBuffer = uint64_t(contextParams.NeighborOffsetCount) * 2;
+    footprint.lightReservoirBuffer = sizeof(RTXDI_PackedReservoir) * reservoirBufferElements * c_NumReservoirBuffers;
+    footprint.secondaryGBuffer = sizeof(SecondaryGBufferData) * reservoirBufferElements;
+    footprint.giReservoirBuffer = sizeof(RTXDI_PackedGIReservoir) * reservoirBufferElements * c_NumGIReservoirBuffers;
+
+    const uint32_t environmentPdfMipLevels = uint32_t(ceilf(::log2f(float(std::max(environmentMapWidth, environmentMapHeight)))));
+    footprint.environmentPdfTexture = GetTextureMipChainBytes(environmentMapWidth, environmentMapHeight, environmentPdfMipLevels, sizeof(uint16_t));
+    footprint.environmentAliasTableBuffer = EnvironmentMapAliasTable::GetBufferSize(environmentMapWidth, environmentMapHeight);
+
+    uint32_t localLightPdfWidth, localLightPdfHeight, localLightPdfMipLevels;
+    rtxdi::ComputePdfTextureSize(uint32_t(maxLocalLights), localLightPdfWidth, localLightPdfHeight, localLightPdfMipLevels);
+    footprint.localLightPdfTexture = GetTextureMipChainBytes(localLightPdfWidth, localLightPdfHeight, localLightPdfMipLevels, sizeof(float));
+
+    const uint64_t visibilityElements = context.GetVisibilityBufferElementCount(uint32_t(maxEmissiveLights));
+    footprint.visibilityBuffer = sizeof(uint32_t) * std::max(visibilityElements, uint64_t(1));
+    footprint.visibleLightIndexBuffer = sizeof(uint32_t) * maxLocalLights; // emitter index for every light in one half of the light buffer
+    footprint.regirHashTableBuffer = sizeof(uint32_t) * std::max(context.GetReGIRHashTableSize(), 1u);
+    footprint.lightTreeNodeBuffer = sizeof(RTXDI_LightTreeNode) * std::max(maxLocalLights * 2, uint64_t(2)); // a binary tree over the local lights of one half
+    footprint.lightTreeTrailBuffer = sizeof(uint32_t) * std::max(maxLocalLights, uint64_t(1));
+    footprint.localLightAliasTableBuffer = sizeof(RTXDI_AliasTableEntry) * std::max(maxLocalLights, uint64_t(1));
+    footprint.dirtyLocalLightMaskBuffer = sizeof(uint32_t) * std::max((maxLocalLights + 31) / 32, uint64_t(1)); // one bit per local light
+    footprint.regirOccupancyBuffer = sizeof(uint32_t) * std::max(context.GetReGIROccupancyMaskSize(), 1u); // one bit per ReGIR cell
+    footprint.regirCellListBuffer = sizeof(uint32_t) * std::max(context.GetReGIROccupancyMaskSize() ? context.GetReGIRCellCount() : 0u, 1u);
+    footprint.regirCellCountBuffer = sizeof(uint32_t) * 4; // cell count + dispatch group counts
+    footprint.regirIndirectArgsBuffer = sizeof(nvrhi::DispatchIndirectArguments);
+
+    return footprint;
+}
+
+RtxdiMemoryFootprint RtxdiResources::ComputeMemoryFootprint(
+    const rtxdi::ContextParameters& contextParams,
+    uint32_t maxEmissiveMeshes,
+    uint32_t maxEmissiveTriangles,
+    uint32_t maxPrimitiveLights,
+    uint32_t maxGeometryInstances,
+    uint32_t environmentMapWidth,
+    uint32_t environmentMapHeight)
+{
+    // Creating a context only involves some CPU work, no GPU resources
+    rtxdi::Context context(contextParams);
+
+    return ComputeMemoryFootprint(context, maxEmissiveMeshes, maxEmissiveTriangles,
+        maxPrimitiveLights, maxGeometryInstances, environmentMapWidth, environmentMapHeight);
+}
+
+// Applies one step of the budget reduction to the given parameters.
+// Returns false if that particular structure is already at its minimum size.
+static bool ReduceContextParameters(rtxdi::ContextParameters& params, int step)
+{
+    constexpr uint32_t minLightsPerCell = 32;
+    constexpr uint32_t minGridSize = 4;
+    constexpr uint32_t minHashGridCapacity = 256;
+    constexpr uint32_t minTileCount = 16;
+    constexpr uint32_t minTileSize = 256;
+    constexpr uint32_t minVisibilityLightsPerCell = 8;
+
+    rtxdi::ReGIRContextParameters& regir = params.ReGIR;
+
+    switch (step)
+    {
+    case 0:
+        if (regir.Mode == rtxdi::ReGIRMode::Disabled || regir.LightsPerCell <= minLightsPerCell)
+            return false;
+        regir.LightsPerCell = std::max(regir.LightsPerCell / 2, minLightsPerCell);
+        return true;
+
+    case 1:
+        if (regir.Mode == rtxdi::ReGIRMode::Grid || regir.Mode == rtxdi::ReGIRMode::AlignGrid)
+        {
+            // Halve the largest dimension of the grid
+            uint32_t* largest = &regir.GridSize.x;
+            if (regir.GridSize.y > *largest) largest = &regir.GridSize.y;
+            if (regir.GridSize.z > *largest) largest = &regir.GridSize.z;
+            if (*largest <= minGridSize)
+                return false;
+            *largest = std::max(*largest / 2, minGridSize);
+            return true;
+        }
+        if (regir.Mode == rtxdi::ReGIRMode::HashGrid)
+        {
+            if (regir.HashGridCapacity <= minHashGridCapacity)
+                return false;
+            regir.HashGridCapacity = std::max(regir.HashGridCapacity / 2, minHashGridCapacity);
+            return true;
+        }
+        if (regir.Mode == rtxdi::ReGIRMode::Onion)
+        {
+            // Drop the coverage layers first, they are the cheapest to lose in terms of quality
+            if (regir.OnionCoverageLayers > 0)
+            {
+                regir.OnionCoverageLayers = regir.OnionCoverageLayers > 2 ? regir.OnionCoverageLayers - 2 : 0;
+                return true;
+            }
+            if (regir.OnionDetailLayers > 1)
+            {
+                regir.OnionDetailLayers--;
+                return true;
+            }
+        }
+        return false;
+
+    case 2:
+        if (params.TileCount > minTileCount)
+        {
+            params.TileCount /= 2;
+            return true;
+        }
+        if (params.TileSize > minTileSize)
+        {
+            params.TileSize = std::max(params.TileSize / 2, minTileSize);
+            return true;
+        }
+        return false;
+
+    case 3:
+        if (params.EnvironmentTileCount > minTileCount)
+        {
+            params.EnvironmentTileCount /= 2;
+            return true;
+        }
+        if (params.EnvironmentTileSize > minTileSize)
+        {
+            params.EnvironmentTileSize = std::max(params.EnvironmentTileSize / 2, minTileSize);
+            return true;
+        }
+        return false;
+
+    case 4:
+        if (!params.enableVisibilityVairanceSampling)
+            return false;
+        if (params.VisibilityLayout == rtxdi::VisibilityBufferLayout::Dense)
+        {
+            params.VisibilityLayout = rtxdi::VisibilityBufferLayout::Compact;
+            return true;
+        }
+        if (params.VisibilityLightsPerCell > minVisibilityLightsPerCell)
+        {
+            params.VisibilityLightsPerCell = std::max(params.VisibilityLightsPerCell / 2, minVisibilityLightsPerCell);
+            return true;
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+bool RtxdiResources::FitContextParametersToBudget(
+    rtxdi::ContextParameters& inoutParams,
+    uint64_t budgetBytes,
+    uint32_t maxEmissiveMeshes,
+    uint32_t maxEmissiveTriangles,
+    uint32_t maxPrimitiveLights,
+    uint32_t maxGeometryInstances,
+    uint32_t environmentMapWidth,
+    uint32_t environmentMapHeight)
+{
+    constexpr int numReductionSteps = 5;
+
+    int step = 0;
+    int stepsWithoutProgress = 0;
+
+    while (true)
+    {
+        const RtxdiMemoryFootprint footprint = ComputeMemoryFootprint(inoutParams, maxEmissiveMeshes, maxEmissiveTriangles,
+            maxPrimitiveLights, maxGeometryInstances, environmentMapWidth, environmentMapHeight);
+
+        if (footprint.GetTotalBytes() <= budgetBytes)
+            return true;
+
+        // Find the next structure in the round-robin order that can still be reduced
+        bool reduced = false;
+        while (!reduced && stepsWithoutProgress < numReductionSteps)
+        {
+            reduced = ReduceContextParameters(inoutParams, step);
+            step = (step + 1) % numReductionSteps;
+            stepsWithoutProgress = reduced ? 0 : stepsWithoutProgress + 1;
+        }
+
+        if (!reduced)
+            return false;
+    }
+}
+
+// Buffers sized by the number of emissive meshes and primitive lights
+void RtxdiResources::CreateEmitterBuffers(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint)
+{
+    nvrhi::BufferDesc taskBufferDesc;
+    taskBufferDesc.byteSize = footprint.taskBuffer;
+    taskBufferDesc.structStride = sizeof(PrepareLightsTask);
+    taskBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    taskBufferDesc.keepInitialState = true;
+    taskBufferDesc.debugName = "TaskBuffer";
+    taskBufferDesc.canHaveUAVs = true;
+    TaskBuffer = device->createBuffer(taskBufferDesc);
+
+    nvrhi::BufferDesc VisibilityBufferDesc;
+    VisibilityBufferDesc.byteSize = footprint.visibilityBuffer;
+    VisibilityBufferDesc.format = nvrhi::Format::R32_UINT;
+    VisibilityBufferDesc.canHaveTypedViews = true;
+    VisibilityBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    VisibilityBufferDesc.keepInitialState = true;
+    VisibilityBufferDesc.debugName = "VisibilityBuffer";
+    VisibilityBufferDesc.canHaveUAVs = true;
+    VisibilityBuffer = device->createBuffer(VisibilityBufferDesc);
+}
+
+void RtxdiResources::CreatePrimitiveLightBuffer(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint)
+{
+    nvrhi::BufferDesc primitiveLightBufferDesc;
+    primitiveLightBufferDesc.byteSize = footprint.primitiveLightBuffer;
+    primitiveLightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
+    primitiveLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    primitiveLightBufferDesc.keepInitialState = true;
+    primitiveLightBufferDesc.debugName = "PrimitiveLightBuffer";
+    PrimitiveLightBuffer = device->createBuffer(primitiveLightBufferDesc);
+}
 
+// Buffers sized by the number of local lights, i.e. emissive triangles and primitive lights
+void RtxdiResources::CreateLocalLightBuffers(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint)
+{
     nvrhi::BufferDesc lightBufferDesc;
-    lightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * lightBufferElements;
+    lightBufferDesc.byteSize = footprint.lightDataBuffer;
     lightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
     lightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
     lightBufferDesc.keepInitialState = true;
@@ -78,18 +440,8 @@ RtxdiResources::RtxdiResources(
     lightBufferDesc.canHaveUAVs = true;
     LightDataBuffer = device->createBuffer(lightBufferDesc);
 
-
-    nvrhi::BufferDesc geometryInstanceToLightBufferDesc;
-    geometryInstanceToLightBufferDesc.byteSize = sizeof(uint32_t) * maxGeometryInstances;
-    geometryInstanceToLightBufferDesc.structStride = sizeof(uint32_t);
-    geometryInstanceToLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    geometryInstanceToLightBufferDesc.keepInitialState = true;
-    geometryInstanceToLightBufferDesc.debugName = "GeometryInstanceToLightBuffer";
-    GeometryInstanceToLightBuffer = device->createBuffer(geometryInstanceToLightBufferDesc);
-
-
     nvrhi::BufferDesc lightIndexMappingBufferDesc;
-    lightIndexMappingBufferDesc.byteSize = sizeof(uint32_t) * lightBufferElements;
+    lightIndexMappingBufferDesc.byteSize = footprint.lightIndexMappingBuffer;
     lightIndexMappingBufferDesc.format = nvrhi::Format::R32_UINT;
     lightIndexMappingBufferDesc.canHaveTypedViews = true;
     lightIndexMappingBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
@@ -97,20 +449,81 @@ RtxdiResources::RtxdiResources(
     lightIndexMappingBufferDesc.debugName = "LightIndexMappingBuffer";
     lightIndexMappingBufferDesc.canHaveUAVs = true;
     LightIndexMappingBuffer = device->createBuffer(lightIndexMappingBufferDesc);
-    
 
-    nvrhi::BufferDesc neighborOffsetBufferDesc;
-    neighborOffsetBufferDesc.byteSize = context.GetParameters().NeighborOffsetCount * 2;
-    neighborOffsetBufferDesc.format = nvrhi::Format::RG8_SNORM;
-    neighborOffsetBufferDesc.canHaveTypedViews = true;
-    neighborOffsetBufferDesc.debugName = "NeighborOffsets";
-    neighborOffsetBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    neighborOffsetBufferDesc.keepInitialState = true;
-    NeighborOffsetsBuffer = device->createBuffer(neighborOffsetBufferDesc);
+    uint32_t maxLocalLights = m_MaxEmissiveTriangles + m_MaxPrimitiveLights;
 
+    nvrhi::TextureDesc localLightPdfDesc;
+    rtxdi::ComputePdfTextureSize(maxLocalLights, localLightPdfDesc.width, localLightPdfDesc.height, localLightPdfDesc.mipLevels);
+    assert(localLightPdfDesc.width * localLightPdfDesc.height >= maxLocalLights);
+    localLightPdfDesc.isUAV = true;
+    localLightPdfDesc.debugName = "LocalLightPdf";
+    localLightPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    localLightPdfDesc.keepInitialState = true;
+    localLightPdfDesc.format = nvrhi::Format::R32_FLOAT; // Use FP32 here to allow a wide range of flux values, esp. when downsampled.
+    LocalLightPdfTexture = device->createTexture(localLightPdfDesc);
+
+    nvrhi::BufferDesc visibleLightIndexBufferDesc;
+    visibleLightIndexBufferDesc.byteSize = footprint.visibleLightIndexBuffer;
+    visibleLightIndexBufferDesc.format = nvrhi::Format::R32_UINT;
+    visibleLightIndexBufferDesc.canHaveTypedViews = true;
+    visibleLightIndexBufferDesc.canHaveUAVs = true;
+    visibleLightIndexBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    visibleLightIndexBufferDesc.keepInitialState = true;
+    visibleLightIndexBufferDesc.debugName = "VisibleLightIndexBuffer";
+    VisibleLightIndexBuffer = device->createBuffer(visibleLightIndexBufferDesc);
+
+    nvrhi::BufferDesc lightTreeNodeBufferDesc;
+    lightTreeNodeBufferDesc.byteSize = footprint.lightTreeNodeBuffer;
+    lightTreeNodeBufferDesc.structStride = sizeof(RTXDI_LightTreeNode);
+    lightTreeNodeBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    lightTreeNodeBufferDesc.keepInitialState = true;
+    lightTreeNodeBufferDesc.debugName = "LightTreeNodes";
+    LightTreeNodeBuffer = device->createBuffer(lightTreeNodeBufferDesc);
+
+    nvrhi::BufferDesc lightTreeTrailBufferDesc;
+    lightTreeTrailBufferDesc.byteSize = footprint.lightTreeTrailBuffer;
+    lightTreeTrailBufferDesc.format = nvrhi::Format::R32_UINT;
+    lightTreeTrailBufferDesc.canHaveTypedViews = true;
+    lightTreeTrailBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    lightTreeTrailBufferDesc.keepInitialState = true;
+    lightTreeTrailBufferDesc.debugName = "LightTreeTrails";
+    LightTreeTrailBuffer = device->createBuffer(lightTreeTrailBufferDesc);
+
+    nvrhi::BufferDesc localLightAliasTableBufferDesc;
+    localLightAliasTableBufferDesc.byteSize = footprint.localLightAliasTableBuffer;
+    localLightAliasTableBufferDesc.structStride = sizeof(RTXDI_AliasTableEntry);
+    localLightAliasTableBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    localLightAliasTableBufferDesc.keepInitialState = true;
+    localLightAliasTableBufferDesc.debugName = "LocalLightAliasTable";
+    LocalLightAliasTableBuffer = device->createBuffer(localLightAliasTableBufferDesc);
+
+    nvrhi::BufferDesc dirtyLocalLightMaskBufferDesc;
+    dirtyLocalLightMaskBufferDesc.byteSize = footprint.dirtyLocalLightMaskBuffer;
+    dirtyLocalLightMaskBufferDesc.format = nvrhi::Format::R32_UINT;
+    dirtyLocalLightMaskBufferDesc.canHaveTypedViews = true;
+    dirtyLocalLightMaskBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    dirtyLocalLightMaskBufferDesc.keepInitialState = true;
+    dirtyLocalLightMaskBufferDesc.debugName = "DirtyLocalLightMask";
+    DirtyLocalLightMaskBuffer = device->createBuffer(dirtyLocalLightMaskBufferDesc);
+}
+
+void RtxdiResources::CreateGeometryInstanceBuffer(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint)
+{
+    nvrhi::BufferDesc geometryInstanceToLightBufferDesc;
+    geometryInstanceToLightBufferDesc.byteSize = footprint.geometryInstanceToLightBuffer;
+    geometryInstanceToLightBufferDesc.structStride = sizeof(uint32_t);
+    geometryInstanceToLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    geometryInstanceToLightBufferDesc.keepInitialState = true;
+    geometryInstanceToLightBufferDesc.debugName = "GeometryInstanceToLightBuffer";
+    GeometryInstanceToLightBuffer = device->createBuffer(geometryInstanceToLightBufferDesc);
+}
+
+void RtxdiResources::CreateReservoirBuffers(nvrhi::IDevice* device, uint32_t reservoirBufferElements)
+{
+    m_ReservoirBufferElementCapacity = reservoirBufferElements;
 
     nvrhi::BufferDesc lightReservoirBufferDesc;
-    lightReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedReservoir) * context.GetReservoirBufferElementCount() * c_NumReservoirBuffers;
+    lightReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedReservoir) * reservoirBufferElements * c_NumReservoirBuffers;
     lightReservoirBufferDesc.structStride = sizeof(RTXDI_PackedReservoir);
     lightReservoirBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
     lightReservoirBufferDesc.keepInitialState = true;
@@ -120,7 +533,7 @@ RtxdiResources::RtxdiResources(
 
 
     nvrhi::BufferDesc secondaryGBufferDesc;
-    secondaryGBufferDesc.byteSize = sizeof(SecondaryGBufferData) * context.GetReservoirBufferElementCount();
+    secondaryGBufferDesc.byteSize = sizeof(SecondaryGBufferData) * reservoirBufferElements;
     secondaryGBufferDesc.structStride = sizeof(SecondaryGBufferData);
     secondaryGBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
     secondaryGBufferDesc.keepInitialState = true;
@@ -129,55 +542,88 @@ RtxdiResources::RtxdiResources(
     SecondaryGBuffer = device->createBuffer(secondaryGBufferDesc);
 
 
-    nvrhi::TextureDesc environmentPdfDesc;
-    environmentPdfDesc.width = environmentMapWidth;
-    environmentPdfDesc.height = environmentMapHeight;
-    environmentPdfDesc.mipLevels = uint32_t(ceilf(::log2f(float(std::max(environmentPdfDesc.width, environmentPdfDesc.height))))); // Stop at 2x1 or 2x2
-    environmentPdfDesc.isUAV = true;
-    environmentPdfDesc.debugName = "EnvironmentPdf";
-    environmentPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    environmentPdfDesc.keepInitialState = true;
-    environmentPdfDesc.format = nvrhi::Format::R16_FLOAT;
-    EnvironmentPdfTexture = device->createTexture(environmentPdfDesc);
-
-    nvrhi::TextureDesc localLightPdfDesc;
-    rtxdi::ComputePdfTextureSize(maxLocalLights, localLightPdfDesc.width, localLightPdfDesc.height, localLightPdfDesc.mipLevels);
-    assert(localLightPdfDesc.width * localLightPdfDesc.height >= maxLocalLights);
-    localLightPdfDesc.isUAV = true;
-    localLightPdfDesc.debugName = "LocalLightPdf";
-    localLightPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    localLightPdfDesc.keepInitialState = true;
-    localLightPdfDesc.format = nvrhi::Format::R32_FLOAT; // Use FP32 here to allow a wide range of flux values, esp. when downsampled.
-    LocalLightPdfTexture = device->createTexture(localLightPdfDesc);
-    
     nvrhi::BufferDesc giReservoirBufferDesc;
-    giReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedGIReservoir) * context.GetReservoirBufferElementCount() * c_NumGIReservoirBuffers;
+    giReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedGIReservoir) * reservoirBufferElements * c_NumGIReservoirBuffers;
     giReservoirBufferDesc.structStride = sizeof(RTXDI_PackedGIReservoir);
     giReservoirBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
     giReservoirBufferDesc.keepInitialState = true;
     giReservoirBufferDesc.debugName = "GIReservoirBuffer";
     giReservoirBufferDesc.canHaveUAVs = true;
     GIReservoirBuffer = device->createBuffer(giReservoirBufferDesc);
+}
 
-    uint32_t maxEmissiveLights = maxEmissiveMeshes + maxPrimitiveLights;
-    nvrhi::BufferDesc VisibilityBufferDesc;
-    // TODO: 16*16*16 -> GridNum
-    VisibilityBufferDesc.byteSize = sizeof(uint32_t) * 2 * std::max((context.GetParameters().enableVisibilityVairanceSampling ? 1 : 0 ) * 16 * 16 * 16 * maxEmissiveLights, (uint32_t)1);
-    VisibilityBufferDesc.format = nvrhi::Format::R32_UINT;
-    VisibilityBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
-    VisibilityBufferDesc.keepInitialState = true;
-    VisibilityBufferDesc.debugName = "VisibilityBuffer";
-    VisibilityBufferDesc.canHaveUAVs = true;
-    VisibilityBuffer = device->createBuffer(VisibilityBufferDesc);
+bool RtxdiResources::ResizeReservoirBuffers(nvrhi::IDevice* device, const rtxdi::Context& context)
+{
+    const uint32_t requiredElements = context.GetReservoirBufferElementCount();
 
-    nvrhi::BufferDesc visibleLightIndexBufferDesc;
-    visibleLightIndexBufferDesc.byteSize = sizeof(uint32_t) * maxEmissiveLights;
-    visibleLightIndexBufferDesc.format = nvrhi::Format::R32_UINT;
-    visibleLightIndexBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    visibleLightIndexBufferDesc.keepInitialState = true;
-    visibleLightIndexBufferDesc.debugName = "VisibleLightIndexBuffer";
-    VisibleLightIndexBuffer = device->createBuffer(visibleLightIndexBufferDesc);
+    // Reuse the existing buffers as long as the reservoir arrays fit, i.e. never shrink
+    if (requiredElements <= m_ReservoirBufferElementCapacity)
+        return false;
+
+    // Grow with some headroom so that a sequence of small size increases, such as dragging
+    // the window border, doesn't reallocate the buffers on every step
+    uint32_t newCapacity = uint32_t(std::ceil(double(requiredElements) * c_ReservoirGrowthFactor));
+    
+    CreateReservoirBuffers(device, newCapacity);
+
+    return true;
+}
+
+// Returns the new capacity for a light count, or the current capacity if the count still fits
+static uint32_t GrowLightCapacity(uint32_t required, uint32_t capacity, double growthFactor)
+{
+    if (required <= capacity)
+        return capacity;
+
+    return std::max(required, uint32_t(std::ceil(double(required) * growthFactor)));
+}
+
+bool RtxdiResources::ResizeLightBuffers(
+    nvrhi::IDevice* device,
+    const rtxdi::Context& context,
+    uint32_t numEmissiveMeshes,
+    uint32_t numEmissiveTriangles,
+    uint32_t numPrimitiveLights,
+    uint32_t numGeometryInstances,
+    double growthFactor)
+{
+    assert(growthFactor >= 1.0);
+
+    const uint32_t newMaxEmissiveMeshes = GrowLightCapacity(numEmissiveMeshes, m_MaxEmissiveMeshes, growthFactor);
+    const uint32_t newMaxEmissiveTriangles = GrowLightCapacity(numEmissiveTriangles, m_MaxEmissiveTriangles, growthFactor);
+    const uint32_t newMaxPrimitiveLights = GrowLightCapacity(numPrimitiveLights, m_MaxPrimitiveLights, growthFactor);
+    const uint32_t newMaxGeometryInstances = GrowLightCapacity(numGeometryInstances, m_MaxGeometryInstances, growthFactor);
+
+    const bool emittersChanged = newMaxEmissiveMeshes != m_MaxEmissiveMeshes || newMaxPrimitiveLights != m_MaxPrimitiveLights;
+    const bool primitiveLightsChanged = newMaxPrimitiveLights != m_MaxPrimitiveLights;
+    const bool localLightsChanged = newMaxEmissiveTriangles != m_MaxEmissiveTriangles || newMaxPrimitiveLights != m_MaxPrimitiveLights;
+    const bool geometryInstancesChanged = newMaxGeometryInstances != m_MaxGeometryInstances;
+
+    if (!emittersChanged && !localLightsChanged && !geometryInstancesChanged)
+        return false;
+
+    m_MaxEmissiveMeshes = newMaxEmissiveMeshes;
+    m_MaxEmissiveTriangles = newMaxEmissiveTriangles;
+    m_MaxPrimitiveLights = newMaxPrimitiveLights;
+    m_MaxGeometryInstances = newMaxGeometryInstances;
+
+    const auto& environmentPdfDesc = EnvironmentPdfTexture->getDesc();
+    const RtxdiMemoryFootprint footprint = ComputeMemoryFootprint(context, m_MaxEmissiveMeshes, m_MaxEmissiveTriangles,
+        m_MaxPrimitiveLights, m_MaxGeometryInstances, environmentPdfDesc.width, environmentPdfDesc.height);
+
+    if (emittersChanged)
+        CreateEmitterBuffers(device, footprint);
+
+    if (primitiveLightsChanged)
+        CreatePrimitiveLightBuffer(device, footprint);
+
+    if (localLightsChanged)
+        CreateLocalLightBuffers(device, footprint);
+
+    if (geometryInstancesChanged)
+        CreateGeometryInstanceBuffer(device, footprint);
 
+    return true;
 }
 
 void RtxdiResources::InitializeNeighborOffsets(nvrhi::ICommandList* commandList, const rtxdi::Context& context)
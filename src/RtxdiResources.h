@@ -12,11 +12,50 @@
 
 #include <nvrhi/nvrhi.h>
 
+#include <utility>
+#include <vector>
+
 namespace rtxdi
 {
     class Context;
+    struct ContextParameters;
 }
 
+// Sizes of the RTXDI resources in bytes, as they would be allocated by RtxdiResources.
+struct RtxdiMemoryFootprint
+{
+    uint64_t taskBuffer = 0;
+    uint64_t primitiveLightBuffer = 0;
+    uint64_t risBuffer = 0;
+    uint64_t risLightDataBuffer = 0;
+    uint64_t lightDataBuffer = 0;
+    uint64_t geometryInstanceToLightBuffer = 0;
+    uint64_t lightIndexMappingBuffer = 0;
+    uint64_t neighborOffsetsBuffer = 0;
+    uint64_t lightReservoirBuffer = 0;
+    uint64_t secondaryGBuffer = 0;
+    uint64_t giReservoirBuffer = 0;
+    uint64_t environmentPdfTexture = 0;
+    uint64_t localLightPdfTexture = 0;
+    uint64_t visibilityBuffer = 0;
+    uint64_t visibleLightIndexBuffer = 0;
+    uint64_t regirHashTableBuffer = 0;
+    uint64_t lightTreeNodeBuffer = 0;
+    uint64_t lightTreeTrailBuffer = 0;
+    uint64_t localLightAliasTableBuffer = 0;
+    uint64_t environmentAliasTableBuffer = 0;
+    uint64_t dirtyLocalLightMaskBuffer = 0;
+    uint64_t regirOccupancyBuffer = 0;
+    uint64_t regirCellListBuffer = 0;
+    uint64_t regirCellCountBuffer = 0;
+    uint64_t regirIndirectArgsBuffer = 0;
+
+    uint64_t GetTotalBytes() const;
+
+    // Returns (resource name, size in bytes) pairs for all resources, for reporting.
+    std::vector<std::pair<const char*, uint64_t>> GetEntries() const;
+};
+
 class RtxdiResources
 {
 private:
@@ -25,6 +64,13 @@ private:
     uint32_t m_MaxEmissiveTriangles = 0;
     uint32_t m_MaxPrimitiveLights = 0;
     uint32_t m_MaxGeometryInstances = 0;
+    uint32_t m_ReservoirBufferElementCapacity = 0;
+
+    void CreateReservoirBuffers(nvrhi::IDevice* device, uint32_t reservoirBufferElements);
+    void CreateEmitterBuffers(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint);
+    void CreatePrimitiveLightBuffer(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint);
+    void CreateLocalLightBuffers(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint);
+    void CreateGeometryInstanceBuffer(nvrhi::IDevice* device, const RtxdiMemoryFootprint& footprint);
 
 public:
     nvrhi::BufferHandle TaskBuffer;
@@ -42,6 +88,20 @@ public:
     nvrhi::BufferHandle GIReservoirBuffer;
     nvrhi::BufferHandle VisibilityBuffer;
     nvrhi::BufferHandle VisibleLightIndexBuffer;
+    nvrhi::BufferHandle ReGIRHashTableBuffer;
+    nvrhi::BufferHandle LightTreeNodeBuffer;
+    nvrhi::BufferHandle LightTreeTrailBuffer;
+    nvrhi::BufferHandle LocalLightAliasTableBuffer;
+    nvrhi::BufferHandle EnvironmentAliasTableBuffer;
+    nvrhi::BufferHandle DirtyLocalLightMaskBuffer;
+
+    // Occupancy-driven ReGIR build, see LightingPasses::PrepareForLightSampling(...)
+    // The cell count buffer holds the number of listed cells followed by the X, Y, Z group counts of the build dispatch,
+    // which are copied into the indirect arguments buffer. That one is not bound to the shaders.
+    nvrhi::BufferHandle ReGIROccupancyBuffer;
+    nvrhi::BufferHandle ReGIRCellListBuffer;
+    nvrhi::BufferHandle ReGIRCellCountBuffer;
+    nvrhi::BufferHandle ReGIRIndirectArgsBuffer;
 
     RtxdiResources(
         nvrhi::IDevice* device, 
@@ -53,13 +113,82 @@ public:
         uint32_t environmentMapWidth,
         uint32_t environmentMapHeight);
 
+    // Computes the sizes of all resources that the constructor would allocate for the given context and light counts.
+    // The reservoir buffers are sized for the current render size, without the headroom added by ResizeReservoirBuffers.
+    static RtxdiMemoryFootprint ComputeMemoryFootprint(
+        const rtxdi::Context& context,
+        uint32_t maxEmissiveMeshes,
+        uint32_t maxEmissiveTriangles,
+        uint32_t maxPrimitiveLights,
+        uint32_t maxGeometryInstances,
+        uint32_t environmentMapWidth,
+        uint32_t environmentMapHeight);
+
+    // Same as above, but doesn't require a context. The render size in 'contextParams' must be set.
+    static RtxdiMemoryFootprint ComputeMemoryFootprint(
+        const rtxdi::ContextParameters& contextParams,
+        uint32_t maxEmissiveMeshes,
+        uint32_t maxEmissiveTriangles,
+        uint32_t maxPrimitiveLights,
+        uint32_t maxGeometryInstances,
+        uint32_t environmentMapWidth,
+        uint32_t environmentMapHeight);
+
+    // Reduces the sampling structure sizes in 'inoutParams' until the total memory footprint fits into 'budgetBytes'.
+    // The reductions are applied one step at a time in a fixed round-robin order: ReGIR lights per cell,
+    // ReGIR grid size, hash grid capacity or onion layers, local light tiles, environment tiles,
+    // visibility buffer (switch to the compact layout, then fewer lights per cell).
+    // The result only depends on the inputs, so the same budget always produces the same parameters.
+    // Parameters that already fit are not changed.
+    // Returns false if the budget cannot be met even with all structures at their minimum sizes;
+    // 'inoutParams' then contains those minimum sizes.
+    static bool FitContextParametersToBudget(
+        rtxdi::ContextParameters& inoutParams,
+        uint64_t budgetBytes,
+        uint32_t maxEmissiveMeshes,
+        uint32_t maxEmissiveTriangles,
+        uint32_t maxPrimitiveLights,
+        uint32_t maxGeometryInstances,
+        uint32_t environmentMapWidth,
+        uint32_t environmentMapHeight);
+
     void InitializeNeighborOffsets(nvrhi::ICommandList* commandList, const rtxdi::Context& context);
 
+    // Makes sure that the buffers sized by the reservoir layout (light and GI reservoirs, secondary G-buffer)
+    // fit the current render size of the context, e.g. after rtxdi::Context::Resize.
+    // The buffers are only reallocated when the reservoir arrays don't fit; the new capacity
+    // includes c_ReservoirGrowthFactor headroom. Returns true if the buffers were reallocated,
+    // in which case all binding sets that reference them must be recreated.
+    bool ResizeReservoirBuffers(nvrhi::IDevice* device, const rtxdi::Context& context);
+
+    // Makes sure that the buffers sized by the light counts fit the given counts, e.g. when a streaming scene
+    // adds emitters. Each group of buffers is only reallocated when its own count doesn't fit, and then grows
+    // to the count times 'growthFactor' so that slowly growing scenes don't reallocate on every change:
+    //   - emissive meshes or primitive lights: TaskBuffer, VisibilityBuffer;
+    //   - primitive lights: PrimitiveLightBuffer;
+    //   - local lights (emissive triangles or primitive lights): LightDataBuffer, LightIndexMappingBuffer,
+    //     LocalLightPdfTexture and the other per-light sampling structures;
+    //   - geometry instances: GeometryInstanceToLightBuffer.
+    // The reservoirs, RIS buffers and the environment PDF are never touched. The buffers never shrink.
+    // Returns true if any buffers were reallocated, in which case all binding sets that reference them
+    // must be recreated, and the light buffer contents are lost.
+    bool ResizeLightBuffers(
+        nvrhi::IDevice* device,
+        const rtxdi::Context& context,
+        uint32_t numEmissiveMeshes,
+        uint32_t numEmissiveTriangles,
+        uint32_t numPrimitiveLights,
+        uint32_t numGeometryInstances,
+        double growthFactor = c_DefaultLightBufferGrowthFactor);
+
     uint32_t GetMaxEmissiveMeshes() const { return m_MaxEmissiveMeshes; }
     uint32_t GetMaxEmissiveTriangles() const { return m_MaxEmissiveTriangles; }
     uint32_t GetMaxPrimitiveLights() const { return m_MaxPrimitiveLights; }
     uint32_t GetMaxGeometryInstances() const { return m_MaxGeometryInstances; }
+    uint32_t GetReservoirBufferElementCapacity() const { return m_ReservoirBufferElementCapacity; }
 
     static constexpr uint32_t c_NumReservoirBuffers = 3;
     static constexpr uint32_t c_NumGIReservoirBuffers = 2;
+    static constexpr double c_ReservoirGrowthFactor = 1.25;
+    static constexpr double c_DefaultLightBufferGrowthFactor = 1.5;
 };
@@ -0,0 +1,169 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "ParallelFor.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Identity of a scene object that stays the same while the object exists, even when it moves in the scene's lists.
+// The index is reused after the object is destroyed, with a new generation, so that an ID never refers to two objects.
+struct StableId
+{
+    static constexpr uint32_t c_InvalidIndex = ~0u;
+
+    uint32_t index = c_InvalidIndex;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return index != c_InvalidIndex; }
+    bool operator==(const StableId& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const StableId& other) const { return !(*this == other); }
+};
+
+// Assigns stable IDs to the objects of a list that is given again on every frame, such as the mesh instances of a scene.
+// Objects are recognized by the control block of their shared_ptr, which the table keeps alive through a weak_ptr,
+// so a new object that is allocated at the address of a destroyed one is never mistaken for it.
+template<typename T>
+class StableIdTable
+{
+private:
+    struct Entry
+    {
+        std::weak_ptr<T> object; // empty if the index is free
+        uint32_t generation = 0;
+        uint32_t lastUpdate = 0; // last update that has seen this object
+    };
+
+    // Granularity of the parallel loop over the objects
+    static constexpr size_t c_ObjectsPerChunk = 1024;
+
+    std::vector<Entry> m_Entries; // indexed by ID index
+    std::vector<uint32_t> m_FreeIndices;
+    std::vector<StableId> m_Ids; // IDs of the objects in the last update, in list order
+    uint32_t m_UpdateIndex = 0;
+
+    static bool IsSameObject(const std::weak_ptr<T>& a, const std::shared_ptr<T>& b)
+    {
+        return !a.owner_before(b) && !b.owner_before(a);
+    }
+
+public:
+    // Forgets all objects. The IDs that have been handed out may be handed out again.
+    void Reset()
+    {
+        m_Entries.clear();
+        m_FreeIndices.clear();
+        m_Ids.clear();
+    }
+
+    // Finds the IDs of the objects getObject(0) to getObject(count - 1), which return a const std::shared_ptr<T>&.
+    // Objects that keep their position in the list are found in parallel, the others through a slower lookup
+    // that is only built when it's needed. Objects that are not in the list anymore release their IDs,
+    // and new objects get new IDs. Returns true if the IDs are not the same as in the last update.
+    template<typename GetObject>
+    bool Update(tf::Executor* executor, size_t count, const GetObject& getObject)
+    {
+        const uint32_t update = ++m_UpdateIndex;
+        std::vector<StableId> ids(count);
+
+        ParallelForChunks(executor, count, c_ObjectsPerChunk, [&](size_t chunk, size_t begin, size_t end)
+        {
+            for (size_t position = begin; position < std::min(end, m_Ids.size()); ++position)
+            {
+                Entry& entry = m_Entries[m_Ids[position].index];
+                if (!IsSameObject(entry.object, getObject(position)))
+                    continue;
+
+                entry.lastUpdate = update;
+                ids[position] = m_Ids[position];
+            }
+        });
+
+        // Objects that have moved are looked up among the entries that haven't been seen yet
+        std::map<std::weak_ptr<T>, uint32_t, std::owner_less<>> movedObjects;
+        bool movedObjectsBuilt = false;
+
+        std::vector<size_t> newObjects;
+        for (size_t position = 0; position < count; ++position)
+        {
+            if (ids[position].IsValid())
+                continue;
+
+            if (!movedObjectsBuilt)
+            {
+                for (const StableId& id : m_Ids)
+                {
+                    const Entry& entry = m_Entries[id.index];
+                    if (entry.lastUpdate != update)
+                        movedObjects.emplace(entry.object, id.index);
+                }
+                movedObjectsBuilt = true;
+            }
+
+            auto it = movedObjects.find(getObject(position));
+            if (it == movedObjects.end())
+            {
+                newObjects.push_back(position);
+                continue;
+            }
+
+            Entry& entry = m_Entries[it->second];
+            entry.lastUpdate = update;
+            ids[position] = { it->second, entry.generation };
+            movedObjects.erase(it);
+        }
+
+        // Release the IDs of the objects that are gone before handing out the new ones
+        for (const StableId& id : m_Ids)
+        {
+            Entry& entry = m_Entries[id.index];
+            if (entry.lastUpdate == update)
+                continue;
+
+            entry.object.reset();
+            entry.generation++;
+            m_FreeIndices.push_back(id.index);
+        }
+
+        for (size_t position : newObjects)
+        {
+            uint32_t index;
+            if (!m_FreeIndices.empty())
+            {
+                index = m_FreeIndices.back();
+                m_FreeIndices.pop_back();
+            }
+            else
+            {
+                index = uint32_t(m_Entries.size());
+                m_Entries.emplace_back();
+            }
+
+            Entry& entry = m_Entries[index];
+            entry.object = getObject(position);
+            entry.lastUpdate = update;
+            ids[position] = { index, entry.generation };
+        }
+
+        const bool changed = ids != m_Ids;
+        m_Ids = std::move(ids);
+        return changed;
+    }
+
+    // IDs of the objects in the last update, in list order
+    const std::vector<StableId>& GetIds() const { return m_Ids; }
+
+    // Returns one past the highest ID index that is in use
+    uint32_t GetIndexCount() const { return uint32_t(m_Entries.size()); }
+};
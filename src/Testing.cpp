@@ -10,6 +10,7 @@
 
 
 #include "Testing.h"
+#include "Profiler.h"
 #include "UserInterface.h"
 
 #include <donut/app/DeviceManager.h>
@@ -19,6 +20,7 @@
 #include <stb_image.h>
 #include <stb_image_write.h>
 #include <filesystem>
+#include <fstream>
 
 using namespace donut;
 namespace fs = std::filesystem;
@@ -153,6 +155,7 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         ("alpha-tested", "Alpha-tested materials toggle", value(ui.gbufferSettings.enableAlphaTestedGeometry))
         ("animation", "Animations toggle", value(ui.enableAnimations))
         ("benchmark", "Run the benchmark", value(args.benchmark))
+        ("benchmark-output", "Save the benchmark statistics to a .json or .csv file", value(args.benchmarkOutputFileName))
         ("bloom", "Bloom effect toggle", value(ui.enableBloom))
         ("checkerboard", "Use checkerboard rendering", value(checkerboard))
         ("d,debug", "Enable the DX12 or Vulkan validation layers", value(deviceParams.enableDebugRuntime))
@@ -162,9 +165,11 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         ("h,help", "Display this help message", value(help))
         ("height", "Window height", value(deviceParams.backBufferHeight))
         ("indirect-resampling", "ReSTIR GI resampling mode: NONE, TEMPORAL, SPATIAL, TEMPORAL_SPATIAL, FUSED", value(ui.lightingSettings.reStirGI.resamplingMode))
+        ("light-buffer-growth", "Growth factor for the light buffers when the scene has more lights than they can hold, at least 1", value(ui.lightBufferGrowthFactor))
         ("noise-mix", "Amount of noise to mix in after denoising", value(ui.noiseMix))
         ("pixel-jitter", "Pixel jitter toggle", value(ui.enablePixelJitter))
         ("preset", "Rendering settings preset: FAST, MEDIUM, UNBIASED, ULTRA, REFERENCE", value(ui))
+        ("rtxdi-budget", "Memory budget for the RTXDI resources in megabytes, reduces the light sampling structures to fit", value(ui.rtxdiMemoryBudgetMB))
         ("rasterize-gbuffer", "G-buffer rasterization toggle", value(ui.rasterizeGBuffer))
         ("ray-query", "Ray Query toggle", value(ui.useRayQuery))
         ("direct-mode", "Direct lighting mode: NONE, BRDF, RESTIR", value(ui.directLightingMode))
@@ -222,6 +227,15 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
                 throw OptionException("Unrecognized value passed to the --denoiser argument.");
 #endif
         }
+
+        if (!args.benchmarkOutputFileName.empty())
+        {
+            std::string extension = fs::path(args.benchmarkOutputFileName).extension().string();
+            toupper(extension);
+
+            if (extension != ".JSON" && extension != ".CSV")
+                throw OptionException("The file passed to the --benchmark-output argument must have a .json or .csv extension.");
+        }
     }
     catch (const std::exception& e)
     {
@@ -356,3 +370,31 @@ bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* w
 
     return success;
 }
+
+bool SaveBenchmarkResults(Profiler& profiler, const std::string& writeFileName)
+{
+    std::string extension = fs::path(writeFileName).extension().string();
+    toupper(extension);
+
+    const std::string results = (extension == ".CSV") ? profiler.GetAsCsv() : profiler.GetAsJson();
+    if (results.empty())
+        return false;
+
+    std::ofstream file(writeFileName);
+    if (!file.is_open())
+    {
+        log::error("Couldn't open '%s' for writing.", writeFileName.c_str());
+        return false;
+    }
+
+    file << results;
+
+    if (file.fail())
+    {
+        log::error("Couldn't write the benchmark results to '%s'.", writeFileName.c_str());
+        return false;
+    }
+
+    log::info("Benchmark results saved to '%s'.", writeFileName.c_str());
+    return true;
+}
@@ -1,5 +1,5 @@
 /***************************************************************************
- # Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
  #
  # NVIDIA CORPORATION and its licensors retain all intellectual property
  # and proprietary rights in and to this software, related documentation
@@ -13,6 +13,7 @@
 #include <nvrhi/nvrhi.h>
 
 struct UIData;
+class Profiler;
 
 namespace donut::app {
     struct DeviceCreationParameters;
@@ -31,6 +32,7 @@ struct CommandLineArguments
     std::string saveFrameFileName;
     bool verbose = false;
     bool benchmark = false;
+    std::string benchmarkOutputFileName;
     bool disableBackgroundOptimization = false;
     int renderWidth = 0;
     int renderHeight = 0;
@@ -38,4 +40,5 @@ struct CommandLineArguments
 
 void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args);
 void ApplicationLogCallback(donut::log::Severity severity, const char* message);
-bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName);
\ No newline at end of file
+bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName);
+bool SaveBenchmarkResults(Profiler& profiler, const std::string& writeFileName);
\ No newline at end of file
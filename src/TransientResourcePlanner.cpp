@@ -0,0 +1,134 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TransientResourcePlanner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+static uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+uint32_t TransientResourcePlanner::AddResource(const char* name, uint64_t size, uint64_t alignment, uint32_t firstPass, uint32_t lastPass)
+{
+    assert(firstPass <= lastPass);
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    Resource resource;
+    resource.name = name ? name : "";
+    resource.size = size;
+    resource.alignment = alignment;
+    resource.firstPass = firstPass;
+    resource.lastPass = lastPass;
+    m_Resources.push_back(resource);
+
+    m_Planned = false;
+
+    return uint32_t(m_Resources.size() - 1);
+}
+
+void TransientResourcePlanner::Plan()
+{
+    // Place the large resources first, they are the hardest to fit into the gaps.
+    // The sort is stable, so the result only depends on the order in which the resources were added.
+    std::vector<uint32_t> order(m_Resources.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+    {
+        return m_Resources[a].size > m_Resources[b].size;
+    });
+
+    std::vector<uint32_t> placed;
+    std::vector<std::pair<uint64_t, uint64_t>> occupied; // begin, end
+    m_HeapSize = 0;
+
+    for (uint32_t index : order)
+    {
+        Resource& resource = m_Resources[index];
+
+        occupied.clear();
+        for (uint32_t other : placed)
+        {
+            const Resource& otherResource = m_Resources[other];
+            if (LifetimesOverlap(resource.firstPass, resource.lastPass, otherResource.firstPass, otherResource.lastPass))
+                occupied.push_back({ otherResource.offset, otherResource.offset + otherResource.size });
+        }
+        std::sort(occupied.begin(), occupied.end());
+
+        // First fit: walk the occupied ranges in the order of their offsets and stop at the first gap that is large enough
+        uint64_t offset = 0;
+        for (const auto& [begin, end] : occupied)
+        {
+            offset = AlignOffset(offset, resource.alignment);
+            if (offset + resource.size <= begin)
+                break;
+            offset = std::max(offset, end);
+        }
+        offset = AlignOffset(offset, resource.alignment);
+
+        resource.offset = offset;
+        m_HeapSize = std::max(m_HeapSize, offset + resource.size);
+        placed.push_back(index);
+    }
+
+    m_Planned = true;
+}
+
+void TransientResourcePlanner::Reset()
+{
+    m_Resources.clear();
+    m_HeapSize = 0;
+    m_Planned = false;
+}
+
+uint64_t TransientResourcePlanner::GetOffset(uint32_t index) const
+{
+    assert(m_Planned);
+    return m_Resources[index].offset;
+}
+
+bool TransientResourcePlanner::IsAliased(uint32_t index) const
+{
+    assert(m_Planned);
+    const Resource& resource = m_Resources[index];
+
+    for (uint32_t other = 0; other < uint32_t(m_Resources.size()); other++)
+    {
+        const Resource& otherResource = m_Resources[other];
+        if (other != index &&
+            resource.offset < otherResource.offset + otherResource.size &&
+            otherResource.offset < resource.offset + resource.size)
+            return true;
+    }
+
+    return false;
+}
+
+uint64_t TransientResourcePlanner::GetHeapSize() const
+{
+    assert(m_Planned);
+    return m_HeapSize;
+}
+
+uint64_t TransientResourcePlanner::GetTotalResourceBytes() const
+{
+    uint64_t total = 0;
+    for (const Resource& resource : m_Resources)
+        total += resource.size;
+    return total;
+}
+
+bool TransientResourcePlanner::LifetimesOverlap(uint32_t firstPassA, uint32_t lastPassA, uint32_t firstPassB, uint32_t lastPassB)
+{
+    return firstPassA <= lastPassB && firstPassB <= lastPassA;
+}
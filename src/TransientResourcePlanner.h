@@ -0,0 +1,66 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Places resources into a single memory heap so that resources whose lifetimes don't overlap
+// share the same memory. A lifetime is an inclusive range of pass indices within a frame;
+// resources that carry data between frames should use the full range of passes.
+// The placement is greedy: resources are placed in the order of decreasing size, each one at the
+// lowest aligned offset that doesn't intersect any already placed resource with an overlapping lifetime.
+// The planner only deals with numbers, the caller creates the heap and binds the resources.
+class TransientResourcePlanner
+{
+private:
+    struct Resource
+    {
+        std::string name;
+        uint64_t size = 0;
+        uint64_t alignment = 1;
+        uint32_t firstPass = 0;
+        uint32_t lastPass = 0;
+        uint64_t offset = 0;
+    };
+
+    std::vector<Resource> m_Resources;
+    uint64_t m_HeapSize = 0;
+    bool m_Planned = false;
+
+public:
+    // Adds a resource that is live from 'firstPass' to 'lastPass', inclusive. 'alignment' must be a power of 2.
+    // Returns the index of the resource, to be used with GetOffset.
+    uint32_t AddResource(const char* name, uint64_t size, uint64_t alignment, uint32_t firstPass, uint32_t lastPass);
+
+    // Computes the offsets of all resources and the heap size.
+    void Plan();
+
+    void Reset();
+
+    uint32_t GetResourceCount() const { return uint32_t(m_Resources.size()); }
+    const std::string& GetName(uint32_t index) const { return m_Resources[index].name; }
+    uint64_t GetOffset(uint32_t index) const;
+
+    // Returns true if the resource shares some memory with another resource.
+    bool IsAliased(uint32_t index) const;
+
+    // Size of the heap that holds all resources, valid after Plan.
+    uint64_t GetHeapSize() const;
+
+    // Total size of the resources if each one had its own allocation.
+    uint64_t GetTotalResourceBytes() const;
+
+    uint64_t GetSavedBytes() const { return GetTotalResourceBytes() - GetHeapSize(); }
+
+    static bool LifetimesOverlap(uint32_t firstPassA, uint32_t lastPassA, uint32_t firstPassB, uint32_t lastPassB);
+};
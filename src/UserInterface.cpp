@@ -34,15 +34,19 @@
 
 #include "UserInterface.h"
 #include "Profiler.h"
+#include "RenderTargets.h"
 #include "SampleScene.h"
 
 #include <donut/engine/IesProfile.h>
 #include <donut/app/Camera.h>
 #include <donut/app/UserInterfaceUtils.h>
 #include <donut/core/json.h>
+#include <donut/core/log.h>
 
 #include <json/writer.h>
 
+#include "../shaders/ShaderParameters.h"
+
 using namespace donut;
 
 UIData::UIData()
@@ -173,6 +177,25 @@ void UIData::ApplyPreset()
         rtxdiContextParams.CheckerboardSamplingMode = newCheckerboardMode;
         resetRtxdiContext = true;
     }
+
+    // Report the memory saved by aliasing the transient render targets with this preset.
+    // The render size is only known after the first frame, see SetupRenderPasses in main.cpp
+    if (rtxdiContextParams.RenderWidth > 0 && rtxdiContextParams.RenderHeight > 0)
+    {
+        static const char* const c_PresetNames[] = { "Custom", "Fast", "Medium", "Unbiased", "Ultra", "Reference" };
+
+        TransientRenderTargetSettings transientSettings;
+        transientSettings.enableDenoiser = enableDenoiser;
+        transientSettings.enableGradients = enableDenoiser && lightingSettings.enableGradients && directLightingMode == DirectLightingMode::ReStir;
+        transientSettings.enableDebugOutput = visualizationMode != VIS_MODE_NONE || debugRenderOutputBuffer != DebugRenderOutput::LDRColor;
+
+        const uint64_t savedBytes = RenderTargets::EstimateTransientSavedBytes(
+            dm::int2(int(rtxdiContextParams.RenderWidth), int(rtxdiContextParams.RenderHeight)), transientSettings);
+
+        log::info("Preset %s: aliasing the transient render targets saves about %.2f MB at %ux%u",
+            c_PresetNames[uint32_t(preset)], double(savedBytes) / double(1 << 20),
+            rtxdiContextParams.RenderWidth, rtxdiContextParams.RenderHeight);
+    }
 }
 
 #ifdef WITH_NRD
@@ -308,7 +331,24 @@ void UserInterface::SamplingSettings()
     if (ImGui_ColoredTreeNode("Shared ReSTIR Settings", c_ColorRegularHeader))
     {
         m_ui.resetAccumulation |= ImGui::Checkbox("Importance Sample Local Lights", &m_ui.enableLocalLightImportanceSampling);
+        m_ui.resetAccumulation |= ImGui::Checkbox("Light Tree Sampling", &m_ui.enableLightTreeSampling);
+        ShowHelpMarker("Sample the local lights by traversing a tree of light bounds built on the CPU, "
+            "which prefers the lights that are close to and facing the surface. Replaces local light importance sampling.");
+        m_ui.resetAccumulation |= ImGui::Checkbox("Alias Table Local Light Sampling", (bool*)&m_ui.lightingSettings.enableLocalLightAliasTable);
+        ShowHelpMarker("Importance sample the local lights from an alias table built on the CPU from the light power, "
+            "which takes one fetch per sample instead of a descent through the PDF texture mip chain.");
         m_ui.resetAccumulation |= ImGui::Checkbox("Importance Sample Env. Map", &m_ui.environmentMapImportanceSampling);
+        if (ImGui::Checkbox("Env. Map Alias Table", (bool*)&m_ui.lightingSettings.enableEnvironmentAliasTable))
+        {
+            // The PDF texture is not generated while the alias table is in use
+            m_ui.environmentMapDirty = 1;
+            m_ui.resetAccumulation = true;
+        }
+        ShowHelpMarker("Importance sample the environment maps loaded from files with an alias table that is built on the CPU "
+            "and cached on disk, instead of the PDF texture mip chain.");
+        ImGui::Checkbox("Incremental Light Updates", &m_ui.enableIncrementalLightUpdates);
+        ShowHelpMarker("Only process the emissive meshes and lights that have changed since the previous frame, "
+            "as long as no emitters are added or removed.");
 
         if (ImGui::TreeNode("RTXDI Context"))
         {
@@ -320,13 +360,29 @@ void UserInterface::SamplingSettings()
             m_ui.rtxdiContextParams.CheckerboardSamplingMode = enableCheckerboardSampling ? rtxdi::CheckerboardMode::Black : rtxdi::CheckerboardMode::Off;
 
             ImGui::Checkbox("Visibility Variance Sampling", &m_ui.rtxdiContextParams.enableVisibilityVairanceSampling);
+            if (m_ui.rtxdiContextParams.enableVisibilityVairanceSampling)
+            {
+                ImGui::Combo("Visibility Buffer Layout", (int*)&m_ui.rtxdiContextParams.VisibilityLayout, "Dense\0Compact\0");
+                if (m_ui.rtxdiContextParams.VisibilityLayout == rtxdi::VisibilityBufferLayout::Compact)
+                    ImGui::DragInt("Visibility Lights per Cell", (int*)&m_ui.rtxdiContextParams.VisibilityLightsPerCell, 1, 1, 1024);
+            }
 
-            ImGui::Combo("ReGIR Mode", (int*)&m_ui.rtxdiContextParams.ReGIR.Mode, "Disabled\0Grid\0Onion\0AlignGrid\0");
+            int reservoirBlockSizeIndex = (m_ui.rtxdiContextParams.ReservoirBlockSize == 8) ? 0 : (m_ui.rtxdiContextParams.ReservoirBlockSize == 32) ? 2 : 1;
+            ImGui::Combo("Reservoir Block Size", &reservoirBlockSizeIndex, "8x8\016x16\032x32\0");
+            m_ui.rtxdiContextParams.ReservoirBlockSize = 8u << reservoirBlockSizeIndex;
+            ImGui::Combo("Reservoir Block Layout", (int*)&m_ui.rtxdiContextParams.ReservoirLayout, "Row-Major\0Z-Curve\0");
+
+            ImGui::Combo("ReGIR Mode", (int*)&m_ui.rtxdiContextParams.ReGIR.Mode, "Disabled\0Grid\0Onion\0AlignGrid\0HashGrid\0");
             ImGui::DragInt("Lights per Cell", (int*)&m_ui.rtxdiContextParams.ReGIR.LightsPerCell, 1, 32, 8192);
             if (m_ui.rtxdiContextParams.ReGIR.Mode == rtxdi::ReGIRMode::Grid || m_ui.rtxdiContextParams.ReGIR.Mode == rtxdi::ReGIRMode::AlignGrid)
             {
                 ImGui::DragInt3("Grid Resolution", (int*)&m_ui.rtxdiContextParams.ReGIR.GridSize.x, 1, 1, 64);
             }
+            else if (m_ui.rtxdiContextParams.ReGIR.Mode == rtxdi::ReGIRMode::HashGrid)
+            {
+                ImGui::DragInt("Hash Grid Capacity", (int*)&m_ui.rtxdiContextParams.ReGIR.HashGridCapacity, 16, 256, 65536);
+                ImGui::SliderInt("Hash Grid Max Probes", (int*)&m_ui.rtxdiContextParams.ReGIR.HashGridMaxProbes, 1, 64);
+            }
             else if (m_ui.rtxdiContextParams.ReGIR.Mode == rtxdi::ReGIRMode::Onion)
             {
                 ImGui::SliderInt("Onion Layers - Detail", (int*)&m_ui.rtxdiContextParams.ReGIR.OnionDetailLayers, 0, 8);
@@ -343,6 +399,12 @@ void UserInterface::SamplingSettings()
             m_ui.resetAccumulation |= ImGui::Checkbox("Use ReGIR", (bool*)&m_ui.lightingSettings.enableReGIR);
             m_ui.resetAccumulation |= ImGui::SliderFloat("Cell Size", &m_ui.regirCellSize, 0.1f, 4.f);
             m_ui.resetAccumulation |= ImGui::SliderInt("Grid Build Samples", (int*)&m_ui.lightingSettings.numRegirBuildSamples, 0, 32);
+            m_ui.resetAccumulation |= ImGui::SliderInt("Refresh Interval", (int*)&m_ui.lightingSettings.regirRefreshInterval, 1, 16);
+            ShowHelpMarker("Number of frames over which all ReGIR cells are rebuilt. Cells with changed lights are updated immediately. "
+                "The HashGrid mode rebuilds all cells on every frame.");
+            m_ui.resetAccumulation |= ImGui::Checkbox("Occupancy-Driven Build", (bool*)&m_ui.lightingSettings.enableReGIROccupancyBuild);
+            ShowHelpMarker("Builds only the cells reachable from the visible surfaces (Grid, AlignGrid and Onion modes). "
+                "Other lookups, e.g. from secondary surfaces, fall back to local light sampling. Ignores the refresh interval.");
             m_ui.resetAccumulation |= ImGui::SliderFloat("Sampling Jitter", &m_ui.regirSamplingJitter, 0.0f, 2.f);
 
             ImGui::Checkbox("Freeze Position", &m_ui.freezeRegirPosition);
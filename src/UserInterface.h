@@ -153,6 +153,8 @@ struct UIData
     int environmentMapIndex = -1;
     bool environmentMapImportanceSampling = true;
     bool enableLocalLightImportanceSampling = true;
+    bool enableLightTreeSampling = false;
+    bool enableIncrementalLightUpdates = true;
     float environmentIntensityBias = 0.f;
     float environmentRotation = 0.f;
     bool enableSunLight = true;
@@ -185,6 +187,8 @@ struct UIData
 
     rtxdi::ContextParameters rtxdiContextParams;
     bool resetRtxdiContext = false;
+    uint32_t rtxdiMemoryBudgetMB = 0; // When nonzero, the context parameters are reduced to fit the RTXDI resources into this budget
+    float lightBufferGrowthFactor = 1.5f; // Headroom added when the light buffers grow, see RtxdiResources::ResizeLightBuffers
     uint32_t regirLightSlotCount = 0;
     bool freezeRegirPosition = false;
     float regirCellSize = 1.f;
@@ -44,6 +44,7 @@
 #include "PrepareLightsPass.h"
 #include "RenderEnvironmentMapPass.h"
 #include "GenerateMipsPass.h"
+#include "EnvironmentMapAliasTable.h"
 #include "LightingPasses.h"
 #include "RtxdiResources.h"
 #include "SampleScene.h"
@@ -118,6 +119,7 @@ private:
     std::unique_ptr<PrepareLightsPass> m_PrepareLightsPass;
     std::unique_ptr<RenderEnvironmentMapPass> m_RenderEnvironmentMapPass;
     std::unique_ptr<GenerateMipsPass> m_EnvironmentMapPdfMipmapPass;
+    std::unique_ptr<EnvironmentMapAliasTable> m_EnvironmentMapAliasTable;
     std::unique_ptr<GenerateMipsPass> m_LocalLightPdfMipmapPass;
     std::unique_ptr<LightingPasses> m_LightingPasses;
     std::unique_ptr<VisualizationPass> m_VisualizationPass;
@@ -125,6 +127,9 @@ private:
     std::unique_ptr<engine::IesProfileLoader> m_IesProfileLoader;
     std::shared_ptr<Profiler> m_Profiler;
     std::unique_ptr<DebugVizPasses> m_DebugVizPasses;
+#ifdef DONUT_WITH_TASKFLOW
+    std::unique_ptr<tf::Executor> m_Executor;
+#endif
 
     uint32_t m_RenderFrameIndex = 0;
     
@@ -148,7 +153,7 @@ private:
 
     std::vector<std::shared_ptr<engine::IesProfile>> m_IesProfiles;
     
-    dm::float3 m_RegirCenter;
+    dm::float3 m_RegirCenter = 0.f;
     
     enum class FrameStepMode
     {
@@ -253,6 +258,12 @@ public:
         m_PostprocessGBufferPass = std::make_unique<PostprocessGBufferPass>(GetDevice(), m_ShaderFactory);
         m_GlassPass = std::make_unique<GlassPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
         m_PrepareLightsPass = std::make_unique<PrepareLightsPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_BindlessLayout);
+        m_EnvironmentMapAliasTable = std::make_unique<EnvironmentMapAliasTable>(GetDevice(), m_RootFs, app::GetDirectoryWithExecutable() / "cache" / "environment");
+#ifdef DONUT_WITH_TASKFLOW
+        m_Executor = std::make_unique<tf::Executor>();
+        m_PrepareLightsPass->SetExecutor(m_Executor.get());
+        m_EnvironmentMapAliasTable->SetExecutor(m_Executor.get());
+#endif
         m_LightingPasses = std::make_unique<LightingPasses>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
 
 
@@ -487,10 +498,15 @@ public:
         if (m_RenderTargets && m_RenderTargets->Size.x == int(width) && m_RenderTargets->Size.y == int(height))
             return;
 
+        ResetRenderTargets();
+    }
+
+    // Releases the render targets and the passes that reference them, they are recreated by SetupRenderPasses
+    void ResetRenderTargets()
+    {
         m_BindingCache.Clear();
         m_RenderTargets = nullptr;
-        m_RtxdiContext = nullptr;
-        m_RtxdiResources = nullptr;
+        // The RTXDI context and resources are resized in place by SetupRenderPasses
         m_TemporalAntiAliasingPass = nullptr;
         m_ToneMappingPass = nullptr;
         m_BloomPass = nullptr;
@@ -505,6 +521,26 @@ public:
 #endif
     }
 
+    TransientRenderTargetSettings GetTransientRenderTargetSettings() const
+    {
+        TransientRenderTargetSettings settings;
+#if WITH_NRD
+        settings.enableDenoiser = m_ui.enableDenoiser;
+#endif
+        // Gradients are only produced by the direct ReSTIR pass and only used by the denoiser, see RenderScene
+        settings.enableGradients = settings.enableDenoiser && m_ui.lightingSettings.enableGradients &&
+            m_ui.directLightingMode == DirectLightingMode::ReStir;
+        settings.enableDebugOutput = m_ui.visualizationMode != VIS_MODE_NONE ||
+            m_ui.debugRenderOutputBuffer != DebugRenderOutput::LDRColor;
+        return settings;
+    }
+
+    // The procedural environment map is rendered on the GPU, so only the maps loaded from files have an alias table
+    bool UseEnvironmentMapAliasTable() const
+    {
+        return m_ui.lightingSettings.enableEnvironmentAliasTable && m_ui.environmentMapIndex > 0 && m_EnvironmentMapAliasTable->IsValid();
+    }
+
     void LoadEnvironmentMap()
     {
         if (m_EnvironmentMap)
@@ -518,6 +554,8 @@ public:
             m_EnvironmentMap = nullptr;
         }
 
+        m_EnvironmentMapAliasTable->Clear();
+
         if (m_ui.environmentMapIndex > 0)
         {
             auto& environmentMaps = m_Scene->GetEnvironmentMaps();
@@ -531,6 +569,9 @@ public:
                 m_TextureCache->LoadingFinished();
 
                 m_EnvironmentMap->bindlessDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, m_EnvironmentMap->texture));
+
+                // Falls back to the PDF texture if the table can't be built
+                m_EnvironmentMapAliasTable->Load(environmentMapPath, m_EnvironmentMap->texture);
             }
             else
             {
@@ -608,6 +649,8 @@ public:
 
         bool renderTargetsCreated = false;
         bool rtxdiResourcesCreated = false;
+        bool rtxdiReservoirsReallocated = false;
+        bool rtxdiLightBuffersReallocated = false;
 
         if (!m_RenderEnvironmentMapPass)
         {
@@ -622,16 +665,20 @@ public:
         m_PrepareLightsPass->CountLightsInScene(numEmissiveMeshes, numEmissiveTriangles);
         uint32_t numPrimitiveLights = uint32_t(m_Scene->GetSceneGraph()->GetLights().size());
         uint32_t numGeometryInstances = uint32_t(m_Scene->GetSceneGraph()->GetGeometryInstancesCount());
+
+        uint32_t meshAllocationQuantum = 128;
+        uint32_t triangleAllocationQuantum = 1024;
+        uint32_t primitiveAllocationQuantum = 128;
+        uint32_t maxEmissiveMeshes = (numEmissiveMeshes + meshAllocationQuantum - 1) & ~(meshAllocationQuantum - 1);
+        uint32_t maxEmissiveTriangles = (numEmissiveTriangles + triangleAllocationQuantum - 1) & ~(triangleAllocationQuantum - 1);
+        uint32_t maxPrimitiveLights = (numPrimitiveLights + primitiveAllocationQuantum - 1) & ~(primitiveAllocationQuantum - 1);
         
         uint2 environmentMapSize = uint2(environmentMap->getDesc().width, environmentMap->getDesc().height);
 
+        // Growing light counts are handled by ResizeLightBuffers below, without recreating the other resources
         if (m_RtxdiResources && (
             environmentMapSize.x != m_RtxdiResources->EnvironmentPdfTexture->getDesc().width ||
-            environmentMapSize.y != m_RtxdiResources->EnvironmentPdfTexture->getDesc().height ||
-            numEmissiveMeshes > m_RtxdiResources->GetMaxEmissiveMeshes() ||
-            numEmissiveTriangles > m_RtxdiResources->GetMaxEmissiveTriangles() || 
-            numPrimitiveLights > m_RtxdiResources->GetMaxPrimitiveLights() ||
-            numGeometryInstances > m_RtxdiResources->GetMaxGeometryInstances()))
+            environmentMapSize.y != m_RtxdiResources->EnvironmentPdfTexture->getDesc().height))
         {
             m_RtxdiResources = nullptr;
         }
@@ -641,10 +688,28 @@ public:
             m_ui.rtxdiContextParams.RenderWidth = renderWidth;
             m_ui.rtxdiContextParams.RenderHeight = renderHeight;
 
+            if (m_ui.rtxdiMemoryBudgetMB > 0)
+            {
+                if (!RtxdiResources::FitContextParametersToBudget(m_ui.rtxdiContextParams, uint64_t(m_ui.rtxdiMemoryBudgetMB) << 20,
+                    numEmissiveMeshes, numEmissiveTriangles, numPrimitiveLights, numGeometryInstances, environmentMapSize.x, environmentMapSize.y))
+                {
+                    log::warning("The RTXDI resources don't fit into the memory budget of %u MB even with the smallest light sampling structures.",
+                        m_ui.rtxdiMemoryBudgetMB);
+                }
+            }
+
             m_RtxdiContext = std::make_unique<rtxdi::Context>(m_ui.rtxdiContextParams);
 
             m_ui.regirLightSlotCount = m_RtxdiContext->GetReGIRLightSlotCount();
         }
+        else if (m_RtxdiContext->GetParameters().RenderWidth != renderWidth ||
+                 m_RtxdiContext->GetParameters().RenderHeight != renderHeight)
+        {
+            m_ui.rtxdiContextParams.RenderWidth = renderWidth;
+            m_ui.rtxdiContextParams.RenderHeight = renderHeight;
+
+            m_RtxdiContext->Resize(renderWidth, renderHeight);
+        }
 
 #if WITH_RTXGI
         if (!m_RTXGI)
@@ -666,7 +731,11 @@ public:
 
         if (!m_RenderTargets)
         {
-            m_RenderTargets = std::make_shared<RenderTargets>(GetDevice(), int2((int)renderWidth, (int)renderHeight));
+            m_RenderTargets = std::make_shared<RenderTargets>(GetDevice(), int2((int)renderWidth, (int)renderHeight), GetTransientRenderTargetSettings());
+
+            log::debug("Transient render targets: %.2f MB, %.2f MB saved by aliasing",
+                double(m_RenderTargets->GetTransientHeapSize()) / double(1 << 20),
+                double(m_RenderTargets->GetTransientSavedBytes()) / double(1 << 20));
 
             m_Profiler->SetRenderTargets(m_RenderTargets);
 
@@ -698,27 +767,48 @@ public:
 
         if (!m_RtxdiResources)
         {
-            uint32_t meshAllocationQuantum = 128;
-            uint32_t triangleAllocationQuantum = 1024;
-            uint32_t primitiveAllocationQuantum = 128;
-
             m_RtxdiResources = std::make_unique<RtxdiResources>(
                 GetDevice(), 
                 *m_RtxdiContext, 
-                (numEmissiveMeshes + meshAllocationQuantum - 1) & ~(meshAllocationQuantum - 1),
-                (numEmissiveTriangles + triangleAllocationQuantum - 1) & ~(triangleAllocationQuantum - 1),
-                (numPrimitiveLights + primitiveAllocationQuantum - 1) & ~(primitiveAllocationQuantum - 1),
+                maxEmissiveMeshes,
+                maxEmissiveTriangles,
+                maxPrimitiveLights,
                 numGeometryInstances,
                 environmentMapSize.x,
                 environmentMapSize.y);
 
             m_PrepareLightsPass->CreateBindingSet(*m_RtxdiResources);
+
+            const RtxdiMemoryFootprint footprint = RtxdiResources::ComputeMemoryFootprint(*m_RtxdiContext,
+                m_RtxdiResources->GetMaxEmissiveMeshes(), m_RtxdiResources->GetMaxEmissiveTriangles(), m_RtxdiResources->GetMaxPrimitiveLights(),
+                m_RtxdiResources->GetMaxGeometryInstances(), environmentMapSize.x, environmentMapSize.y);
+            for (const auto& [name, bytes] : footprint.GetEntries())
+                log::debug("RTXDI resource %s: %.2f MB", name, double(bytes) / double(1 << 20));
+            log::debug("RTXDI resources total: %.2f MB", double(footprint.GetTotalBytes()) / double(1 << 20));
             
             rtxdiResourcesCreated = true;
 
             // Make sure that the environment PDF map is re-generated
             m_ui.environmentMapDirty = 1;
         }
+        else
+        {
+            // Keep the reservoir storage if it still fits after a resize
+            rtxdiReservoirsReallocated = m_RtxdiResources->ResizeReservoirBuffers(GetDevice(), *m_RtxdiContext);
+
+            // Only the buffers whose light counts no longer fit are reallocated
+            rtxdiLightBuffersReallocated = m_RtxdiResources->ResizeLightBuffers(GetDevice(), *m_RtxdiContext,
+                maxEmissiveMeshes, maxEmissiveTriangles, maxPrimitiveLights, numGeometryInstances, std::max(double(m_ui.lightBufferGrowthFactor), 1.0));
+
+            if (rtxdiLightBuffersReallocated)
+            {
+                m_PrepareLightsPass->CreateBindingSet(*m_RtxdiResources);
+
+                log::debug("RTXDI light buffers grown to %u emissive meshes, %u emissive triangles, %u primitive lights, %u geometry instances",
+                    m_RtxdiResources->GetMaxEmissiveMeshes(), m_RtxdiResources->GetMaxEmissiveTriangles(),
+                    m_RtxdiResources->GetMaxPrimitiveLights(), m_RtxdiResources->GetMaxGeometryInstances());
+            }
+        }
         
         if (!m_EnvironmentMapPdfMipmapPass || rtxdiResourcesCreated)
         {
@@ -729,7 +819,7 @@ public:
                 m_RtxdiResources->EnvironmentPdfTexture);
         }
 
-        if (!m_LocalLightPdfMipmapPass || rtxdiResourcesCreated)
+        if (!m_LocalLightPdfMipmapPass || rtxdiResourcesCreated || rtxdiLightBuffersReallocated)
         {
             m_LocalLightPdfMipmapPass = std::make_unique<GenerateMipsPass>(
                 GetDevice(),
@@ -738,7 +828,7 @@ public:
                 m_RtxdiResources->LocalLightPdfTexture);
         }
 
-        if (renderTargetsCreated || rtxdiResourcesCreated)
+        if (renderTargetsCreated || rtxdiResourcesCreated || rtxdiReservoirsReallocated || rtxdiLightBuffersReallocated)
         {
             m_LightingPasses->CreateBindingSet(
                 m_Scene->GetTopLevelAS(),
@@ -787,7 +877,7 @@ public:
             m_BloomPass = std::make_unique<render::BloomPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ResolvedFramebuffer, m_UpscaledView);
         }
 
-        if (!m_VisualizationPass || renderTargetsCreated || rtxdiResourcesCreated)
+        if (!m_VisualizationPass || renderTargetsCreated || rtxdiResourcesCreated || rtxdiReservoirsReallocated)
         {
             m_VisualizationPass = std::make_unique<VisualizationPass>(GetDevice(), *m_CommonPasses, *m_ShaderFactory, *m_RenderTargets, *m_RtxdiResources);
         }
@@ -923,6 +1013,9 @@ public:
                     glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
                     log::info("BENCHMARK RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
                 }
+
+                if (!m_args.benchmarkOutputFileName.empty())
+                    SaveBenchmarkResults(*m_Profiler, m_args.benchmarkOutputFileName);
             }
         }
 
@@ -981,10 +1074,21 @@ public:
             renderWidth = m_args.renderWidth;
             renderHeight = m_args.renderHeight;
         }
+
+        // The transient render targets are placed according to the lifetimes that the current settings imply
+        if (m_RenderTargets && m_RenderTargets->IsUpdateRequired(int2((int)renderWidth, (int)renderHeight), GetTransientRenderTargetSettings()))
+            ResetRenderTargets();
+
         SetupView(renderWidth, renderHeight, activeCamera);
         SetupRenderPasses(renderWidth, renderHeight, exposureResetRequired);
         if (!m_ui.freezeRegirPosition)
-            m_RegirCenter = m_Camera.GetPosition();
+        {
+            // The amortized ReGIR build keeps the cells only while the center stays in place, so let the camera
+            // move within half a cell before following it. The sampling jitter is usually larger than that.
+            const float regirCenterTolerance = m_ui.lightingSettings.regirRefreshInterval > 1 ? m_ui.regirCellSize * 0.5f : 0.f;
+            if (dm::length(m_Camera.GetPosition() - m_RegirCenter) > regirCenterTolerance)
+                m_RegirCenter = m_Camera.GetPosition();
+        }
 #if WITH_DLSS
         if (!m_ui.dlssAvailable && m_ui.aaMode == AntiAliasingMode::DLSS)
             m_ui.aaMode = AntiAliasingMode::TAA;
@@ -1100,7 +1204,10 @@ public:
                 m_RenderEnvironmentMapPass->Render(m_CommandList, *m_SunLight, params);
             }
             
-            m_EnvironmentMapPdfMipmapPass->Process(m_CommandList);
+            if (UseEnvironmentMapAliasTable())
+                m_EnvironmentMapAliasTable->Upload(m_CommandList, m_RtxdiResources->EnvironmentAliasTableBuffer);
+            else
+                m_EnvironmentMapPdfMipmapPass->Process(m_CommandList);
 
             m_ui.environmentMapDirty = 0;
         }
@@ -1129,6 +1236,11 @@ public:
         frameParameters.regirCellSize = m_ui.regirCellSize;
         frameParameters.regirSamplingJitter = m_ui.regirSamplingJitter;
         frameParameters.enableLocalLightImportanceSampling = m_ui.enableLocalLightImportanceSampling;
+        frameParameters.enableLightTree = m_ui.enableLightTreeSampling;
+
+        // The alias table replaces the local light PDF texture, see LightingPasses::FillResamplingConstants
+        const bool useLocalLightAliasTable = m_ui.lightingSettings.enableLocalLightAliasTable &&
+            m_ui.enableLocalLightImportanceSampling && !m_ui.enableLightTreeSampling;
 
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::MeshProcessing);
@@ -1138,10 +1250,13 @@ public:
                 *m_RtxdiContext,
                 m_Scene->GetSceneGraph()->GetLights(),
                 m_EnvironmentMapPdfMipmapPass != nullptr && m_ui.environmentMapImportanceSampling,
+                m_ui.enableIncrementalLightUpdates,
+                m_ui.enableLightTreeSampling,
+                useLocalLightAliasTable,
                 frameParameters);
         }
 
-        if (m_ui.enableLocalLightImportanceSampling)
+        if (m_ui.enableLocalLightImportanceSampling && !m_ui.enableLightTreeSampling && !useLocalLightAliasTable)
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::LocalLightPdfMap);
             
@@ -1166,6 +1281,7 @@ public:
         lightingSettings.enablePreviousTLAS &= m_ui.enableAnimations;
         lightingSettings.enableAlphaTestedGeometry = m_ui.gbufferSettings.enableAlphaTestedGeometry;
         lightingSettings.enableTransparentGeometry = m_ui.gbufferSettings.enableTransparentGeometry;
+        lightingSettings.enableEnvironmentAliasTable = UseEnvironmentMapAliasTable();
 #if WITH_NRD
         lightingSettings.reblurDiffHitDistanceParams = &m_ui.reblurSettings.hitDistanceParameters;
         lightingSettings.reblurSpecHitDistanceParams = &m_ui.reblurSettings.hitDistanceParameters;
@@ -1228,6 +1344,14 @@ public:
             lightingSettings.enableGradients = false;
         }
 
+        // Aliased lighting targets start the frame with the data of other transient targets,
+        // and the lighting passes don't write every pixel
+        if (m_RenderTargets->IsAliased(m_RenderTargets->DiffuseLighting) || m_RenderTargets->IsAliased(m_RenderTargets->SpecularLighting))
+        {
+            m_CommandList->clearTextureFloat(m_RenderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            m_CommandList->clearTextureFloat(m_RenderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+        }
+
         if (enableDirectReStirPass || enableIndirect)
         {
             m_LightingPasses->PrepareForLightSampling(m_CommandList,
@@ -1235,6 +1359,8 @@ public:
                 m_View, m_ViewPrevious,
                 lightingSettings,
                 frameParameters,
+                m_PrepareLightsPass->HaveLightsRelocated(),
+                m_PrepareLightsPass->HaveLocalLightsChanged(),
                 /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation);
         }
 
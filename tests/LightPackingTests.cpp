@@ -0,0 +1,138 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "LightPacking.h"
+
+#include <donut/core/math/math.h>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    float3 RandomDirection(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+        while (true)
+        {
+            const float x = uniform(rng);
+            const float y = uniform(rng);
+            const float z = uniform(rng);
+            const float length = std::sqrt(x * x + y * y + z * z);
+            if (length > 1e-3f && length <= 1.f)
+                return float3(x / length, y / length, z / length);
+        }
+    }
+
+    // Finite inputs of all light types, with radiance over a wide range of magnitudes including black and
+    // single-channel colors, unused directions, and directions on the octahedron edges and poles
+    LightPackingInput RandomInput(std::mt19937& rng, uint32_t index)
+    {
+        std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+        std::uniform_real_distribution<float> exponent(-30.f, 45.f);
+
+        LightPackingInput input;
+        input.colorTypeAndFlags = (index % 7) << kPolymorphicLightTypeShift;
+
+        const float scale = std::exp2(exponent(rng));
+        input.radiance = float3(std::abs(uniform(rng)) * scale, std::abs(uniform(rng)) * scale, std::abs(uniform(rng)) * scale);
+        if (index % 13 == 0)
+            input.radiance[index % 3] = 0.f;
+        if (index % 17 == 0)
+            input.radiance = float3(0.f);
+
+        input.center = float3(uniform(rng) * 1000.f, uniform(rng), uniform(rng) * 1e-3f);
+        input.scalars[0] = std::abs(uniform(rng)) * std::exp2(exponent(rng) * 0.5f);
+        input.scalars[1] = (index % 3 == 0) ? uniform(rng) * 70000.f : 0.f;
+
+        if (index % 2 == 1)
+            input.direction1 = RandomDirection(rng);
+        if (index % 11 == 0)
+            input.direction1 = float3(0.f, 0.f, (index % 22 == 0) ? 1.f : -1.f);
+        if (index % 19 == 0)
+            input.direction1 = float3(0.f, (index % 38 == 0) ? 1.f : -1.f, 0.f);
+        if (index % 5 == 0)
+            input.direction2 = RandomDirection(rng);
+
+        if (index % 4 == 0)
+        {
+            input.primaryAxis = RandomDirection(rng);
+            input.cosConeAngleAndSoftness[0] = uniform(rng);
+            input.cosConeAngleAndSoftness[1] = std::abs(uniform(rng));
+            input.iesProfileIndex = index;
+        }
+
+        return input;
+    }
+
+    void CheckBatchMatchesPackLight(bool allowSimd)
+    {
+        // Not a multiple of 8, so that the scalar tail of the vectorized path is covered too
+        const uint32_t lightCount = 100003;
+        std::mt19937 rng(7);
+
+        std::vector<LightPackingInput> inputs;
+        for (uint32_t index = 0; index < lightCount; index++)
+            inputs.push_back(RandomInput(rng, index));
+
+        // The batch writes to arbitrary output indices, so use a permutation
+        std::vector<uint32_t> outputIndices(lightCount);
+        for (uint32_t index = 0; index < lightCount; index++)
+            outputIndices[index] = index;
+        std::shuffle(outputIndices.begin(), outputIndices.end(), rng);
+
+        LightPackingBatch batch;
+        for (uint32_t index = 0; index < lightCount; index++)
+            batch.Append(inputs[index], outputIndices[index]);
+        RTXDI_CHECK_EQUAL(batch.GetSize(), size_t(lightCount));
+
+        std::vector<PolymorphicLightInfo> expected(lightCount);
+        for (uint32_t index = 0; index < lightCount; index++)
+            PackLight(inputs[index], expected[outputIndices[index]]);
+
+        // Stale contents, to catch fields that the batch doesn't write
+        std::vector<PolymorphicLightInfo> actual(lightCount);
+        memset(static_cast<void*>(actual.data()), 0xcd, actual.size() * sizeof(PolymorphicLightInfo));
+        batch.Pack(actual.data(), allowSimd);
+
+        uint32_t mismatches = 0;
+        for (uint32_t index = 0; index < lightCount; index++)
+        {
+            if (memcmp(&actual[index], &expected[index], sizeof(PolymorphicLightInfo)) != 0)
+                mismatches++;
+        }
+        RTXDI_CHECK_EQUAL(mismatches, 0u);
+    }
+}
+
+RTXDI_TEST(LightPacking_ScalarBatchMatchesPackLight)
+{
+    CheckBatchMatchesPackLight(false);
+}
+
+RTXDI_TEST(LightPacking_SimdBatchMatchesPackLight)
+{
+    if (!IsLightPackingSimdSupported())
+    {
+        printf("AVX2 is not supported, only the scalar path is tested.\n");
+        return;
+    }
+
+    CheckBatchMatchesPackLight(true);
+}
@@ -0,0 +1,216 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "LightSlotAllocator.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Allocation
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // The reference allocator: one flag per slot, first fit by scanning the flags
+    struct ReferenceBitmap
+    {
+        std::vector<bool> used;
+
+        bool FindFirstFit(uint32_t count, uint32_t& outOffset) const
+        {
+            uint32_t runStart = 0;
+            for (uint32_t slot = 0; slot < uint32_t(used.size()); slot++)
+            {
+                if (used[slot])
+                {
+                    runStart = slot + 1;
+                    continue;
+                }
+
+                if (slot + 1 - runStart == count)
+                {
+                    outOffset = runStart;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Mark(const Allocation& allocation, bool value)
+        {
+            for (uint32_t slot = allocation.offset; slot < allocation.offset + allocation.count; slot++)
+                used[slot] = value;
+        }
+
+        uint32_t GetAllocatedSlots() const
+        {
+            uint32_t count = 0;
+            for (bool value : used)
+                count += value ? 1 : 0;
+            return count;
+        }
+
+        uint32_t GetUsedRangeEnd() const
+        {
+            for (uint32_t slot = uint32_t(used.size()); slot > 0; slot--)
+            {
+                if (used[slot - 1])
+                    return slot;
+            }
+            return 0;
+        }
+    };
+
+    void CheckAgainstReference(const LightSlotAllocator& allocator, const ReferenceBitmap& reference)
+    {
+        const uint32_t capacity = uint32_t(reference.used.size());
+        RTXDI_CHECK_EQUAL(allocator.GetCapacity(), capacity);
+        RTXDI_CHECK_EQUAL(allocator.GetAllocatedSlots(), reference.GetAllocatedSlots());
+        RTXDI_CHECK_EQUAL(allocator.GetUsedRangeEnd(), reference.GetUsedRangeEnd());
+        RTXDI_CHECK_EQUAL(allocator.GetHoleSlots(), reference.GetUsedRangeEnd() - reference.GetAllocatedSlots());
+
+        // The free ranges must be exactly the maximal runs of free slots, in order
+        auto range = allocator.GetFreeRanges().begin();
+        uint32_t slot = 0;
+        while (slot < capacity)
+        {
+            if (reference.used[slot])
+            {
+                slot++;
+                continue;
+            }
+
+            uint32_t runEnd = slot;
+            while (runEnd < capacity && !reference.used[runEnd])
+                runEnd++;
+
+            RTXDI_CHECK(range != allocator.GetFreeRanges().end());
+            if (range == allocator.GetFreeRanges().end())
+                return;
+
+            RTXDI_CHECK_EQUAL(range->first, slot);
+            RTXDI_CHECK_EQUAL(range->second, runEnd - slot);
+            ++range;
+            slot = runEnd;
+        }
+
+        RTXDI_CHECK(range == allocator.GetFreeRanges().end());
+    }
+}
+
+RTXDI_TEST(LightSlotAllocator_MatchesReferenceBitmap)
+{
+    std::mt19937 rng(5);
+
+    for (int sequence = 0; sequence < 8; sequence++)
+    {
+        uint32_t capacity = 256 + rng() % 2048;
+        LightSlotAllocator allocator(capacity);
+        ReferenceBitmap reference;
+        reference.used.resize(capacity, false);
+        std::vector<Allocation> allocations;
+
+        CheckAgainstReference(allocator, reference);
+
+        for (int step = 0; step < 4000; step++)
+        {
+            const uint32_t action = rng() % 16;
+
+            if (action < 8)
+            {
+                // Mostly small emitters with an occasional large mesh, like the scene emitters
+                const uint32_t count = (rng() % 10 == 0) ? 32 + rng() % 256 : 1 + rng() % 16;
+
+                uint32_t expectedOffset = 0;
+                const bool expectedSuccess = reference.FindFirstFit(count, expectedOffset);
+
+                uint32_t offset = ~0u;
+                const bool success = allocator.Allocate(count, offset);
+                RTXDI_CHECK_EQUAL(success, expectedSuccess);
+
+                if (success && expectedSuccess)
+                {
+                    RTXDI_CHECK_EQUAL(offset, expectedOffset);
+                    Allocation allocation = { offset, count };
+                    reference.Mark(allocation, true);
+                    allocations.push_back(allocation);
+                }
+            }
+            else if (action < 15)
+            {
+                if (allocations.empty())
+                    continue;
+
+                const size_t index = rng() % allocations.size();
+                const Allocation allocation = allocations[index];
+                allocations[index] = allocations.back();
+                allocations.pop_back();
+
+                allocator.Free(allocation.offset, allocation.count);
+                reference.Mark(allocation, false);
+            }
+            else
+            {
+                // Grow, or shrink to somewhere around the used range end, which may fail
+                const uint32_t usedRangeEnd = reference.GetUsedRangeEnd();
+                uint32_t newCapacity;
+                if (rng() % 2)
+                    newCapacity = capacity + rng() % 512;
+                else
+                    newCapacity = (usedRangeEnd > 16 ? usedRangeEnd - 16 : 0) + rng() % 32;
+
+                const bool expectedSuccess = newCapacity >= usedRangeEnd;
+                RTXDI_CHECK_EQUAL(allocator.SetCapacity(newCapacity), expectedSuccess);
+
+                if (expectedSuccess)
+                {
+                    capacity = newCapacity;
+                    reference.used.resize(capacity, false);
+                }
+            }
+
+            CheckAgainstReference(allocator, reference);
+        }
+
+        // Releasing everything must leave a single free range covering the whole buffer
+        for (const Allocation& allocation : allocations)
+            allocator.Free(allocation.offset, allocation.count);
+
+        RTXDI_CHECK_EQUAL(allocator.GetAllocatedSlots(), 0u);
+        RTXDI_CHECK_EQUAL(allocator.GetUsedRangeEnd(), 0u);
+        RTXDI_CHECK_EQUAL(allocator.GetFreeRanges().size(), capacity > 0 ? 1u : 0u);
+    }
+}
+
+RTXDI_TEST(LightSlotAllocator_ZeroCapacity)
+{
+    LightSlotAllocator allocator;
+    uint32_t offset = 0;
+    RTXDI_CHECK(!allocator.Allocate(1, offset));
+    RTXDI_CHECK(allocator.GetFreeRanges().empty());
+    RTXDI_CHECK_EQUAL(allocator.GetUsedRangeEnd(), 0u);
+
+    RTXDI_CHECK(allocator.SetCapacity(4));
+    RTXDI_CHECK(allocator.Allocate(4, offset));
+    RTXDI_CHECK_EQUAL(offset, 0u);
+    RTXDI_CHECK(allocator.GetFreeRanges().empty());
+    RTXDI_CHECK_EQUAL(allocator.GetUsedRangeEnd(), 4u);
+    RTXDI_CHECK(!allocator.SetCapacity(3));
+
+    // Growing a full allocator adds a free range at the old end
+    RTXDI_CHECK(allocator.SetCapacity(10));
+    RTXDI_CHECK(allocator.Allocate(6, offset));
+    RTXDI_CHECK_EQUAL(offset, 4u);
+}
@@ -0,0 +1,278 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "LightSlotTable.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // An emitter that is the only geometry of its mesh instance
+    LayoutEmitter MakeGeometryEmitter(StableId owner, uint32_t geometryInstanceIndex, uint32_t count)
+    {
+        LayoutEmitter emitter;
+        emitter.owner = owner;
+        emitter.geometryInstanceIndex = geometryInstanceIndex;
+        emitter.instance = geometryInstanceIndex;
+        emitter.count = count;
+        return emitter;
+    }
+
+    // Checks that the emitters have distinct emitter indices below the index count, and that the local emitters
+    // have disjoint ranges inside the allocator's used range, below 'firstInfiniteLightSlot'.
+    void CheckLayout(const LightSlotTable& table, const std::vector<LayoutEmitter>& emitters, uint32_t firstInfiniteLightSlot)
+    {
+        std::vector<bool> usedEmitterIndices(table.GetEmitterIndexCount(), false);
+        std::vector<bool> usedSlots(firstInfiniteLightSlot, false);
+
+        for (const LayoutEmitter& emitter : emitters)
+        {
+            RTXDI_CHECK(emitter.emitterIndex < table.GetEmitterIndexCount());
+            if (emitter.emitterIndex >= table.GetEmitterIndexCount())
+                continue;
+
+            RTXDI_CHECK(!usedEmitterIndices[emitter.emitterIndex]);
+            usedEmitterIndices[emitter.emitterIndex] = true;
+
+            if (emitter.infinite)
+            {
+                RTXDI_CHECK(emitter.lightBufferOffset >= firstInfiniteLightSlot);
+                continue;
+            }
+
+            RTXDI_CHECK(emitter.lightBufferOffset + emitter.count <= table.GetSlotAllocator().GetUsedRangeEnd());
+            RTXDI_CHECK(emitter.lightBufferOffset + emitter.count <= firstInfiniteLightSlot);
+            for (uint32_t slot = emitter.lightBufferOffset; slot < emitter.lightBufferOffset + emitter.count && slot < firstInfiniteLightSlot; slot++)
+            {
+                RTXDI_CHECK(!usedSlots[slot]);
+                usedSlots[slot] = true;
+            }
+        }
+    }
+}
+
+RTXDI_TEST(LightSlotTable_UnchangedEmittersKeepTheirSlots)
+{
+    const uint32_t emitterCount = 64;
+    const uint32_t capacity = 4096;
+    std::vector<LayoutEmitter> emitters;
+    for (uint32_t index = 0; index < emitterCount; index++)
+        emitters.push_back(MakeGeometryEmitter({ index, 0 }, index, 1 + index % 7));
+
+    LightSlotTable table;
+    std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+    table.Update(nullptr, emitters, emitterCount, capacity, freedRanges);
+    CheckLayout(table, emitters, capacity);
+    for (const LayoutEmitter& emitter : emitters)
+        RTXDI_CHECK_EQUAL(emitter.previousLightBufferOffset, -1);
+
+    const std::vector<LayoutEmitter> firstLayout = emitters;
+    for (int update = 0; update < 3; update++)
+    {
+        freedRanges.clear();
+        RTXDI_CHECK(!table.Update(nullptr, emitters, emitterCount, capacity, freedRanges));
+        RTXDI_CHECK(freedRanges.empty());
+
+        for (uint32_t index = 0; index < emitterCount; index++)
+        {
+            RTXDI_CHECK_EQUAL(emitters[index].lightBufferOffset, firstLayout[index].lightBufferOffset);
+            RTXDI_CHECK_EQUAL(emitters[index].emitterIndex, firstLayout[index].emitterIndex);
+            RTXDI_CHECK_EQUAL(emitters[index].previousLightBufferOffset, int(firstLayout[index].lightBufferOffset));
+        }
+    }
+
+    RTXDI_CHECK_EQUAL(table.GetEmitterIndexCount(), emitterCount);
+}
+
+RTXDI_TEST(LightSlotTable_ReplaceEveryEmitter)
+{
+    // Every emitter is replaced by a new one in the same update, which must reuse the released emitter indices:
+    // the visibility buffer only has room for as many emitters as there are in the scene.
+    const uint32_t emitterCount = 100;
+    const uint32_t capacity = 4096;
+    const uint32_t rounds = 8;
+
+    LightSlotTable table;
+    for (uint32_t round = 0; round < rounds; round++)
+    {
+        std::vector<LayoutEmitter> emitters;
+        for (uint32_t index = 0; index < emitterCount; index++)
+            emitters.push_back(MakeGeometryEmitter({ round * emitterCount + index, 0 }, index, 1 + (index + round) % 5));
+
+        std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+        table.Update(nullptr, emitters, emitterCount, capacity, freedRanges);
+
+        RTXDI_CHECK_EQUAL(table.GetEmitterIndexCount(), emitterCount);
+        RTXDI_CHECK_EQUAL(freedRanges.size(), size_t(round == 0 ? 0 : emitterCount));
+        for (const LayoutEmitter& emitter : emitters)
+            RTXDI_CHECK_EQUAL(emitter.previousLightBufferOffset, -1);
+
+        CheckLayout(table, emitters, capacity);
+    }
+}
+
+RTXDI_TEST(LightSlotTable_RandomUpdates)
+{
+    // Emitters are added, removed and resized at random, and some of them are primitive lights, some infinite.
+    // The emitter index count never exceeds the largest number of emitters in a single update.
+    const uint32_t maxInstances = 200;
+    const uint32_t maxPrimitiveLights = 20;
+    const uint32_t capacity = 2048;
+    std::mt19937 rng(1);
+
+    std::vector<StableId> owners(maxInstances + maxPrimitiveLights);
+    for (uint32_t index = 0; index < uint32_t(owners.size()); index++)
+        owners[index] = { index, 0 };
+    std::vector<uint32_t> counts(maxInstances);
+    std::vector<bool> present(maxInstances + maxPrimitiveLights, false);
+    for (uint32_t& count : counts)
+        count = 1 + rng() % 8;
+
+    LightSlotTable table;
+    size_t maxEmitters = 0;
+
+    for (int update = 0; update < 500; update++)
+    {
+        for (uint32_t index = 0; index < uint32_t(present.size()); index++)
+        {
+            if (rng() % 8 == 0)
+                present[index] = !present[index];
+
+            // A new object that has been given the ID index of a removed one is a different emitter
+            if (!present[index] && rng() % 4 == 0)
+                owners[index].generation++;
+        }
+
+        if (rng() % 4 == 0)
+            counts[rng() % maxInstances] = 1 + rng() % 8;
+
+        std::vector<LayoutEmitter> emitters;
+        for (uint32_t index = 0; index < maxInstances; index++)
+        {
+            if (present[index])
+                emitters.push_back(MakeGeometryEmitter(owners[index], index, counts[index]));
+        }
+
+        uint32_t numInfiniteLights = 0;
+        uint32_t primitiveLightIndex = 0;
+        for (uint32_t index = maxInstances; index < uint32_t(present.size()); index++)
+        {
+            if (!present[index])
+                continue;
+
+            LayoutEmitter emitter;
+            emitter.owner = owners[index];
+            emitter.instance = primitiveLightIndex++;
+            emitter.count = 1;
+            emitter.infinite = index % 4 == 0;
+            numInfiniteLights += emitter.infinite ? 1 : 0;
+            emitters.push_back(emitter);
+        }
+
+        maxEmitters = std::max(maxEmitters, emitters.size());
+
+        std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+        const bool relocate = table.Update(nullptr, emitters, maxInstances, capacity - numInfiniteLights, freedRanges);
+        CheckLayout(table, emitters, capacity - numInfiniteLights);
+        RTXDI_CHECK(table.GetEmitterIndexCount() <= maxEmitters);
+
+        // Emitters that have been found again keep their slots unless the layout has been relocated
+        for (const LayoutEmitter& emitter : emitters)
+        {
+            if (emitter.previousLightBufferOffset >= 0 && !relocate)
+                RTXDI_CHECK_EQUAL(emitter.lightBufferOffset, uint32_t(emitter.previousLightBufferOffset));
+        }
+    }
+}
+
+RTXDI_TEST(LightSlotTable_ReusedIdIsNewEmitter)
+{
+    // The ID index of a removed mesh instance is given to a new one at the same geometry instance index:
+    // the new emitter must not inherit the slot and emitter history of the old one.
+    const uint32_t capacity = 1024;
+    std::vector<LayoutEmitter> emitters = { MakeGeometryEmitter({ 0, 0 }, 0, 4), MakeGeometryEmitter({ 1, 0 }, 1, 4) };
+
+    LightSlotTable table;
+    std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+    table.Update(nullptr, emitters, 2, capacity, freedRanges);
+    const uint32_t replacedOffset = emitters[1].lightBufferOffset;
+
+    emitters[1].owner = { 1, 1 };
+    freedRanges.clear();
+    table.Update(nullptr, emitters, 2, capacity, freedRanges);
+
+    RTXDI_CHECK_EQUAL(emitters[0].previousLightBufferOffset, int(emitters[0].lightBufferOffset));
+    RTXDI_CHECK_EQUAL(emitters[1].previousLightBufferOffset, -1);
+    RTXDI_CHECK_EQUAL(freedRanges.size(), size_t(1));
+    RTXDI_CHECK_EQUAL(freedRanges[0].first, replacedOffset);
+    CheckLayout(table, emitters, capacity);
+
+    // Same for primitive lights, whose slots are indexed by ID
+    LayoutEmitter light;
+    light.owner = { 0, 0 };
+    light.count = 1;
+    std::vector<LayoutEmitter> lights = { light };
+    table.Update(nullptr, lights, 0, capacity, freedRanges);
+    table.Update(nullptr, lights, 0, capacity, freedRanges);
+    RTXDI_CHECK(lights[0].previousLightBufferOffset >= 0);
+
+    lights[0].owner.generation++;
+    table.Update(nullptr, lights, 0, capacity, freedRanges);
+    RTXDI_CHECK_EQUAL(lights[0].previousLightBufferOffset, -1);
+}
+
+RTXDI_TEST(LightSlotTable_MovedInstancesKeepTheirSlots)
+{
+    // Mesh instances with 3 geometries each, of which the first and the last are emissive.
+    // Removing the first instance moves all the others down in the geometry instance list.
+    const uint32_t instanceCount = 50;
+    const uint32_t capacity = 4096;
+
+    auto makeEmitters = [](uint32_t firstInstance, uint32_t instanceCount)
+    {
+        std::vector<LayoutEmitter> emitters;
+        for (uint32_t instance = firstInstance; instance < instanceCount; instance++)
+        {
+            const uint32_t firstGeometryInstance = (instance - firstInstance) * 3;
+            for (uint32_t geometryIndex : { 0u, 2u })
+            {
+                LayoutEmitter emitter = MakeGeometryEmitter({ instance, 0 }, firstGeometryInstance + geometryIndex, 1 + instance % 3 + geometryIndex);
+                emitter.geometryIndex = geometryIndex;
+                emitters.push_back(emitter);
+            }
+        }
+        return emitters;
+    };
+
+    LightSlotTable table;
+    std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+    std::vector<LayoutEmitter> emitters = makeEmitters(0, instanceCount);
+    table.Update(nullptr, emitters, instanceCount * 3, capacity, freedRanges);
+    const std::vector<LayoutEmitter> firstLayout = emitters;
+
+    freedRanges.clear();
+    emitters = makeEmitters(1, instanceCount);
+    RTXDI_CHECK(!table.Update(nullptr, emitters, (instanceCount - 1) * 3, capacity, freedRanges));
+    CheckLayout(table, emitters, capacity);
+
+    RTXDI_CHECK_EQUAL(freedRanges.size(), size_t(2));
+    RTXDI_CHECK_EQUAL(emitters.size(), firstLayout.size() - 2);
+    for (size_t index = 0; index < emitters.size(); index++)
+    {
+        const LayoutEmitter& previous = firstLayout[index + 2];
+        RTXDI_CHECK_EQUAL(emitters[index].lightBufferOffset, previous.lightBufferOffset);
+        RTXDI_CHECK_EQUAL(emitters[index].emitterIndex, previous.emitterIndex);
+        RTXDI_CHECK_EQUAL(emitters[index].previousLightBufferOffset, int(previous.lightBufferOffset));
+    }
+}
@@ -0,0 +1,288 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "ParallelFor.h"
+#include "PrepareLightsTasks.h"
+
+#include <donut/core/math/math.h>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Checks that the chunked task generation of PrepareLightsPass gives bit-identical results with and without
+// an executor, on synthetic scene graphs that are given to the production functions through an EmitterSceneView.
+
+namespace
+{
+    struct SyntheticMesh
+    {
+        std::vector<uint32_t> geometryTriangleCounts;
+        std::vector<bool> geometryEmissive;
+    };
+
+    struct SyntheticInstance
+    {
+        uint32_t meshIndex;
+        uint32_t geometryInstanceIndex;
+    };
+
+    struct SyntheticSceneGraph : public EmitterSceneView
+    {
+        std::vector<SyntheticMesh> meshes;
+        std::vector<SyntheticInstance> instances;
+        uint32_t geometryInstanceCount = 0;
+
+        size_t GetInstanceCount() const override { return instances.size(); }
+        StableId GetInstanceId(size_t instance) const override { return { uint32_t(instance), 0 }; }
+        uint32_t GetInstanceIndex(size_t instance) const override { return uint32_t(instance); }
+        uint32_t GetFirstGeometryInstanceIndex(size_t instance) const override { return instances[instance].geometryInstanceIndex; }
+        uint32_t GetGeometryCount(size_t instance) const override { return uint32_t(meshes[instances[instance].meshIndex].geometryTriangleCounts.size()); }
+
+        uint32_t GetEmissiveTriangleCount(size_t instance, uint32_t geometryIndex) const override
+        {
+            const SyntheticMesh& mesh = meshes[instances[instance].meshIndex];
+            return mesh.geometryEmissive[geometryIndex] ? mesh.geometryTriangleCounts[geometryIndex] : 0;
+        }
+    };
+
+    void CreateSceneGraph(SyntheticSceneGraph& scene, size_t instanceCount, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+
+        scene.meshes.resize(1000);
+        for (SyntheticMesh& mesh : scene.meshes)
+        {
+            const uint32_t geometryCount = 1 + rng() % 4;
+            for (uint32_t geometry = 0; geometry < geometryCount; geometry++)
+            {
+                mesh.geometryTriangleCounts.push_back(1 + rng() % 500);
+                mesh.geometryEmissive.push_back(rng() % 10 == 0);
+            }
+        }
+
+        scene.instances.resize(instanceCount);
+        for (SyntheticInstance& instance : scene.instances)
+        {
+            instance.meshIndex = rng() % uint32_t(scene.meshes.size());
+            instance.geometryInstanceIndex = scene.geometryInstanceCount;
+            scene.geometryInstanceCount += uint32_t(scene.meshes[instance.meshIndex].geometryTriangleCounts.size());
+        }
+    }
+
+    std::vector<LayoutEmitter> GatherEmittersReference(const SyntheticSceneGraph& scene)
+    {
+        std::vector<LayoutEmitter> emitters;
+        for (size_t instanceIndex = 0; instanceIndex < scene.instances.size(); ++instanceIndex)
+        {
+            const SyntheticInstance& instance = scene.instances[instanceIndex];
+            const SyntheticMesh& mesh = scene.meshes[instance.meshIndex];
+            for (uint32_t geometryIndex = 0; geometryIndex < uint32_t(mesh.geometryEmissive.size()); ++geometryIndex)
+            {
+                if (!mesh.geometryEmissive[geometryIndex])
+                    continue;
+
+                LayoutEmitter emitter;
+                emitter.owner = { uint32_t(instanceIndex), 0 };
+                emitter.geometryIndex = geometryIndex;
+                emitter.geometryInstanceIndex = instance.geometryInstanceIndex + geometryIndex;
+                emitter.instance = uint32_t(instanceIndex);
+                emitter.instanceAndGeometryIndex = (uint32_t(instanceIndex) << 12) | geometryIndex;
+                emitter.count = mesh.geometryTriangleCounts[geometryIndex];
+                emitters.push_back(emitter);
+            }
+        }
+        return emitters;
+    }
+
+    // LayoutEmitter has padding, so the emitters are compared field by field
+    bool AreEmittersEqual(const std::vector<LayoutEmitter>& a, const std::vector<LayoutEmitter>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        for (size_t index = 0; index < a.size(); ++index)
+        {
+            const LayoutEmitter& x = a[index];
+            const LayoutEmitter& y = b[index];
+            if (x.owner != y.owner || x.geometryIndex != y.geometryIndex || x.geometryInstanceIndex != y.geometryInstanceIndex ||
+                x.instance != y.instance || x.instanceAndGeometryIndex != y.instanceAndGeometryIndex || x.count != y.count ||
+                x.infinite != y.infinite || x.lightBufferOffset != y.lightBufferOffset || x.emitterIndex != y.emitterIndex ||
+                x.previousLightBufferOffset != y.previousLightBufferOffset)
+                return false;
+        }
+        return true;
+    }
+
+    // Places the emitters next to each other, in reverse order for the emitter indices, like after a relocating layout update.
+    // Returns the number of lights.
+    uint32_t PackEmitters(std::vector<LayoutEmitter>& emitters)
+    {
+        uint32_t lightBufferOffset = 0;
+        for (size_t index = 0; index < emitters.size(); ++index)
+        {
+            emitters[index].lightBufferOffset = lightBufferOffset;
+            emitters[index].emitterIndex = uint32_t(emitters.size() - 1 - index);
+            lightBufferOffset += emitters[index].count;
+        }
+        return lightBufferOffset;
+    }
+
+    uint32_t BuildInPlaceDirtyTasksReference(
+        const std::vector<PrepareLightsTask>& tasks,
+        const std::vector<uint8_t>& taskDirty,
+        std::vector<PrepareLightsTask>& dirtyTasks)
+    {
+        dirtyTasks.clear();
+        uint32_t numThreads = 0;
+        for (size_t index = 0; index < tasks.size(); ++index)
+        {
+            if (!taskDirty[index])
+                continue;
+
+            PrepareLightsTask task = tasks[index];
+            task.previousLightBufferOffset = int(task.lightBufferOffset);
+            task.dispatchOffset = numThreads;
+            numThreads += task.triangleCount;
+            dirtyTasks.push_back(task);
+        }
+        return numThreads;
+    }
+
+    template<typename T>
+    bool AreBitIdentical(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    tf::Executor* GetExecutor()
+    {
+#ifdef DONUT_WITH_TASKFLOW
+        static tf::Executor executor;
+        return &executor;
+#else
+        // Without taskflow, the chunked code runs serially and is only compared to the reference
+        return nullptr;
+#endif
+    }
+}
+
+RTXDI_TEST(ParallelPrepareLights_EmitterGatherIsBitIdentical)
+{
+    tf::Executor* executor = GetExecutor();
+
+    for (size_t instanceCount : { size_t(0), size_t(1000), size_t(100000), size_t(1000000) })
+    {
+        SyntheticSceneGraph scene;
+        CreateSceneGraph(scene, instanceCount, uint32_t(instanceCount) + 1);
+
+        const std::vector<LayoutEmitter> reference = GatherEmittersReference(scene);
+
+        // Start from stale contents, like on a later frame
+        std::vector<LayoutEmitter> serial(5);
+        std::vector<LayoutEmitter> parallel;
+        GatherGeometryEmitters(nullptr, scene, serial);
+        GatherGeometryEmitters(executor, scene, parallel);
+
+        RTXDI_CHECK(instanceCount == 0 || !reference.empty());
+        RTXDI_CHECK(AreEmittersEqual(serial, reference));
+        RTXDI_CHECK(AreEmittersEqual(parallel, serial));
+    }
+}
+
+RTXDI_TEST(ParallelPrepareLights_LayoutTasksAreBitIdentical)
+{
+    tf::Executor* executor = GetExecutor();
+
+    for (size_t instanceCount : { size_t(0), size_t(1000), size_t(100000) })
+    {
+        SyntheticSceneGraph scene;
+        CreateSceneGraph(scene, instanceCount, uint32_t(instanceCount) + 3);
+
+        std::vector<LayoutEmitter> emitters;
+        GatherGeometryEmitters(executor, scene, emitters);
+        const uint32_t numLights = PackEmitters(emitters);
+
+        std::vector<PrepareLightsTask> serialTasks;
+        std::vector<PrepareLightsTask> parallelTasks;
+        std::vector<uint32_t> serialMapping(3, 0);
+        std::vector<uint32_t> parallelMapping;
+        BuildLayoutTasks(nullptr, emitters, scene.geometryInstanceCount, serialTasks, serialMapping);
+        BuildLayoutTasks(executor, emitters, scene.geometryInstanceCount, parallelTasks, parallelMapping);
+
+        RTXDI_CHECK(AreBitIdentical(parallelTasks, serialTasks));
+        RTXDI_CHECK(AreBitIdentical(parallelMapping, serialMapping));
+        RTXDI_CHECK_EQUAL(serialTasks.size(), emitters.size());
+        RTXDI_CHECK_EQUAL(serialMapping.size(), size_t(scene.geometryInstanceCount));
+
+        // The geometry instances map onto the first light of their emitters, the others onto no light
+        size_t numMappedGeometryInstances = 0;
+        for (const LayoutEmitter& emitter : emitters)
+            RTXDI_CHECK_EQUAL(serialMapping[emitter.geometryInstanceIndex], emitter.lightBufferOffset);
+        for (uint32_t lightIndex : serialMapping)
+            numMappedGeometryInstances += (lightIndex != RTXDI_INVALID_LIGHT_INDEX) ? 1 : 0;
+        RTXDI_CHECK_EQUAL(numMappedGeometryInstances, emitters.size());
+
+        // Every light of an emitter is found by the dispatch and stores the emitter index
+        std::vector<uint32_t> visibleLightIndex(numLights, TASK_EMPTY_SLOTS);
+        WriteVisibleLightIndices(serialTasks, numLights, visibleLightIndex);
+        for (const LayoutEmitter& emitter : emitters)
+        {
+            RTXDI_CHECK_EQUAL(GetVisibilityBufferLightIndex(visibleLightIndex, emitter.lightBufferOffset, numLights), int(emitter.emitterIndex));
+            RTXDI_CHECK_EQUAL(GetVisibilityBufferLightIndex(visibleLightIndex, emitter.lightBufferOffset + emitter.count - 1, numLights), int(emitter.emitterIndex));
+        }
+    }
+}
+
+RTXDI_TEST(ParallelPrepareLights_DirtyTasksAreBitIdentical)
+{
+    tf::Executor* executor = GetExecutor();
+    std::mt19937 rng(3);
+
+    for (size_t instanceCount : { size_t(100000), size_t(1000000) })
+    {
+        SyntheticSceneGraph scene;
+        CreateSceneGraph(scene, instanceCount, uint32_t(instanceCount) + 2);
+
+        std::vector<LayoutEmitter> emitters = GatherEmittersReference(scene);
+        PackEmitters(emitters);
+
+        std::vector<PrepareLightsTask> tasks;
+        std::vector<uint32_t> geometryInstanceToLight;
+        BuildLayoutTasks(nullptr, emitters, scene.geometryInstanceCount, tasks, geometryInstanceToLight);
+
+        // No changes, a few changes, and everything dirty like the first frame after a relocation
+        for (uint32_t dirtyPercentage : { 0u, 1u, 10u, 100u })
+        {
+            std::vector<uint8_t> taskDirty(tasks.size());
+            for (uint8_t& dirty : taskDirty)
+                dirty = (rng() % 100 < dirtyPercentage) ? 1 : 0;
+
+            std::vector<PrepareLightsTask> reference;
+            const uint32_t referenceThreads = BuildInPlaceDirtyTasksReference(tasks, taskDirty, reference);
+
+            // Start from stale contents, like m_DirtyTasks on a later frame
+            std::vector<PrepareLightsTask> serial = tasks;
+            std::vector<PrepareLightsTask> parallel = tasks;
+            const uint32_t serialThreads = BuildInPlaceDirtyTasks(nullptr, tasks, taskDirty, serial);
+            const uint32_t parallelThreads = BuildInPlaceDirtyTasks(executor, tasks, taskDirty, parallel);
+
+            RTXDI_CHECK_EQUAL(serialThreads, referenceThreads);
+            RTXDI_CHECK_EQUAL(parallelThreads, serialThreads);
+            RTXDI_CHECK(AreBitIdentical(serial, reference));
+            RTXDI_CHECK(AreBitIdentical(parallel, serial));
+        }
+    }
+}
@@ -0,0 +1,222 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "LightSlotAllocator.h"
+#include "PrepareLightsTasks.h"
+
+#include <donut/core/math/math.h>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct TestEmitter
+    {
+        uint32_t offset;
+        uint32_t count;
+        uint32_t emitterIndex;
+    };
+
+    const uint32_t c_Capacity = 1 << 16;
+
+    // Value of the light -> emitter mapping elements that have never been written, like uninitialized GPU memory
+    const uint32_t c_Garbage = 0x12345678;
+
+    // The reference: the old implementation of GetVisibilityBufferLightIndex scanned the emitters
+    int FindEmitterLinear(const std::vector<TestEmitter>& emitters, uint32_t lightBufferOffset)
+    {
+        for (const TestEmitter& emitter : emitters)
+        {
+            if (lightBufferOffset >= emitter.offset && lightBufferOffset < emitter.offset + emitter.count)
+                return int(emitter.emitterIndex);
+        }
+        return -1;
+    }
+
+    PrepareLightsTask MakeTask(uint32_t offset, uint32_t count, uint32_t emitterIndex)
+    {
+        PrepareLightsTask task{};
+        task.instanceAndGeometryIndex = (emitterIndex == TASK_EMPTY_SLOTS) ? TASK_EMPTY_SLOTS : 0;
+        task.lightBufferOffset = offset;
+        task.triangleCount = count;
+        task.previousLightBufferOffset = -1;
+        task.emitterIndex = emitterIndex;
+        return task;
+    }
+
+    // Sorts the tasks by light buffer offset and packs their threads, like PrepareLightsPass does for the dirty tasks
+    uint32_t AssignDispatchOffsets(std::vector<PrepareLightsTask>& tasks)
+    {
+        std::sort(tasks.begin(), tasks.end(), [](const PrepareLightsTask& a, const PrepareLightsTask& b)
+            { return a.lightBufferOffset < b.lightBufferOffset; });
+
+        uint32_t numThreads = 0;
+        for (PrepareLightsTask& task : tasks)
+        {
+            task.dispatchOffset = numThreads;
+            numThreads += task.triangleCount;
+        }
+        return numThreads;
+    }
+
+    uint32_t RandomEmitterSize(std::mt19937& rng)
+    {
+        // Mostly small meshes, some single primitive lights and a few large meshes
+        switch (rng() % 8)
+        {
+        case 0: return 1;
+        case 1: return 200 + rng() % 800;
+        default: return 1 + rng() % 32;
+        }
+    }
+
+    void CheckLookup(const std::vector<TestEmitter>& emitters, const std::vector<uint32_t>& visibleLightIndex, uint32_t numLights)
+    {
+        for (uint32_t offset = 0; offset < numLights + 64; offset++)
+        {
+            const int expected = (offset < numLights) ? FindEmitterLinear(emitters, offset) : -1;
+            RTXDI_CHECK_EQUAL(GetVisibilityBufferLightIndex(visibleLightIndex, offset, numLights), expected);
+        }
+    }
+}
+
+RTXDI_TEST(PrepareLightsTasks_FindTask)
+{
+    std::mt19937 rng(7);
+
+    for (int iteration = 0; iteration < 100; iteration++)
+    {
+        // Tasks with gaps between their dispatch ranges, which can't happen in a dispatch but must not be matched
+        std::vector<PrepareLightsTask> tasks;
+        uint32_t dispatchOffset = rng() % 4;
+        const uint32_t numTasks = rng() % 200;
+        for (uint32_t i = 0; i < numTasks; i++)
+        {
+            PrepareLightsTask task = MakeTask(0, RandomEmitterSize(rng), i);
+            task.dispatchOffset = dispatchOffset;
+            dispatchOffset += task.triangleCount + ((rng() % 4 == 0) ? rng() % 10 : 0);
+            tasks.push_back(task);
+        }
+
+        for (uint32_t thread = 0; thread < dispatchOffset + 16; thread++)
+        {
+            int expected = -1;
+            for (size_t i = 0; i < tasks.size(); i++)
+            {
+                if (thread >= tasks[i].dispatchOffset && thread < tasks[i].dispatchOffset + tasks[i].triangleCount)
+                    expected = int(i);
+            }
+
+            RTXDI_CHECK_EQUAL(FindPrepareLightsTask(tasks, thread), expected);
+        }
+    }
+}
+
+RTXDI_TEST(PrepareLightsTasks_EmitterLookupMatchesLinearScan)
+{
+    std::mt19937 rng(11);
+
+    for (int layout = 0; layout < 20; layout++)
+    {
+        LightSlotAllocator allocator(c_Capacity);
+        std::vector<TestEmitter> emitters;
+        std::vector<uint32_t> visibleLightIndex(c_Capacity, c_Garbage);
+        uint32_t nextEmitterIndex = 0;
+
+        // The first frame relocates the lights: all emitters and all holes are written
+        const uint32_t initialEmitters = 50 + rng() % 500;
+        for (uint32_t i = 0; i < initialEmitters; i++)
+        {
+            TestEmitter emitter{ 0, RandomEmitterSize(rng), nextEmitterIndex++ };
+            if (allocator.Allocate(emitter.count, emitter.offset))
+                emitters.push_back(emitter);
+        }
+
+        // Remove some emitters to leave holes in the used range
+        for (size_t i = 0; i < emitters.size(); )
+        {
+            if (rng() % 4 == 0)
+            {
+                allocator.Free(emitters[i].offset, emitters[i].count);
+                emitters.erase(emitters.begin() + i);
+            }
+            else
+                i++;
+        }
+
+        std::vector<PrepareLightsTask> tasks;
+        for (const TestEmitter& emitter : emitters)
+            tasks.push_back(MakeTask(emitter.offset, emitter.count, emitter.emitterIndex));
+        for (const auto& [offset, count] : allocator.GetFreeRanges())
+        {
+            if (offset < allocator.GetUsedRangeEnd())
+                tasks.push_back(MakeTask(offset, count, TASK_EMPTY_SLOTS));
+        }
+
+        uint32_t numThreads = AssignDispatchOffsets(tasks);
+        WriteVisibleLightIndices(tasks, numThreads, visibleLightIndex);
+        CheckLookup(emitters, visibleLightIndex, allocator.GetUsedRangeEnd());
+
+        // The following frames are incremental: only new emitters, changed emitters and released slots are written
+        for (int frame = 0; frame < 10; frame++)
+        {
+            std::vector<PrepareLightsTask> dirtyTasks;
+            std::vector<std::pair<uint32_t, uint32_t>> freedRanges;
+
+            for (size_t i = 0; i < emitters.size(); )
+            {
+                const uint32_t action = rng() % 16;
+                if (action == 0)
+                {
+                    freedRanges.push_back({ emitters[i].offset, emitters[i].count });
+                    allocator.Free(emitters[i].offset, emitters[i].count);
+                    emitters.erase(emitters.begin() + i);
+                    continue;
+                }
+
+                if (action == 1)
+                    dirtyTasks.push_back(MakeTask(emitters[i].offset, emitters[i].count, emitters[i].emitterIndex));
+                i++;
+            }
+
+            const uint32_t newEmitters = rng() % 20;
+            for (uint32_t i = 0; i < newEmitters; i++)
+            {
+                TestEmitter emitter{ 0, RandomEmitterSize(rng), nextEmitterIndex++ };
+                if (!allocator.Allocate(emitter.count, emitter.offset))
+                    continue;
+
+                emitters.push_back(emitter);
+                dirtyTasks.push_back(MakeTask(emitter.offset, emitter.count, emitter.emitterIndex));
+            }
+
+            // Released slots that were not reused are cleared, the reused ones are covered by the new emitters
+            for (const auto& [freedOffset, freedCount] : freedRanges)
+            {
+                for (uint32_t slot = freedOffset; slot < freedOffset + freedCount; slot++)
+                {
+                    if (FindEmitterLinear(emitters, slot) < 0)
+                        dirtyTasks.push_back(MakeTask(slot, 1, TASK_EMPTY_SLOTS));
+                }
+            }
+
+            numThreads = AssignDispatchOffsets(dirtyTasks);
+            WriteVisibleLightIndices(dirtyTasks, numThreads, visibleLightIndex);
+            CheckLookup(emitters, visibleLightIndex, allocator.GetUsedRangeEnd());
+        }
+    }
+}
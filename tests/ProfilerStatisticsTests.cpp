@@ -0,0 +1,174 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "ProfilerStatistics.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const double c_Tolerance = 1e-9;
+
+    uint32_t GetHistogramTotal(const TimingStatistics& stats)
+    {
+        uint32_t total = 0;
+        for (uint32_t count : stats.histogram)
+            total += count;
+        return total;
+    }
+}
+
+RTXDI_TEST(ProfilerStatistics_KnownPercentiles)
+{
+    // 1 to 100 in a shuffled order, the statistics don't depend on the order of the samples
+    std::vector<double> samples;
+    for (int value = 1; value <= 100; value++)
+        samples.push_back(double(value));
+    std::mt19937 rng(1);
+    std::shuffle(samples.begin(), samples.end(), rng);
+
+    TimingHistory history;
+    for (double sample : samples)
+        history.AddSample(sample);
+
+    const TimingStatistics stats = history.ComputeStatistics(10);
+    RTXDI_CHECK_EQUAL(stats.sampleCount, 100u);
+    RTXDI_CHECK_NEAR(stats.mean, 50.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.min, 1.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.max, 100.0, c_Tolerance);
+
+    // Linear interpolation between the closest ranks: rank = p / 100 * (N - 1)
+    RTXDI_CHECK_NEAR(stats.p50, 50.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p95, 95.05, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p99, 99.01, c_Tolerance);
+
+    RTXDI_CHECK_EQUAL(stats.histogram.size(), size_t(10));
+    RTXDI_CHECK_NEAR(stats.GetHistogramBinWidth(), 9.9, c_Tolerance);
+    for (uint32_t count : stats.histogram)
+        RTXDI_CHECK_EQUAL(count, 10u);
+}
+
+RTXDI_TEST(ProfilerStatistics_Spikes)
+{
+    // 990 frames at 10 ms and 10 frames at 50 ms: the spikes only show above p99
+    TimingHistory history;
+    for (int frame = 0; frame < 1000; frame++)
+        history.AddSample((frame % 100 == 0) ? 50.0 : 10.0);
+
+    const TimingStatistics stats = history.ComputeStatistics(4);
+    RTXDI_CHECK_NEAR(stats.mean, 10.4, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p50, 10.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p95, 10.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p99, 10.4, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.max, 50.0, c_Tolerance);
+
+    RTXDI_CHECK_EQUAL(stats.histogram[0], 990u);
+    RTXDI_CHECK_EQUAL(stats.histogram[1], 0u);
+    RTXDI_CHECK_EQUAL(stats.histogram[2], 0u);
+    RTXDI_CHECK_EQUAL(stats.histogram[3], 10u);
+}
+
+RTXDI_TEST(ProfilerStatistics_SingleSample)
+{
+    TimingHistory history;
+    history.AddSample(5.0);
+
+    const TimingStatistics stats = history.ComputeStatistics(4);
+    RTXDI_CHECK_EQUAL(stats.sampleCount, 1u);
+    RTXDI_CHECK_NEAR(stats.mean, 5.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.min, 5.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p50, 5.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p95, 5.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p99, 5.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.max, 5.0, c_Tolerance);
+
+    RTXDI_CHECK_EQUAL(stats.histogram.size(), size_t(4));
+    RTXDI_CHECK_EQUAL(stats.histogram[0], 1u);
+    RTXDI_CHECK_EQUAL(GetHistogramTotal(stats), 1u);
+    RTXDI_CHECK_EQUAL(stats.GetHistogramBinWidth(), 0.0);
+}
+
+RTXDI_TEST(ProfilerStatistics_AllSamplesEqual)
+{
+    TimingHistory history;
+    for (int frame = 0; frame < 50; frame++)
+        history.AddSample(2.5);
+
+    // All the samples are in the first bin
+    const TimingStatistics stats = history.ComputeStatistics();
+    RTXDI_CHECK_EQUAL(stats.sampleCount, 50u);
+    RTXDI_CHECK_NEAR(stats.mean, 2.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.min, 2.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p50, 2.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p99, 2.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.max, 2.5, c_Tolerance);
+
+    RTXDI_CHECK_EQUAL(stats.histogram.size(), size_t(TimingHistory::c_DefaultHistogramBins));
+    RTXDI_CHECK_EQUAL(stats.histogram[0], 50u);
+    RTXDI_CHECK_EQUAL(GetHistogramTotal(stats), 50u);
+}
+
+RTXDI_TEST(ProfilerStatistics_RingWraparound)
+{
+    TimingHistory history(8);
+
+    // Partially wrapped: 0 and 1 are replaced by 8 and 9
+    for (int frame = 0; frame < 10; frame++)
+        history.AddSample(double(frame));
+
+    RTXDI_CHECK_EQUAL(history.GetSampleCount(), size_t(8));
+    TimingStatistics stats = history.ComputeStatistics(8);
+    RTXDI_CHECK_NEAR(stats.min, 2.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.max, 9.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p50, 5.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.mean, 5.5, c_Tolerance);
+    for (uint32_t count : stats.histogram)
+        RTXDI_CHECK_EQUAL(count, 1u);
+
+    // Wrapped more than once, only 12 to 19 remain
+    for (int frame = 10; frame < 20; frame++)
+        history.AddSample(double(frame));
+
+    RTXDI_CHECK_EQUAL(history.GetSampleCount(), size_t(8));
+    stats = history.ComputeStatistics(8);
+    RTXDI_CHECK_NEAR(stats.min, 12.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.max, 19.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p50, 15.5, c_Tolerance);
+    RTXDI_CHECK_NEAR(stats.p95, 18.65, c_Tolerance);
+    RTXDI_CHECK_EQUAL(GetHistogramTotal(stats), 8u);
+
+    // A reset starts filling from the beginning again
+    history.Reset();
+    RTXDI_CHECK_EQUAL(history.GetSampleCount(), size_t(0));
+    RTXDI_CHECK_EQUAL(history.ComputeStatistics().sampleCount, 0u);
+    RTXDI_CHECK(history.ComputeStatistics().histogram.empty());
+
+    history.AddSample(3.0);
+    RTXDI_CHECK_EQUAL(history.GetSampleCount(), size_t(1));
+    RTXDI_CHECK_NEAR(history.ComputeStatistics().max, 3.0, c_Tolerance);
+}
+
+RTXDI_TEST(ProfilerStatistics_GetPercentile)
+{
+    const std::vector<double> sorted = { 1.0, 2.0, 4.0, 8.0 };
+    RTXDI_CHECK_NEAR(TimingHistory::GetPercentile(sorted, 0.0), 1.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(TimingHistory::GetPercentile(sorted, 50.0), 3.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(TimingHistory::GetPercentile(sorted, 100.0), 8.0, c_Tolerance);
+
+    // Out of range percentiles are clamped
+    RTXDI_CHECK_NEAR(TimingHistory::GetPercentile(sorted, -10.0), 1.0, c_Tolerance);
+    RTXDI_CHECK_NEAR(TimingHistory::GetPercentile(sorted, 150.0), 8.0, c_Tolerance);
+
+    RTXDI_CHECK_NEAR(TimingHistory::GetPercentile({ 7.0 }, 95.0), 7.0, c_Tolerance);
+}
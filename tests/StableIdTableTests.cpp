@@ -0,0 +1,131 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "StableIdTable.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Object
+    {
+        int value = 0;
+    };
+
+    using ObjectList = std::vector<std::shared_ptr<Object>>;
+
+    bool UpdateIds(StableIdTable<Object>& table, const ObjectList& objects)
+    {
+        return table.Update(nullptr, objects.size(), [&objects](size_t position) -> const std::shared_ptr<Object>& { return objects[position]; });
+    }
+}
+
+RTXDI_TEST(StableIdTable_KeepsIdsOfMovedObjects)
+{
+    ObjectList objects;
+    for (int index = 0; index < 10; index++)
+        objects.push_back(std::make_shared<Object>());
+
+    StableIdTable<Object> table;
+    RTXDI_CHECK(UpdateIds(table, objects));
+    const std::vector<StableId> firstIds = table.GetIds();
+    RTXDI_CHECK_EQUAL(table.GetIndexCount(), 10u);
+
+    RTXDI_CHECK(!UpdateIds(table, objects));
+    RTXDI_CHECK(table.GetIds() == firstIds);
+
+    // Reversing the list changes the IDs at every position, but not the IDs of the objects
+    ObjectList reversed(objects.rbegin(), objects.rend());
+    RTXDI_CHECK(UpdateIds(table, reversed));
+    for (size_t position = 0; position < reversed.size(); position++)
+        RTXDI_CHECK(table.GetIds()[position] == firstIds[reversed.size() - 1 - position]);
+
+    RTXDI_CHECK_EQUAL(table.GetIndexCount(), 10u);
+}
+
+RTXDI_TEST(StableIdTable_ReusedAddressGetsNewGeneration)
+{
+    ObjectList objects = { std::make_shared<Object>(), std::make_shared<Object>() };
+
+    StableIdTable<Object> table;
+    UpdateIds(table, objects);
+    const StableId removedId = table.GetIds()[1];
+
+    // Replace the second object. The allocation is likely to reuse the freed memory, but even if it does,
+    // the new object has a different control block, and the released index comes back with a new generation.
+    objects[1].reset();
+    objects[1] = std::make_shared<Object>();
+
+    RTXDI_CHECK(UpdateIds(table, objects));
+    const StableId newId = table.GetIds()[1];
+    RTXDI_CHECK(newId != removedId);
+    RTXDI_CHECK_EQUAL(newId.index, removedId.index);
+    RTXDI_CHECK_EQUAL(newId.generation, removedId.generation + 1);
+    RTXDI_CHECK_EQUAL(table.GetIndexCount(), 2u);
+}
+
+RTXDI_TEST(StableIdTable_RandomUpdates)
+{
+    // Objects are added, removed and shuffled at random, and compared with the IDs they had in the last update
+    std::mt19937 rng(1);
+    ObjectList objects;
+    std::vector<std::pair<std::weak_ptr<Object>, StableId>> previousIds;
+    size_t maxObjects = 0;
+
+    StableIdTable<Object> table;
+    for (int update = 0; update < 300; update++)
+    {
+        const uint32_t removals = uint32_t(objects.empty() ? 0 : rng() % std::min<size_t>(objects.size(), 8));
+        for (uint32_t removal = 0; removal < removals; removal++)
+            objects.erase(objects.begin() + rng() % objects.size());
+
+        const uint32_t additions = rng() % 8;
+        for (uint32_t addition = 0; addition < additions; addition++)
+            objects.insert(objects.begin() + rng() % (objects.size() + 1), std::make_shared<Object>());
+
+        if (rng() % 4 == 0)
+            std::shuffle(objects.begin(), objects.end(), rng);
+
+        maxObjects = std::max(maxObjects, objects.size());
+        UpdateIds(table, objects);
+        const std::vector<StableId>& ids = table.GetIds();
+        RTXDI_CHECK_EQUAL(ids.size(), objects.size());
+        RTXDI_CHECK(table.GetIndexCount() <= maxObjects);
+
+        // Objects that were there before keep their IDs, and no two objects share an ID index
+        std::vector<bool> usedIndices(table.GetIndexCount(), false);
+        for (size_t position = 0; position < objects.size(); position++)
+        {
+            RTXDI_CHECK(ids[position].index < table.GetIndexCount());
+            if (ids[position].index >= table.GetIndexCount())
+                continue;
+
+            RTXDI_CHECK(!usedIndices[ids[position].index]);
+            usedIndices[ids[position].index] = true;
+
+            for (const auto& [object, id] : previousIds)
+            {
+                if (object.lock() == objects[position])
+                    RTXDI_CHECK(id == ids[position]);
+                else
+                    RTXDI_CHECK(id != ids[position]);
+            }
+        }
+
+        previousIds.clear();
+        for (size_t position = 0; position < objects.size(); position++)
+            previousIds.push_back({ objects[position], ids[position] });
+    }
+}
@@ -0,0 +1,191 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestFramework.h"
+
+#include "TransientResourcePlanner.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct ResourceDesc
+    {
+        uint64_t size;
+        uint64_t alignment;
+        uint32_t firstPass;
+        uint32_t lastPass;
+    };
+
+    bool MemoryOverlaps(uint64_t offsetA, uint64_t sizeA, uint64_t offsetB, uint64_t sizeB)
+    {
+        return offsetA < offsetB + sizeB && offsetB < offsetA + sizeA;
+    }
+
+    // Checks a plan against the descriptions of its resources: every resource is aligned and inside the heap,
+    // resources with overlapping lifetimes never share memory, and the heap is between the peak of the live bytes
+    // and the total size plus the alignment padding.
+    void CheckPlan(const TransientResourcePlanner& planner, const std::vector<ResourceDesc>& resources, uint32_t passCount)
+    {
+        const uint64_t heapSize = planner.GetHeapSize();
+        uint64_t totalBytes = 0;
+        uint64_t maxPadding = 0;
+
+        for (uint32_t index = 0; index < uint32_t(resources.size()); index++)
+        {
+            const ResourceDesc& resource = resources[index];
+            const uint64_t offset = planner.GetOffset(index);
+
+            RTXDI_CHECK_EQUAL(offset % resource.alignment, 0u);
+            RTXDI_CHECK(offset + resource.size <= heapSize);
+
+            totalBytes += resource.size;
+            maxPadding += resource.alignment - 1;
+
+            bool sharesMemory = false;
+            for (uint32_t other = 0; other < uint32_t(resources.size()); other++)
+            {
+                if (other == index)
+                    continue;
+
+                const ResourceDesc& otherResource = resources[other];
+                if (!MemoryOverlaps(offset, resource.size, planner.GetOffset(other), otherResource.size))
+                    continue;
+
+                sharesMemory = true;
+                RTXDI_CHECK(!TransientResourcePlanner::LifetimesOverlap(
+                    resource.firstPass, resource.lastPass, otherResource.firstPass, otherResource.lastPass));
+            }
+
+            RTXDI_CHECK_EQUAL(planner.IsAliased(index), sharesMemory);
+        }
+
+        uint64_t peakLiveBytes = 0;
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            uint64_t liveBytes = 0;
+            for (const ResourceDesc& resource : resources)
+                liveBytes += (resource.firstPass <= pass && pass <= resource.lastPass) ? resource.size : 0;
+            peakLiveBytes = std::max(peakLiveBytes, liveBytes);
+        }
+
+        RTXDI_CHECK_EQUAL(planner.GetTotalResourceBytes(), totalBytes);
+        RTXDI_CHECK(heapSize >= peakLiveBytes);
+        RTXDI_CHECK(heapSize <= totalBytes + maxPadding);
+        RTXDI_CHECK_EQUAL(planner.GetSavedBytes(), totalBytes - heapSize);
+    }
+}
+
+RTXDI_TEST(TransientResourcePlanner_DisjointLifetimesShareMemory)
+{
+    TransientResourcePlanner planner;
+    const uint32_t a = planner.AddResource("a", 100, 1, 0, 1);
+    const uint32_t b = planner.AddResource("b", 100, 1, 2, 3);
+    planner.Plan();
+
+    RTXDI_CHECK_EQUAL(planner.GetHeapSize(), 100u);
+    RTXDI_CHECK_EQUAL(planner.GetOffset(a), planner.GetOffset(b));
+    RTXDI_CHECK(planner.IsAliased(a));
+    RTXDI_CHECK(planner.IsAliased(b));
+    RTXDI_CHECK_EQUAL(planner.GetSavedBytes(), 100u);
+    RTXDI_CHECK(planner.GetName(b) == "b");
+
+    // Lifetimes are inclusive, so sharing a pass is an overlap
+    TransientResourcePlanner touching;
+    touching.AddResource("a", 100, 1, 0, 2);
+    touching.AddResource("b", 100, 1, 2, 3);
+    touching.Plan();
+
+    RTXDI_CHECK_EQUAL(touching.GetHeapSize(), 200u);
+    RTXDI_CHECK(!touching.IsAliased(0));
+    RTXDI_CHECK(!touching.IsAliased(1));
+}
+
+RTXDI_TEST(TransientResourcePlanner_Alignment)
+{
+    TransientResourcePlanner planner;
+    planner.AddResource("a", 100, 1, 0, 0);
+    const uint32_t b = planner.AddResource("b", 50, 64, 0, 0);
+    planner.Plan();
+
+    RTXDI_CHECK_EQUAL(planner.GetOffset(b), 128u);
+    RTXDI_CHECK_EQUAL(planner.GetHeapSize(), 178u);
+}
+
+RTXDI_TEST(TransientResourcePlanner_FillsGaps)
+{
+    // 'z' fits between 'x' and 'y', which only overlap 'z' in memory, not in time
+    TransientResourcePlanner planner;
+    planner.AddResource("big", 1000, 1, 0, 5);
+    const uint32_t x = planner.AddResource("x", 400, 1, 0, 1);
+    const uint32_t y = planner.AddResource("y", 400, 1, 4, 5);
+    const uint32_t z = planner.AddResource("z", 300, 1, 2, 3);
+    planner.Plan();
+
+    RTXDI_CHECK_EQUAL(planner.GetHeapSize(), 1400u);
+    RTXDI_CHECK_EQUAL(planner.GetOffset(x), 1000u);
+    RTXDI_CHECK_EQUAL(planner.GetOffset(y), 1000u);
+    RTXDI_CHECK_EQUAL(planner.GetOffset(z), 1000u);
+}
+
+RTXDI_TEST(TransientResourcePlanner_RandomPlansAreValid)
+{
+    const uint32_t passCount = 8;
+    std::mt19937 rng(1);
+
+    for (int iteration = 0; iteration < 5000; iteration++)
+    {
+        TransientResourcePlanner planner;
+        std::vector<ResourceDesc> resources;
+
+        const uint32_t resourceCount = 1 + rng() % 16;
+        for (uint32_t index = 0; index < resourceCount; index++)
+        {
+            ResourceDesc resource;
+            resource.firstPass = rng() % passCount;
+            resource.lastPass = resource.firstPass + rng() % (passCount - resource.firstPass);
+            resource.alignment = uint64_t(1) << (rng() % 17);
+            resource.size = (iteration % 4 == 0) ? resource.alignment * (1 + rng() % 8) : 1 + rng() % 100000;
+            resources.push_back(resource);
+
+            RTXDI_CHECK_EQUAL(planner.AddResource("resource", resource.size, resource.alignment, resource.firstPass, resource.lastPass), index);
+        }
+
+        planner.Plan();
+        CheckPlan(planner, resources, passCount);
+
+        // Planning again after adding a resource that is live in every pass
+        const ResourceDesc persistent = { 4096, 256, 0, passCount - 1 };
+        resources.push_back(persistent);
+        planner.AddResource("persistent", persistent.size, persistent.alignment, persistent.firstPass, persistent.lastPass);
+        planner.Plan();
+        CheckPlan(planner, resources, passCount);
+        RTXDI_CHECK(!planner.IsAliased(resourceCount));
+    }
+}
+
+RTXDI_TEST(TransientResourcePlanner_Empty)
+{
+    TransientResourcePlanner planner;
+    planner.Plan();
+    RTXDI_CHECK_EQUAL(planner.GetHeapSize(), 0u);
+    RTXDI_CHECK_EQUAL(planner.GetResourceCount(), 0u);
+
+    planner.AddResource("a", 100, 16, 0, 0);
+    planner.Plan();
+    RTXDI_CHECK_EQUAL(planner.GetHeapSize(), 100u);
+
+    planner.Reset();
+    planner.Plan();
+    RTXDI_CHECK_EQUAL(planner.GetHeapSize(), 0u);
+    RTXDI_CHECK_EQUAL(planner.GetTotalResourceBytes(), 0u);
+}